@@ -0,0 +1,53 @@
+#
+# Locate SQLite3
+#
+# This module accepts the following environment variables:
+#
+#    SQLITE3_DIR or SQLITE3_ROOT - Specify the location of SQLite3
+#
+# This module defines the following CMake variables:
+#
+#    SQLITE3_FOUND - True if libsqlite3 is found
+#    SQLITE3_LIBRARY - A variable pointing to the SQLite3 library
+#    SQLITE3_INCLUDE_DIR - Where to find the headers
+
+find_path(SQLITE3_INCLUDE_DIR sqlite3.h
+  HINTS
+    ENV SQLITE3_DIR
+    ENV SQLITE3_ROOT
+  PATH_SUFFIXES
+    include
+)
+
+if(UNIX)
+  find_library(SQLITE3_LIBRARY
+    NAMES sqlite3
+    HINTS
+      ENV SQLITE3_DIR
+      ENV SQLITE3_ROOT
+    PATH_SUFFIXES lib
+  )
+elseif(WIN32)
+  find_library(SQLITE3_LIBRARY_RELEASE
+               NAMES sqlite3 sqlite
+               PATH_SUFFIXES lib)
+
+  find_library(SQLITE3_LIBRARY_DEBUG
+               NAMES sqlite3d sqlite3_d sqlited
+               PATH_SUFFIXES lib)
+
+  if(SQLITE3_LIBRARY_RELEASE AND SQLITE3_LIBRARY_DEBUG)
+    set(SQLITE3_LIBRARY optimized ${SQLITE3_LIBRARY_RELEASE} debug ${SQLITE3_LIBRARY_DEBUG})
+  elseif(SQLITE3_LIBRARY_RELEASE)
+    set(SQLITE3_LIBRARY optimized ${SQLITE3_LIBRARY_RELEASE} debug ${SQLITE3_LIBRARY_RELEASE})
+  elseif(SQLITE3_LIBRARY_DEBUG)
+    set(SQLITE3_LIBRARY optimized ${SQLITE3_LIBRARY_DEBUG} debug ${SQLITE3_LIBRARY_DEBUG})
+  endif()
+endif()
+
+include(FindPackageHandleStandardArgs)
+
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(SQLite3 DEFAULT_MSG SQLITE3_LIBRARY SQLITE3_INCLUDE_DIR)
+
+set(SQLITE3_LIBRARIES ${SQLITE3_LIBRARY})
+set(SQLITE3_INCLUDE_DIRS ${SQLITE3_INCLUDE_DIR})
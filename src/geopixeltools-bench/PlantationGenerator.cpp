@@ -0,0 +1,321 @@
+/*!
+  \file geopx-desktop/src/geopixeltools-bench/PlantationGenerator.cpp
+
+  \brief This class creates synthetic plantations used to measure the track classification.
+*/
+
+#include "PlantationGenerator.h"
+
+//TerraLib Includes
+#include <terralib/datatype/Enums.h>
+#include <terralib/geometry/Envelope.h>
+#include <terralib/geometry/Geometry.h>
+#include <terralib/geometry/Utils.h>
+#include <terralib/memory/ExpansibleRaster.h>
+#include <terralib/raster/BandProperty.h>
+#include <terralib/raster/Grid.h>
+#include <terralib/raster/Raster.h>
+#include <terralib/srs/Config.h>
+
+//STL Includes
+#include <algorithm>
+#include <cmath>
+
+#define NDVI_SOIL 40.
+#define NDVI_CANOPY 200.
+#define PLANTATION_PI 3.14159265358979323846
+
+geopx::bench::PlantationParameters::PlantationParameters() :
+  m_parcelsX(4),
+  m_parcelsY(4),
+  m_parcelSize(100.),
+  m_parcelGap(20.),
+  m_rowAngle(0.),
+  m_treeSpacing(2.),
+  m_rowSpacing(3.),
+  m_gapRate(0.05),
+  m_deadRate(0.5),
+  m_noise(0.1),
+  m_intruderRate(0.01),
+  m_resolution(0.5),
+  m_knownDirection(true),
+  m_seed(7)
+{
+}
+
+geopx::bench::PlantationGenerator::PlantationGenerator() :
+  m_plantedCount(0)
+{
+}
+
+geopx::bench::PlantationGenerator::~PlantationGenerator()
+{
+}
+
+void geopx::bench::PlantationGenerator::generate(const PlantationParameters& params)
+{
+  m_params = params;
+  m_random.seed(params.m_seed);
+
+  m_centroidIndex.clear();
+  m_classCache.clear();
+  m_parcels.clear();
+  m_rows.clear();
+  m_types.clear();
+  m_areas.clear();
+  m_rootIds.clear();
+  m_rootParcels.clear();
+  m_plantedCount = 0;
+
+  //create the NDVI raster over all parcels, filled with the soil value
+  double step = params.m_parcelSize + params.m_parcelGap;
+
+  unsigned int nCols = static_cast<unsigned int>(std::ceil(params.m_parcelsX * step / params.m_resolution));
+  unsigned int nRows = static_cast<unsigned int>(std::ceil(params.m_parcelsY * step / params.m_resolution));
+
+  te::gm::Envelope* extent = new te::gm::Envelope(0., 0., nCols * params.m_resolution, nRows * params.m_resolution);
+
+  te::rst::Grid* grid = new te::rst::Grid(nCols, nRows, extent, TE_UNKNOWN_SRS);
+
+  std::vector<te::rst::BandProperty*> bandsProperties;
+  bandsProperties.push_back(new te::rst::BandProperty(0, te::dt::UCHAR_TYPE));
+
+  m_ndviRaster.reset(new te::mem::ExpansibleRaster(10, grid, bandsProperties));
+
+  for(unsigned int r = 0; r < nRows; ++r)
+  {
+    for(unsigned int c = 0; c < nCols; ++c)
+      m_ndviRaster->setValue(c, r, NDVI_SOIL, 0);
+  }
+
+  //plant the parcels
+  int parcelId = 0;
+
+  for(std::size_t py = 0; py < params.m_parcelsY; ++py)
+  {
+    for(std::size_t px = 0; px < params.m_parcelsX; ++px)
+    {
+      double llx = px * step + params.m_parcelGap / 2.;
+      double lly = py * step + params.m_parcelGap / 2.;
+
+      te::gm::Envelope env(llx, lly, llx + params.m_parcelSize, lly + params.m_parcelSize);
+
+      tools::TrackParcel parcel;
+      parcel.m_id = parcelId;
+      parcel.m_geom.reset(te::gm::GetGeomFromEnvelope(&env, TE_UNKNOWN_SRS));
+      parcel.m_hasDirection = params.m_knownDirection;
+      parcel.m_dirX = std::cos(params.m_rowAngle * PLANTATION_PI / 180.);
+      parcel.m_dirY = std::sin(params.m_rowAngle * PLANTATION_PI / 180.);
+
+      m_parcels.push_back(std::move(parcel));
+
+      plantParcel(parcelId, llx, lly);
+
+      ++parcelId;
+    }
+  }
+
+  m_centroidIndex.build();
+
+  //the classification follows the index positions
+  for(std::size_t pos = 0; pos < m_centroidIndex.size(); ++pos)
+  {
+    int id = m_centroidIndex.getId(pos);
+
+    m_classCache.insert(pos, m_types[id], m_areas[id]);
+  }
+
+  //the roots keep the creation order, as the layer order of the tools
+  for(std::size_t t = 0; t < m_rootIds.size(); ++t)
+  {
+    std::size_t pos = 0;
+
+    if(m_centroidIndex.find(m_rootIds[t], pos))
+      m_parcels[m_rootParcels[t]].m_roots.push_back(pos);
+  }
+}
+
+const geopx::tools::SpatialIndex& geopx::bench::PlantationGenerator::getCentroidIndex() const
+{
+  return m_centroidIndex;
+}
+
+const geopx::tools::ClassificationCache& geopx::bench::PlantationGenerator::getClassCache() const
+{
+  return m_classCache;
+}
+
+const std::vector<geopx::tools::TrackParcel>& geopx::bench::PlantationGenerator::getParcels() const
+{
+  return m_parcels;
+}
+
+const std::vector<geopx::bench::PlantationRow>& geopx::bench::PlantationGenerator::getRows() const
+{
+  return m_rows;
+}
+
+te::rst::Raster* geopx::bench::PlantationGenerator::getNdviRaster() const
+{
+  return m_ndviRaster.get();
+}
+
+std::size_t geopx::bench::PlantationGenerator::getPlantedCount() const
+{
+  return m_plantedCount;
+}
+
+void geopx::bench::PlantationGenerator::setSearchCounter(std::atomic<unsigned long long>* counter)
+{
+  m_centroidIndex.setSearchCounter(counter);
+}
+
+void geopx::bench::PlantationGenerator::plantParcel(int parcelId, double llx, double lly)
+{
+  std::uniform_real_distribution<double> uniform(0., 1.);
+  std::uniform_real_distribution<double> noise(-m_params.m_noise, m_params.m_noise);
+  std::uniform_real_distribution<double> area(0.3, 1.5);
+
+  double size = m_params.m_parcelSize;
+
+  //the planted positions keep half a tree spacing from the parcel boundary
+  double margin = m_params.m_treeSpacing / 2.;
+
+  double ux = std::cos(m_params.m_rowAngle * PLANTATION_PI / 180.);
+  double uy = std::sin(m_params.m_rowAngle * PLANTATION_PI / 180.);
+
+  double cx = llx + size / 2.;
+  double cy = lly + size / 2.;
+
+  double radius = size * std::sqrt(2.) / 2.;
+
+  int nRows = static_cast<int>(radius / m_params.m_rowSpacing);
+  int nTrees = static_cast<int>(std::ceil(radius / m_params.m_treeSpacing));
+
+  std::size_t parcelPlanted = 0;
+
+  for(int k = -nRows; k <= nRows; ++k)
+  {
+    //row origin, moved from the parcel center along the row normal
+    double ox = cx - uy * k * m_params.m_rowSpacing;
+    double oy = cy + ux * k * m_params.m_rowSpacing;
+
+    std::vector<std::pair<double, double> > positions;
+
+    for(int j = -nTrees; j <= nTrees; ++j)
+    {
+      double x = ox + ux * j * m_params.m_treeSpacing;
+      double y = oy + uy * j * m_params.m_treeSpacing;
+
+      if(x < llx + margin || x > llx + size - margin || y < lly + margin || y > lly + size - margin)
+        continue;
+
+      positions.push_back(std::make_pair(x, y));
+    }
+
+    if(positions.size() < 2)
+      continue;
+
+    PlantationRow row;
+    row.m_parcelId = parcelId;
+    row.m_x0 = positions.front().first;
+    row.m_y0 = positions.front().second;
+    row.m_x1 = positions.back().first;
+    row.m_y1 = positions.back().second;
+
+    m_rows.push_back(row);
+
+    //the root of the row is the centroid nearest to the middle of the row
+    int rootId = -1;
+    std::size_t middle = positions.size() / 2;
+    std::size_t rootDistance = positions.size();
+
+    for(std::size_t t = 0; t < positions.size(); ++t)
+    {
+      double x = positions[t].first;
+      double y = positions[t].second;
+
+      if(uniform(m_random) < m_params.m_gapRate)
+      {
+        //dead trees keep the soil value, the other gaps are live trees that were not extracted
+        if(uniform(m_random) >= m_params.m_deadRate)
+          paint(x, y, m_params.m_treeSpacing / 4., NDVI_CANOPY);
+
+        continue;
+      }
+
+      x += noise(m_random);
+      y += noise(m_random);
+
+      int id = static_cast<int>(m_types.size());
+
+      m_centroidIndex.add(id, x, y);
+      m_types.push_back(CLASSIFICATION_UNKNOWN);
+      m_areas.push_back(area(m_random));
+
+      paint(x, y, m_params.m_treeSpacing / 4., NDVI_CANOPY);
+
+      std::size_t distance = (t > middle) ? t - middle : middle - t;
+
+      if(distance < rootDistance)
+      {
+        rootDistance = distance;
+        rootId = id;
+      }
+    }
+
+    parcelPlanted += positions.size();
+
+    if(rootId >= 0)
+    {
+      m_types[rootId] = CLASSIFICATION_CREATED;
+
+      m_rootIds.push_back(rootId);
+      m_rootParcels.push_back(parcelId);
+    }
+  }
+
+  //intruders at random locations inside the parcel
+  std::uniform_real_distribution<double> location(margin, size - margin);
+
+  std::size_t nIntruders = static_cast<std::size_t>(m_params.m_intruderRate * parcelPlanted + 0.5);
+
+  for(std::size_t t = 0; t < nIntruders; ++t)
+  {
+    int id = static_cast<int>(m_types.size());
+
+    m_centroidIndex.add(id, llx + location(m_random), lly + location(m_random));
+    m_types.push_back(CLASSIFICATION_UNKNOWN);
+    m_areas.push_back(area(m_random));
+  }
+
+  m_plantedCount += parcelPlanted;
+}
+
+void geopx::bench::PlantationGenerator::paint(double x, double y, double radius, double value)
+{
+  double res = m_params.m_resolution;
+
+  const te::gm::Envelope* extent = m_ndviRaster->getExtent();
+
+  int nCols = static_cast<int>(m_ndviRaster->getNumberOfColumns());
+  int nRows = static_cast<int>(m_ndviRaster->getNumberOfRows());
+
+  int c0 = std::max(0, static_cast<int>((x - radius - extent->m_llx) / res));
+  int c1 = std::min(nCols - 1, static_cast<int>((x + radius - extent->m_llx) / res));
+  int r0 = std::max(0, static_cast<int>((extent->m_ury - (y + radius)) / res));
+  int r1 = std::min(nRows - 1, static_cast<int>((extent->m_ury - (y - radius)) / res));
+
+  for(int r = r0; r <= r1; ++r)
+  {
+    for(int c = c0; c <= c1; ++c)
+    {
+      //pixel center
+      double px = extent->m_llx + (c + 0.5) * res;
+      double py = extent->m_ury - (r + 0.5) * res;
+
+      if((px - x) * (px - x) + (py - y) * (py - y) <= radius * radius)
+        m_ndviRaster->setValue(c, r, value, 0);
+    }
+  }
+}
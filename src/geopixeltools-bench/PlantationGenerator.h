@@ -0,0 +1,137 @@
+/*!
+  \file geopx-desktop/src/geopixeltools-bench/PlantationGenerator.h
+
+  \brief This class creates synthetic plantations used to measure the track classification.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_BENCH_PLANTATIONGENERATOR_H
+#define __GEOPXDESKTOP_TOOLS_BENCH_PLANTATIONGENERATOR_H
+
+#include "../geopixeltools/forestMonitor/core/ClassificationCache.h"
+#include "../geopixeltools/forestMonitor/core/SpatialIndex.h"
+#include "../geopixeltools/forestMonitor/core/TrackEngine.h"
+
+//STL Includes
+#include <atomic>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace te { namespace rst { class Raster; } }
+
+namespace geopx
+{
+  namespace bench
+  {
+    /*!
+      \struct PlantationParameters
+
+      \brief The layout of a synthetic plantation (distances in meters).
+    */
+    struct PlantationParameters
+    {
+      PlantationParameters();
+
+      std::size_t m_parcelsX;       //!< Number of parcel columns.
+      std::size_t m_parcelsY;       //!< Number of parcel rows.
+      double m_parcelSize;          //!< Width and height of each parcel.
+      double m_parcelGap;           //!< Distance between neighbor parcels.
+      double m_rowAngle;            //!< Rows azimuth in degrees, counter clockwise from the x axis.
+      double m_treeSpacing;         //!< Distance between the trees of a row.
+      double m_rowSpacing;          //!< Distance between the rows.
+      double m_gapRate;             //!< Fraction of the planted positions without a centroid.
+      double m_deadRate;            //!< Fraction of the gaps that are dead trees (low NDVI), the others are live trees not extracted.
+      double m_noise;               //!< Maximum offset of a centroid from its planted position.
+      double m_intruderRate;        //!< Number of intruders (random centroids) for each planted position.
+      double m_resolution;          //!< Pixel size of the NDVI raster.
+      bool m_knownDirection;        //!< If false the parcels have no direction line (the engine estimates it).
+      unsigned int m_seed;          //!< Seed of the random generator.
+    };
+
+    /*!
+      \struct PlantationRow
+
+      \brief A planted row, from its first to its last planted position inside the parcel.
+    */
+    struct PlantationRow
+    {
+      int m_parcelId;
+      double m_x0;
+      double m_y0;
+      double m_x1;
+      double m_y1;
+    };
+
+    /*!
+      \class PlantationGenerator
+
+      \brief Creates the inputs of the track engine for a synthetic plantation: the centroid
+             index, the classification, the parcels with one created root for each row and a
+             matching NDVI raster.
+
+      The parcels are squares laid out in a grid, the rows cross each parcel with the same
+      angle. The NDVI raster has high values over the live trees (extracted or not) and low
+      values over the soil and the dead trees, so the trees created by the tracks in the gaps
+      get the expected type.
+    */
+    class PlantationGenerator
+    {
+      public:
+
+        PlantationGenerator();
+
+        ~PlantationGenerator();
+
+      public:
+
+        /*! \brief Creates a new plantation, the previous one is dropped. */
+        void generate(const PlantationParameters& params);
+
+        const tools::SpatialIndex& getCentroidIndex() const;
+
+        const tools::ClassificationCache& getClassCache() const;
+
+        const std::vector<tools::TrackParcel>& getParcels() const;
+
+        const std::vector<PlantationRow>& getRows() const;
+
+        /*! \brief Returns the NDVI raster (owned by the generator). */
+        te::rst::Raster* getNdviRaster() const;
+
+        /*! \brief Returns the number of planted positions (centroids and gaps). */
+        std::size_t getPlantedCount() const;
+
+        /*! \brief Counts the queries to the centroid index, null stops counting. */
+        void setSearchCounter(std::atomic<unsigned long long>* counter);
+
+      protected:
+
+        /*! \brief Plants the rows of a parcel, the centroids are added to the items of the index. */
+        void plantParcel(int parcelId, double llx, double lly);
+
+        /*! \brief Sets the NDVI of the pixels inside the disk. */
+        void paint(double x, double y, double radius, double value);
+
+      protected:
+
+        PlantationParameters m_params;
+
+        std::mt19937 m_random;                                //!< The random generator.
+
+        tools::SpatialIndex m_centroidIndex;                  //!< The centroids (id is the creation order).
+        tools::ClassificationCache m_classCache;              //!< The classification of the centroids (index positions).
+        std::vector<tools::TrackParcel> m_parcels;            //!< The parcels and their roots.
+        std::vector<PlantationRow> m_rows;                    //!< The planted rows.
+        std::unique_ptr<te::rst::Raster> m_ndviRaster;        //!< The NDVI raster.
+
+        std::vector<unsigned char> m_types;                   //!< Type of each centroid (id).
+        std::vector<double> m_areas;                          //!< Area of each centroid (id).
+        std::vector<int> m_rootIds;                           //!< Id of the root of each row.
+        std::vector<int> m_rootParcels;                       //!< Parcel of each root.
+        std::size_t m_plantedCount;                           //!< Number of planted positions.
+    };
+
+  }  // end namespace bench
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_BENCH_PLANTATIONGENERATOR_H
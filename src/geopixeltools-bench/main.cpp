@@ -0,0 +1,469 @@
+/*!
+  \file geopx-desktop/src/geopixeltools-bench/main.cpp
+
+  \brief It contains the main routine of the track classification and tile generation benchmark.
+*/
+
+#include "PlantationGenerator.h"
+#include "../geopixeltools/forestMonitor/core/NdviSampler.h"
+#include "../geopixeltools/forestMonitor/core/ParallelTrackClassifier.h"
+#include "../geopixeltools/tileGenerator/core/RasterTileReader.h"
+#include "../geopixeltools/tileGenerator/core/Tile.h"
+#include "../geopixeltools/tileGenerator/core/TileEncoder.h"
+#include "../geopixeltools/tileGenerator/core/TileEncoderPool.h"
+#include "../geopixeltools/tileGenerator/core/TilePyramid.h"
+#include "../geopixeltools/tileGenerator/core/TileSink.h"
+#include "../geopixeltools/tileGenerator/core/TileStatistics.h"
+
+// TerraLib
+#include <terralib/common/TerraLib.h>
+#include <terralib/core/Exception.h>
+#include <terralib/raster/Raster.h>
+
+// Boost
+#include <boost/filesystem.hpp>
+
+// STL
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  std::atomic<unsigned long long> g_allocations(0);       //!< Number of calls to operator new.
+  std::atomic<unsigned long long> g_allocatedBytes(0);    //!< Bytes requested to operator new.
+
+  struct BenchOptions
+  {
+    BenchOptions() : m_threads(0), m_fitTrack(false), m_batchSteps(TRACK_BATCH_STEPS), m_repeat(3), m_tileLevels(0), m_tileSize(256) {}
+
+    std::size_t m_threads;        //!< Worker threads of the parcel classification and the tiles, 0 to use the hardware threads.
+    bool m_fitTrack;              //!< Uses the line fit track predictor.
+    std::size_t m_batchSteps;     //!< Number of track steps searched by one index query.
+    std::size_t m_repeat;         //!< Number of runs of each phase, the fastest run is reported.
+    int m_tileLevels;             //!< Zoom levels of the tiles phase, 0 to skip it.
+    int m_tileSize;               //!< Tile width and height.
+    std::string m_tileReport;     //!< JSON report of the tiles phase, not written if empty.
+  };
+
+  struct PhaseStats
+  {
+    PhaseStats() : m_seconds(0.), m_tracks(0), m_trees(0), m_queries(0), m_allocations(0), m_bytes(0) {}
+
+    double m_seconds;
+    std::size_t m_tracks;
+    std::size_t m_trees;                  //!< Trees of the tracks (centroids and created trees).
+    unsigned long long m_queries;         //!< Spatial index queries.
+    unsigned long long m_allocations;
+    unsigned long long m_bytes;
+  };
+
+  void PrintUsage()
+  {
+    std::cerr << "Usage: geopixeltools-bench [options]" << std::endl
+              << "  --parcels-x <n>       parcel columns (4)" << std::endl
+              << "  --parcels-y <n>       parcel rows (4)" << std::endl
+              << "  --parcel-size <m>     parcel width and height (100)" << std::endl
+              << "  --angle <degrees>     rows azimuth (0)" << std::endl
+              << "  --spacing <m>         distance between trees (2)" << std::endl
+              << "  --row-spacing <m>     distance between rows (3)" << std::endl
+              << "  --gaps <rate>         planted positions without centroid (0.05)" << std::endl
+              << "  --dead <rate>         gaps that are dead trees (0.5)" << std::endl
+              << "  --noise <m>           centroid offset (0.1)" << std::endl
+              << "  --intruders <rate>    intruders per planted position (0.01)" << std::endl
+              << "  --no-direction        parcels without direction line" << std::endl
+              << "  --seed <n>            random seed (7)" << std::endl
+              << "  --threads <n>         worker threads, 0 for all cores (0)" << std::endl
+              << "  --fit-track           line fit track predictor" << std::endl
+              << "  --batch-steps <n>     track steps for each index query (" << TRACK_BATCH_STEPS << ")" << std::endl
+              << "  --repeat <n>          runs of each phase, the fastest is reported (3)" << std::endl
+              << "  --tile-levels <n>     zoom levels of the tiles phase, 0 to skip it (0)" << std::endl
+              << "  --tile-size <n>       tile width and height (256)" << std::endl
+              << "  --tile-report <file>  JSON report of the tiles phase" << std::endl;
+  }
+
+  bool ParseArguments(int argc, char** argv, geopx::bench::PlantationParameters& params, BenchOptions& options)
+  {
+    for(int i = 1; i < argc; ++i)
+    {
+      std::string key = argv[i];
+
+      if(key == "--no-direction")
+      {
+        params.m_knownDirection = false;
+        continue;
+      }
+
+      if(key == "--fit-track")
+      {
+        options.m_fitTrack = true;
+        continue;
+      }
+
+      if(i + 1 >= argc)
+        return false;
+
+      const char* value = argv[++i];
+
+      if(key == "--parcels-x")
+        params.m_parcelsX = std::strtoul(value, 0, 10);
+      else if(key == "--parcels-y")
+        params.m_parcelsY = std::strtoul(value, 0, 10);
+      else if(key == "--parcel-size")
+        params.m_parcelSize = std::strtod(value, 0);
+      else if(key == "--angle")
+        params.m_rowAngle = std::strtod(value, 0);
+      else if(key == "--spacing")
+        params.m_treeSpacing = std::strtod(value, 0);
+      else if(key == "--row-spacing")
+        params.m_rowSpacing = std::strtod(value, 0);
+      else if(key == "--gaps")
+        params.m_gapRate = std::strtod(value, 0);
+      else if(key == "--dead")
+        params.m_deadRate = std::strtod(value, 0);
+      else if(key == "--noise")
+        params.m_noise = std::strtod(value, 0);
+      else if(key == "--intruders")
+        params.m_intruderRate = std::strtod(value, 0);
+      else if(key == "--seed")
+        params.m_seed = static_cast<unsigned int>(std::strtoul(value, 0, 10));
+      else if(key == "--threads")
+        options.m_threads = std::strtoul(value, 0, 10);
+      else if(key == "--batch-steps")
+        options.m_batchSteps = std::strtoul(value, 0, 10);
+      else if(key == "--repeat")
+        options.m_repeat = std::strtoul(value, 0, 10);
+      else if(key == "--tile-levels")
+        options.m_tileLevels = std::atoi(value);
+      else if(key == "--tile-size")
+        options.m_tileSize = std::atoi(value);
+      else if(key == "--tile-report")
+        options.m_tileReport = value;
+      else
+        return false;
+    }
+
+    return params.m_treeSpacing > 0. && params.m_rowSpacing > 0. && options.m_repeat > 0 && options.m_tileLevels >= 0 && options.m_tileSize > 0;
+  }
+
+  /*! Runs a phase the given number of times and keeps the fastest run */
+  template<class Phase> PhaseStats Measure(std::size_t repeat, std::atomic<unsigned long long>& queries, Phase phase)
+  {
+    PhaseStats best;
+
+    for(std::size_t r = 0; r < repeat; ++r)
+    {
+      PhaseStats stats;
+
+      queries = 0;
+
+      unsigned long long allocations = g_allocations;
+      unsigned long long bytes = g_allocatedBytes;
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+      phase(stats);
+
+      stats.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      stats.m_queries = queries;
+      stats.m_allocations = g_allocations - allocations;
+      stats.m_bytes = g_allocatedBytes - bytes;
+
+      if(r == 0 || stats.m_seconds < best.m_seconds)
+        best = stats;
+    }
+
+    return best;
+  }
+
+  /*!
+    Creates the tiles of the NDVI raster as the raster mode of the tile generator: the maximum
+    level is read from the raster blocks in Z-order, the lower levels are built in memory and
+    the tiles are encoded as PNG by the encoder threads and written to a temporary directory.
+  */
+  void RunTiles(te::rst::Raster* raster, const BenchOptions& options, geopx::tools::TileStatistics& statistics)
+  {
+    te::gm::Envelope env(*raster->getExtent());
+
+    int maxLevel = geopx::tools::Tile(raster->getResolutionX(), options.m_tileSize).bestZoomLevel(raster->getResolutionX());
+    int minLevel = std::max(0, maxLevel - options.m_tileLevels + 1);
+
+    geopx::tools::Tile tile(maxLevel, options.m_tileSize);
+
+    long tIdxX1, tIdxY1, tIdxX2, tIdxY2;
+
+    tile.tileMatrix(env, tIdxX1, tIdxY1, tIdxX2, tIdxY2);
+
+    std::vector<std::pair<long, long> > tiles;
+
+    for(long k = tIdxY2; k <= tIdxY1; ++k)
+    {
+      for(long j = tIdxX1; j <= tIdxX2; ++j)
+        tiles.push_back(std::make_pair(j, k));
+    }
+
+    std::sort(tiles.begin(), tiles.end(), [](const std::pair<long, long>& a, const std::pair<long, long>& b)
+    {
+      return geopx::tools::TilePyramid::getZOrder(a.first, a.second) < geopx::tools::TilePyramid::getZOrder(b.first, b.second);
+    });
+
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("geopixeltools-bench-%%%%-%%%%");
+
+    boost::filesystem::create_directories(path);
+
+    statistics.start(minLevel, maxLevel);
+
+    try
+    {
+      geopx::tools::DirectoryTileSink sink(path.string(), "PNG");
+
+      sink.setStatistics(&statistics);
+
+      geopx::tools::ImageTileEncoder encoder("PNG");
+
+      geopx::tools::TileEncoderPool pool(encoder, sink, options.m_threads, &statistics);
+
+      geopx::tools::TilePyramid pyramid(env, minLevel, maxLevel, options.m_tileSize, &statistics);
+
+      //the NDVI raster has a single 8 bit band, read as gray
+      geopx::tools::RasterTileReader reader(raster, std::vector<std::size_t>(1, 0), Qt::transparent);
+
+      geopx::tools::TilePyramid::Consumer save = [&pool](int level, long x, long y, const QImage& image)
+      {
+        pool.add(level, x, y, image);
+      };
+
+      std::atomic<std::size_t> next(0);
+
+      auto worker = [&]()
+      {
+        for(std::size_t idx = next++; idx < tiles.size(); idx = next++)
+        {
+          QImage image;
+
+          {
+            geopx::tools::TileStageTimer timer(&statistics, geopx::tools::TILE_STAGE_DRAW, maxLevel);
+
+            image = reader.read(tile.tileBox(tiles[idx].first, tiles[idx].second), raster->getSRID(), options.m_tileSize, options.m_tileSize);
+          }
+
+          save(maxLevel, tiles[idx].first, tiles[idx].second, image);
+
+          pyramid.add(maxLevel, tiles[idx].first, tiles[idx].second, image, save);
+        }
+      };
+
+      std::size_t nThreads = options.m_threads ? options.m_threads : std::max<unsigned int>(1, std::thread::hardware_concurrency());
+
+      std::vector<std::thread> threads;
+
+      for(std::size_t t = 0; t < nThreads; ++t)
+        threads.push_back(std::thread(worker));
+
+      for(std::size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+      pool.finish();
+    }
+    catch(...)
+    {
+      boost::filesystem::remove_all(path);
+
+      throw;
+    }
+
+    statistics.stop();
+
+    boost::filesystem::remove_all(path);
+  }
+
+  void Report(const std::string& name, const PhaseStats& stats)
+  {
+    double seconds = stats.m_seconds > 0. ? stats.m_seconds : 1e-9;
+
+    std::cout << std::fixed << std::setprecision(3)
+              << name << ": " << stats.m_tracks << " tracks, " << stats.m_trees << " trees in " << stats.m_seconds << " s" << std::endl
+              << std::setprecision(0)
+              << "  " << stats.m_tracks / seconds << " tracks/s, " << stats.m_trees / seconds << " trees/s" << std::endl
+              << "  " << stats.m_queries << " index queries (" << std::setprecision(1) << static_cast<double>(stats.m_queries) / std::max<std::size_t>(stats.m_tracks, 1) << " per track)" << std::endl
+              << "  " << stats.m_allocations << " allocations, " << stats.m_bytes / 1024 << " KB" << std::endl;
+  }
+}
+
+/*
+  The allocations of the phases are counted by replacing the global operators (the operators
+  of the shared libraries are replaced too, except on Windows).
+*/
+void* operator new(std::size_t size)
+{
+  ++g_allocations;
+  g_allocatedBytes += size;
+
+  if(void* p = std::malloc(size ? size : 1))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+
+int main(int argc, char** argv)
+{
+  geopx::bench::PlantationParameters params;
+
+  BenchOptions options;
+
+  if(!ParseArguments(argc, argv, params, options))
+  {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  //set locale info
+  setlocale(LC_ALL, "C"); // This force to use "." as decimal separator.
+
+  int ret = EXIT_SUCCESS;
+
+  TerraLib::getInstance().initialize();
+
+  try
+  {
+    geopx::bench::PlantationGenerator generator;
+
+    generator.generate(params);
+
+    std::atomic<unsigned long long> queries(0);
+
+    generator.setSearchCounter(&queries);
+
+    const geopx::tools::SpatialIndex& centroidIndex = generator.getCentroidIndex();
+
+    std::cout << "plantation: " << generator.getParcels().size() << " parcels, " << generator.getRows().size() << " rows, "
+              << generator.getPlantedCount() << " planted positions, " << centroidIndex.size() << " centroids" << std::endl;
+
+    geopx::tools::NdviSampler sampler(generator.getNdviRaster());
+
+    geopx::tools::TrackParameters trackParams;
+    trackParams.m_distance = params.m_treeSpacing;
+    trackParams.m_distanceTrack = params.m_rowSpacing;
+    trackParams.m_predictor = options.m_fitTrack ? geopx::tools::TRACK_PREDICTOR_LINE_FIT : geopx::tools::TRACK_PREDICTOR_STEP;
+    trackParams.m_batchSteps = options.m_batchSteps;
+
+    geopx::tools::TrackEngine engine(centroidIndex, generator.getClassCache(), &sampler, trackParams);
+
+    //auto classifier: the tracks of all parcels, from the created roots
+    PhaseStats autoStats = Measure(options.m_repeat, queries, [&](PhaseStats& stats)
+    {
+      geopx::tools::ParallelTrackClassifier classifier(engine, options.m_threads);
+
+      classifier.run(generator.getParcels(), [&stats](const geopx::tools::TrackParcel&, std::vector<geopx::tools::TrackResult>& results)
+      {
+        for(std::size_t t = 0; t < results.size(); ++t)
+        {
+          ++stats.m_tracks;
+          stats.m_trees += results[t].m_live.size() + results[t].m_created.size();
+        }
+      });
+    });
+
+    Report("auto", autoStats);
+
+    //dead classifier: one segment track for each planted row
+    PhaseStats deadStats = Measure(options.m_repeat, queries, [&](PhaseStats& stats)
+    {
+      const std::vector<geopx::bench::PlantationRow>& rows = generator.getRows();
+
+      for(std::size_t t = 0; t < rows.size(); ++t)
+      {
+        geopx::tools::TrackResult result;
+
+        if(!engine.classifySegment(rows[t].m_parcelId, rows[t].m_x0, rows[t].m_y0, rows[t].m_x1, rows[t].m_y1, 0, result))
+          continue;
+
+        ++stats.m_tracks;
+        stats.m_trees += result.m_live.size() + result.m_created.size();
+      }
+    });
+
+    Report("dead", deadStats);
+
+    generator.setSearchCounter(0);
+
+    //tiles of the NDVI raster, the fastest run is reported
+    if(options.m_tileLevels > 0)
+    {
+      std::unique_ptr<geopx::tools::TileStatistics> tileStats;
+
+      for(std::size_t r = 0; r < options.m_repeat; ++r)
+      {
+        std::unique_ptr<geopx::tools::TileStatistics> stats(new geopx::tools::TileStatistics);
+
+        RunTiles(generator.getNdviRaster(), options, *stats);
+
+        if(!tileStats.get() || stats->getSeconds() < tileStats->getSeconds())
+          tileStats = std::move(stats);
+      }
+
+      std::cout << std::endl << tileStats->getSummary();
+
+      if(!options.m_tileReport.empty())
+      {
+        std::ofstream report(options.m_tileReport.c_str());
+
+        if(!report)
+          throw te::core::Exception() << te::ErrorDescription("Error creating the report file " + options.m_tileReport + ".");
+
+        tileStats->writeJSON(report);
+      }
+    }
+  }
+  catch(const boost::exception& e)
+  {
+    if(const std::string* d = boost::get_error_info<te::ErrorDescription>(e))
+      std::cerr << "Error: " << *d << std::endl;
+    else
+      std::cerr << "Error: an unknown error has occurred" << std::endl;
+
+    ret = EXIT_FAILURE;
+  }
+  catch(const std::exception& e)
+  {
+    std::cerr << "Error: " << e.what() << std::endl;
+
+    ret = EXIT_FAILURE;
+  }
+  catch(...)
+  {
+    std::cerr << "Error: an unknown error has occurred" << std::endl;
+
+    ret = EXIT_FAILURE;
+  }
+
+  TerraLib::getInstance().finalize();
+
+  return ret;
+}
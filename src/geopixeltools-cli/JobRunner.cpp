@@ -0,0 +1,433 @@
+/*!
+  \file geopx-desktop/src/geopixeltools-cli/JobRunner.cpp
+
+  \brief This class runs the forest monitor stages described in a job file without any user interface.
+*/
+
+#include "JobRunner.h"
+#include "../geopixeltools/forestMonitor/core/ClassificationCache.h"
+#include "../geopixeltools/forestMonitor/core/ForestMonitorClassification.h"
+#include "../geopixeltools/forestMonitor/core/ForestMonitorService.h"
+#include "../geopixeltools/forestMonitor/core/LayerIndex.h"
+#include "../geopixeltools/forestMonitor/core/NDVI.h"
+#include "../geopixeltools/forestMonitor/core/NdviSampler.h"
+#include "../geopixeltools/forestMonitor/core/ParallelTrackClassifier.h"
+#include "../geopixeltools/forestMonitor/core/ParcelCache.h"
+#include "../geopixeltools/forestMonitor/core/SpatialIndex.h"
+#include "../geopixeltools/forestMonitor/core/TrackEngine.h"
+#include "../geopixeltools/forestMonitor/core/TrackParcels.h"
+#include "../geopixeltools/forestMonitor/core/TrackResultWriter.h"
+
+//TerraLib Includes
+#include <terralib/common/STLUtils.h>
+#include <terralib/core/Exception.h>
+#include <terralib/dataaccess/dataset/DataSet.h>
+#include <terralib/dataaccess/dataset/DataSetType.h>
+#include <terralib/dataaccess/datasource/DataSourceInfo.h>
+#include <terralib/dataaccess/datasource/DataSourceInfoManager.h>
+#include <terralib/dataaccess/datasource/DataSourceManager.h>
+#include <terralib/dataaccess/utils/Utils.h>
+#include <terralib/geometry/GeometryProperty.h>
+#include <terralib/maptools/DataSetLayer.h>
+#include <terralib/memory/DataSet.h>
+#include <terralib/raster/Grid.h>
+#include <terralib/raster/Raster.h>
+#include <terralib/raster/RasterProperty.h>
+
+// Boost
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/uuid/random_generator.hpp>
+#include <boost/uuid/uuid_io.hpp>
+
+//STL Includes
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#define GEOPXCLI_PI 3.14159265358979323846
+
+geopx::cli::JobRunner::JobRunner()
+{
+}
+
+geopx::cli::JobRunner::~JobRunner()
+{
+}
+
+void geopx::cli::JobRunner::load(const std::string& fileName)
+{
+  try
+  {
+    boost::property_tree::json_parser::read_json(fileName, m_job);
+  }
+  catch(const boost::property_tree::json_parser_error& e)
+  {
+    throw te::core::Exception() << te::ErrorDescription("Invalid job file: " + std::string(e.what()));
+  }
+
+  if(!m_job.get_child_optional("ndvi") && !m_job.get_child_optional("classify") && !m_job.get_child_optional("autoclassify") &&
+     !m_job.get_child_optional("tracks"))
+    throw te::core::Exception() << te::ErrorDescription("The job file does not define any stage.");
+}
+
+void geopx::cli::JobRunner::run()
+{
+  if(boost::optional<boost::property_tree::ptree&> stage = m_job.get_child_optional("ndvi"))
+  {
+    std::cout << "Running stage: ndvi" << std::endl;
+
+    runNDVI(*stage);
+  }
+
+  if(boost::optional<boost::property_tree::ptree&> stage = m_job.get_child_optional("classify"))
+  {
+    std::cout << "Running stage: classify" << std::endl;
+
+    runClassify(*stage);
+  }
+
+  if(boost::optional<boost::property_tree::ptree&> stage = m_job.get_child_optional("autoclassify"))
+  {
+    std::cout << "Running stage: autoclassify" << std::endl;
+
+    runAutoClassify(*stage);
+  }
+
+  if(boost::optional<boost::property_tree::ptree&> stage = m_job.get_child_optional("tracks"))
+  {
+    std::cout << "Running stage: tracks" << std::endl;
+
+    runTracks(*stage);
+  }
+}
+
+void geopx::cli::JobRunner::runNDVI(const boost::property_tree::ptree& stage)
+{
+  std::string output = getPath(stage, "output", "");
+
+  //get input rasters
+  te::map::AbstractLayerPtr nirLayer = openLayer(getPath(stage, "nir", ""), "GDAL");
+  te::map::AbstractLayerPtr visLayer = openLayer(getPath(stage, "vis", ""), "GDAL");
+
+  std::unique_ptr<te::da::DataSet> nirDS = nirLayer->getData();
+  std::size_t rpos = te::da::GetFirstPropertyPos(nirDS.get(), te::dt::RASTER_TYPE);
+  std::unique_ptr<te::rst::Raster> nirRaster = nirDS->getRaster(rpos);
+
+  std::unique_ptr<te::da::DataSet> visDS = visLayer->getData();
+  rpos = te::da::GetFirstPropertyPos(visDS.get(), te::dt::RASTER_TYPE);
+  std::unique_ptr<te::rst::Raster> visRaster = visDS->getRaster(rpos);
+
+  int nirBand = stage.get<int>("nirBand", 0);
+  int visBand = stage.get<int>("visBand", 0);
+
+  double gain = stage.get<double>("gain", 1.);
+  double offset = stage.get<double>("offset", 0.);
+
+  bool normalize = stage.get<bool>("normalize", false);
+  bool invert = stage.get<bool>("invert", false);
+  bool rgbVIS = stage.get<bool>("rgbVIS", false);
+
+  //rinfo information
+  std::string type = "GDAL";
+  std::map<std::string, std::string> rInfo;
+  rInfo["URI"] = output;
+
+  std::unique_ptr<te::rst::Raster> rOut = geopx::tools::GenerateNDVIRaster(nirRaster.get(), nirBand, visRaster.get(), visBand, gain, offset, normalize, rInfo, type, visLayer->getSRID(), invert, rgbVIS);
+
+  if(!rOut.get())
+    throw te::core::Exception() << te::ErrorDescription("Error generating the NDVI raster.");
+
+  m_ndviFile = output;
+}
+
+void geopx::cli::JobRunner::runClassify(const boost::property_tree::ptree& stage)
+{
+  std::string output = getPath(stage, "output", "");
+
+  m_parcelFile = getPath(stage, "parcels", "");
+
+  //get ndvi raster
+  te::map::AbstractLayerPtr ndviLayer = openLayer(getPath(stage, "ndvi", m_ndviFile), "GDAL");
+
+  std::unique_ptr<te::da::DataSet> ndviDS = ndviLayer->getData();
+  std::size_t rpos = te::da::GetFirstPropertyPos(ndviDS.get(), te::dt::RASTER_TYPE);
+  std::unique_ptr<te::rst::Raster> ndviRst = ndviDS->getRaster(rpos);
+
+  ndviRst->getGrid()->setSRID(ndviLayer->getSRID());
+
+  int ndviBand = stage.get<int>("band", 0);
+
+  boost::optional<double> threshold = stage.get_optional<double>("threshold");
+
+  if(!threshold)
+    throw te::core::Exception() << te::ErrorDescription("Threshold not defined.");
+
+  int dilation = stage.get<int>("dilation", 0);
+  int erosion = stage.get<int>("erosion", 0);
+
+  bool saveImages = stage.get<bool>("saveImages", false);
+
+  te::map::AbstractLayerPtr parcelLayer = openLayer(m_parcelFile, "OGR");
+
+  //output data sources
+  boost::filesystem::path outPath(output);
+
+  std::string dataSetName = outPath.stem().string();
+
+  std::string repName = (outPath.parent_path() / outPath.stem()).string();
+
+  te::da::DataSourcePtr outputDataSource = createDataSource(output, "OGR");
+
+  te::da::DataSourcePtr polyOutputDataSource = createDataSource(repName + "_polygons" + ".shp", "OGR");
+
+  std::vector<geopx::tools::CentroidInfo*> centroidsVec;
+
+  std::vector<te::gm::Geometry*> fullGeomVec;
+
+  try
+  {
+    geopx::tools::ClassifyParcels(ndviRst.get(), ndviBand, parcelLayer, *threshold, dilation, erosion, repName, saveImages, centroidsVec, fullGeomVec);
+
+    //export data
+    geopx::tools::ExportVector(centroidsVec, dataSetName, "OGR", outputDataSource->getConnectionInfo(), ndviRst->getSRID());
+
+    geopx::tools::ExportPolyVector(fullGeomVec, dataSetName + "_polygons", "OGR", polyOutputDataSource->getConnectionInfo(), ndviRst->getSRID());
+  }
+  catch(...)
+  {
+    te::common::FreeContents(centroidsVec);
+    te::common::FreeContents(fullGeomVec);
+
+    throw;
+  }
+
+  te::common::FreeContents(centroidsVec);
+  te::common::FreeContents(fullGeomVec);
+
+  m_centroidFile = output;
+}
+
+void geopx::cli::JobRunner::runAutoClassify(const boost::property_tree::ptree& stage)
+{
+  te::map::AbstractLayerPtr centroidLayer = openLayer(getPath(stage, "centroids", m_centroidFile), "OGR");
+  te::map::AbstractLayerPtr parcelLayer = openLayer(getPath(stage, "parcels", m_parcelFile), "OGR");
+  te::map::AbstractLayerPtr ndviLayer = openLayer(getPath(stage, "ndvi", m_ndviFile), "GDAL");
+
+  //the direction lines are optional, the direction of the other parcels is estimated from their centroids
+  te::map::AbstractLayerPtr angleLayer;
+
+  std::string angleFile = stage.get<std::string>("angles", "");
+
+  if(!angleFile.empty())
+    angleLayer = openLayer(angleFile, "OGR");
+
+  //the parameters not defined keep the values of the track auto classifier tool
+  geopx::tools::TrackParameters params;
+
+  params.m_distance = stage.get<double>("distance", params.m_distance);
+  params.m_distanceTrack = stage.get<double>("distanceTrack", params.m_distanceTrack);
+  params.m_toleranceFactor = stage.get<double>("toleranceFactor", params.m_toleranceFactor);
+  params.m_trackToleranceFactor = stage.get<double>("trackToleranceFactor", params.m_trackToleranceFactor);
+  params.m_polyAreaMin = stage.get<double>("polyAreaMin", params.m_polyAreaMin);
+  params.m_polyAreaMax = stage.get<double>("polyAreaMax", params.m_polyAreaMax);
+  params.m_maxDead = stage.get<unsigned int>("maxDead", params.m_maxDead);
+  params.m_deltaTol = stage.get<double>("deadTol", params.m_deltaTol);
+  params.m_ndviThreshold = stage.get<double>("threshold", params.m_ndviThreshold);
+  params.m_adjustTrackSteps = stage.get<std::size_t>("adjustTrackSteps", params.m_adjustTrackSteps);
+  params.m_adjustTrack = params.m_adjustTrackSteps > 0;
+  params.m_fitPoints = stage.get<std::size_t>("fitPoints", params.m_fitPoints);
+
+  if(stage.get<bool>("fitTrack", false))
+    params.m_predictor = geopx::tools::TRACK_PREDICTOR_LINE_FIT;
+
+  //rows azimuth (degrees, counter clockwise from the x axis) used where the direction estimated from the centroids is not confident
+  if(boost::optional<double> direction = stage.get_optional<double>("direction"))
+  {
+    params.m_hasDirection = true;
+    params.m_dirX = std::cos(*direction * GEOPXCLI_PI / 180.);
+    params.m_dirY = std::sin(*direction * GEOPXCLI_PI / 180.);
+  }
+
+  params.m_minDirectionConfidence = stage.get<double>("minDirectionConfidence", params.m_minDirectionConfidence);
+
+  if(params.m_distance <= 0. || params.m_distanceTrack <= 0.)
+    throw te::core::Exception() << te::ErrorDescription("Distance between trees or between tracks not defined.");
+
+  std::size_t nThreads = stage.get<std::size_t>("threads", 0);
+
+  //ndvi raster
+  std::unique_ptr<te::da::DataSet> ndviDS = ndviLayer->getData();
+  std::size_t rpos = te::da::GetFirstPropertyPos(ndviDS.get(), te::dt::RASTER_TYPE);
+  std::unique_ptr<te::rst::Raster> ndviRst = ndviDS->getRaster(rpos);
+
+  geopx::tools::NdviSampler sampler(ndviRst.get(), stage.get<std::size_t>("band", 0));
+
+  //indexes and caches, as created by the tool
+  geopx::tools::SpatialIndex centroidIndex;
+  geopx::tools::CreateLayerIndex(centroidLayer, centroidIndex);
+
+  geopx::tools::SpatialIndex angleIndex;
+
+  if(angleLayer.get())
+    geopx::tools::CreateLayerIndex(angleLayer, angleIndex);
+
+  geopx::tools::ClassificationCache classCache;
+  classCache.load(centroidLayer, centroidIndex);
+
+  geopx::tools::ParcelCache parcelCache;
+  parcelCache.load(parcelLayer, centroidLayer->getSRID());
+
+  std::vector<geopx::tools::TrackParcel> parcels;
+
+  geopx::tools::GetTrackParcels(parcelCache, centroidIndex, classCache, angleLayer, angleIndex, parcels);
+
+  //the created trees get the ids after the max primary key value
+  te::map::DataSetLayer* dsLayer = dynamic_cast<te::map::DataSetLayer*>(centroidLayer.get());
+
+  std::unique_ptr<te::da::DataSetType> dsType = centroidLayer->getSchema();
+
+  te::da::DataSourcePtr dataSource = te::da::GetDataSource(dsLayer->getDataSourceId());
+
+  geopx::tools::TrackResultWriter writer(dataSource, dsType.get(), centroidIndex, centroidLayer->getSRID(), centroidIndex.getMaxId() + 1);
+
+  geopx::tools::TrackEngine engine(centroidIndex, classCache, &sampler, params);
+
+  geopx::tools::ParallelTrackClassifier classifier(engine, nThreads);
+
+  std::size_t nTracks = 0;
+
+  try
+  {
+    bool finished = classifier.run(parcels, [&](const geopx::tools::TrackParcel&, std::vector<geopx::tools::TrackResult>& results)
+    {
+      for(std::size_t t = 0; t < results.size(); ++t)
+      {
+        writer.add(results[t]);
+
+        writer.endTrack();
+      }
+
+      nTracks += results.size();
+    });
+
+    //the batches written before the cancel are kept
+    if(!finished)
+      writer.discard();
+
+    writer.flush();
+  }
+  catch(...)
+  {
+    writer.discard();
+
+    throw;
+  }
+
+  std::cout << parcels.size() << " parcels, " << nTracks << " tracks, " << writer.getCommittedTypes().size() << " trees classified, "
+            << writer.getCreated()->size() << " trees created" << std::endl;
+}
+
+void geopx::cli::JobRunner::runTracks(const boost::property_tree::ptree& stage)
+{
+  std::string output = getPath(stage, "output", "");
+
+  te::map::AbstractLayerPtr centroidLayer = openLayer(getPath(stage, "centroids", m_centroidFile), "OGR");
+  te::map::AbstractLayerPtr parcelLayer = openLayer(getPath(stage, "parcels", m_parcelFile), "OGR");
+
+  //the direction lines are optional
+  te::map::AbstractLayerPtr angleLayer;
+
+  std::string angleFile = stage.get<std::string>("angles", "");
+
+  if(!angleFile.empty())
+    angleLayer = openLayer(angleFile, "OGR");
+
+  double angleTol = stage.get<double>("angleTol", 0.);
+  double centroidDist = stage.get<double>("distance", 0.);
+  double distTol = stage.get<double>("distanceTol", 0.);
+
+  if(centroidDist <= 0.)
+    throw te::core::Exception() << te::ErrorDescription("Distance between trees not defined.");
+
+  te::da::DataSourcePtr outputDataSource = createDataSource(output, "OGR");
+
+  geopx::tools::ForestMonitorService fms;
+
+  fms.setInputParameters(centroidLayer, parcelLayer, angleLayer, angleTol, centroidDist, distTol);
+
+  fms.setOutputParameters(outputDataSource, boost::filesystem::path(output).stem().string());
+
+  fms.runService();
+}
+
+te::map::AbstractLayerPtr geopx::cli::JobRunner::openLayer(const std::string& fileName, const std::string& dsType)
+{
+  if(!boost::filesystem::exists(fileName))
+    throw te::core::Exception() << te::ErrorDescription("File not found: " + fileName);
+
+  te::da::DataSourcePtr ds = createDataSource(fileName, dsType);
+
+  std::vector<std::string> names = ds->getDataSetNames();
+
+  if(names.empty())
+    throw te::core::Exception() << te::ErrorDescription("Data source without data sets: " + fileName);
+
+  std::unique_ptr<te::da::DataSetType> schema = ds->getDataSetType(names[0]);
+
+  //srid from the geometry or from the raster grid
+  int srid = 0;
+
+  if(te::gm::GeometryProperty* gmProp = te::da::GetFirstGeomProperty(schema.get()))
+    srid = gmProp->getSRID();
+  else if(te::rst::RasterProperty* rstProp = te::da::GetFirstRasterProperty(schema.get()))
+    srid = rstProp->getGrid()->getSRID();
+
+  boost::uuids::basic_random_generator<boost::mt19937> gen;
+  boost::uuids::uuid u = gen();
+  std::string id = boost::uuids::to_string(u);
+
+  te::map::DataSetLayerPtr layer(new te::map::DataSetLayer(id, names[0]));
+  layer->setDataSetName(names[0]);
+  layer->setDataSourceId(ds->getId());
+  layer->setRendererType("ABSTRACT_LAYER_RENDERER");
+  layer->setVisibility(te::map::VISIBLE);
+  layer->setSRID(srid);
+
+  return layer;
+}
+
+te::da::DataSourcePtr geopx::cli::JobRunner::createDataSource(const std::string& fileName, const std::string& dsType)
+{
+  boost::filesystem::path uri(fileName);
+
+  std::string connInfo("file://");
+  connInfo += uri.string();
+
+  boost::uuids::basic_random_generator<boost::mt19937> gen;
+  boost::uuids::uuid u = gen();
+  std::string id_ds = boost::uuids::to_string(u);
+
+  te::da::DataSourceInfoPtr dsInfoPtr(new te::da::DataSourceInfo);
+  dsInfoPtr->setConnInfo(connInfo);
+  dsInfoPtr->setTitle(uri.stem().string());
+  dsInfoPtr->setAccessDriver(dsType);
+  dsInfoPtr->setType(dsType);
+  dsInfoPtr->setDescription(uri.string());
+  dsInfoPtr->setId(id_ds);
+
+  te::da::DataSourceInfoManager::getInstance().add(dsInfoPtr);
+
+  return te::da::DataSourceManager::getInstance().get(id_ds, dsType, dsInfoPtr->getConnInfo());
+}
+
+std::string geopx::cli::JobRunner::getPath(const boost::property_tree::ptree& stage, const std::string& key, const std::string& defaultValue)
+{
+  std::string value = stage.get<std::string>(key, defaultValue);
+
+  if(value.empty())
+    throw te::core::Exception() << te::ErrorDescription("Job parameter not defined: " + key);
+
+  return value;
+}
@@ -0,0 +1,95 @@
+/*!
+  \file geopx-desktop/src/geopixeltools-cli/JobRunner.h
+
+  \brief This class runs the forest monitor stages described in a job file without any user interface.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_CLI_JOBRUNNER_H
+#define __GEOPXDESKTOP_TOOLS_CLI_JOBRUNNER_H
+
+//TerraLib Includes
+#include <terralib/dataaccess/datasource/DataSource.h>
+#include <terralib/maptools/AbstractLayer.h>
+
+// Boost
+#include <boost/property_tree/ptree.hpp>
+
+//STL Includes
+#include <string>
+
+namespace geopx
+{
+  namespace cli
+  {
+    /*!
+      \class JobRunner
+
+      \brief Runs the forest monitor stages (ndvi, classify, autoclassify, tracks) from a JSON job file.
+
+      Each stage is an optional object in the job file and the stages are executed in the
+      order ndvi, classify, autoclassify, tracks. A stage input that is not defined is taken
+      from the output of the previous stage, for example:
+
+      \code
+      {
+        "ndvi":         { "nir": "nir.tif", "nirBand": 0, "vis": "vis.tif", "visBand": 0, "output": "ndvi.tif" },
+        "classify":     { "parcels": "parcels.shp", "threshold": 0.4, "dilation": 1, "erosion": 1, "output": "centroids.shp" },
+        "autoclassify": { "angles": "lines.shp", "distance": 2.5, "distanceTrack": 4.0, "direction": 90, "threshold": 120, "threads": 0 },
+        "tracks":       { "parcels": "parcels.shp", "angles": "lines.shp", "angleTol": 10, "distance": 2.5, "distanceTol": 0.5, "output": "tracks.shp" }
+      }
+      \endcode
+
+      The autoclassify stage classifies the tracks of all parcels, as the track auto classifier
+      tool, and writes the result into the centroids file (the types are updated and the
+      created trees are inserted). The rows of the parcels without direction line are
+      estimated from their centroids, the optional "direction" azimuth is used where the
+      estimate is not confident.
+    */
+    class JobRunner
+    {
+      public:
+
+        JobRunner();
+
+        ~JobRunner();
+
+      public:
+
+        /*! \brief Reads the job file, throws if the file is not a valid JSON document. */
+        void load(const std::string& fileName);
+
+        /*! \brief Runs all stages defined in the job, throws on the first stage that fails. */
+        void run();
+
+      protected:
+
+        void runNDVI(const boost::property_tree::ptree& stage);
+
+        void runClassify(const boost::property_tree::ptree& stage);
+
+        void runAutoClassify(const boost::property_tree::ptree& stage);
+
+        void runTracks(const boost::property_tree::ptree& stage);
+
+        /*! \brief Opens a file data source and creates a layer for its first data set. */
+        te::map::AbstractLayerPtr openLayer(const std::string& fileName, const std::string& dsType);
+
+        /*! \brief Creates (or opens) a file data source using the given driver. */
+        te::da::DataSourcePtr createDataSource(const std::string& fileName, const std::string& dsType);
+
+        /*! \brief Returns a path of a stage (or the default value), throws if both are empty. */
+        std::string getPath(const boost::property_tree::ptree& stage, const std::string& key, const std::string& defaultValue);
+
+      protected:
+
+        boost::property_tree::ptree m_job;        //!< Job description.
+
+        std::string m_ndviFile;                   //!< Output of the ndvi stage.
+        std::string m_centroidFile;               //!< Output of the classify stage.
+        std::string m_parcelFile;                 //!< Parcels used by the classify stage.
+    };
+
+  }  // end namespace cli
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_CLI_JOBRUNNER_H
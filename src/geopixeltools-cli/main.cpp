@@ -0,0 +1,102 @@
+/*!
+  \file geopx-desktop/src/geopixeltools-cli/main.cpp
+
+  \brief It contains the main routine of the Geopixel Tools batch executable.
+*/
+
+#include "JobRunner.h"
+
+// TerraLib
+#include <terralib/common/TerraLib.h>
+#include <terralib/common/progress/ConsoleProgressViewer.h>
+#include <terralib/common/progress/ProgressManager.h>
+#include <terralib/core/Exception.h>
+#include <terralib/core/plugin.h>
+
+// STL
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <locale>
+#include <vector>
+
+namespace
+{
+  /*! Loads the data access plugins (the Qt plugins require an application and are not loaded) */
+  void LoadDataAccessPlugins()
+  {
+    std::vector<te::core::PluginInfo> plugins = te::core::plugin::TopologicalSort(te::core::plugin::DefaultPluginFinder());
+
+    for(const te::core::PluginInfo& info : plugins)
+    {
+      if(info.name.compare(0, 6, "te.da.") != 0)
+        continue;
+
+      te::core::PluginManager::instance().insert(info);
+      te::core::PluginManager::instance().load(info.name);
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if(argc != 2)
+  {
+    std::cerr << "Usage: geopixeltools-cli <job file>" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  //set locale info
+  setlocale(LC_ALL, "C"); // This force to use "." as decimal separator.
+
+  int ret = EXIT_SUCCESS;
+
+  TerraLib::getInstance().initialize();
+
+  te::core::plugin::InitializePluginSystem();
+
+  te::common::ConsoleProgressViewer viewer;
+  int viewerId = te::common::ProgressManager::getInstance().addViewer(&viewer);
+
+  try
+  {
+    LoadDataAccessPlugins();
+
+    geopx::cli::JobRunner runner;
+
+    runner.load(argv[1]);
+
+    runner.run();
+  }
+  catch(const boost::exception& e)
+  {
+    if(const std::string* d = boost::get_error_info<te::ErrorDescription>(e))
+      std::cerr << "Error: " << *d << std::endl;
+    else
+      std::cerr << "Error: an unknown error has occurred" << std::endl;
+
+    ret = EXIT_FAILURE;
+  }
+  catch(const std::exception& e)
+  {
+    std::cerr << "Error: " << e.what() << std::endl;
+
+    ret = EXIT_FAILURE;
+  }
+  catch(...)
+  {
+    std::cerr << "Error: an unknown error has occurred" << std::endl;
+
+    ret = EXIT_FAILURE;
+  }
+
+  te::common::ProgressManager::getInstance().removeViewer(viewerId);
+
+  te::core::plugin::UnloadAll();
+
+  te::core::plugin::FinalizePluginSystem();
+
+  TerraLib::getInstance().finalize();
+
+  return ret;
+}
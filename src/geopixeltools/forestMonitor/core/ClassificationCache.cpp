@@ -0,0 +1,329 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/ClassificationCache.cpp
+
+  \brief This file contains a class used to keep the classification of the tree centroids in memory.
+*/
+
+#include "ClassificationCache.h"
+#include "LayerIndex.h"
+#include "SpatialIndex.h"
+
+//TerraLib Includes
+#include <terralib/core/Exception.h>
+#include <terralib/core/logger/Logger.h>
+#include <terralib/dataaccess/dataset/DataSet.h>
+#include <terralib/dataaccess/dataset/DataSetType.h>
+#include <terralib/dataaccess/dataset/PrimaryKey.h>
+#include <terralib/dataaccess/utils/Utils.h>
+
+// Boost
+#include <boost/filesystem.hpp>
+
+//STL Includes
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#define CLASSIFICATION_SNAPSHOT_VERSION 1
+
+namespace
+{
+  const char CLASSIFICATION_SNAPSHOT_MAGIC[8] = { 'G', 'P', 'X', 'C', 'L', 'S', '0', '1' };
+
+  struct ClassificationSnapshotHeader
+  {
+    char m_magic[8];
+    unsigned long long m_version;
+    unsigned long long m_signatureSize;
+    unsigned long long m_size;
+  };
+}
+
+geopx::tools::ClassificationCache::ClassificationCache() :
+  m_index(0)
+{
+}
+
+geopx::tools::ClassificationCache::~ClassificationCache()
+{
+}
+
+void geopx::tools::ClassificationCache::clear()
+{
+  m_index = 0;
+
+  m_types.clear();
+  m_areas.clear();
+  m_journal.clear();
+}
+
+void geopx::tools::ClassificationCache::load(te::map::AbstractLayerPtr layer, const SpatialIndex& index)
+{
+  assert(layer.get());
+
+  m_index = &index;
+
+  m_journal.clear();
+
+  std::string fileName = GetLayerIndexFileName(layer);
+  std::string signature = GetLayerSignature(layer);
+
+  if(!fileName.empty())
+    fileName += CLASSIFICATION_FILE_EXTENSION;
+
+  //try the snapshot
+  if(!fileName.empty() && loadSnapshot(fileName, signature, index))
+    return;
+
+  readLayer(layer, index);
+
+  //save the snapshot (it follows the index positions), a read only repository only means a slower start next time
+  if(!fileName.empty() && !index.hasChanges())
+  {
+    try
+    {
+      saveSnapshot(fileName, signature);
+    }
+    catch(const std::exception& e)
+    {
+      TE_LOG_WARN("Could not save the classification snapshot " + fileName + ": " + e.what());
+    }
+  }
+}
+
+void geopx::tools::ClassificationCache::readLayer(te::map::AbstractLayerPtr layer, const SpatialIndex& index)
+{
+  //centroids without attributes are considered classified
+  m_types.assign(index.size(), CLASSIFICATION_OTHER);
+  m_areas.assign(index.size(), 0.);
+
+  std::unique_ptr<te::da::DataSetType> schema = layer->getSchema();
+
+  te::da::PrimaryKey* pk = schema->getPrimaryKey();
+
+  std::size_t idIdx = te::da::GetPropertyPos(schema.get(), pk->getProperties()[0]->getName());
+  std::size_t typeIdx = te::da::GetPropertyPos(schema.get(), "type");
+  std::size_t areaIdx = te::da::GetPropertyPos(schema.get(), "area");
+
+  if(typeIdx == std::string::npos)
+    return;
+
+  std::unique_ptr<te::da::DataSet> ds = layer->getData();
+
+  ds->moveBeforeFirst();
+
+  while(ds->moveNext())
+  {
+    std::string strId = ds->getAsString(idIdx);
+
+    std::size_t pos;
+
+    if(!index.find(atoi(strId.c_str()), pos))
+      continue;
+
+    if(!ds->isNull(typeIdx))
+      m_types[pos] = GetType(ds->getString(typeIdx));
+
+    if(areaIdx != std::string::npos && !ds->isNull(areaIdx))
+      m_areas[pos] = ds->getDouble(areaIdx);
+  }
+}
+
+void geopx::tools::ClassificationCache::saveSnapshot(const std::string& fileName, const std::string& signature) const
+{
+  assert(m_index);
+
+  std::size_t n = m_types.size();
+
+  //the ids tell if the snapshot follows the positions of the index loaded later
+  std::vector<int> ids(n);
+
+  for(std::size_t t = 0; t < n; ++t)
+    ids[t] = m_index->getId(t);
+
+  ClassificationSnapshotHeader header;
+  std::memset(&header, 0, sizeof(ClassificationSnapshotHeader));
+  std::memcpy(header.m_magic, CLASSIFICATION_SNAPSHOT_MAGIC, sizeof(CLASSIFICATION_SNAPSHOT_MAGIC));
+  header.m_version = CLASSIFICATION_SNAPSHOT_VERSION;
+  header.m_signatureSize = signature.size();
+  header.m_size = n;
+
+  std::string tmpFileName = fileName + ".tmp";
+
+  {
+    std::ofstream out(tmpFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if(!out.is_open())
+      throw te::core::Exception() << te::ErrorDescription("Could not create the classification file: " + tmpFileName);
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(ClassificationSnapshotHeader));
+    out.write(signature.data(), signature.size());
+
+    if(n)
+    {
+      out.write(reinterpret_cast<const char*>(&ids[0]), sizeof(int) * n);
+      out.write(reinterpret_cast<const char*>(&m_types[0]), n);
+      out.write(reinterpret_cast<const char*>(&m_areas[0]), sizeof(double) * n);
+    }
+
+    if(!out.good())
+      throw te::core::Exception() << te::ErrorDescription("Could not write the classification file: " + tmpFileName);
+  }
+
+  boost::filesystem::rename(tmpFileName, fileName);
+}
+
+bool geopx::tools::ClassificationCache::loadSnapshot(const std::string& fileName, const std::string& signature, const SpatialIndex& index)
+{
+  std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+
+  if(!in.is_open())
+    return false;
+
+  ClassificationSnapshotHeader header;
+
+  if(!in.read(reinterpret_cast<char*>(&header), sizeof(ClassificationSnapshotHeader)))
+    return false;
+
+  if(std::memcmp(header.m_magic, CLASSIFICATION_SNAPSHOT_MAGIC, sizeof(CLASSIFICATION_SNAPSHOT_MAGIC)) != 0 ||
+     header.m_version != CLASSIFICATION_SNAPSHOT_VERSION || header.m_signatureSize != signature.size() || header.m_size != index.size())
+    return false;
+
+  std::string fileSignature(signature.size(), '\0');
+
+  if(!signature.empty() && !in.read(&fileSignature[0], signature.size()))
+    return false;
+
+  if(fileSignature != signature)
+    return false;
+
+  std::size_t n = static_cast<std::size_t>(header.m_size);
+
+  std::vector<int> ids(n);
+  std::vector<unsigned char> types(n);
+  std::vector<double> areas(n);
+
+  if(n && (!in.read(reinterpret_cast<char*>(&ids[0]), sizeof(int) * n) ||
+           !in.read(reinterpret_cast<char*>(&types[0]), n) ||
+           !in.read(reinterpret_cast<char*>(&areas[0]), sizeof(double) * n)))
+    return false;
+
+  for(std::size_t t = 0; t < n; ++t)
+  {
+    if(ids[t] != index.getId(t))
+      return false;
+  }
+
+  m_types.swap(types);
+  m_areas.swap(areas);
+
+  return true;
+}
+
+std::size_t geopx::tools::ClassificationCache::size() const
+{
+  return m_types.size();
+}
+
+unsigned char geopx::tools::ClassificationCache::getType(std::size_t pos) const
+{
+  assert(pos < m_types.size());
+
+  return m_types[pos];
+}
+
+double geopx::tools::ClassificationCache::getArea(std::size_t pos) const
+{
+  assert(pos < m_areas.size());
+
+  return m_areas[pos];
+}
+
+void geopx::tools::ClassificationCache::setType(std::size_t pos, unsigned char type)
+{
+  assert(pos < m_types.size());
+
+  m_journal.push_back(std::make_pair(pos, m_types[pos]));
+
+  m_types[pos] = type;
+}
+
+void geopx::tools::ClassificationCache::insert(std::size_t pos, unsigned char type, double area)
+{
+  if(pos >= m_types.size())
+  {
+    m_types.resize(pos + 1, CLASSIFICATION_OTHER);
+    m_areas.resize(pos + 1, 0.);
+  }
+
+  m_types[pos] = type;
+  m_areas[pos] = area;
+}
+
+bool geopx::tools::ClassificationCache::setTypeById(int id, unsigned char type)
+{
+  if(!m_index)
+    return false;
+
+  std::size_t pos;
+
+  if(!m_index->find(id, pos) || pos >= m_types.size())
+    return false;
+
+  setType(pos, type);
+
+  return true;
+}
+
+void geopx::tools::ClassificationCache::commit()
+{
+  m_journal.clear();
+}
+
+void geopx::tools::ClassificationCache::rollback()
+{
+  for(std::size_t t = m_journal.size(); t > 0; --t)
+    m_types[m_journal[t - 1].first] = m_journal[t - 1].second;
+
+  m_journal.clear();
+}
+
+unsigned char geopx::tools::ClassificationCache::GetType(const std::string& value)
+{
+  if(value == "UNKNOWN")
+    return CLASSIFICATION_UNKNOWN;
+  else if(value == "CREATED")
+    return CLASSIFICATION_CREATED;
+  else if(value == "LIVE")
+    return CLASSIFICATION_LIVE;
+  else if(value == "DEAD")
+    return CLASSIFICATION_DEAD;
+  else if(value == "INTRUDER")
+    return CLASSIFICATION_INTRUDER;
+  else if(value == "REMOVED")
+    return CLASSIFICATION_REMOVED;
+
+  return CLASSIFICATION_OTHER;
+}
+
+std::string geopx::tools::ClassificationCache::GetTypeName(unsigned char type)
+{
+  switch(type)
+  {
+    case CLASSIFICATION_UNKNOWN:
+      return "UNKNOWN";
+    case CLASSIFICATION_CREATED:
+      return "CREATED";
+    case CLASSIFICATION_LIVE:
+      return "LIVE";
+    case CLASSIFICATION_DEAD:
+      return "DEAD";
+    case CLASSIFICATION_INTRUDER:
+      return "INTRUDER";
+    case CLASSIFICATION_REMOVED:
+      return "REMOVED";
+    default:
+      return "";
+  }
+}
@@ -0,0 +1,120 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/ClassificationCache.h
+
+  \brief This file contains a class used to keep the classification of the tree centroids in memory.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_CLASSIFICATIONCACHE_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_CLASSIFICATIONCACHE_H
+
+#include "../../Config.h"
+
+// TerraLib
+#include <terralib/maptools/AbstractLayer.h>
+
+//STL Includes
+#include <string>
+#include <utility>
+#include <vector>
+
+#define CLASSIFICATION_UNKNOWN    0     //!< Centroid extracted from the NDVI and not classified yet ("UNKNOWN").
+#define CLASSIFICATION_CREATED    1     //!< Centroid created by the operator ("CREATED").
+#define CLASSIFICATION_LIVE       2     //!< Centroid classified as a live tree ("LIVE").
+#define CLASSIFICATION_DEAD       3     //!< Centroid classified as a dead tree ("DEAD").
+#define CLASSIFICATION_INTRUDER   4     //!< Centroid classified as an intruder ("INTRUDER").
+#define CLASSIFICATION_REMOVED    5     //!< Dead centroid removed by the operator ("REMOVED").
+#define CLASSIFICATION_OTHER      6     //!< Any other value of the type attribute.
+
+#define CLASSIFICATION_FILE_EXTENSION ".class"  //!< Added to the index snapshot name to get the classification snapshot name.
+
+namespace geopx
+{
+  namespace tools
+  {
+    class SpatialIndex;
+
+    /*!
+      \class ClassificationCache
+
+      \brief Keeps the type and area attributes of the centroids in arrays that follow the
+             positions of the centroid spatial index.
+
+      The attributes are read once from the layer and updated in place when the tools write
+      a new classification, so the candidate tests of the tracks do not query the data source.
+      The arrays are kept in a snapshot file next to the index snapshot, under the same layer
+      signature, so a layer not changed since the last load is not read again.
+    */
+    class GEOPXTOOLSEXPORT ClassificationCache
+    {
+      public:
+
+        ClassificationCache();
+
+        ~ClassificationCache();
+
+      public:
+
+        void clear();
+
+        /*!
+          \brief Reads the "type" and "area" attributes of all centroids of the layer.
+
+          The snapshot is used if it was created for the current layer signature and the same
+          index items, otherwise the layer is read and a new snapshot is written.
+
+          \param layer  The centroid layer.
+          \param index  The spatial index created for the same layer (its ids are the primary key values).
+        */
+        void load(te::map::AbstractLayerPtr layer, const SpatialIndex& index);
+
+        std::size_t size() const;
+
+        unsigned char getType(std::size_t pos) const;
+
+        double getArea(std::size_t pos) const;
+
+        void setType(std::size_t pos, unsigned char type);
+
+        /*! \brief Adds the attributes of a centroid inserted in the index after the load (not journaled). */
+        void insert(std::size_t pos, unsigned char type, double area);
+
+        /*! \brief Sets the type of the centroid with the given primary key value, returns false if it is not indexed. */
+        bool setTypeById(int id, unsigned char type);
+
+        /*! \brief Accepts the type changes made since the last commit() or rollback(). */
+        void commit();
+
+        /*! \brief Restores the types changed since the last commit() (used when the writes are discarded). */
+        void rollback();
+
+        /*! \brief Converts the value of the type attribute. */
+        static unsigned char GetType(const std::string& value);
+
+        /*! \brief Returns the value of the type attribute ("OTHER" types have no name). */
+        static std::string GetTypeName(unsigned char type);
+
+      protected:
+
+        /*! \brief Reads the attributes of all centroids from the layer. */
+        void readLayer(te::map::AbstractLayerPtr layer, const SpatialIndex& index);
+
+        /*! \brief Writes the arrays and the ids of the index positions into a snapshot file. */
+        void saveSnapshot(const std::string& fileName, const std::string& signature) const;
+
+        /*! \brief Reads a snapshot file, returns false if it was created for another signature or other index items. */
+        bool loadSnapshot(const std::string& fileName, const std::string& signature, const SpatialIndex& index);
+
+      protected:
+
+        const SpatialIndex* m_index;              //!< The index used to map the ids to positions.
+
+        std::vector<unsigned char> m_types;       //!< Type of each centroid (index position).
+        std::vector<double> m_areas;              //!< Area of each centroid (index position).
+
+        std::vector<std::pair<std::size_t, unsigned char> > m_journal;    //!< Positions and previous types not committed.
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_CLASSIFICATIONCACHE_H
@@ -0,0 +1,183 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/DataSourceTrackSink.cpp
+
+  \brief This file contains a track sink that writes the tracks into a data source while they are created.
+*/
+
+#include "DataSourceTrackSink.h"
+
+//TerraLib Includes
+#include <terralib/core/Exception.h>
+#include <terralib/dataaccess/dataset/DataSetType.h>
+#include <terralib/geometry/LineString.h>
+#include <terralib/memory/DataSet.h>
+#include <terralib/memory/DataSetItem.h>
+
+//STL Includes
+#include <cassert>
+#include <map>
+
+geopx::tools::DataSourceTrackSink::DataSourceTrackSink(te::da::DataSourcePtr ds, std::unique_ptr<te::da::DataSetType> dsType,
+                                                       std::size_t batchSize, std::size_t queueSize) :
+  m_ds(ds),
+  m_dsType(std::move(dsType)),
+  m_batchSize(batchSize ? batchSize : 1),
+  m_queueSize(queueSize ? queueSize : 1),
+  m_stop(false)
+{
+  assert(m_ds.get());
+  assert(m_dsType.get());
+
+  //create the output dataset
+  std::map<std::string, std::string> options;
+
+  m_ds->createDataSet(m_dsType.get(), options);
+
+  m_writer = std::thread(&DataSourceTrackSink::run, this);
+}
+
+geopx::tools::DataSourceTrackSink::~DataSourceTrackSink()
+{
+  stop();
+
+  //tracks not written because of a writer error
+  for(std::size_t t = 0; t < m_queue.size(); ++t)
+    delete m_queue[t].m_line;
+}
+
+void geopx::tools::DataSourceTrackSink::add(int trackId, int parcelId, te::gm::LineString* line)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  m_notFull.wait(lock, [this] { return m_queue.size() < m_queueSize || !m_error.empty() || m_stop; });
+
+  if(!m_error.empty() || m_stop)
+  {
+    delete line;
+
+    if(!m_error.empty())
+      throw te::core::Exception() << te::ErrorDescription(m_error);
+
+    throw te::core::Exception() << te::ErrorDescription("Track sink already flushed.");
+  }
+
+  Track track;
+  track.m_trackId = trackId;
+  track.m_parcelId = parcelId;
+  track.m_line = line;
+
+  m_queue.push_back(track);
+
+  lock.unlock();
+
+  m_notEmpty.notify_one();
+}
+
+void geopx::tools::DataSourceTrackSink::flush()
+{
+  stop();
+
+  if(!m_error.empty())
+    throw te::core::Exception() << te::ErrorDescription(m_error);
+}
+
+void geopx::tools::DataSourceTrackSink::run()
+{
+  std::vector<Track> tracks;
+
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+
+      m_notEmpty.wait(lock, [this] { return !m_queue.empty() || m_stop; });
+
+      if(m_queue.empty())
+        return;
+
+      //get a batch
+      while(!m_queue.empty() && tracks.size() < m_batchSize)
+      {
+        tracks.push_back(m_queue.front());
+        m_queue.pop_front();
+      }
+    }
+
+    m_notFull.notify_all();
+
+    try
+    {
+      write(tracks);
+    }
+    catch(const std::exception& e)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      m_error = e.what();
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      m_error = "Error writing the tracks.";
+    }
+
+    if(!m_error.empty())
+    {
+      for(std::size_t t = 0; t < tracks.size(); ++t)
+        delete tracks[t].m_line;
+
+      tracks.clear();
+
+      m_notFull.notify_all();
+      return;
+    }
+  }
+}
+
+void geopx::tools::DataSourceTrackSink::write(std::vector<Track>& tracks)
+{
+  te::mem::DataSet ds(m_dsType.get());
+
+  for(std::size_t t = 0; t < tracks.size(); ++t)
+  {
+    //create dataset item
+    te::mem::DataSetItem* item = new te::mem::DataSetItem(&ds);
+
+    //set id
+    item->setInt32("trackId", tracks[t].m_trackId);
+
+    //set parcel id
+    item->setInt32("parcelId", tracks[t].m_parcelId);
+
+    //set geometry (the item takes the line ownership)
+    item->setGeometry("geom", tracks[t].m_line);
+
+    tracks[t].m_line = 0;
+
+    ds.add(item);
+  }
+
+  tracks.clear();
+
+  ds.moveBeforeFirst();
+
+  std::map<std::string, std::string> options;
+
+  m_ds->add(m_dsType->getName(), &ds, options);
+}
+
+void geopx::tools::DataSourceTrackSink::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_stop = true;
+  }
+
+  m_notEmpty.notify_all();
+  m_notFull.notify_all();
+
+  if(m_writer.joinable())
+    m_writer.join();
+}
@@ -0,0 +1,113 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/DataSourceTrackSink.h
+
+  \brief This file contains a track sink that writes the tracks into a data source while they are created.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_DATASOURCETRACKSINK_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_DATASOURCETRACKSINK_H
+
+#include "../../Config.h"
+#include "TrackSink.h"
+
+//TerraLib Includes
+#include <terralib/dataaccess/datasource/DataSource.h>
+
+//STL Includes
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define TRACK_SINK_BATCH_SIZE 1000
+#define TRACK_SINK_QUEUE_SIZE 10000
+
+namespace te
+{
+  namespace da { class DataSetType; }
+}
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \class DataSourceTrackSink
+
+      \brief A sink that inserts the tracks in batches into an output dataset.
+
+      The tracks are kept in a bounded queue and a single writer thread inserts them into the
+      data source, so the track generation and the I/O overlap and the memory used does not
+      grow with the number of tracks. add() blocks while the queue is full.
+    */
+    class GEOPXTOOLSEXPORT DataSourceTrackSink : public TrackSink
+    {
+      public:
+
+        /*!
+          \brief Creates the output dataset and starts the writer thread.
+
+          \param ds         The output data source.
+          \param dsType     The output dataset type (trackId, parcelId and geom properties).
+          \param batchSize  Maximum number of tracks inserted by each data source call.
+          \param queueSize  Maximum number of tracks waiting to be written.
+        */
+        DataSourceTrackSink(te::da::DataSourcePtr ds, std::unique_ptr<te::da::DataSetType> dsType,
+                            std::size_t batchSize = TRACK_SINK_BATCH_SIZE, std::size_t queueSize = TRACK_SINK_QUEUE_SIZE);
+
+        /*! \brief Writes the pending tracks and stops the writer thread. */
+        ~DataSourceTrackSink();
+
+      public:
+
+        /*! \brief Adds a track to the queue. Throws if the writer has failed. */
+        void add(int trackId, int parcelId, te::gm::LineString* line);
+
+        /*! \brief Writes the pending tracks and stops the writer thread. Throws if the writer has failed. */
+        void flush();
+
+      protected:
+
+        struct Track
+        {
+          int m_trackId;
+          int m_parcelId;
+          te::gm::LineString* m_line;
+        };
+
+        /*! \brief Writer thread loop. */
+        void run();
+
+        /*! \brief Inserts a batch of tracks into the output dataset. */
+        void write(std::vector<Track>& tracks);
+
+        /*! \brief Stops the writer thread after the queue is empty. */
+        void stop();
+
+      protected:
+
+        te::da::DataSourcePtr m_ds;                       //!< The output data source.
+        std::unique_ptr<te::da::DataSetType> m_dsType;    //!< The output dataset type.
+
+        std::size_t m_batchSize;
+        std::size_t m_queueSize;
+
+        std::deque<Track> m_queue;                        //!< Tracks waiting to be written.
+
+        std::mutex m_mutex;                               //!< Protects the queue and the state.
+        std::condition_variable m_notEmpty;               //!< Signaled when a track is added or the sink is stopped.
+        std::condition_variable m_notFull;                //!< Signaled when the writer removes tracks from the queue.
+
+        bool m_stop;                                      //!< Flag used to finish the writer thread.
+        std::string m_error;                              //!< The writer error, if any.
+
+        std::thread m_writer;                             //!< The writer thread.
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_DATASOURCETRACKSINK_H
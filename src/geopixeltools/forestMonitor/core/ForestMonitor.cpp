@@ -5,36 +5,38 @@
 */
 
 #include "ForestMonitor.h"
+#include "LayerIndex.h"
+#include "RowDirectionEstimator.h"
+#include "TrackCandidateFilter.h"
 
 //TerraLib Includes
 #include <terralib/common/progress/TaskProgress.h>
 #include <terralib/common/STLUtils.h>
-#include <terralib/geometry/MultiLineString.h>
-#include <terralib/geometry/MultiPoint.h>
+#include <terralib/geometry/LineString.h>
+#include <terralib/geometry/Point.h>
 #include <terralib/memory/DataSetItem.h>
 
 //STL Includes
 #include <cassert>
+#include <cmath>
 
-geopx::tools::ForestMonitor::ForestMonitor(double tolAngle, double distance, double distTol, te::mem::DataSet* ds) :
-  m_tolAngle(tolAngle), m_distance(distance), m_distTol(distTol), m_ds(ds)
+geopx::tools::ForestMonitor::ForestMonitor(double tolAngle, double distance, double distTol, TrackSink* sink) :
+  m_tolAngle(tolAngle), m_distance(distance), m_distTol(distTol), m_sink(sink)
 {
   m_count = 0;
 }
 
 geopx::tools::ForestMonitor::~ForestMonitor()
 {
-  m_ignoredCentroids.clear();
+  m_centroidFlags.clear();
 
-  m_usedCentroids.clear();
+  m_flaggedCentroids.clear();
 
   m_trackMap.clear();
 
-  m_centroidRtree.clear();
-  te::common::FreeContents(m_centroidGeomMap);
+  m_centroidIndex.clear();
 
-  m_angleRtree.clear();
-  te::common::FreeContents(m_angleGeomMap);
+  m_angleIndex.clear();
 }
 
 void geopx::tools::ForestMonitor::execute(std::unique_ptr<te::da::DataSet> parcelDs, int parcelGeomIdx, int parcelIdIdx,
@@ -51,6 +53,22 @@ void geopx::tools::ForestMonitor::execute(std::unique_ptr<te::da::DataSet> parce
   setParcelDataSet(std::move(parcelDs), parcelGeomIdx, parcelIdIdx);
 }
 
+void geopx::tools::ForestMonitor::execute(std::unique_ptr<te::da::DataSet> parcelDs, int parcelGeomIdx, int parcelIdIdx)
+{
+  //set parcel info and create the track information
+  setParcelDataSet(std::move(parcelDs), parcelGeomIdx, parcelIdIdx);
+}
+
+geopx::tools::SpatialIndex& geopx::tools::ForestMonitor::getCentroidIndex()
+{
+  return m_centroidIndex;
+}
+
+geopx::tools::SpatialIndex& geopx::tools::ForestMonitor::getAngleIndex()
+{
+  return m_angleIndex;
+}
+
 void geopx::tools::ForestMonitor::setParcelDataSet(std::unique_ptr<te::da::DataSet> ds, int geomIdx, int idIdx)
 {
   assert(ds.get());
@@ -68,9 +86,7 @@ void geopx::tools::ForestMonitor::setParcelDataSet(std::unique_ptr<te::da::DataS
     //clear memory data
     m_trackMap.clear();
 
-    m_ignoredCentroids.clear();
-
-    m_usedCentroids.clear();
+    clearCentroidFlags();
 
     if(!task.isActive())
       break;
@@ -82,11 +98,11 @@ void geopx::tools::ForestMonitor::setParcelDataSet(std::unique_ptr<te::da::DataS
 
     int id = atoi(strId.c_str());
 
-    //get parcel angle
-    double angle = getParcelLineAngle(g.get());
-
     //get centroids
-    std::vector<int> results = getParcelCentroids(g.get());
+    std::vector<std::size_t> results = getParcelCentroids(g.get());
+
+    //get parcel angle
+    double angle = getParcelLineAngle(g.get(), results);
 
     //create parcel lines
     createParcelLines(g.get(), id, results, angle);
@@ -102,317 +118,238 @@ void geopx::tools::ForestMonitor::setParcelDataSet(std::unique_ptr<te::da::DataS
 void geopx::tools::ForestMonitor::setCentroidDataSet(std::unique_ptr<te::da::DataSet> ds, int geomIdx, int idIdx)
 {
   //create tree
-  createRTree(m_centroidRtree, m_centroidGeomMap, std::move(ds), geomIdx, idIdx);
+  createRTree(m_centroidIndex, std::move(ds), geomIdx, idIdx);
 }
 
 void geopx::tools::ForestMonitor::setAngleDataSet(std::unique_ptr<te::da::DataSet> ds, int geomIdx, int idIdx)
 {
   //create tree
-  createRTree(m_angleRtree, m_angleGeomMap, std::move(ds), geomIdx, idIdx);
+  createRTree(m_angleIndex, std::move(ds), geomIdx, idIdx);
 }
 
-void geopx::tools::ForestMonitor::createRTree(te::sam::rtree::Index<int> &tree, std::map<int, te::gm::Geometry*> &geomMap, std::unique_ptr<te::da::DataSet> ds, int geomIdx, int idIdx)
+void geopx::tools::ForestMonitor::createRTree(SpatialIndex& index, std::unique_ptr<te::da::DataSet> ds, int geomIdx, int idIdx)
 {
   assert(ds.get());
 
   //create tree
-  tree.clear();
-  te::common::FreeContents(geomMap);
-
-  ds->moveBeforeFirst();
-
-  while(ds->moveNext())
-  {
-    std::string strId = ds->getAsString(idIdx);
-
-    int id = atoi(strId.c_str());
-
-    te::gm::Geometry* g = ds->getGeometry(geomIdx).release();
-    const te::gm::Envelope* box = g->getMBR();
-
-    tree.insert(*box, id);
-
-    geomMap.insert(std::map<int, te::gm::Geometry*>::value_type(id, g));
-  }
+  CreateDataSetIndex(ds.get(), geomIdx, idIdx, index);
 }
 
-void geopx::tools::ForestMonitor::createParcelLines(te::gm::Geometry* parcelGeom, int parcelId, std::vector<int> centroidsIdx, double angle)
+void geopx::tools::ForestMonitor::createParcelLines(te::gm::Geometry* parcelGeom, int parcelId, const std::vector<std::size_t>& centroidsIdx, double angle)
 {
   assert(parcelGeom);
 
   for(std::size_t t = 0; t < centroidsIdx.size(); ++t)
   {
-    int centroidId = centroidsIdx[t];
-
-    std::set<int>::iterator it = m_usedCentroids.find(centroidId);
+    std::size_t centroidPos = centroidsIdx[t];
 
-    if(it != m_usedCentroids.end())
+    if(m_centroidFlags[centroidPos] & TRACK_CANDIDATE_USED)
       continue;
 
     //add as used centroid
-    m_usedCentroids.insert(centroidId);
+    setCentroidFlag(centroidPos, TRACK_CANDIDATE_USED);
 
-    createParcelLine(parcelGeom, parcelId, centroidsIdx, angle, centroidId);
+    createParcelLine(parcelGeom, parcelId, centroidsIdx, angle, centroidPos);
   }
 }
 
-void geopx::tools::ForestMonitor::createParcelLine(te::gm::Geometry* parcelGeom, int parcelId, std::vector<int> centroidsIdx, double angle, int centroidId)
+void geopx::tools::ForestMonitor::createParcelLine(te::gm::Geometry* parcelGeom, int parcelId, const std::vector<std::size_t>& centroidsIdx, double angle, std::size_t centroidPos)
 {
-  std::set<int>::iterator itIgnored = m_ignoredCentroids.find(centroidId);
-
-  if(itIgnored != m_ignoredCentroids.end())
+  if(m_centroidFlags[centroidPos] & TRACK_CANDIDATE_IGNORED)
     return;
 
   bool newSeg = false;
-  int newId;
+  std::size_t newPos = centroidPos;
 
-  std::map<int, te::gm::Geometry*>::iterator it = m_centroidGeomMap.find(centroidId);
+  std::vector<std::size_t> centroids = getCentroidNeighborsCandidates(parcelGeom, angle, centroidPos);
 
-  if(it != m_centroidGeomMap.end())
-  {
-    te::gm::Geometry* centroid = it->second;
+  std::vector<double> angles(centroids.size());
 
-    te::gm::MultiPoint* mFirst = dynamic_cast<te::gm::MultiPoint*>(centroid);
-    te::gm::Point* first = dynamic_cast<te::gm::Point*>(mFirst->getGeometryN(0));
+  ComputeTrackAngles(m_centroidIndex.getXs(), m_centroidIndex.getYs(), centroids.data(), centroids.size(),
+                     m_centroidIndex.getX(centroidPos), m_centroidIndex.getY(centroidPos), false, angles.data());
 
-    std::vector<int> centroids = getCentroidNeighborsCandidates(parcelGeom, angle, centroid);
+  std::map<double, std::pair<std::size_t, std::size_t> > anglesDiffs;
 
-    std::map<double, std::pair<int, int> > anglesDiffs;
+  for(std::size_t p = 0; p < centroids.size(); ++p)
+  {
+    if(centroids[p] == centroidPos)
+      continue;
 
-    for(std::size_t p = 0; p < centroids.size(); ++p)
-    {
-      std::map<int, te::gm::Geometry*>::iterator itP = m_centroidGeomMap.find(centroids[p]);
+    double angleDiff = fabs(angle - angles[p]);
 
-      te::gm::Geometry* c = itP->second;
+    std::pair<std::size_t, std::size_t> pair(centroidPos, centroids[p]);
 
-      if(centroid == c)
-        continue;
+    anglesDiffs.insert(std::map<double, std::pair<std::size_t, std::size_t> >::value_type(angleDiff, pair));
+  }
 
-      te::gm::MultiPoint* mLast = dynamic_cast<te::gm::MultiPoint*>(c);
-      te::gm::Point* last = dynamic_cast<te::gm::Point*>(mLast->getGeometryN(0));
+  //get line with minimum distance
+  double minDist = std::numeric_limits<double>::max();
 
-      double a = getAngle(first, last);
-      double angleDiff = abs(angle - a);
+  std::pair<std::size_t, std::size_t> pairTrack;
 
-      std::pair<int, int> pair(centroidId, centroids[p]);
+  std::map<double, std::pair<std::size_t, std::size_t> >::iterator itAngles = anglesDiffs.begin();
 
-      anglesDiffs.insert(std::map<double, std::pair<int, int> >::value_type(angleDiff, pair));
+  while(itAngles != anglesDiffs.end())
+  {
+    if(itAngles->first != 0. && itAngles->first < minDist)
+    {
+      minDist = itAngles->first;
+      pairTrack = itAngles->second;
     }
 
-    //get line with minimum distance
-    double minDist = std::numeric_limits<double>::max();
-
-    std::pair<int, int> pairTrack;
+    ++itAngles;
+  }
 
-    std::map<double, std::pair<int, int> >::iterator itAngles = anglesDiffs.begin();
+  //add to track map
+  if(minDist != std::numeric_limits<double>::max())
+  {
+    std::map<std::size_t, TrackPair>::iterator itTrackMap = m_trackMap.find(pairTrack.second);
 
-    while(itAngles != anglesDiffs.end())
+    if(itTrackMap != m_trackMap.end())
     {
-      if(itAngles->first != 0. && itAngles->first < minDist)
-      {
-        minDist = itAngles->first;
-        pairTrack = itAngles->second;
-      }
-
-      ++itAngles;
+      itTrackMap->second.m_startCentroids.insert(pairTrack.first);
     }
-
-    //add to track map
-    if(minDist != std::numeric_limits<double>::max())
+    else
     {
-      std::map<int, TrackPair>::iterator itTrackMap = m_trackMap.find(pairTrack.second);
+      TrackPair tp;
+      tp.m_parcelId = parcelId;
+      tp.m_parcelAngle = angle;
+      tp.m_parcelSRID = parcelGeom->getSRID();
+      tp.m_startCentroids.insert(pairTrack.first);
 
-      if(itTrackMap != m_trackMap.end())
-      {
-        itTrackMap->second.m_startCentroids.insert(pairTrack.first);
-      }
-      else
-      {
-        TrackPair tp;
-        tp.m_parcelId = parcelId;
-        tp.m_parcelAngle = angle;
-        tp.m_parcelSRID = parcelGeom->getSRID();
-        tp.m_startCentroids.insert(pairTrack.first);
+      m_trackMap.insert(std::map<std::size_t, TrackPair>::value_type(pairTrack.second, tp));
 
-        m_trackMap.insert(std::map<int, TrackPair>::value_type(pairTrack.second, tp));
+      setCentroidFlag(pairTrack.second, TRACK_CANDIDATE_USED);
 
-        m_usedCentroids.insert(pairTrack.second);
-
-        newSeg = true;
-        newId = pairTrack.second;
-      }
+      newSeg = true;
+      newPos = pairTrack.second;
     }
+  }
 
-    //ignore others
-    itAngles = anglesDiffs.begin();
+  //ignore others
+  itAngles = anglesDiffs.begin();
 
-    while(itAngles != anglesDiffs.end())
+  while(itAngles != anglesDiffs.end())
+  {
+    if(!newSeg || itAngles->second.second != newPos)
     {
-      if(itAngles->second.second != newId)
-      {
-        m_ignoredCentroids.insert(itAngles->second.second);
-      }
-     
-      ++itAngles;
+      setCentroidFlag(itAngles->second.second, TRACK_CANDIDATE_IGNORED);
     }
 
-    anglesDiffs.clear();
+    ++itAngles;
   }
 
+  anglesDiffs.clear();
+
   //recursive... used to continue the line
   if(newSeg)
-    createParcelLine(parcelGeom, parcelId, centroidsIdx, angle, newId);
+    createParcelLine(parcelGeom, parcelId, centroidsIdx, angle, newPos);
 }
 
-std::vector<int> geopx::tools::ForestMonitor::getParcelCentroids(te::gm::Geometry* geom)
+std::vector<std::size_t> geopx::tools::ForestMonitor::getParcelCentroids(te::gm::Geometry* geom)
 {
   assert(geom);
 
   te::gm::Envelope ext(*geom->getMBR());
 
-  std::vector<int> resultsTree;
+  std::vector<std::size_t> resultsTree;
 
-  std::vector<int> resultsContains;
+  std::vector<std::size_t> resultsContains;
 
-  m_centroidRtree.search(ext, resultsTree);
+  m_centroidIndex.search(ext, resultsTree);
 
   for(size_t t = 0; t < resultsTree.size(); ++t)
   {
-    std::map<int, te::gm::Geometry*>::iterator it = m_centroidGeomMap.find(resultsTree[t]);
+    te::gm::Point p(m_centroidIndex.getX(resultsTree[t]), m_centroidIndex.getY(resultsTree[t]), geom->getSRID());
 
-    if(it != m_centroidGeomMap.end())
+    if(geom->contains(&p))
     {
-      if(geom->contains(it->second))
-      {
-        resultsContains.push_back(resultsTree[t]);
-      }
+      resultsContains.push_back(resultsTree[t]);
     }
   }
 
   return resultsContains;
 }
 
-std::vector<int> geopx::tools::ForestMonitor::getCentroidNeighborsCandidates(te::gm::Geometry* parcelGeom, double angle, te::gm::Geometry* centroidGeom)
+std::vector<std::size_t> geopx::tools::ForestMonitor::getCentroidNeighborsCandidates(te::gm::Geometry* parcelGeom, double angle, std::size_t centroidPos)
 {
-  assert(parcelGeom && centroidGeom);
+  assert(parcelGeom);
 
-  std::vector<int> resultsTree;
+  std::vector<std::size_t> resultsTree;
 
-  std::vector<int> resultsContains;
+  std::vector<std::size_t> resultsContains;
 
-  te::gm::Envelope ext = createCentroidBox(centroidGeom);
+  te::gm::Envelope ext = createCentroidBox(centroidPos);
 
-  m_centroidRtree.search(ext, resultsTree);
+  m_centroidIndex.search(ext, resultsTree);
+
+  //check distance, angle, inverted angle and ignored or used flags for all candidates
+  std::vector<unsigned char> flags(resultsTree.size());
+
+  FilterTrackCandidates(m_centroidIndex.getXs(), m_centroidIndex.getYs(), resultsTree.data(), resultsTree.size(),
+                        m_centroidIndex.getX(centroidPos), m_centroidIndex.getY(centroidPos),
+                        m_distance - m_distTol, m_distance + m_distTol, angle, m_tolAngle,
+                        m_centroidFlags.data(), flags.data());
 
   for(size_t t = 0; t < resultsTree.size(); ++t)
   {
-    std::map<int, te::gm::Geometry*>::iterator it = m_centroidGeomMap.find(resultsTree[t]);
-
-    if(it != m_centroidGeomMap.end())
+    //ignored candidates do not need the parcel test
+    if(flags[t] & TRACK_CANDIDATE_IGNORED)
     {
-      //check if centroid is inside parcel
-      if(parcelGeom->contains(it->second))
-      {
-        //check distance
-        double minDist = m_distance - m_distTol;
-        double maxDist = m_distance + m_distTol;
+      setCentroidFlag(resultsTree[t], TRACK_CANDIDATE_IGNORED);
+      continue;
+    }
 
-        double dist = centroidGeom->distance(it->second);
+    te::gm::Point last(m_centroidIndex.getX(resultsTree[t]), m_centroidIndex.getY(resultsTree[t]), parcelGeom->getSRID());
 
-        if(dist > minDist && dist < maxDist)
-        {
-          te::gm::MultiPoint* mFirst = dynamic_cast<te::gm::MultiPoint*>(centroidGeom);
-          te::gm::Point* first = dynamic_cast<te::gm::Point*>(mFirst->getGeometryN(0));
-
-          te::gm::MultiPoint* mLast = dynamic_cast<te::gm::MultiPoint*>(it->second);
-          te::gm::Point* last = dynamic_cast<te::gm::Point*>(mLast->getGeometryN(0));
-
-          //check angle
-          if(centroidsSameTrack(first, last, angle))
-          {
-            //check if is not ignored or used
-            std::set<int>::iterator itIgnored = m_ignoredCentroids.find(resultsTree[t]);
-            std::set<int>::iterator itUsed = m_usedCentroids.find(resultsTree[t]);
-
-            if(itIgnored == m_ignoredCentroids.end() && itUsed == m_usedCentroids.end())
-            {
-              resultsContains.push_back(resultsTree[t]);
-            }
-          }
-          else
-          {
-            //check inverted angle
-            double a = getAngle(first, last);
-
-            bool ignore = true;
-
-            //case 1
-            double minus180a = angle - 180 - m_tolAngle;
-            double minus180b = angle - 180 + m_tolAngle;
-
-            if(a > minus180a && a < minus180b)
-              ignore = false;
-
-            //case 2
-            double plus180a = angle + 180 - m_tolAngle;
-            double plus180b = angle + 180 + m_tolAngle;
-
-            if(a > plus180a && a < plus180b)
-              ignore = false;
-             
-
-            if(ignore)
-              m_ignoredCentroids.insert(resultsTree[t]);
-          }
-        }
-        else if(dist < minDist && dist != 0.)
-        {
-          m_ignoredCentroids.insert(resultsTree[t]);
-        }
-      }
-      else
-      {
-        m_ignoredCentroids.insert(resultsTree[t]);
-      }
+    //check if centroid is inside parcel
+    if(!parcelGeom->contains(&last))
+    {
+      setCentroidFlag(resultsTree[t], TRACK_CANDIDATE_IGNORED);
+      continue;
     }
+
+    if(flags[t] & TRACK_CANDIDATE_ACCEPTED)
+      resultsContains.push_back(resultsTree[t]);
   }
 
   return resultsContains;
 }
 
-double geopx::tools::ForestMonitor::getParcelLineAngle(te::gm::Geometry* geom)
+double geopx::tools::ForestMonitor::getParcelLineAngle(te::gm::Geometry* geom, const std::vector<std::size_t>& centroidsIdx)
 {
   assert(geom);
 
   te::gm::Envelope ext(*geom->getMBR());
 
-  std::vector<int> results;
+  std::vector<std::size_t> results;
 
-  m_angleRtree.search(ext, results);
+  m_angleIndex.search(ext, results);
 
   for(size_t t = 0; t < results.size(); ++t)
   {
-    std::map<int, te::gm::Geometry*>::iterator it = m_angleGeomMap.find(results[t]);
+    te::gm::LineString line(2, te::gm::LineStringType, geom->getSRID());
+    line.setPoint(0, m_angleIndex.getX(results[t]), m_angleIndex.getY(results[t]));
+    line.setPoint(1, m_angleIndex.getX1(results[t]), m_angleIndex.getY1(results[t]));
 
-    if(it != m_angleGeomMap.end())
+    if(geom->contains(&line))
     {
-      if(geom->contains(it->second))
-      {
-        te::gm::MultiLineString* mLine = dynamic_cast<te::gm::MultiLineString*>(it->second);
+      std::unique_ptr<te::gm::Point> first(line.getPointN(0));
+      std::unique_ptr<te::gm::Point> last(line.getPointN(1));
 
-        if(mLine && mLine->getNumGeometries() != 0)
-        {
-          te::gm::LineString* line = dynamic_cast<te::gm::LineString*>(mLine->getGeometryN(0));
+      return getAngle(first.get(), last.get());
+    }
+  }
 
-          assert(line && line->size() == 2);
+  //no direction line for this parcel, estimate the rows direction from the centroids
+  RowDirectionEstimator estimator;
 
-          std::unique_ptr<te::gm::Point> first(line->getPointN(0));
-          std::unique_ptr<te::gm::Point> last(line->getPointN(1));
+  if(estimator.estimate(m_centroidIndex.getXs(), m_centroidIndex.getYs(), centroidsIdx.data(), centroidsIdx.size()))
+  {
+    te::gm::Point first(0., 0., geom->getSRID());
+    te::gm::Point last(estimator.getDx(), estimator.getDy(), geom->getSRID());
 
-          return getAngle(first.get(), last.get());
-        }
-      }
-    }
+    return getAngle(&first, &last);
   }
 
   return 0.;
@@ -425,7 +362,7 @@ bool geopx::tools::ForestMonitor::centroidsSameTrack(te::gm::Point* first, te::g
   double angle = getAngle(first, last);
 
   //check tolerance
-  double absDiff = abs(parcelAngle - angle);
+  double absDiff = fabs(parcelAngle - angle);
 
   if(absDiff > m_tolAngle)
     return false;
@@ -457,11 +394,9 @@ double geopx::tools::ForestMonitor::getAngle(te::gm::Point* first, te::gm::Point
   return angle;
 }
 
-te::gm::Envelope geopx::tools::ForestMonitor::createCentroidBox(te::gm::Geometry* geom)
+te::gm::Envelope geopx::tools::ForestMonitor::createCentroidBox(std::size_t centroidPos)
 {
-  assert(geom);
-
-  te::gm::Envelope ext(*geom->getMBR());
+  te::gm::Envelope ext(m_centroidIndex.getX(centroidPos), m_centroidIndex.getY(centroidPos), m_centroidIndex.getX(centroidPos), m_centroidIndex.getY(centroidPos));
 
   ext.m_llx -= m_distance - m_distTol;
   ext.m_lly -= m_distance - m_distTol;
@@ -475,40 +410,25 @@ void geopx::tools::ForestMonitor::saveTrackLines()
 {
   checkConsistency();
 
-  std::map<int, TrackPair>::iterator it =  m_trackMap.begin();
+  std::map<std::size_t, TrackPair>::iterator it =  m_trackMap.begin();
 
   while(it != m_trackMap.end())
   {
     int parcelId = it->second.m_parcelId;
 
     //get centroid start
-    std::map<int, te::gm::Geometry*>::iterator itCentroid = m_centroidGeomMap.find(*it->second.m_startCentroids.begin());
-    te::gm::MultiPoint* mFirst = dynamic_cast<te::gm::MultiPoint*>(itCentroid->second);
-    te::gm::Point* first = dynamic_cast<te::gm::Point*>(mFirst->getGeometryN(0));
+    std::size_t first = *it->second.m_startCentroids.begin();
 
     //get centroid last
-    itCentroid = m_centroidGeomMap.find(it->first);
-    te::gm::MultiPoint* mLast = dynamic_cast<te::gm::MultiPoint*>(itCentroid->second);
-    te::gm::Point* last = dynamic_cast<te::gm::Point*>(mLast->getGeometryN(0));
+    std::size_t last = it->first;
 
     //create line
     te::gm::LineString* line = new te::gm::LineString(2, te::gm::LineStringType, it->second.m_parcelSRID);
-    line->setPoint(0, first->getX(), first->getY());
-    line->setPoint(1, last->getX(), last->getY());
-
-    //create dataset item
-    te::mem::DataSetItem* item = new te::mem::DataSetItem(m_ds);
-
-    //set id
-    item->setInt32("trackId", m_count);
+    line->setPoint(0, m_centroidIndex.getX(first), m_centroidIndex.getY(first));
+    line->setPoint(1, m_centroidIndex.getX(last), m_centroidIndex.getY(last));
 
-    //set parcel id
-    item->setInt32("parcelId", parcelId);
-
-    //set geometry
-    item->setGeometry("geom", line);
-
-    m_ds->add(item);
+    //send to the output
+    m_sink->add(m_count, parcelId, line);
 
     ++m_count;
 
@@ -518,49 +438,46 @@ void geopx::tools::ForestMonitor::saveTrackLines()
 
 void geopx::tools::ForestMonitor::checkConsistency()
 {
-  std::map<int, TrackPair>::iterator it =  m_trackMap.begin();
+  std::map<std::size_t, TrackPair>::iterator it =  m_trackMap.begin();
 
   while(it != m_trackMap.end())
   {
     if(it->second.m_startCentroids.size() == 2)
     {
       //get last centroid
-      std::map<int, te::gm::Geometry*>::iterator itCentroid = m_centroidGeomMap.find(it->first);
-      te::gm::MultiPoint* mLast = dynamic_cast<te::gm::MultiPoint*>(itCentroid->second);
-      te::gm::Point* last = dynamic_cast<te::gm::Point*>(mLast->getGeometryN(0));
+      double lastX = m_centroidIndex.getX(it->first);
+      double lastY = m_centroidIndex.getY(it->first);
 
       //vector with angle diffs
       double minDiff = std::numeric_limits<double>::max();
 
-      int minCentroidId;
+      std::size_t minCentroidPos = 0;
 
       //get best first centroid
-      std::set<int>::iterator itSet = it->second.m_startCentroids.begin();
-      while(itSet != it->second.m_startCentroids.end())
-      {
-        itCentroid = m_centroidGeomMap.find(*itSet);
-        te::gm::MultiPoint* mFirst = dynamic_cast<te::gm::MultiPoint*>(itCentroid->second);
-        te::gm::Point* first = dynamic_cast<te::gm::Point*>(mFirst->getGeometryN(0));
+      std::vector<std::size_t> starts(it->second.m_startCentroids.begin(), it->second.m_startCentroids.end());
 
-        double angle = getAngle(first, last);
+      std::vector<double> angles(starts.size());
 
+      ComputeTrackAngles(m_centroidIndex.getXs(), m_centroidIndex.getYs(), starts.data(), starts.size(),
+                         lastX, lastY, true, angles.data());
+
+      for(std::size_t p = 0; p < starts.size(); ++p)
+      {
         //check tolerance
-        double absDiff = abs(it->second.m_parcelAngle - angle);
+        double absDiff = fabs(it->second.m_parcelAngle - angles[p]);
 
         if(absDiff < minDiff)
         {
           minDiff = absDiff;
 
-          minCentroidId = *itSet;
+          minCentroidPos = starts[p];
         }
-
-        ++itSet;
       }
 
       if(minDiff != std::numeric_limits<double>::max())
       {
         it->second.m_startCentroids.clear();
-        it->second.m_startCentroids.insert(minCentroidId);
+        it->second.m_startCentroids.insert(minCentroidPos);
       }
 
     }
@@ -568,3 +485,26 @@ void geopx::tools::ForestMonitor::checkConsistency()
     ++it;
   }
 }
+
+void geopx::tools::ForestMonitor::setCentroidFlag(std::size_t centroidPos, unsigned char flag)
+{
+  if(!m_centroidFlags[centroidPos])
+    m_flaggedCentroids.push_back(centroidPos);
+
+  m_centroidFlags[centroidPos] |= flag;
+}
+
+void geopx::tools::ForestMonitor::clearCentroidFlags()
+{
+  if(m_centroidFlags.size() != m_centroidIndex.size())
+  {
+    m_centroidFlags.assign(m_centroidIndex.size(), 0);
+  }
+  else
+  {
+    for(std::size_t t = 0; t < m_flaggedCentroids.size(); ++t)
+      m_centroidFlags[m_flaggedCentroids[t]] = 0;
+  }
+
+  m_flaggedCentroids.clear();
+}
@@ -8,6 +8,8 @@
 #define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_FORESTMONITOR_H
 
 #include "../../Config.h"
+#include "SpatialIndex.h"
+#include "TrackSink.h"
 
 // TerraLib
 #include <terralib/dataaccess/dataset/DataSet.h>
@@ -16,6 +18,7 @@
 //STL Includes
 #include <memory>
 #include <set>
+#include <vector>
 
 namespace geopx
 {
@@ -36,12 +39,13 @@ namespace geopx
         int m_parcelId;
         int m_parcelSRID;
         double m_parcelAngle;
-        std::set<int> m_startCentroids;
+        std::set<std::size_t> m_startCentroids;
       };
 
       public:
 
-        ForestMonitor(double tolAngle, double distance, double distTol, te::mem::DataSet* ds);
+        /*! \brief Constructor. The tracks are sent to the sink (not owned) as each parcel is finished. */
+        ForestMonitor(double tolAngle, double distance, double distTol, TrackSink* sink);
 
         virtual ~ForestMonitor();
 
@@ -51,6 +55,13 @@ namespace geopx
                       std::unique_ptr<te::da::DataSet> angleDs, int angleGeomIdx, int angleIdIdx,
                       std::unique_ptr<te::da::DataSet> centroidDs, int centroidGeomIdx, int centroidIdIdx);
 
+        /*! \brief Creates the tracks using the centroid and angle indexes already filled (see getCentroidIndex and getAngleIndex). */
+        void execute(std::unique_ptr<te::da::DataSet> parcelDs, int parcelGeomIdx, int parcelIdIdx);
+
+        SpatialIndex& getCentroidIndex();
+
+        SpatialIndex& getAngleIndex();
+
       protected:
 
         void setParcelDataSet(std::unique_ptr<te::da::DataSet> ds, int geomIdx, int idIdx);
@@ -59,47 +70,52 @@ namespace geopx
 
         void setAngleDataSet(std::unique_ptr<te::da::DataSet> ds, int geomIdx, int idIdx);
 
-        void createRTree(te::sam::rtree::Index<int> &tree, std::map<int, te::gm::Geometry*> &geomMap, std::unique_ptr<te::da::DataSet> ds, int geomIdx, int idIdx);
+        void createRTree(SpatialIndex& index, std::unique_ptr<te::da::DataSet> ds, int geomIdx, int idIdx);
 
-        void createParcelLines(te::gm::Geometry* parcelGeom, int parcelId, std::vector<int> centroidsIdx, double angle);
+        void createParcelLines(te::gm::Geometry* parcelGeom, int parcelId, const std::vector<std::size_t>& centroidsIdx, double angle);
 
-        void createParcelLine(te::gm::Geometry* parcelGeom, int parcelId, std::vector<int> centroidsIdx, double angle, int centroidId);
+        void createParcelLine(te::gm::Geometry* parcelGeom, int parcelId, const std::vector<std::size_t>& centroidsIdx, double angle, std::size_t centroidPos);
 
-        std::vector<int> getParcelCentroids(te::gm::Geometry* geom);
+        std::vector<std::size_t> getParcelCentroids(te::gm::Geometry* geom);
 
-        std::vector<int> getCentroidNeighborsCandidates(te::gm::Geometry* parcelGeom, double angle, te::gm::Geometry* centroidGeom);
+        std::vector<std::size_t> getCentroidNeighborsCandidates(te::gm::Geometry* parcelGeom, double angle, std::size_t centroidPos);
 
-        double getParcelLineAngle(te::gm::Geometry* geom);
+        /*! \brief Returns the angle of the direction line inside the parcel or, if there is none, the angle estimated from the parcel centroids. */
+        double getParcelLineAngle(te::gm::Geometry* geom, const std::vector<std::size_t>& centroidsIdx);
 
         bool centroidsSameTrack(te::gm::Point* first, te::gm::Point* last, double parcelAngle);
 
         double getAngle(te::gm::Point* first, te::gm::Point* last);
 
-        te::gm::Envelope createCentroidBox(te::gm::Geometry* geom);
+        te::gm::Envelope createCentroidBox(std::size_t centroidPos);
 
         void saveTrackLines();
 
         void checkConsistency();
 
+        /*! \brief Sets a flag (TRACK_CANDIDATE_IGNORED or TRACK_CANDIDATE_USED) for a centroid. */
+        void setCentroidFlag(std::size_t centroidPos, unsigned char flag);
+
+        /*! \brief Clears the flags set while processing the last parcel. */
+        void clearCentroidFlags();
+
       protected:
 
-        te::sam::rtree::Index<int> m_centroidRtree;
-        std::map<int, te::gm::Geometry*> m_centroidGeomMap;
+        SpatialIndex m_centroidIndex;                   //!< Centroids, tracks refer to centroids by their position in this index.
 
-        te::sam::rtree::Index<int> m_angleRtree;
-        std::map<int, te::gm::Geometry*> m_angleGeomMap;
+        SpatialIndex m_angleIndex;                      //!< Direction lines.
 
         double m_tolAngle;
         double m_distance;
         double m_distTol;
 
-        te::mem::DataSet* m_ds;
+        TrackSink* m_sink;                              //!< Output of the tracks.
 
-        std::map<int, TrackPair> m_trackMap;
+        std::map<std::size_t, TrackPair> m_trackMap;
 
-        std::set<int> m_ignoredCentroids;
+        std::vector<unsigned char> m_centroidFlags;     //!< Ignored and used flags by centroid position.
 
-        std::set<int> m_usedCentroids;
+        std::vector<std::size_t> m_flaggedCentroids;    //!< Positions with flags set while processing the current parcel.
 
         int m_count;
     };
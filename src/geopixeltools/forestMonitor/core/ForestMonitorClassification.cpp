@@ -10,6 +10,8 @@
 #include <terralib/common/progress/TaskProgress.h>
 #include <terralib/common/Exception.h>
 #include <terralib/common/STLUtils.h>
+#include <terralib/common/StringUtils.h>
+#include <terralib/core/Exception.h>
 #include <terralib/dataaccess/dataset/DataSetType.h>
 #include <terralib/dataaccess/dataset/PrimaryKey.h>
 #include <terralib/dataaccess/datasource/DataSource.h>
@@ -174,6 +176,137 @@ void geopx::tools::ExtractCentroids(std::vector<te::gm::Geometry*>& geomVec, std
   }
 }
 
+void geopx::tools::ClassifyParcels(te::rst::Raster* ndviRaster, int band, te::map::AbstractLayerPtr parcelLayer, double threshold, int dilation, int erosion,
+                                   std::string repName, bool saveImages, std::vector<CentroidInfo*>& centroids, std::vector<te::gm::Geometry*>& polygons)
+{
+  assert(ndviRaster);
+  assert(parcelLayer.get());
+
+  std::map<std::string, std::string> rInfo;
+
+  std::string type = "GDAL";
+
+  std::unique_ptr<te::da::DataSet> dataSet = parcelLayer->getData();
+  std::unique_ptr<te::da::DataSetType> dataSetType = parcelLayer->getSchema();
+
+  std::size_t gpos = te::da::GetFirstPropertyPos(dataSet.get(), te::dt::GEOMETRY_TYPE);
+
+  bool remap = false;
+
+  if(parcelLayer->getSRID() != ndviRaster->getSRID())
+    remap = true;
+
+  te::da::PrimaryKey* pk = dataSetType->getPrimaryKey();
+
+  if(!pk || pk->getProperties().empty())
+    throw te::core::Exception() << te::ErrorDescription("Parcel layer without primary key.");
+
+  std::string name = pk->getProperties()[0]->getName();
+
+  std::size_t size = dataSet->size();
+
+  dataSet->moveBeforeFirst();
+
+  te::common::TaskProgress task("Associating Centroids");
+  task.setTotalSteps(static_cast<int>(size));
+
+  while(dataSet->moveNext())
+  {
+    if(!task.isActive())
+    {
+      break;
+    }
+
+    task.pulse();
+
+    std::unique_ptr<te::gm::Geometry> g(dataSet->getGeometry(gpos));
+
+    if(!g->isValid())
+    {
+      continue;
+    }
+
+    g->setSRID(parcelLayer->getSRID());
+
+    if(remap)
+      g->transform(ndviRaster->getSRID());
+
+    int parcelId = dataSet->getInt32(name);
+
+    te::gm::Polygon* poly = 0;
+
+    if(g->getGeomTypeId() == te::gm::MultiPolygonType)
+    {
+      te::gm::MultiPolygon* mPoly = dynamic_cast<te::gm::MultiPolygon*>(g.get());
+
+      poly = dynamic_cast<te::gm::Polygon*>(mPoly->getGeometryN(0));
+    }
+    else if(g->getGeomTypeId() == te::gm::PolygonType)
+    {
+      poly = dynamic_cast<te::gm::Polygon*>(g.get());
+    }
+
+    if(!poly || !poly->isValid())
+      continue;
+
+    //create raster crop from parcel
+    rInfo["URI"] = repName + "_parcel_" + te::common::Convert2String(parcelId) + ".tif";
+    te::rst::RasterPtr parcelRaster(te::rst::CropRaster(*ndviRaster, *poly, rInfo, type));
+
+    //create threshold raster
+    rInfo["URI"] = repName + "_threshold_" + te::common::Convert2String(parcelId) + ".tif";
+    std::unique_ptr<te::rst::Raster> outputRaster = GenerateThresholdRaster(parcelRaster.get(), band, threshold, type, rInfo);
+
+    //create erosion raster
+    if(dilation > 0)
+    {
+      rInfo["URI"] = repName + "_erosion_" + te::common::Convert2String(parcelId) + ".tif";
+      std::unique_ptr<te::rst::Raster> erosionRaster = GenerateFilterRaster(outputRaster.get(), 0, dilation, te::rp::Filter::InputParameters::DilationFilterT, type, rInfo);
+
+      outputRaster.reset(0);
+
+      outputRaster = std::move(erosionRaster);
+    }
+
+    //create dilation raster
+    if(erosion > 0)
+    {
+      rInfo["URI"] = repName + "_dilation_" + te::common::Convert2String(parcelId) + ".tif";
+      std::unique_ptr<te::rst::Raster> dilationRaster = GenerateFilterRaster(outputRaster.get(), 0, erosion, te::rp::Filter::InputParameters::ErosionFilterT, type, rInfo);
+
+      outputRaster.reset(0);
+
+      outputRaster = std::move(dilationRaster);
+    }
+
+    //export image
+    if(saveImages)
+    {
+      std::string rasterFileName = repName + "_" + te::common::Convert2String(parcelId) + ".tif";
+
+      geopx::tools::ExportRaster(outputRaster.get(), rasterFileName);
+    }
+
+    //create geometries
+    std::vector<te::gm::Geometry*> geomVec = geopx::tools::Raster2Vector(outputRaster.get(), 0);
+
+    outputRaster.reset(0);
+
+    //get centroids
+    geopx::tools::ExtractCentroids(geomVec, centroids, parcelId);
+
+    if(geomVec.size() > 2)
+    {
+      for(std::size_t t = 1; t < geomVec.size(); ++t)
+      {
+        polygons.push_back(geomVec[t]);
+      }
+    }
+
+    geomVec.clear();
+  }
+}
+
 void geopx::tools::AssociateObjects(te::map::AbstractLayer* layer, std::vector<geopx::tools::CentroidInfo*>& points, int srid)
 {
   std::unique_ptr<te::da::DataSet> dataSet = layer->getData();
@@ -34,7 +34,7 @@ namespace geopx
       FOREST_DEAD
     };
 
-    struct CentroidInfo
+    struct GEOPXTOOLSEXPORT CentroidInfo
     {
       te::gm::Point* m_point;
       int m_parentId;
@@ -44,26 +44,43 @@ namespace geopx
 
 
 
-    std::unique_ptr<te::rst::Raster> GenerateFilterRaster(te::rst::Raster* raster, int band, int nIter, te::rp::Filter::InputParameters::FilterType fType,
-                                                        std::string type, std::map<std::string, std::string> rinfo);
+    GEOPXTOOLSEXPORT std::unique_ptr<te::rst::Raster> GenerateFilterRaster(te::rst::Raster* raster, int band, int nIter, te::rp::Filter::InputParameters::FilterType fType,
+                                                                         std::string type, std::map<std::string, std::string> rinfo);
 
-    std::unique_ptr<te::rst::Raster> GenerateThresholdRaster(te::rst::Raster* raster, int band, double value,
-                                                            std::string type, std::map<std::string, std::string> rinfo);
+    GEOPXTOOLSEXPORT std::unique_ptr<te::rst::Raster> GenerateThresholdRaster(te::rst::Raster* raster, int band, double value,
+                                                                             std::string type, std::map<std::string, std::string> rinfo);
 
 
-    void ExportRaster(te::rst::Raster* rasterIn, std::string fileName);
+    GEOPXTOOLSEXPORT void ExportRaster(te::rst::Raster* rasterIn, std::string fileName);
 
-    std::vector<te::gm::Geometry*> Raster2Vector(te::rst::Raster* raster, int band);
+    GEOPXTOOLSEXPORT std::vector<te::gm::Geometry*> Raster2Vector(te::rst::Raster* raster, int band);
 
-    void ExtractCentroids(std::vector<te::gm::Geometry*>& geomVec, std::vector<CentroidInfo*>& centroids, int parcelId);
+    GEOPXTOOLSEXPORT void ExtractCentroids(std::vector<te::gm::Geometry*>& geomVec, std::vector<CentroidInfo*>& centroids, int parcelId);
 
-    void AssociateObjects(te::map::AbstractLayer* layer, std::vector<geopx::tools::CentroidInfo*>& points, int srid);
+    /*!
+      \brief Runs the threshold, dilation, erosion and vectorization steps for each parcel of a layer.
 
-    void ExportVector(std::vector<geopx::tools::CentroidInfo*>& ciVec, std::string dataSetName, std::string dsType, const te::core::URI& connInfo, int srid);
+      \param ndviRaster  The NDVI raster (its srid must be defined).
+      \param band        The NDVI band.
+      \param parcelLayer The parcel layer, the geometries are reprojected to the raster srid.
+      \param threshold   The NDVI threshold value.
+      \param dilation    Number of dilation iterations (0 to skip).
+      \param erosion     Number of erosion iterations (0 to skip).
+      \param repName     Base name (without extension) used for the intermediate rasters.
+      \param saveImages  If true the classified raster of each parcel is exported.
+      \param centroids   Output centroids (caller takes the ownership).
+      \param polygons    Output tree polygons (caller takes the ownership).
+    */
+    GEOPXTOOLSEXPORT void ClassifyParcels(te::rst::Raster* ndviRaster, int band, te::map::AbstractLayerPtr parcelLayer, double threshold, int dilation, int erosion,
+                                          std::string repName, bool saveImages, std::vector<CentroidInfo*>& centroids, std::vector<te::gm::Geometry*>& polygons);
 
-    void ExportPolyVector(std::vector<te::gm::Geometry*>& geomVec, std::string dataSetName, std::string dsType, const te::core::URI& connInfo, int srid);
+    GEOPXTOOLSEXPORT void AssociateObjects(te::map::AbstractLayer* layer, std::vector<geopx::tools::CentroidInfo*>& points, int srid);
 
-    void ClearData(te::map::AbstractLayerPtr layer);
+    GEOPXTOOLSEXPORT void ExportVector(std::vector<geopx::tools::CentroidInfo*>& ciVec, std::string dataSetName, std::string dsType, const te::core::URI& connInfo, int srid);
+
+    GEOPXTOOLSEXPORT void ExportPolyVector(std::vector<te::gm::Geometry*>& geomVec, std::string dataSetName, std::string dsType, const te::core::URI& connInfo, int srid);
+
+    GEOPXTOOLSEXPORT void ClearData(te::map::AbstractLayerPtr layer);
 
   }     // end namespace qt
 }       // end namespace te
@@ -6,14 +6,15 @@
 */
 
 #include "ForestMonitorService.h"
+#include "DataSourceTrackSink.h"
 #include "ForestMonitor.h"
+#include "LayerIndex.h"
 
 //TerraLib Includes
 #include <terralib/core/Exception.h>
 #include <terralib/dataaccess/utils/Utils.h>
 #include <terralib/datatype/SimpleProperty.h>
 #include <terralib/geometry/GeometryProperty.h>
-#include <terralib/memory/DataSet.h>
 
 
 //STL Includes
@@ -67,33 +68,26 @@ void geopx::tools::ForestMonitorService::runService()
   int parcelIdIdx, parcelGeomIdx;
   getDataSetTypeInfo(parcelDsType.get(), parcelIdIdx, parcelGeomIdx);
 
-  std::unique_ptr<te::da::DataSet> angleDataSet = m_angleLayer->getData();
-  std::unique_ptr<te::da::DataSetType> angleDsType = m_angleLayer->getSchema();
-  int angleIdIdx, angleGeomIdx;
-  getDataSetTypeInfo(angleDsType.get(), angleIdIdx, angleGeomIdx);
-
-  std::unique_ptr<te::da::DataSet> centroidDataSet = m_centroidLayer->getData();
-  std::unique_ptr<te::da::DataSetType> centroidDsType = m_centroidLayer->getSchema();
-  int centroidIdIdx, centroidGeomIdx;
-  getDataSetTypeInfo(centroidDsType.get(), centroidIdIdx, centroidGeomIdx);
-
   //get srid
   int srid = getParcelSRID();
 
-  //create output dataset
-  std::unique_ptr<te::da::DataSetType> dsType = createDataSetType(srid);
-
-  std::unique_ptr<te::mem::DataSet> ds(new te::mem::DataSet(dsType.get()));
+  //create output dataset, the tracks are written while the parcels are processed
+  geopx::tools::DataSourceTrackSink sink(m_ds, createDataSetType(srid));
 
   //generate tracks
-  geopx::tools::ForestMonitor fm(m_angleTol, m_centroidDist, m_distTol,ds.get());
+  geopx::tools::ForestMonitor fm(m_angleTol, m_centroidDist, m_distTol, &sink);
+
+  //get centroids and angles from the index snapshots (the layers are read only if the snapshots are out of date)
+  geopx::tools::CreateLayerIndex(m_centroidLayer, fm.getCentroidIndex());
 
-  fm.execute(std::move(parcelDataSet), parcelGeomIdx, parcelIdIdx, 
-             std::move(angleDataSet), angleGeomIdx, angleIdIdx, 
-             std::move(centroidDataSet), centroidGeomIdx, centroidIdIdx);
+  //the angle layer is optional, parcels without direction lines use the angle estimated from its centroids
+  if(m_angleLayer.get())
+    geopx::tools::CreateLayerIndex(m_angleLayer, fm.getAngleIndex());
 
-  //save output information
-  saveDataSet(ds.get(), dsType.get());
+  fm.execute(std::move(parcelDataSet), parcelGeomIdx, parcelIdIdx);
+
+  //wait for the output information
+  sink.flush();
 }
 
 void geopx::tools::ForestMonitorService::checkParameters()
@@ -104,9 +98,6 @@ void geopx::tools::ForestMonitorService::checkParameters()
   if(!m_parcelLayer.get())
     throw te::core::Exception() << te::ErrorDescription("Parcel Layer not defined.");
 
-  if(!m_angleLayer.get())
-    throw te::core::Exception() << te::ErrorDescription("Angle Layer not defined.");
-
   if(!m_ds.get())
     throw te::core::Exception() << te::ErrorDescription("Data Source not defined.");
 
@@ -138,21 +129,6 @@ std::unique_ptr<te::da::DataSetType> geopx::tools::ForestMonitorService::createD
   return dsType;
 }
 
-void geopx::tools::ForestMonitorService::saveDataSet(te::mem::DataSet* dataSet, te::da::DataSetType* dsType)
-{
-  assert(dataSet);
-  assert(dsType);
-
-  //save dataset
-  dataSet->moveBeforeFirst();
-
-  std::map<std::string, std::string> options;
-
-  m_ds->createDataSet(dsType, options);
-
-  m_ds->add(m_outputDataSetName, dataSet, options);
-}
-
 void geopx::tools::ForestMonitorService::getDataSetTypeInfo(te::da::DataSetType* dsType, int& idIdx, int& geomIdx)
 {
   //geom property info
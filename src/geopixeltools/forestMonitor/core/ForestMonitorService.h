@@ -4,9 +4,9 @@
   \brief This file implements the service to monitor the forest information.
 
   - get all centroids from centroidLayer and add into a rtree
-  - get all lines from angleLayer and add into another rtree
+  - get all lines from angleLayer (optional) and add into another rtree
   - get all polygons from parcelLayer and iterate over the elements
-  - get line and calculate the angle for the current polygon
+  - get line and calculate the angle for the current polygon (or estimate it from the polygon centroids)
   - get all centroids that is inside the current polygon box
   - for each centroid check if in inside the current polygon geometry
   - get the centroid neighboors from the current centroid using the centroidDistance
@@ -39,7 +39,7 @@ namespace geopx
     //forward declarations
     class ForestMonitor;
 
-    class ForestMonitorService
+    class GEOPXTOOLSEXPORT ForestMonitorService
     {
       public:
 
@@ -65,9 +65,6 @@ namespace geopx
         /*! Function used to create the output dataset type */
         std::unique_ptr<te::da::DataSetType> createDataSetType(int srid);
 
-        /*! Function used to save the output dataset */
-        void saveDataSet(te::mem::DataSet* dataSet, te::da::DataSetType* dsType);
-
         void getDataSetTypeInfo(te::da::DataSetType* dsType, int& idIdx, int& geomIdx);
 
         int getParcelSRID();
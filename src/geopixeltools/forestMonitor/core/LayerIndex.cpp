@@ -0,0 +1,402 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/LayerIndex.cpp
+
+  \brief This file contains functions used to build the spatial index of a layer and to keep
+         a snapshot of it next to the layer dataset.
+*/
+
+#include "LayerIndex.h"
+#include "SpatialIndex.h"
+
+//TerraLib Includes
+#include <terralib/core/logger/Logger.h>
+#include <terralib/dataaccess/dataset/DataSet.h>
+#include <terralib/dataaccess/dataset/DataSetType.h>
+#include <terralib/dataaccess/dataset/ObjectId.h>
+#include <terralib/dataaccess/dataset/ObjectIdSet.h>
+#include <terralib/dataaccess/dataset/PrimaryKey.h>
+#include <terralib/dataaccess/utils/Utils.h>
+#include <terralib/geometry/Geometry.h>
+#include <terralib/geometry/GeometryProperty.h>
+#include <terralib/geometry/LineString.h>
+#include <terralib/geometry/MultiLineString.h>
+#include <terralib/geometry/MultiPoint.h>
+#include <terralib/geometry/Point.h>
+#include <terralib/datatype/Numeric.h>
+#include <terralib/datatype/SimpleData.h>
+#include <terralib/maptools/DataSetLayer.h>
+#include <terralib/memory/DataSet.h>
+#include <terralib/memory/DataSetItem.h>
+
+// Boost
+#include <boost/filesystem.hpp>
+
+//STL Includes
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define INDEX_FILE_EXTENSION ".gpxidx"
+#define SIGNATURE_HEADER_SIZE 512
+
+namespace
+{
+  /*! Returns the path used by the data source of the layer (a file or a directory) */
+  boost::filesystem::path GetLayerDataSourcePath(te::map::AbstractLayerPtr layer)
+  {
+    te::map::DataSetLayer* dsLayer = dynamic_cast<te::map::DataSetLayer*>(layer.get());
+
+    if(!dsLayer)
+      return boost::filesystem::path();
+
+    std::string path;
+
+    try
+    {
+      te::da::DataSourcePtr ds = te::da::GetDataSource(dsLayer->getDataSourceId());
+
+      if(!ds.get())
+        return boost::filesystem::path();
+
+      path = ds->getConnectionInfo().path();
+    }
+    catch(...)
+    {
+      return boost::filesystem::path();
+    }
+
+#ifdef WIN32
+    //uri paths are like /C:/dir/file.shp
+    if(path.size() > 2 && path[0] == '/' && path[2] == ':')
+      path = path.substr(1);
+#endif
+
+    boost::system::error_code ec;
+
+    if(path.empty() || !boost::filesystem::exists(path, ec))
+      return boost::filesystem::path();
+
+    return boost::filesystem::path(path);
+  }
+
+  /*! Returns all files that belong to the layer dataset (e.g. shp, shx and dbf for a shapefile) */
+  std::vector<boost::filesystem::path> GetLayerFiles(te::map::AbstractLayerPtr layer, boost::filesystem::path& stem)
+  {
+    std::vector<boost::filesystem::path> files;
+
+    boost::filesystem::path path = GetLayerDataSourcePath(layer);
+
+    if(path.empty())
+      return files;
+
+    te::map::DataSetLayer* dsLayer = dynamic_cast<te::map::DataSetLayer*>(layer.get());
+
+    boost::filesystem::path dir;
+
+    if(boost::filesystem::is_directory(path))
+    {
+      //directory data sources keep one file per dataset
+      dir = path;
+      stem = dir / dsLayer->getDataSetName();
+    }
+    else
+    {
+      dir = path.parent_path();
+      stem = dir / path.stem();
+    }
+
+    boost::system::error_code ec;
+
+    for(boost::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+    {
+      const boost::filesystem::path& p = it->path();
+
+      if(!boost::filesystem::is_regular_file(p))
+        continue;
+
+      if(p.extension() == INDEX_FILE_EXTENSION)
+        continue;
+
+      if(p.parent_path() / p.stem() == stem)
+        files.push_back(p);
+    }
+
+    std::sort(files.begin(), files.end());
+
+    return files;
+  }
+
+  /*! Returns a hash (FNV-1a) of the first bytes of the file, the headers keep the record count, the extent and the dbf update date */
+  unsigned long long GetFileHeaderHash(const boost::filesystem::path& file)
+  {
+    std::ifstream in(file.string().c_str(), std::ios::in | std::ios::binary);
+
+    char buffer[SIGNATURE_HEADER_SIZE];
+
+    in.read(buffer, SIGNATURE_HEADER_SIZE);
+
+    std::streamsize size = in.gcount();
+
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for(std::streamsize t = 0; t < size; ++t)
+    {
+      hash ^= static_cast<unsigned char>(buffer[t]);
+      hash *= 1099511628211ULL;
+    }
+
+    return hash;
+  }
+
+  /*! Returns the index id as a value of the key property type */
+  te::dt::AbstractData* CreateKeyValue(int type, int id)
+  {
+    switch(type)
+    {
+      case te::dt::INT16_TYPE:
+        return new te::dt::Int16(static_cast<boost::int16_t>(id));
+      case te::dt::UINT16_TYPE:
+        return new te::dt::UInt16(static_cast<boost::uint16_t>(id));
+      case te::dt::UINT32_TYPE:
+        return new te::dt::UInt32(static_cast<boost::uint32_t>(id));
+      case te::dt::INT64_TYPE:
+        return new te::dt::Int64(static_cast<boost::int64_t>(id));
+      case te::dt::UINT64_TYPE:
+        return new te::dt::UInt64(static_cast<boost::uint64_t>(id));
+      case te::dt::DOUBLE_TYPE:
+        return new te::dt::Double(static_cast<double>(id));
+      case te::dt::NUMERIC_TYPE:
+        return new te::dt::Numeric(std::to_string(id));
+      case te::dt::STRING_TYPE:
+        return new te::dt::String(std::to_string(id));
+      default:
+        return new te::dt::Int32(id);
+    }
+  }
+
+  /*! Creates the object ids of the index positions from a dataset holding their primary key values */
+  void CreateObjectIds(const te::da::DataSetType* schema, const geopx::tools::SpatialIndex& index,
+                       const std::vector<std::size_t>& positions, std::vector<te::da::ObjectId*>& oids)
+  {
+    assert(schema);
+
+    const te::dt::Property* keyProp = schema->getPrimaryKey()->getProperties()[0];
+
+    te::da::DataSetType keyType(schema->getName());
+    keyType.add(keyProp->clone());
+
+    te::mem::DataSet keys(&keyType);
+
+    for(std::size_t t = 0; t < positions.size(); ++t)
+    {
+      te::mem::DataSetItem* item = new te::mem::DataSetItem(&keys);
+
+      item->setValue(0, CreateKeyValue(keyProp->getType(), index.getId(positions[t])));
+
+      keys.add(item);
+    }
+
+    std::vector<std::string> pnames(1, keyProp->getName());
+
+    keys.moveBeforeFirst();
+
+    while(keys.moveNext())
+      oids.push_back(te::da::GenerateOID(&keys, pnames));
+  }
+}
+
+std::string geopx::tools::GetLayerSignature(te::map::AbstractLayerPtr layer)
+{
+  boost::filesystem::path stem;
+
+  std::vector<boost::filesystem::path> files = GetLayerFiles(layer, stem);
+
+  if(files.empty())
+    return "";
+
+  te::map::DataSetLayer* dsLayer = dynamic_cast<te::map::DataSetLayer*>(layer.get());
+
+  std::ostringstream signature;
+
+  signature << dsLayer->getDataSetName() << ";" << layer->getSRID() << ";";
+
+  for(std::size_t t = 0; t < files.size(); ++t)
+  {
+    boost::system::error_code ec;
+
+    boost::uintmax_t size = boost::filesystem::file_size(files[t], ec);
+    std::time_t time = boost::filesystem::last_write_time(files[t], ec);
+
+    //the time has a resolution of one second, an edit that keeps the size is found by the headers
+    signature << files[t].filename().string() << ":" << size << ":" << time << ":" << GetFileHeaderHash(files[t]) << ";";
+  }
+
+  return signature.str();
+}
+
+std::string geopx::tools::GetLayerIndexFileName(te::map::AbstractLayerPtr layer)
+{
+  boost::filesystem::path stem;
+
+  std::vector<boost::filesystem::path> files = GetLayerFiles(layer, stem);
+
+  if(files.empty())
+    return "";
+
+  te::map::DataSetLayer* dsLayer = dynamic_cast<te::map::DataSetLayer*>(layer.get());
+
+  std::string fileName = stem.string();
+
+  if(stem.filename().string() != dsLayer->getDataSetName())
+    fileName += "." + dsLayer->getDataSetName();
+
+  return fileName + INDEX_FILE_EXTENSION;
+}
+
+void geopx::tools::CreateLayerIndex(te::map::AbstractLayerPtr layer, SpatialIndex& index)
+{
+  assert(layer.get());
+
+  std::string fileName = GetLayerIndexFileName(layer);
+  std::string signature = GetLayerSignature(layer);
+
+  //try the snapshot
+  if(!fileName.empty() && index.load(fileName, signature))
+    return;
+
+  //read the layer
+  std::unique_ptr<te::da::DataSetType> schema = layer->getSchema();
+  std::unique_ptr<te::da::DataSet> ds = layer->getData();
+
+  te::gm::GeometryProperty* gmProp = te::da::GetFirstGeomProperty(schema.get());
+
+  int geomIdx = te::da::GetPropertyPos(schema.get(), gmProp->getName());
+
+  te::da::PrimaryKey* pk = schema->getPrimaryKey();
+
+  int idIdx = te::da::GetPropertyPos(schema.get(), pk->getProperties()[0]->getName());
+
+  CreateDataSetIndex(ds.get(), geomIdx, idIdx, index);
+
+  index.setSRID(layer->getSRID());
+
+  //save the snapshot, a read only repository only means a slower start next time
+  if(!fileName.empty())
+  {
+    try
+    {
+      index.save(fileName, signature);
+    }
+    catch(const std::exception& e)
+    {
+      TE_LOG_WARN("Could not save the spatial index snapshot " + fileName + ": " + e.what());
+    }
+  }
+}
+
+void geopx::tools::SaveLayerIndex(te::map::AbstractLayerPtr layer, SpatialIndex& index)
+{
+  std::string fileName = GetLayerIndexFileName(layer);
+
+  if(fileName.empty())
+    return;
+
+  //the index may be mapped from the file that will be replaced
+  index.detach();
+
+  index.save(fileName, GetLayerSignature(layer));
+}
+
+void geopx::tools::CreateDataSetIndex(te::da::DataSet* ds, int geomIdx, int idIdx, SpatialIndex& index)
+{
+  assert(ds);
+
+  index.clear();
+
+  ds->moveBeforeFirst();
+
+  while(ds->moveNext())
+  {
+    if(ds->isNull(geomIdx))
+      continue;
+
+    std::string strId = ds->getAsString(idIdx);
+
+    int id = atoi(strId.c_str());
+
+    std::unique_ptr<te::gm::Geometry> g = ds->getGeometry(geomIdx);
+
+    AddGeometryToIndex(id, g.get(), index);
+  }
+
+  index.build();
+}
+
+te::da::ObjectId* geopx::tools::CreateObjectId(const te::da::DataSetType* schema, const SpatialIndex& index, std::size_t pos)
+{
+  std::vector<te::da::ObjectId*> oids;
+
+  CreateObjectIds(schema, index, std::vector<std::size_t>(1, pos), oids);
+
+  return oids[0];
+}
+
+te::da::ObjectIdSet* geopx::tools::CreateObjectIdSet(te::map::AbstractLayerPtr layer, const SpatialIndex& index, const std::vector<std::size_t>& positions)
+{
+  std::unique_ptr<const te::map::LayerSchema> schema(layer->getSchema());
+
+  te::da::ObjectIdSet* oids = 0;
+
+  te::da::GetEmptyOIDSet(schema.get(), oids);
+
+  std::vector<te::da::ObjectId*> items;
+
+  CreateObjectIds(schema.get(), index, positions, items);
+
+  for(std::size_t t = 0; t < items.size(); ++t)
+    oids->add(items[t]);
+
+  return oids;
+}
+
+void geopx::tools::AddGeometryToIndex(int id, const te::gm::Geometry* geom, SpatialIndex& index)
+{
+  assert(geom);
+
+  const te::gm::Geometry* g = geom;
+
+  //first element of collections
+  const te::gm::MultiPoint* mPoint = dynamic_cast<const te::gm::MultiPoint*>(geom);
+  const te::gm::MultiLineString* mLine = dynamic_cast<const te::gm::MultiLineString*>(geom);
+
+  if(mPoint && mPoint->getNumGeometries() != 0)
+    g = mPoint->getGeometryN(0);
+  else if(mLine && mLine->getNumGeometries() != 0)
+    g = mLine->getGeometryN(0);
+
+  const te::gm::Point* point = dynamic_cast<const te::gm::Point*>(g);
+
+  if(point)
+  {
+    index.add(id, point->getX(), point->getY());
+    return;
+  }
+
+  const te::gm::LineString* line = dynamic_cast<const te::gm::LineString*>(g);
+
+  if(line && line->size() >= 2)
+  {
+    index.add(id, line->getX(0), line->getY(0), line->getX(1), line->getY(1));
+    return;
+  }
+
+  const te::gm::Envelope* box = geom->getMBR();
+
+  index.add(id, box->m_llx, box->m_lly, box->m_urx, box->m_ury);
+}
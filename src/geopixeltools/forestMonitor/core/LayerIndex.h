@@ -0,0 +1,84 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/LayerIndex.h
+
+  \brief This file contains functions used to build the spatial index of a layer and to keep
+         a snapshot of it next to the layer dataset.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_LAYERINDEX_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_LAYERINDEX_H
+
+#include "../../Config.h"
+
+// TerraLib
+#include <terralib/maptools/AbstractLayer.h>
+
+//STL Includes
+#include <string>
+#include <vector>
+
+namespace te
+{
+  namespace da { class DataSet; class DataSetType; class ObjectId; class ObjectIdSet; }
+  namespace gm { class Geometry; }
+}
+
+namespace geopx
+{
+  namespace tools
+  {
+    class SpatialIndex;
+
+    /*!
+      \brief Returns a string that identifies the current state of the files used by the layer dataset.
+
+      The signature has the size, the modification time and a hash of the header of each file.
+
+      \return An empty string if the layer is not stored in local files.
+    */
+    GEOPXTOOLSEXPORT std::string GetLayerSignature(te::map::AbstractLayerPtr layer);
+
+    /*!
+      \brief Returns the name of the snapshot file for the layer spatial index.
+
+      \return An empty string if the layer is not stored in local files.
+    */
+    GEOPXTOOLSEXPORT std::string GetLayerIndexFileName(te::map::AbstractLayerPtr layer);
+
+    /*!
+      \brief Fills the index with the layer geometries.
+
+      The snapshot file is used if it was created for the current layer signature, otherwise
+      the layer is read and a new snapshot is written.
+    */
+    GEOPXTOOLSEXPORT void CreateLayerIndex(te::map::AbstractLayerPtr layer, SpatialIndex& index);
+
+    /*!
+      \brief Writes the index as the layer snapshot. Nothing is done for layers not stored in local files.
+
+      A mapped index is detached from the old snapshot before it is replaced.
+
+      \exception te::core::Exception Or a boost filesystem error if the snapshot could not be written.
+    */
+    GEOPXTOOLSEXPORT void SaveLayerIndex(te::map::AbstractLayerPtr layer, SpatialIndex& index);
+
+    /*! \brief Fills the index with all geometries from the dataset. */
+    GEOPXTOOLSEXPORT void CreateDataSetIndex(te::da::DataSet* ds, int geomIdx, int idIdx, SpatialIndex& index);
+
+    /*!
+      \brief Creates the object id of the item at the given index position.
+
+      The index keeps the primary key value as id, it is converted to the type of the key property of the schema.
+    */
+    GEOPXTOOLSEXPORT te::da::ObjectId* CreateObjectId(const te::da::DataSetType* schema, const SpatialIndex& index, std::size_t pos);
+
+    /*! \brief Creates the object id set of the items at the given index positions, used to read only these features from the layer. */
+    GEOPXTOOLSEXPORT te::da::ObjectIdSet* CreateObjectIdSet(te::map::AbstractLayerPtr layer, const SpatialIndex& index, const std::vector<std::size_t>& positions);
+
+    /*! \brief Adds a geometry: points by its coordinate, lines by the first two vertices and others by the MBR. */
+    GEOPXTOOLSEXPORT void AddGeometryToIndex(int id, const te::gm::Geometry* geom, SpatialIndex& index);
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_LAYERINDEX_H
@@ -24,17 +24,17 @@ namespace geopx
   namespace tools
   {
 
-    std::unique_ptr<te::rst::Raster> GenerateNDVIRaster(te::rst::Raster* rasterNIR, int bandNIR,
-                                                      te::rst::Raster* rasterVIS, int bandVIS, 
-                                                      double gain, double offset, bool normalize, 
-                                                      std::map<std::string, std::string> rInfo,
-                                                      std::string type, int srid,
-                                                      bool invert, bool rgbVIS);
+    GEOPXTOOLSEXPORT std::unique_ptr<te::rst::Raster> GenerateNDVIRaster(te::rst::Raster* rasterNIR, int bandNIR,
+                                                                       te::rst::Raster* rasterVIS, int bandVIS, 
+                                                                       double gain, double offset, bool normalize, 
+                                                                       std::map<std::string, std::string> rInfo,
+                                                                       std::string type, int srid,
+                                                                       bool invert, bool rgbVIS);
 
-    te::rst::Raster* InvertRaster(te::rst::Raster* rasterNIR, int bandNIR);
+    GEOPXTOOLSEXPORT te::rst::Raster* InvertRaster(te::rst::Raster* rasterNIR, int bandNIR);
 
-    std::unique_ptr<te::rst::Raster> NormalizeRaster(te::rst::Raster* inraster, double min, double max, double nmin, double nmax,
-                                                    std::map<std::string, std::string> rInfo, std::string type);
+    GEOPXTOOLSEXPORT std::unique_ptr<te::rst::Raster> NormalizeRaster(te::rst::Raster* inraster, double min, double max, double nmin, double nmax,
+                                                                     std::map<std::string, std::string> rInfo, std::string type);
 
 
   } // end namespace tools
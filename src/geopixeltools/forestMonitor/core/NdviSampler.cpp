@@ -0,0 +1,304 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/NdviSampler.cpp
+
+  \brief This file contains a class used to read NDVI values at many geographic locations.
+*/
+
+#include "NdviSampler.h"
+
+//TerraLib Includes
+#include <terralib/datatype/Enums.h>
+#include <terralib/geometry/Envelope.h>
+#include <terralib/raster/Band.h>
+#include <terralib/raster/BandProperty.h>
+#include <terralib/raster/Grid.h>
+#include <terralib/raster/Raster.h>
+
+//STL Includes
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+  template<class T> void DecodeBuffer(const unsigned char* buffer, std::size_t size, std::vector<double>& values)
+  {
+    const T* data = reinterpret_cast<const T*>(buffer);
+
+    for(std::size_t t = 0; t < size; ++t)
+      values[t] = static_cast<double>(data[t]);
+  }
+}
+
+geopx::tools::NdviSampler::NdviSampler(te::rst::Raster* raster, std::size_t band, std::size_t maxBlocks) :
+  m_raster(raster),
+  m_band(raster->getBand(band)),
+  m_mode(NDVI_SAMPLING_NEAREST),
+  m_radius(1),
+  m_maxBlocks(maxBlocks ? maxBlocks : 1),
+  m_hits(0),
+  m_misses(0)
+{
+  assert(m_raster);
+
+  te::rst::Grid* grid = m_raster->getGrid();
+
+  //the transform is affine, three locations are enough to get its coefficients
+  double x0 = grid->getExtent()->getLowerLeftX();
+  double y0 = grid->getExtent()->getLowerLeftY();
+
+  te::gm::Coord2D c0 = grid->geoToGrid(x0, y0);
+  te::gm::Coord2D cx = grid->geoToGrid(x0 + 1., y0);
+  te::gm::Coord2D cy = grid->geoToGrid(x0, y0 + 1.);
+
+  m_geoT[1] = cx.getX() - c0.getX();
+  m_geoT[2] = cy.getX() - c0.getX();
+  m_geoT[0] = c0.getX() - m_geoT[1] * x0 - m_geoT[2] * y0;
+  m_geoT[4] = cx.getY() - c0.getY();
+  m_geoT[5] = cy.getY() - c0.getY();
+  m_geoT[3] = c0.getY() - m_geoT[4] * x0 - m_geoT[5] * y0;
+
+  m_nCols = static_cast<int>(m_raster->getNumberOfColumns());
+  m_nRows = static_cast<int>(m_raster->getNumberOfRows());
+
+  const te::rst::BandProperty* prop = m_band->getProperty();
+
+  m_blkw = prop->m_blkw > 0 ? prop->m_blkw : m_nCols;
+  m_blkh = prop->m_blkh > 0 ? prop->m_blkh : 1;
+  m_nBlocksX = (m_nCols + m_blkw - 1) / m_blkw;
+  m_dataType = prop->m_type;
+  m_noDataValue = prop->m_noDataValue;
+}
+
+geopx::tools::NdviSampler::~NdviSampler()
+{
+}
+
+void geopx::tools::NdviSampler::setMode(NdviSamplingMode mode, int radius)
+{
+  m_mode = mode;
+  m_radius = radius > 0 ? radius : 1;
+}
+
+bool geopx::tools::NdviSampler::sample(double x, double y, double& value)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  return sampleValue(x, y, value);
+}
+
+void geopx::tools::NdviSampler::sample(const std::vector<te::gm::Coord2D>& points, std::vector<double>& values)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  values.resize(points.size());
+
+  for(std::size_t t = 0; t < points.size(); ++t)
+  {
+    if(!sampleValue(points[t].getX(), points[t].getY(), values[t]))
+      values[t] = m_noDataValue;
+  }
+}
+
+bool geopx::tools::NdviSampler::sampleValue(double x, double y, double& value)
+{
+  double col = m_geoT[0] + m_geoT[1] * x + m_geoT[2] * y;
+  double row = m_geoT[3] + m_geoT[4] * x + m_geoT[5] * y;
+
+  int c = static_cast<int>(std::floor(col));
+  int r = static_cast<int>(std::floor(row));
+
+  if(m_mode == NDVI_SAMPLING_BILINEAR)
+  {
+    //pixel centers are at the integer grid coordinates, the border pixels are repeated
+    if(c < -1 || r < -1 || c >= m_nCols || r >= m_nRows)
+      return false;
+
+    double dx = col - c;
+    double dy = row - r;
+
+    int c0 = std::max(c, 0);
+    int r0 = std::max(r, 0);
+    int c1 = std::min(c + 1, m_nCols - 1);
+    int r1 = std::min(r + 1, m_nRows - 1);
+
+    double v00 = 0., v10 = 0., v01 = 0., v11 = 0.;
+
+    getPixel(c0, r0, v00);
+    getPixel(c1, r0, v10);
+    getPixel(c0, r1, v01);
+    getPixel(c1, r1, v11);
+
+    value = (v00 * (1. - dx) + v10 * dx) * (1. - dy) + (v01 * (1. - dx) + v11 * dx) * dy;
+
+    return true;
+  }
+
+  if(!getPixel(c, r, value))
+    return false;
+
+  if(m_mode == NDVI_SAMPLING_MAX)
+  {
+    for(int i = r - m_radius; i <= r + m_radius; ++i)
+    {
+      for(int j = c - m_radius; j <= c + m_radius; ++j)
+      {
+        double v;
+
+        if(getPixel(j, i, v) && v != m_noDataValue && (value == m_noDataValue || v > value))
+          value = v;
+      }
+    }
+  }
+
+  return true;
+}
+
+double geopx::tools::NdviSampler::getNoDataValue() const
+{
+  return m_noDataValue;
+}
+
+std::size_t geopx::tools::NdviSampler::getHits() const
+{
+  return m_hits.load(std::memory_order_relaxed);
+}
+
+std::size_t geopx::tools::NdviSampler::getMisses() const
+{
+  return m_misses.load(std::memory_order_relaxed);
+}
+
+bool geopx::tools::NdviSampler::getPixel(int col, int row, double& value)
+{
+  if(col < 0 || row < 0 || col >= m_nCols || row >= m_nRows)
+    return false;
+
+  int bx = col / m_blkw;
+  int by = row / m_blkh;
+
+  const std::vector<double>& block = getBlock(bx, by);
+
+  value = block[(row - by * m_blkh) * m_blkw + (col - bx * m_blkw)];
+
+  return true;
+}
+
+const std::vector<double>& geopx::tools::NdviSampler::getBlock(int bx, int by)
+{
+  int key = by * m_nBlocksX + bx;
+
+  auto it = m_blocks.find(key);
+
+  if(it != m_blocks.end())
+  {
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+
+    //move to the front of the LRU list
+    m_lru.splice(m_lru.begin(), m_lru, it->second.second);
+
+    return it->second.first;
+  }
+
+  m_misses.fetch_add(1, std::memory_order_relaxed);
+
+  if(m_blocks.size() >= m_maxBlocks)
+  {
+    m_blocks.erase(m_lru.back());
+    m_lru.pop_back();
+  }
+
+  m_lru.push_front(key);
+
+  std::pair<std::vector<double>, std::list<int>::iterator>& entry = m_blocks[key];
+
+  entry.second = m_lru.begin();
+
+  decodeBlock(bx, by, entry.first);
+
+  return entry.first;
+}
+
+void geopx::tools::NdviSampler::decodeBlock(int bx, int by, std::vector<double>& values)
+{
+  std::size_t size = static_cast<std::size_t>(m_blkw) * static_cast<std::size_t>(m_blkh);
+
+  values.assign(size, m_noDataValue);
+
+  std::size_t pixelSize = 0;
+
+  switch(m_dataType)
+  {
+    case te::dt::UCHAR_TYPE:
+    case te::dt::CHAR_TYPE:
+      pixelSize = 1;
+      break;
+    case te::dt::INT16_TYPE:
+    case te::dt::UINT16_TYPE:
+      pixelSize = 2;
+      break;
+    case te::dt::INT32_TYPE:
+    case te::dt::UINT32_TYPE:
+    case te::dt::FLOAT_TYPE:
+      pixelSize = 4;
+      break;
+    case te::dt::DOUBLE_TYPE:
+      pixelSize = 8;
+      break;
+    default:
+      break;
+  }
+
+  const te::rst::BandProperty* prop = m_band->getProperty();
+
+  //other data types and bands that do not report their blocks are read pixel by pixel,
+  //a block read could be larger than the assumed one row blocks
+  if(pixelSize == 0 || prop->m_blkw != m_blkw || prop->m_blkh != m_blkh)
+  {
+    int c0 = bx * m_blkw;
+    int r0 = by * m_blkh;
+    int c1 = std::min(c0 + m_blkw, m_nCols);
+    int r1 = std::min(r0 + m_blkh, m_nRows);
+
+    for(int r = r0; r < r1; ++r)
+    {
+      for(int c = c0; c < c1; ++c)
+        m_band->getValue(c, r, values[(r - r0) * m_blkw + (c - c0)]);
+    }
+
+    return;
+  }
+
+  m_buffer.resize(size * pixelSize);
+
+  m_band->read(bx, by, m_buffer.data());
+
+  switch(m_dataType)
+  {
+    case te::dt::UCHAR_TYPE:
+      DecodeBuffer<unsigned char>(m_buffer.data(), size, values);
+      break;
+    case te::dt::CHAR_TYPE:
+      DecodeBuffer<char>(m_buffer.data(), size, values);
+      break;
+    case te::dt::INT16_TYPE:
+      DecodeBuffer<int16_t>(m_buffer.data(), size, values);
+      break;
+    case te::dt::UINT16_TYPE:
+      DecodeBuffer<uint16_t>(m_buffer.data(), size, values);
+      break;
+    case te::dt::INT32_TYPE:
+      DecodeBuffer<int32_t>(m_buffer.data(), size, values);
+      break;
+    case te::dt::UINT32_TYPE:
+      DecodeBuffer<uint32_t>(m_buffer.data(), size, values);
+      break;
+    case te::dt::FLOAT_TYPE:
+      DecodeBuffer<float>(m_buffer.data(), size, values);
+      break;
+    default:
+      DecodeBuffer<double>(m_buffer.data(), size, values);
+      break;
+  }
+}
@@ -0,0 +1,124 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/NdviSampler.h
+
+  \brief This file contains a class used to read NDVI values at many geographic locations.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_NDVISAMPLER_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_NDVISAMPLER_H
+
+#include "../../Config.h"
+
+// TerraLib
+#include <terralib/geometry/Coord2D.h>
+
+//STL Includes
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#define NDVI_SAMPLER_BLOCKS 64
+
+namespace te { namespace rst { class Band; class Raster; } }
+
+namespace geopx
+{
+  namespace tools
+  {
+    enum NdviSamplingMode
+    {
+      NDVI_SAMPLING_NEAREST,      //!< Value of the pixel that contains the location (same pixel used by Grid::geoToGrid + Raster::getValue).
+      NDVI_SAMPLING_BILINEAR,     //!< Bilinear interpolation of the four pixel centers around the location.
+      NDVI_SAMPLING_MAX           //!< Maximum value in the pixel neighborhood of the location.
+    };
+
+    /*!
+      \class NdviSampler
+
+      \brief Reads the values of a raster band at geographic locations.
+
+      The geographic to grid transform is computed once and the band is read by blocks, the
+      decoded blocks are kept in a LRU list. The tracks walk along the plantation rows, so
+      consecutive locations are almost always inside the cached blocks.
+
+      \note The sample methods can be called from more than one thread.
+    */
+    class GEOPXTOOLSEXPORT NdviSampler
+    {
+      public:
+
+        /*!
+          \param raster     The NDVI raster (not owned, must have the same SRID of the sampled locations).
+          \param band       The band index.
+          \param maxBlocks  Maximum number of decoded blocks kept in memory.
+        */
+        NdviSampler(te::rst::Raster* raster, std::size_t band = 0, std::size_t maxBlocks = NDVI_SAMPLER_BLOCKS);
+
+        ~NdviSampler();
+
+      public:
+
+        /*!
+          \brief Sets the sampling mode.
+
+          \param mode    The sampling mode.
+          \param radius  Neighborhood radius in pixels (only used by NDVI_SAMPLING_MAX).
+        */
+        void setMode(NdviSamplingMode mode, int radius = 1);
+
+        /*! \brief Reads the value at the location, returns false if the location is outside the raster. */
+        bool sample(double x, double y, double& value);
+
+        /*! \brief Reads the values at all locations, locations outside the raster get the no data value. */
+        void sample(const std::vector<te::gm::Coord2D>& points, std::vector<double>& values);
+
+        double getNoDataValue() const;
+
+        std::size_t getHits() const;
+
+        std::size_t getMisses() const;
+
+      protected:
+
+        bool sampleValue(double x, double y, double& value);
+
+        bool getPixel(int col, int row, double& value);
+
+        const std::vector<double>& getBlock(int bx, int by);
+
+        void decodeBlock(int bx, int by, std::vector<double>& values);
+
+      protected:
+
+        te::rst::Raster* m_raster;            //!< The sampled raster.
+        te::rst::Band* m_band;                //!< The sampled band.
+
+        double m_geoT[6];                     //!< Geographic to grid transform: col = t0 + t1 * x + t2 * y, row = t3 + t4 * x + t5 * y.
+
+        int m_nCols;
+        int m_nRows;
+        int m_blkw;                           //!< Block width in pixels.
+        int m_blkh;                           //!< Block height in pixels.
+        int m_nBlocksX;                       //!< Number of blocks in a block row.
+        int m_dataType;                       //!< The band data type.
+        double m_noDataValue;
+
+        NdviSamplingMode m_mode;
+        int m_radius;
+
+        std::size_t m_maxBlocks;
+        std::list<int> m_lru;                                                                 //!< Block keys, most recently used first.
+        std::map<int, std::pair<std::vector<double>, std::list<int>::iterator> > m_blocks;    //!< Decoded blocks and their LRU entries.
+        std::vector<unsigned char> m_buffer;                                                  //!< Raw block buffer.
+        std::mutex m_mutex;                                                                   //!< Protects the blocks and the raster.
+
+        std::atomic<std::size_t> m_hits;                                                      //!< Blocks found in the cache.
+        std::atomic<std::size_t> m_misses;                                                    //!< Blocks decoded.
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_NDVISAMPLER_H
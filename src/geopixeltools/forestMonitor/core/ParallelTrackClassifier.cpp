@@ -0,0 +1,167 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/ParallelTrackClassifier.cpp
+
+  \brief This file contains a class used to classify the tracks of many parcels concurrently.
+*/
+
+#include "ParallelTrackClassifier.h"
+
+//TerraLib Includes
+#include <terralib/common/progress/TaskProgress.h>
+
+//STL Includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+geopx::tools::ParallelTrackClassifier::ParallelTrackClassifier(const TrackEngine& engine, std::size_t nThreads) :
+  m_engine(engine),
+  m_nThreads(nThreads)
+{
+  if(m_nThreads == 0)
+    m_nThreads = std::thread::hardware_concurrency();
+
+  if(m_nThreads == 0)
+    m_nThreads = 1;
+}
+
+geopx::tools::ParallelTrackClassifier::~ParallelTrackClassifier()
+{
+}
+
+bool geopx::tools::ParallelTrackClassifier::run(const std::vector<TrackParcel>& parcels, Consumer consumer)
+{
+  if(parcels.empty())
+    return true;
+
+  std::atomic<std::size_t> next(0);
+  std::atomic<bool> stop(false);
+
+  std::mutex mutex;
+  std::condition_variable finished;
+  //parcels finished and not consumed yet
+  std::deque<std::pair<std::size_t, std::vector<TrackResult> > > done;
+  std::size_t runningWorkers = 0;
+  std::exception_ptr error;
+
+  auto worker = [&]()
+  {
+    while(!stop)
+    {
+      std::size_t idx = next++;
+
+      if(idx >= parcels.size())
+        break;
+
+      std::vector<TrackResult> results;
+
+      try
+      {
+        m_engine.classifyParcel(parcels[idx], results);
+      }
+      catch(...)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if(!error)
+          error = std::current_exception();
+
+        stop = true;
+
+        break;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+
+      done.push_back(std::make_pair(idx, std::move(results)));
+
+      finished.notify_one();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    --runningWorkers;
+
+    finished.notify_one();
+  };
+
+  std::size_t nThreads = std::min(m_nThreads, parcels.size());
+
+  runningWorkers = nThreads;
+
+  std::vector<std::thread> threads;
+
+  for(std::size_t t = 0; t < nThreads; ++t)
+    threads.push_back(std::thread(worker));
+
+  te::common::TaskProgress task("Auto Classifier");
+  task.setTotalSteps(static_cast<int>(parcels.size()));
+
+  int consumed = 0;
+
+  bool canceled = false;
+
+  while(true)
+  {
+    std::deque<std::pair<std::size_t, std::vector<TrackResult> > > ready;
+
+    bool running = true;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      //wake up from time to time to keep the progress viewer alive
+      finished.wait_for(lock, std::chrono::milliseconds(100), [&]() { return !done.empty() || runningWorkers == 0; });
+
+      ready.swap(done);
+
+      running = runningWorkers != 0;
+    }
+
+    try
+    {
+      for(std::size_t t = 0; t < ready.size(); ++t)
+      {
+        if(!stop)
+          consumer(parcels[ready[t].first], ready[t].second);
+
+        ++consumed;
+      }
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      if(!error)
+        error = std::current_exception();
+
+      stop = true;
+    }
+
+    task.setCurrentStep(consumed);
+
+    if(!task.isActive() && !stop)
+    {
+      canceled = true;
+
+      stop = true;
+    }
+
+    if(!running && ready.empty())
+      break;
+  }
+
+  for(std::size_t t = 0; t < threads.size(); ++t)
+    threads[t].join();
+
+  if(error)
+    std::rethrow_exception(error);
+
+  return !canceled;
+}
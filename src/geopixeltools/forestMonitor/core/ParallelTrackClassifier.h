@@ -0,0 +1,70 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/ParallelTrackClassifier.h
+
+  \brief This file contains a class used to classify the tracks of many parcels concurrently.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_PARALLELTRACKCLASSIFIER_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_PARALLELTRACKCLASSIFIER_H
+
+#include "../../Config.h"
+#include "TrackEngine.h"
+
+//STL Includes
+#include <functional>
+#include <vector>
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \class ParallelTrackClassifier
+
+      \brief Classifies the parcels in worker threads with a shared track engine.
+
+      The results of each parcel are handed to the consumer in the calling thread, so the
+      consumer is the single writer of the data source and of the classification cache.
+      The progress is reported by the calling thread, that also stops the workers when the
+      task is canceled.
+    */
+    class GEOPXTOOLSEXPORT ParallelTrackClassifier
+    {
+      public:
+
+        /*! \brief Receives the tracks of a parcel (called from the thread that called run()). */
+        typedef std::function<void(const TrackParcel&, std::vector<TrackResult>&)> Consumer;
+
+        /*!
+          \param engine    The track engine (not owned).
+          \param nThreads  Number of worker threads, 0 to use the number of hardware threads.
+        */
+        ParallelTrackClassifier(const TrackEngine& engine, std::size_t nThreads = 0);
+
+        ~ParallelTrackClassifier();
+
+      public:
+
+        /*!
+          \brief Classifies the parcels.
+
+          \param parcels   The parcels, each one is processed by a single worker.
+          \param consumer  Receives the results of each parcel as soon as it is finished.
+
+          \return False if the operation was canceled. The results of the parcels finished before the cancel were consumed.
+
+          \note The first exception thrown by a worker or by the consumer stops the workers and is thrown again.
+          \note It blocks until the parcels are classified, a GUI calls it from its own thread.
+        */
+        bool run(const std::vector<TrackParcel>& parcels, Consumer consumer);
+
+      protected:
+
+        const TrackEngine& m_engine;      //!< The track engine.
+        std::size_t m_nThreads;           //!< Number of worker threads.
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_PARALLELTRACKCLASSIFIER_H
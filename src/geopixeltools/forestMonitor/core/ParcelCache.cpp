@@ -0,0 +1,159 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/ParcelCache.cpp
+
+  \brief This file contains a class used to keep the parcel polygons in memory.
+*/
+
+#include "ParcelCache.h"
+
+// TerraLib
+#include <terralib/core/Exception.h>
+#include <terralib/dataaccess/dataset/DataSet.h>
+#include <terralib/dataaccess/dataset/DataSetType.h>
+#include <terralib/dataaccess/dataset/PrimaryKey.h>
+#include <terralib/dataaccess/utils/Utils.h>
+#include <terralib/geometry/Envelope.h>
+#include <terralib/geometry/Geometry.h>
+#include <terralib/geometry/GeometryProperty.h>
+#include <terralib/geometry/Point.h>
+
+//STL Includes
+#include <algorithm>
+#include <cassert>
+#include <string>
+
+geopx::tools::ParcelCache::ParcelCache() :
+  m_srid(TE_UNKNOWN_SRS)
+{
+}
+
+geopx::tools::ParcelCache::~ParcelCache()
+{
+}
+
+void geopx::tools::ParcelCache::clear()
+{
+  m_ids.clear();
+  m_geoms.clear();
+  m_index.clear();
+  m_srid = TE_UNKNOWN_SRS;
+}
+
+void geopx::tools::ParcelCache::load(te::map::AbstractLayerPtr parcelLayer, int srid)
+{
+  clear();
+
+  if(!parcelLayer.get())
+    throw te::core::Exception() << te::ErrorDescription("The parcel layer is not defined.");
+
+  std::unique_ptr<const te::map::LayerSchema> schema(parcelLayer->getSchema());
+
+  if(!schema->hasGeom())
+    throw te::core::Exception() << te::ErrorDescription("The parcel layer has no geometry.");
+
+  te::da::PrimaryKey* pk = schema->getPrimaryKey();
+
+  if(!pk)
+    throw te::core::Exception() << te::ErrorDescription("The parcel layer has no primary key.");
+
+  std::string geomName = te::da::GetFirstGeomProperty(schema.get())->getName();
+  std::string idName = pk->getProperties()[0]->getName();
+
+  m_srid = srid;
+
+  std::unique_ptr<te::da::DataSet> dataset = parcelLayer->getData();
+
+  assert(dataset.get());
+
+  dataset->moveBeforeFirst();
+
+  while(dataset->moveNext())
+  {
+    std::unique_ptr<te::gm::Geometry> g = dataset->getGeometry(geomName);
+
+    if(!g.get())
+      continue;
+
+    if(g->getSRID() == TE_UNKNOWN_SRS)
+      g->setSRID(parcelLayer->getSRID());
+
+    if(g->getSRID() != srid && srid != TE_UNKNOWN_SRS)
+      g->transform(srid);
+
+    const te::gm::Envelope* mbr = g->getMBR();
+
+    m_index.add(static_cast<int>(m_geoms.size()), mbr->m_llx, mbr->m_lly, mbr->m_urx, mbr->m_ury);
+
+    m_ids.push_back(dataset->getInt32(idName));
+    m_geoms.push_back(std::shared_ptr<const te::gm::Geometry>(g.release()));
+  }
+
+  m_index.setSRID(srid);
+  m_index.build();
+}
+
+bool geopx::tools::ParcelCache::isEmpty() const
+{
+  return m_geoms.empty();
+}
+
+std::size_t geopx::tools::ParcelCache::size() const
+{
+  return m_geoms.size();
+}
+
+int geopx::tools::ParcelCache::getSRID() const
+{
+  return m_srid;
+}
+
+int geopx::tools::ParcelCache::getId(std::size_t pos) const
+{
+  return m_ids[pos];
+}
+
+std::shared_ptr<const te::gm::Geometry> geopx::tools::ParcelCache::getGeometry(std::size_t pos) const
+{
+  return m_geoms[pos];
+}
+
+bool geopx::tools::ParcelCache::find(double x, double y, std::size_t& pos) const
+{
+  std::vector<std::size_t> results;
+
+  search(te::gm::Envelope(x, y, x, y), results);
+
+  if(results.empty())
+    return false;
+
+  te::gm::Point p(x, y, m_srid);
+
+  for(std::size_t t = 0; t < results.size(); ++t)
+  {
+    if(m_geoms[results[t]]->covers(&p))
+    {
+      pos = results[t];
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void geopx::tools::ParcelCache::search(const te::gm::Envelope& ext, std::vector<std::size_t>& results) const
+{
+  results.clear();
+
+  if(m_geoms.empty())
+    return;
+
+  std::vector<std::size_t> found;
+
+  m_index.search(ext, found);
+
+  //the index ids are the parcel positions
+  for(std::size_t t = 0; t < found.size(); ++t)
+    results.push_back(static_cast<std::size_t>(m_index.getId(found[t])));
+
+  std::sort(results.begin(), results.end());
+}
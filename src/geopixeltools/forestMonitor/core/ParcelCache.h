@@ -0,0 +1,93 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/ParcelCache.h
+
+  \brief This file contains a class used to keep the parcel polygons in memory.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_PARCELCACHE_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_PARCELCACHE_H
+
+#include "../../Config.h"
+#include "SpatialIndex.h"
+
+// TerraLib
+#include <terralib/maptools/AbstractLayer.h>
+
+//STL Includes
+#include <memory>
+#include <vector>
+
+namespace te { namespace gm { class Envelope; class Geometry; } }
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \class ParcelCache
+
+      \brief Keeps the parcel polygons, already decoded and reprojected to the SRID of the
+             classified layer, and an index of their MBRs.
+
+      The parcel layer is read once by load(), so finding the parcel of a root point is a
+      search in memory instead of a spatial query to the data source. The polygons are
+      shared with the track parcels and are never changed after the load.
+    */
+    class GEOPXTOOLSEXPORT ParcelCache
+    {
+      public:
+
+        ParcelCache();
+
+        ~ParcelCache();
+
+      public:
+
+        void clear();
+
+        /*!
+          \brief Reads all parcels of the layer (the first primary key property is the parcel id).
+
+          \param parcelLayer  The parcel layer.
+          \param srid         The SRID of the classified layer, the polygons are reprojected to it.
+        */
+        void load(te::map::AbstractLayerPtr parcelLayer, int srid);
+
+        bool isEmpty() const;
+
+        /*! \brief Returns the number of parcels, the positions follow the layer order. */
+        std::size_t size() const;
+
+        int getSRID() const;
+
+        int getId(std::size_t pos) const;
+
+        std::shared_ptr<const te::gm::Geometry> getGeometry(std::size_t pos) const;
+
+        /*!
+          \brief Finds the first parcel (in the layer order) that covers the point.
+
+          \param x    The x coordinate (in the cache SRID).
+          \param y    The y coordinate (in the cache SRID).
+          \param pos  Output, the parcel position.
+
+          \return False if no parcel covers the point.
+        */
+        bool find(double x, double y, std::size_t& pos) const;
+
+        /*! \brief Searches the parcels whose MBR intersects the envelope, the positions are returned in the layer order. */
+        void search(const te::gm::Envelope& ext, std::vector<std::size_t>& results) const;
+
+      protected:
+
+        std::vector<int> m_ids;                                           //!< The parcel ids.
+        std::vector<std::shared_ptr<const te::gm::Geometry> > m_geoms;    //!< The parcel polygons in the cache SRID.
+
+        SpatialIndex m_index;                                             //!< The index of the parcel MBRs (id is the parcel position).
+        int m_srid;
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_PARCELCACHE_H
@@ -0,0 +1,272 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/RowDirectionEstimator.cpp
+
+  \brief This file contains a class used to estimate the plantation rows direction from the tree centroids.
+*/
+
+#include "RowDirectionEstimator.h"
+
+//STL Includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#define ROW_DIRECTION_PI 3.14159265358979323846
+#define ROW_DIRECTION_BINS 180
+#define ROW_DIRECTION_WINDOW 2
+#define ROW_DIRECTION_MIN_POINTS 3
+#define ROW_DIRECTION_MAX_GRID_CELLS 512
+
+geopx::tools::RowDirectionEstimator::RowDirectionEstimator() :
+  m_azimuth(0.), m_spacing(0.), m_confidence(0.)
+{
+}
+
+geopx::tools::RowDirectionEstimator::~RowDirectionEstimator()
+{
+}
+
+bool geopx::tools::RowDirectionEstimator::estimate(const double* xs, const double* ys, const std::size_t* positions, std::size_t size)
+{
+  m_azimuth = 0.;
+  m_spacing = 0.;
+  m_confidence = 0.;
+
+  if(size < ROW_DIRECTION_MIN_POINTS)
+    return false;
+
+  m_x.resize(size);
+  m_y.resize(size);
+
+  for(std::size_t t = 0; t < size; ++t)
+  {
+    m_x[t] = xs[positions[t]];
+    m_y[t] = ys[positions[t]];
+  }
+
+  findNearestNeighbors();
+
+  if(m_vecX.size() < ROW_DIRECTION_MIN_POINTS)
+    return false;
+
+  //azimuth histogram (modulo 180, one degree bins)
+  std::vector<double> azimuths(m_vecX.size());
+  std::vector<std::size_t> histogram(ROW_DIRECTION_BINS, 0);
+
+  for(std::size_t t = 0; t < m_vecX.size(); ++t)
+  {
+    double a = std::atan2(m_vecY[t], m_vecX[t]) * 180. / ROW_DIRECTION_PI;
+
+    if(a < 0.)
+      a += 180.;
+
+    if(a >= 180.)
+      a -= 180.;
+
+    azimuths[t] = a;
+
+    int bin = static_cast<int>(a) % ROW_DIRECTION_BINS;
+
+    ++histogram[bin];
+  }
+
+  //dominant bin using the same window of the refinement (the histogram is circular)
+  int peak = 0;
+  std::size_t peakCount = 0;
+
+  for(int b = 0; b < ROW_DIRECTION_BINS; ++b)
+  {
+    std::size_t count = 0;
+
+    for(int w = -ROW_DIRECTION_WINDOW; w <= ROW_DIRECTION_WINDOW; ++w)
+      count += histogram[(b + w + ROW_DIRECTION_BINS) % ROW_DIRECTION_BINS];
+
+    if(count > peakCount)
+    {
+      peakCount = count;
+      peak = b;
+    }
+  }
+
+  //refine with the mean of the doubled angles around the peak
+  double sumCos = 0.;
+  double sumSin = 0.;
+
+  std::vector<double> distances;
+
+  for(std::size_t t = 0; t < azimuths.size(); ++t)
+  {
+    int bin = static_cast<int>(azimuths[t]) % ROW_DIRECTION_BINS;
+
+    int diff = std::abs(bin - peak);
+
+    diff = std::min(diff, ROW_DIRECTION_BINS - diff);
+
+    if(diff > ROW_DIRECTION_WINDOW)
+      continue;
+
+    double a = azimuths[t] * ROW_DIRECTION_PI / 90.;
+
+    sumCos += std::cos(a);
+    sumSin += std::sin(a);
+
+    distances.push_back(std::sqrt(m_vecX[t] * m_vecX[t] + m_vecY[t] * m_vecY[t]));
+  }
+
+  m_azimuth = std::atan2(sumSin, sumCos) * 90. / ROW_DIRECTION_PI;
+
+  if(m_azimuth < 0.)
+    m_azimuth += 180.;
+
+  std::nth_element(distances.begin(), distances.begin() + distances.size() / 2, distances.end());
+
+  m_spacing = distances[distances.size() / 2];
+
+  m_confidence = static_cast<double>(distances.size()) / static_cast<double>(azimuths.size());
+
+  return true;
+}
+
+double geopx::tools::RowDirectionEstimator::getAzimuth() const
+{
+  return m_azimuth;
+}
+
+double geopx::tools::RowDirectionEstimator::getDx() const
+{
+  return std::cos(m_azimuth * ROW_DIRECTION_PI / 180.);
+}
+
+double geopx::tools::RowDirectionEstimator::getDy() const
+{
+  return std::sin(m_azimuth * ROW_DIRECTION_PI / 180.);
+}
+
+double geopx::tools::RowDirectionEstimator::getSpacing() const
+{
+  return m_spacing;
+}
+
+double geopx::tools::RowDirectionEstimator::getConfidence() const
+{
+  return m_confidence;
+}
+
+void geopx::tools::RowDirectionEstimator::findNearestNeighbors()
+{
+  m_vecX.clear();
+  m_vecY.clear();
+
+  std::size_t size = m_x.size();
+
+  double minX = *std::min_element(m_x.begin(), m_x.end());
+  double maxX = *std::max_element(m_x.begin(), m_x.end());
+  double minY = *std::min_element(m_y.begin(), m_y.end());
+  double maxY = *std::max_element(m_y.begin(), m_y.end());
+
+  double w = maxX - minX;
+  double h = maxY - minY;
+
+  //about one point per cell, for points along a thin band the area gives tiny cells,
+  //so the cell is at least the length shared by the points and the grid side is bounded
+  double side = std::max(w, h);
+
+  double cell = std::sqrt(w * h / static_cast<double>(size));
+
+  cell = std::max(cell, side / static_cast<double>(size));
+  cell = std::max(cell, side / ROW_DIRECTION_MAX_GRID_CELLS);
+
+  if(cell <= 0.)
+    return;
+
+  int nCols = std::min(static_cast<int>(w / cell), ROW_DIRECTION_MAX_GRID_CELLS - 1) + 1;
+  int nRows = std::min(static_cast<int>(h / cell), ROW_DIRECTION_MAX_GRID_CELLS - 1) + 1;
+
+  //points sorted by cell (counting sort)
+  std::vector<int> pointCell(size);
+  std::vector<std::size_t> cellStart(static_cast<std::size_t>(nCols) * nRows + 1, 0);
+  std::vector<std::size_t> cellItems(size);
+
+  for(std::size_t t = 0; t < size; ++t)
+  {
+    int col = std::min(static_cast<int>((m_x[t] - minX) / cell), nCols - 1);
+    int row = std::min(static_cast<int>((m_y[t] - minY) / cell), nRows - 1);
+
+    pointCell[t] = row * nCols + col;
+
+    ++cellStart[pointCell[t] + 1];
+  }
+
+  for(std::size_t t = 1; t < cellStart.size(); ++t)
+    cellStart[t] += cellStart[t - 1];
+
+  std::vector<std::size_t> cellFill(cellStart.begin(), cellStart.end() - 1);
+
+  for(std::size_t t = 0; t < size; ++t)
+    cellItems[cellFill[pointCell[t]]++] = t;
+
+  m_vecX.reserve(size);
+  m_vecY.reserve(size);
+
+  int maxRing = std::max(nCols, nRows);
+
+  for(std::size_t t = 0; t < size; ++t)
+  {
+    int col = pointCell[t] % nCols;
+    int row = pointCell[t] / nCols;
+
+    double bestDist = std::numeric_limits<double>::max();
+    std::size_t best = size;
+
+    for(int r = 0; r <= maxRing; ++r)
+    {
+      //cells in the ring r around the point cell
+      for(int j = row - r; j <= row + r; ++j)
+      {
+        if(j < 0 || j >= nRows)
+          continue;
+
+        bool border = (j == row - r || j == row + r);
+
+        int step = (border || r == 0) ? 1 : 2 * r;
+
+        for(int i = col - r; i <= col + r; i += step)
+        {
+          if(i < 0 || i >= nCols)
+            continue;
+
+          int c = j * nCols + i;
+
+          for(std::size_t k = cellStart[c]; k < cellStart[c + 1]; ++k)
+          {
+            std::size_t p = cellItems[k];
+
+            double dx = m_x[p] - m_x[t];
+            double dy = m_y[p] - m_y[t];
+
+            double dist = dx * dx + dy * dy;
+
+            //duplicated centroids do not give a direction
+            if(dist > 0. && dist < bestDist)
+            {
+              bestDist = dist;
+              best = p;
+            }
+          }
+        }
+      }
+
+      //points not visited yet are at least r cells away
+      double ringDist = r * cell;
+
+      if(best != size && bestDist <= ringDist * ringDist)
+        break;
+    }
+
+    if(best == size)
+      continue;
+
+    m_vecX.push_back(m_x[best] - m_x[t]);
+    m_vecY.push_back(m_y[best] - m_y[t]);
+  }
+}
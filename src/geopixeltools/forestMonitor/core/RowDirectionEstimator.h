@@ -0,0 +1,87 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/RowDirectionEstimator.h
+
+  \brief This file contains a class used to estimate the plantation rows direction from the tree centroids.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_ROWDIRECTIONESTIMATOR_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_ROWDIRECTIONESTIMATOR_H
+
+#include "../../Config.h"
+
+//STL Includes
+#include <cstddef>
+#include <vector>
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \class RowDirectionEstimator
+
+      \brief Estimates the dominant row direction and the spacing between trees of a parcel.
+
+      The nearest neighbor of each centroid is found using a regular grid, the azimuth of
+      each nearest neighbor vector (modulo 180) is added to a histogram and the dominant bin
+      is refined by the mean of the vectors around it. The spacing is the median length of
+      these vectors.
+    */
+    class GEOPXTOOLSEXPORT RowDirectionEstimator
+    {
+      public:
+
+        RowDirectionEstimator();
+
+        ~RowDirectionEstimator();
+
+      public:
+
+        /*!
+          \brief Estimates the row direction for a set of centroids.
+
+          \param xs         The x coordinates of all centroids.
+          \param ys         The y coordinates of all centroids.
+          \param positions  The positions of the parcel centroids in the coordinates arrays.
+          \param size       The number of parcel centroids.
+
+          \return False if there are not enough distinct centroids.
+        */
+        bool estimate(const double* xs, const double* ys, const std::size_t* positions, std::size_t size);
+
+        /*! \brief Returns the row azimuth in degrees, counter clockwise from the x axis, in [0, 180). */
+        double getAzimuth() const;
+
+        /*! \brief Returns the x component of the unit vector of the row direction. */
+        double getDx() const;
+
+        /*! \brief Returns the y component of the unit vector of the row direction. */
+        double getDy() const;
+
+        /*! \brief Returns the median distance between neighbor trees in the same row. */
+        double getSpacing() const;
+
+        /*! \brief Returns the fraction of nearest neighbor vectors that agree with the estimated direction. */
+        double getConfidence() const;
+
+      protected:
+
+        /*! \brief Finds the nearest neighbor of each point and fills m_vecX and m_vecY. */
+        void findNearestNeighbors();
+
+      protected:
+
+        std::vector<double> m_x;                  //!< Centroids x coordinates.
+        std::vector<double> m_y;                  //!< Centroids y coordinates.
+        std::vector<double> m_vecX;               //!< Nearest neighbor vectors x component.
+        std::vector<double> m_vecY;               //!< Nearest neighbor vectors y component.
+
+        double m_azimuth;
+        double m_spacing;
+        double m_confidence;
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_ROWDIRECTIONESTIMATOR_H
@@ -0,0 +1,673 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/SpatialIndex.cpp
+
+  \brief This file contains a packed spatial index over points and two point segments
+         that can be saved to and memory mapped from a binary snapshot file.
+*/
+
+#include "SpatialIndex.h"
+
+// TerraLib
+#include <terralib/core/Exception.h>
+
+// Boost
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+//STL Includes
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#define NODE_SIZE 16
+#define SNAPSHOT_VERSION 1
+
+namespace
+{
+  const char SNAPSHOT_MAGIC[8] = { 'G', 'P', 'X', 'I', 'D', 'X', '0', '1' };
+
+  struct SnapshotHeader
+  {
+    char m_magic[8];
+    unsigned long long m_version;
+    unsigned long long m_nodeSize;
+    long long m_srid;
+    unsigned long long m_signatureSize;
+    unsigned long long m_size;
+    unsigned long long m_levelCount;
+    unsigned long long m_nodeCount;
+  };
+
+  std::size_t Align8(std::size_t size)
+  {
+    return (size + 7) & ~static_cast<std::size_t>(7);
+  }
+
+  bool Intersects(const te::gm::Envelope& ext, double llx, double lly, double urx, double ury)
+  {
+    return !(llx > ext.m_urx || urx < ext.m_llx || lly > ext.m_ury || ury < ext.m_lly);
+  }
+
+  void WritePadded(std::ofstream& out, const void* data, std::size_t size)
+  {
+    static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    if(size)
+      out.write(static_cast<const char*>(data), size);
+
+    out.write(zeros, Align8(size) - size);
+  }
+}
+
+geopx::tools::SpatialIndex::SpatialIndex() :
+  m_ids(0), m_x0(0), m_y0(0), m_x1(0), m_y1(0), m_nodes(0), m_levels(0), m_sortedIds(0), m_sortedPos(0),
+  m_size(0), m_levelCount(0), m_srid(0), m_searchCounter(0)
+{
+}
+
+geopx::tools::SpatialIndex::~SpatialIndex()
+{
+  clear();
+}
+
+void geopx::tools::SpatialIndex::clear()
+{
+  m_items.clear();
+
+  m_idsData.clear();
+  m_coordsData.clear();
+  m_nodesData.clear();
+  m_levelsData.clear();
+  m_sortedIdsData.clear();
+  m_sortedPosData.clear();
+
+  m_delta.clear();
+  m_removed.clear();
+
+  m_region.reset();
+
+  m_size = 0;
+  m_levelCount = 0;
+
+  setPointers();
+}
+
+void geopx::tools::SpatialIndex::add(int id, double x, double y)
+{
+  add(id, x, y, x, y);
+}
+
+void geopx::tools::SpatialIndex::add(int id, double x0, double y0, double x1, double y1)
+{
+  Item item;
+  item.m_id = id;
+  item.m_x0 = x0;
+  item.m_y0 = y0;
+  item.m_x1 = x1;
+  item.m_y1 = y1;
+
+  m_items.push_back(item);
+}
+
+void geopx::tools::SpatialIndex::build()
+{
+  //items added after a previous build are merged with the current ones
+  unpack();
+
+  m_region.reset();
+
+  pack();
+
+  m_items.clear();
+
+  setPointers();
+}
+
+void geopx::tools::SpatialIndex::search(const te::gm::Envelope& ext, std::vector<std::size_t>& results) const
+{
+  if(m_searchCounter)
+    m_searchCounter->fetch_add(1, std::memory_order_relaxed);
+
+  //inserted items
+  for(std::size_t t = 0; t < m_delta.size(); ++t)
+  {
+    const Item& item = m_delta[t];
+
+    if(!isRemoved(m_size + t) && Intersects(ext, std::min(item.m_x0, item.m_x1), std::min(item.m_y0, item.m_y1), std::max(item.m_x0, item.m_x1), std::max(item.m_y0, item.m_y1)))
+      results.push_back(m_size + t);
+  }
+
+  if(m_size == 0)
+    return;
+
+  //root node
+  const double* root = m_nodes + (4 * m_levels[m_levelCount - 1]);
+
+  if(!Intersects(ext, root[0], root[1], root[2], root[3]))
+    return;
+
+  //nodes already checked against the search envelope
+  std::vector<std::pair<std::size_t, std::size_t> > stack;
+
+  stack.push_back(std::make_pair(m_levelCount, static_cast<std::size_t>(0)));
+
+  while(!stack.empty())
+  {
+    std::size_t level = stack.back().first - 1;
+    std::size_t first = stack.back().second * NODE_SIZE;
+
+    stack.pop_back();
+
+    if(level == 0)
+    {
+      std::size_t last = std::min(first + NODE_SIZE, m_size);
+
+      for(std::size_t t = first; t < last; ++t)
+      {
+        if(Intersects(ext, std::min(m_x0[t], m_x1[t]), std::min(m_y0[t], m_y1[t]), std::max(m_x0[t], m_x1[t]), std::max(m_y0[t], m_y1[t])) && !isRemoved(t))
+          results.push_back(t);
+      }
+    }
+    else
+    {
+      std::size_t count = static_cast<std::size_t>(m_levels[level] - m_levels[level - 1]);
+      std::size_t last = std::min(first + NODE_SIZE, count);
+
+      const double* box = m_nodes + (4 * m_levels[level - 1]);
+
+      for(std::size_t t = first; t < last; ++t)
+      {
+        const double* b = box + (4 * t);
+
+        if(Intersects(ext, b[0], b[1], b[2], b[3]))
+          stack.push_back(std::make_pair(level, t));
+      }
+    }
+  }
+}
+
+bool geopx::tools::SpatialIndex::find(int id, std::size_t& pos) const
+{
+  if(m_size)
+  {
+    const int* end = m_sortedIds + m_size;
+
+    const int* it = std::lower_bound(m_sortedIds, end, id);
+
+    if(it != end && *it == id && !isRemoved(m_sortedPos[it - m_sortedIds]))
+    {
+      pos = m_sortedPos[it - m_sortedIds];
+
+      return true;
+    }
+  }
+
+  //the last inserted item is the current one
+  for(std::size_t t = m_delta.size(); t > 0; --t)
+  {
+    if(m_delta[t - 1].m_id == id && !isRemoved(m_size + t - 1))
+    {
+      pos = m_size + t - 1;
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+std::size_t geopx::tools::SpatialIndex::insert(int id, double x, double y)
+{
+  return insert(id, x, y, x, y);
+}
+
+std::size_t geopx::tools::SpatialIndex::insert(int id, double x0, double y0, double x1, double y1)
+{
+  Item item;
+  item.m_id = id;
+  item.m_x0 = x0;
+  item.m_y0 = y0;
+  item.m_x1 = x1;
+  item.m_y1 = y1;
+
+  m_delta.push_back(item);
+
+  if(!m_removed.empty())
+    m_removed.push_back(0);
+
+  return m_size + m_delta.size() - 1;
+}
+
+void geopx::tools::SpatialIndex::remove(std::size_t pos)
+{
+  assert(pos < size());
+
+  if(m_removed.empty())
+    m_removed.assign(size(), 0);
+
+  m_removed[pos] = 1;
+}
+
+bool geopx::tools::SpatialIndex::isRemoved(std::size_t pos) const
+{
+  return !m_removed.empty() && m_removed[pos] != 0;
+}
+
+bool geopx::tools::SpatialIndex::hasChanges() const
+{
+  return !m_delta.empty() || !m_removed.empty();
+}
+
+std::size_t geopx::tools::SpatialIndex::size() const
+{
+  return m_size + m_delta.size();
+}
+
+std::size_t geopx::tools::SpatialIndex::getPackedSize() const
+{
+  return m_size;
+}
+
+bool geopx::tools::SpatialIndex::isEmpty() const
+{
+  return size() == 0;
+}
+
+int geopx::tools::SpatialIndex::getId(std::size_t pos) const
+{
+  assert(pos < size());
+
+  return pos < m_size ? m_ids[pos] : m_delta[pos - m_size].m_id;
+}
+
+double geopx::tools::SpatialIndex::getX(std::size_t pos) const
+{
+  assert(pos < size());
+
+  return pos < m_size ? m_x0[pos] : m_delta[pos - m_size].m_x0;
+}
+
+double geopx::tools::SpatialIndex::getY(std::size_t pos) const
+{
+  assert(pos < size());
+
+  return pos < m_size ? m_y0[pos] : m_delta[pos - m_size].m_y0;
+}
+
+double geopx::tools::SpatialIndex::getX1(std::size_t pos) const
+{
+  assert(pos < size());
+
+  return pos < m_size ? m_x1[pos] : m_delta[pos - m_size].m_x1;
+}
+
+double geopx::tools::SpatialIndex::getY1(std::size_t pos) const
+{
+  assert(pos < size());
+
+  return pos < m_size ? m_y1[pos] : m_delta[pos - m_size].m_y1;
+}
+
+const double* geopx::tools::SpatialIndex::getXs() const
+{
+  return m_x0;
+}
+
+const double* geopx::tools::SpatialIndex::getYs() const
+{
+  return m_y0;
+}
+
+int geopx::tools::SpatialIndex::getMaxId() const
+{
+  int maxId = m_size ? m_sortedIds[m_size - 1] : 0;
+
+  for(std::size_t t = 0; t < m_delta.size(); ++t)
+    maxId = std::max(maxId, m_delta[t].m_id);
+
+  return maxId;
+}
+
+int geopx::tools::SpatialIndex::getSRID() const
+{
+  return m_srid;
+}
+
+void geopx::tools::SpatialIndex::setSRID(int srid)
+{
+  m_srid = srid;
+}
+
+void geopx::tools::SpatialIndex::setSearchCounter(std::atomic<unsigned long long>* counter)
+{
+  m_searchCounter = counter;
+}
+
+void geopx::tools::SpatialIndex::save(const std::string& fileName, const std::string& signature) const
+{
+  //the snapshot only keeps packed items
+  if(hasChanges())
+  {
+    SpatialIndex index;
+
+    for(std::size_t t = 0; t < size(); ++t)
+    {
+      if(!isRemoved(t))
+        index.add(getId(t), getX(t), getY(t), getX1(t), getY1(t));
+    }
+
+    index.build();
+    index.setSRID(m_srid);
+    index.save(fileName, signature);
+
+    return;
+  }
+
+  SnapshotHeader header;
+  std::memset(&header, 0, sizeof(SnapshotHeader));
+  std::memcpy(header.m_magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  header.m_version = SNAPSHOT_VERSION;
+  header.m_nodeSize = NODE_SIZE;
+  header.m_srid = m_srid;
+  header.m_signatureSize = signature.size();
+  header.m_size = m_size;
+  header.m_levelCount = m_levelCount;
+  header.m_nodeCount = m_levelCount ? m_levels[m_levelCount] : 0;
+
+  std::string tmpFileName = fileName + ".tmp";
+
+  {
+    std::ofstream out(tmpFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if(!out.is_open())
+      throw te::core::Exception() << te::ErrorDescription("Could not create the spatial index file: " + tmpFileName);
+
+    WritePadded(out, &header, sizeof(SnapshotHeader));
+    WritePadded(out, signature.data(), signature.size());
+    WritePadded(out, m_levels, sizeof(unsigned long long) * (m_levelCount + 1));
+    WritePadded(out, m_ids, sizeof(int) * m_size);
+    WritePadded(out, m_sortedIds, sizeof(int) * m_size);
+    WritePadded(out, m_sortedPos, sizeof(unsigned int) * m_size);
+    WritePadded(out, m_x0, sizeof(double) * m_size);
+    WritePadded(out, m_y0, sizeof(double) * m_size);
+    WritePadded(out, m_x1, sizeof(double) * m_size);
+    WritePadded(out, m_y1, sizeof(double) * m_size);
+    WritePadded(out, m_nodes, sizeof(double) * 4 * header.m_nodeCount);
+
+    if(!out.good())
+      throw te::core::Exception() << te::ErrorDescription("Could not write the spatial index file: " + tmpFileName);
+  }
+
+  boost::filesystem::rename(tmpFileName, fileName);
+}
+
+bool geopx::tools::SpatialIndex::load(const std::string& fileName, const std::string& signature)
+{
+  if(!boost::filesystem::exists(fileName))
+    return false;
+
+  std::unique_ptr<boost::interprocess::mapped_region> region;
+
+  try
+  {
+    boost::interprocess::file_mapping file(fileName.c_str(), boost::interprocess::read_only);
+
+    region.reset(new boost::interprocess::mapped_region(file, boost::interprocess::read_only));
+  }
+  catch(const boost::interprocess::interprocess_exception&)
+  {
+    return false;
+  }
+
+  const char* data = static_cast<const char*>(region->get_address());
+  std::size_t dataSize = region->get_size();
+
+  if(dataSize < sizeof(SnapshotHeader))
+    return false;
+
+  const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(data);
+
+  if(std::memcmp(header->m_magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+     header->m_version != SNAPSHOT_VERSION || header->m_nodeSize != NODE_SIZE)
+    return false;
+
+  std::size_t n = static_cast<std::size_t>(header->m_size);
+  std::size_t levelCount = static_cast<std::size_t>(header->m_levelCount);
+  std::size_t nodeCount = static_cast<std::size_t>(header->m_nodeCount);
+
+  std::size_t offsetSignature = Align8(sizeof(SnapshotHeader));
+  std::size_t offsetLevels = offsetSignature + Align8(static_cast<std::size_t>(header->m_signatureSize));
+  std::size_t offsetIds = offsetLevels + Align8(sizeof(unsigned long long) * (levelCount + 1));
+  std::size_t offsetSortedIds = offsetIds + Align8(sizeof(int) * n);
+  std::size_t offsetSortedPos = offsetSortedIds + Align8(sizeof(int) * n);
+  std::size_t offsetCoords = offsetSortedPos + Align8(sizeof(unsigned int) * n);
+  std::size_t offsetNodes = offsetCoords + (sizeof(double) * 4 * n);
+  std::size_t expectedSize = offsetNodes + (sizeof(double) * 4 * nodeCount);
+
+  if(dataSize != expectedSize)
+    return false;
+
+  if(header->m_signatureSize != signature.size() || std::memcmp(data + offsetSignature, signature.data(), signature.size()) != 0)
+    return false;
+
+  //snapshot is valid, drop the current content and point to the mapped arrays
+  clear();
+
+  m_region = std::move(region);
+
+  m_size = n;
+  m_levelCount = levelCount;
+  m_srid = static_cast<int>(header->m_srid);
+
+  m_levels = reinterpret_cast<const unsigned long long*>(data + offsetLevels);
+  m_ids = reinterpret_cast<const int*>(data + offsetIds);
+  m_sortedIds = reinterpret_cast<const int*>(data + offsetSortedIds);
+  m_sortedPos = reinterpret_cast<const unsigned int*>(data + offsetSortedPos);
+  m_x0 = reinterpret_cast<const double*>(data + offsetCoords);
+  m_y0 = m_x0 + n;
+  m_x1 = m_y0 + n;
+  m_y1 = m_x1 + n;
+  m_nodes = reinterpret_cast<const double*>(data + offsetNodes);
+
+  return true;
+}
+
+void geopx::tools::SpatialIndex::detach()
+{
+  if(!m_region.get())
+    return;
+
+  std::size_t nodeCount = m_levelCount ? static_cast<std::size_t>(m_levels[m_levelCount]) : 0;
+
+  m_idsData.assign(m_ids, m_ids + m_size);
+  m_coordsData.assign(m_x0, m_x0 + (4 * m_size));
+  m_nodesData.assign(m_nodes, m_nodes + (4 * nodeCount));
+  m_levelsData.assign(m_levels, m_levels + m_levelCount + 1);
+  m_sortedIdsData.assign(m_sortedIds, m_sortedIds + m_size);
+  m_sortedPosData.assign(m_sortedPos, m_sortedPos + m_size);
+
+  m_region.reset();
+
+  setPointers();
+}
+
+void geopx::tools::SpatialIndex::unpack()
+{
+  std::size_t n = size();
+
+  if(n == 0)
+    return;
+
+  std::vector<Item> items;
+  items.reserve(n + m_items.size());
+
+  for(std::size_t t = 0; t < n; ++t)
+  {
+    if(isRemoved(t))
+      continue;
+
+    Item item;
+    item.m_id = getId(t);
+    item.m_x0 = getX(t);
+    item.m_y0 = getY(t);
+    item.m_x1 = getX1(t);
+    item.m_y1 = getY1(t);
+
+    items.push_back(item);
+  }
+
+  items.insert(items.end(), m_items.begin(), m_items.end());
+
+  m_items.swap(items);
+
+  m_delta.clear();
+  m_removed.clear();
+}
+
+void geopx::tools::SpatialIndex::pack()
+{
+  std::size_t n = m_items.size();
+
+  //sort tile recursive: slices ordered by x and, inside each slice, items ordered by y
+  std::vector<std::size_t> order(n);
+
+  for(std::size_t t = 0; t < n; ++t)
+    order[t] = t;
+
+  const std::vector<Item>& items = m_items;
+
+  std::sort(order.begin(), order.end(), [&items](std::size_t a, std::size_t b)
+  {
+    return (items[a].m_x0 + items[a].m_x1) < (items[b].m_x0 + items[b].m_x1);
+  });
+
+  std::size_t leafCount = (n + NODE_SIZE - 1) / NODE_SIZE;
+  std::size_t sliceCount = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(leafCount))));
+  std::size_t sliceSize = sliceCount ? ((leafCount + sliceCount - 1) / sliceCount) * NODE_SIZE : n;
+
+  for(std::size_t t = 0; t < n; t += sliceSize)
+  {
+    std::vector<std::size_t>::iterator end = (t + sliceSize < n) ? order.begin() + t + sliceSize : order.end();
+
+    std::sort(order.begin() + t, end, [&items](std::size_t a, std::size_t b)
+    {
+      return (items[a].m_y0 + items[a].m_y1) < (items[b].m_y0 + items[b].m_y1);
+    });
+  }
+
+  //items in tree order
+  m_idsData.resize(n);
+  m_coordsData.resize(4 * n);
+
+  for(std::size_t t = 0; t < n; ++t)
+  {
+    const Item& item = items[order[t]];
+
+    m_idsData[t] = item.m_id;
+    m_coordsData[t] = item.m_x0;
+    m_coordsData[n + t] = item.m_y0;
+    m_coordsData[(2 * n) + t] = item.m_x1;
+    m_coordsData[(3 * n) + t] = item.m_y1;
+  }
+
+  //id lookup table
+  std::vector<std::pair<int, unsigned int> > sorted(n);
+
+  for(std::size_t t = 0; t < n; ++t)
+    sorted[t] = std::make_pair(m_idsData[t], static_cast<unsigned int>(t));
+
+  std::sort(sorted.begin(), sorted.end());
+
+  m_sortedIdsData.resize(n);
+  m_sortedPosData.resize(n);
+
+  for(std::size_t t = 0; t < n; ++t)
+  {
+    m_sortedIdsData[t] = sorted[t].first;
+    m_sortedPosData[t] = sorted[t].second;
+  }
+
+  //node levels, each node groups NODE_SIZE consecutive entries from the level below
+  m_nodesData.clear();
+  m_levelsData.clear();
+  m_levelsData.push_back(0);
+
+  std::size_t childCount = n;
+  std::size_t childOffset = 0;
+  bool childIsItem = true;
+
+  while(childCount > 1 || (childIsItem && childCount == 1))
+  {
+    std::size_t nodeCount = (childCount + NODE_SIZE - 1) / NODE_SIZE;
+    std::size_t nodeOffset = m_nodesData.size() / 4;
+
+    for(std::size_t node = 0; node < nodeCount; ++node)
+    {
+      double llx = std::numeric_limits<double>::max();
+      double lly = std::numeric_limits<double>::max();
+      double urx = -std::numeric_limits<double>::max();
+      double ury = -std::numeric_limits<double>::max();
+
+      std::size_t last = std::min((node + 1) * NODE_SIZE, childCount);
+
+      for(std::size_t t = node * NODE_SIZE; t < last; ++t)
+      {
+        if(childIsItem)
+        {
+          llx = std::min(llx, std::min(m_coordsData[t], m_coordsData[(2 * n) + t]));
+          lly = std::min(lly, std::min(m_coordsData[n + t], m_coordsData[(3 * n) + t]));
+          urx = std::max(urx, std::max(m_coordsData[t], m_coordsData[(2 * n) + t]));
+          ury = std::max(ury, std::max(m_coordsData[n + t], m_coordsData[(3 * n) + t]));
+        }
+        else
+        {
+          std::size_t b = 4 * (childOffset + t);
+
+          llx = std::min(llx, m_nodesData[b]);
+          lly = std::min(lly, m_nodesData[b + 1]);
+          urx = std::max(urx, m_nodesData[b + 2]);
+          ury = std::max(ury, m_nodesData[b + 3]);
+        }
+      }
+
+      m_nodesData.push_back(llx);
+      m_nodesData.push_back(lly);
+      m_nodesData.push_back(urx);
+      m_nodesData.push_back(ury);
+    }
+
+    m_levelsData.push_back(m_nodesData.size() / 4);
+
+    childCount = nodeCount;
+    childOffset = nodeOffset;
+    childIsItem = false;
+  }
+
+  m_size = n;
+  m_levelCount = m_levelsData.size() - 1;
+}
+
+void geopx::tools::SpatialIndex::setPointers()
+{
+  if(m_region.get())
+    return;
+
+  std::size_t n = m_idsData.size();
+
+  if(m_levelsData.empty())
+    m_levelsData.push_back(0);
+
+  m_ids = m_idsData.empty() ? 0 : &m_idsData[0];
+  m_x0 = m_coordsData.empty() ? 0 : &m_coordsData[0];
+  m_y0 = m_coordsData.empty() ? 0 : &m_coordsData[n];
+  m_x1 = m_coordsData.empty() ? 0 : &m_coordsData[2 * n];
+  m_y1 = m_coordsData.empty() ? 0 : &m_coordsData[3 * n];
+  m_nodes = m_nodesData.empty() ? 0 : &m_nodesData[0];
+  m_levels = &m_levelsData[0];
+  m_sortedIds = m_sortedIdsData.empty() ? 0 : &m_sortedIdsData[0];
+  m_sortedPos = m_sortedPosData.empty() ? 0 : &m_sortedPosData[0];
+}
@@ -0,0 +1,203 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/SpatialIndex.h
+
+  \brief This file contains a packed spatial index over points and two point segments
+         that can be saved to and memory mapped from a binary snapshot file.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_SPATIALINDEX_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_SPATIALINDEX_H
+
+#include "../../Config.h"
+
+// TerraLib
+#include <terralib/geometry/Envelope.h>
+
+//STL Includes
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace boost { namespace interprocess { class mapped_region; } }
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \class SpatialIndex
+
+      \brief A static packed R-tree (sort tile recursive) over items described by two coordinates.
+
+      Points are stored with both coordinates equal, direction lines with their first and
+      second vertices and polygons with the corners of their MBR. All arrays are kept as
+      plain structures of arrays so the whole index can be written to a snapshot file and
+      mapped back without any parsing.
+
+      Items inserted after the build are kept in a small list searched sequentially and
+      removed items are only flagged, so the tools can keep the index up to date after
+      their edits without reading the layer again.
+    */
+    class GEOPXTOOLSEXPORT SpatialIndex
+    {
+      public:
+
+        SpatialIndex();
+
+        ~SpatialIndex();
+
+      public:
+
+        /*! \brief Removes all items and releases the mapped snapshot, if any. */
+        void clear();
+
+        /*! \brief Adds a point item. The index must be built before searching. */
+        void add(int id, double x, double y);
+
+        /*! \brief Adds a two point item (segment or MBR corners). */
+        void add(int id, double x0, double y0, double x1, double y1);
+
+        /*! \brief Sorts the items and packs the tree levels. */
+        void build();
+
+        /*!
+          \brief Searches the items whose box intersects the given envelope.
+
+          \param ext      The search envelope.
+          \param results  The positions of the items found (use getId() to get the original ids).
+        */
+        void search(const te::gm::Envelope& ext, std::vector<std::size_t>& results) const;
+
+        /*! \brief Finds the position of the item with the given id (removed items are not found). */
+        bool find(int id, std::size_t& pos) const;
+
+        /*!
+          \brief Inserts a point item in the built index, without packing it again.
+
+          \return The position of the new item (after the positions of the packed items).
+        */
+        std::size_t insert(int id, double x, double y);
+
+        /*! \brief Inserts a two point item in the built index, without packing it again. */
+        std::size_t insert(int id, double x0, double y0, double x1, double y1);
+
+        /*! \brief Removes the item at the given position, the position is not reused until the next build. */
+        void remove(std::size_t pos);
+
+        bool isRemoved(std::size_t pos) const;
+
+        /*! \brief Returns true if items were inserted or removed after the last build. */
+        bool hasChanges() const;
+
+        /*! \brief Returns the number of positions (packed and inserted items). */
+        std::size_t size() const;
+
+        /*! \brief Returns the number of packed items, the size of the arrays returned by getXs() and getYs(). */
+        std::size_t getPackedSize() const;
+
+        bool isEmpty() const;
+
+        int getId(std::size_t pos) const;
+
+        double getX(std::size_t pos) const;
+
+        double getY(std::size_t pos) const;
+
+        double getX1(std::size_t pos) const;
+
+        double getY1(std::size_t pos) const;
+
+        const double* getXs() const;
+
+        const double* getYs() const;
+
+        /*! \brief Returns the greater id stored in the index (0 if it is empty). */
+        int getMaxId() const;
+
+        int getSRID() const;
+
+        void setSRID(int srid);
+
+        /*! \brief Adds one to the counter for each search (statistics, the counter may be shared by threads), null stops counting. */
+        void setSearchCounter(std::atomic<unsigned long long>* counter);
+
+        /*!
+          \brief Writes the built index into a snapshot file (inserted and removed items are packed first).
+
+          \param fileName   The snapshot file name.
+          \param signature  A string that identifies the state of the source dataset.
+
+          \note The file is written in a temporary file and renamed, so readers never see a partial snapshot.
+        */
+        void save(const std::string& fileName, const std::string& signature) const;
+
+        /*!
+          \brief Maps a snapshot file created by save().
+
+          \return False if the file does not exist, is corrupted or was created for another signature.
+        */
+        bool load(const std::string& fileName, const std::string& signature);
+
+        /*!
+          \brief Copies the arrays of a mapped snapshot to memory and releases the file.
+
+          \note The snapshot file can not be replaced while it is mapped on some systems, detach before saving over it.
+        */
+        void detach();
+
+      protected:
+
+        /*! \brief Moves the packed items not removed and the inserted items back to the items list. */
+        void unpack();
+
+        void pack();
+
+        void setPointers();
+
+      protected:
+
+        struct Item
+        {
+          int m_id;
+          double m_x0;
+          double m_y0;
+          double m_x1;
+          double m_y1;
+        };
+
+        std::vector<Item> m_items;                              //!< Items added before build.
+
+        std::vector<int> m_idsData;                             //!< Item ids in tree order.
+        std::vector<double> m_coordsData;                       //!< x0, y0, x1 and y1 arrays in tree order.
+        std::vector<double> m_nodesData;                        //!< Node boxes (llx, lly, urx, ury) for all levels above the items.
+        std::vector<unsigned long long> m_levelsData;           //!< Offset of each level in the node boxes array.
+        std::vector<int> m_sortedIdsData;                       //!< Item ids in ascending order.
+        std::vector<unsigned int> m_sortedPosData;              //!< Item positions following m_sortedIdsData.
+
+        std::vector<Item> m_delta;                              //!< Items inserted after build (positions after the packed items).
+        std::vector<unsigned char> m_removed;                   //!< Removed flag of each position (empty if nothing was removed).
+
+        std::unique_ptr<boost::interprocess::mapped_region> m_region;  //!< Mapped snapshot, when loaded from a file.
+
+        const int* m_ids;
+        const double* m_x0;
+        const double* m_y0;
+        const double* m_x1;
+        const double* m_y1;
+        const double* m_nodes;
+        const unsigned long long* m_levels;
+        const int* m_sortedIds;
+        const unsigned int* m_sortedPos;
+
+        std::size_t m_size;                                     //!< Number of items.
+        std::size_t m_levelCount;                               //!< Number of node levels above the items.
+        int m_srid;
+
+        std::atomic<unsigned long long>* m_searchCounter;       //!< Search statistics, null if the searches are not counted.
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_SPATIALINDEX_H
@@ -0,0 +1,195 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackCandidateFilter.cpp
+
+  \brief This file contains batch functions used to evaluate the track candidates of a centroid.
+*/
+
+#include "TrackCandidateFilter.h"
+
+//STL Includes
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define GEOPX_TRACK_CANDIDATE_SSE2
+  #include <emmintrin.h>
+#endif
+
+namespace
+{
+  /*! Same pseudo angle used by ForestMonitor::getAngle */
+  inline double PseudoAngle(double dx, double dy)
+  {
+    double t = 0.0;
+
+    if(dx != 0.0 || dy != 0.0)
+      t = dy / (std::fabs(dx) + std::fabs(dy));
+
+    if(dx < 0.0)
+      t = 2.0 - t;
+    else if(dy < 0.0)
+      t = 4.0 + t;
+
+    return t * 90.0;
+  }
+
+  /*! Flags of one candidate given its distance and angle from the centroid */
+  inline unsigned char CandidateFlags(double dist, double a, double minDist, double maxDist, double angle, double tolAngle, unsigned char state)
+  {
+    unsigned char flags = state & (TRACK_CANDIDATE_IGNORED | TRACK_CANDIDATE_USED);
+
+    if(dist > minDist && dist < maxDist)
+    {
+      if(std::fabs(angle - a) <= tolAngle)
+      {
+        if(!flags)
+          flags |= TRACK_CANDIDATE_ACCEPTED;
+      }
+      else
+      {
+        bool inverted = (a > angle - 180. - tolAngle && a < angle - 180. + tolAngle) ||
+                        (a > angle + 180. - tolAngle && a < angle + 180. + tolAngle);
+
+        if(!inverted)
+          flags |= TRACK_CANDIDATE_IGNORED;
+      }
+    }
+    else if(dist < minDist && dist != 0.)
+    {
+      flags |= TRACK_CANDIDATE_IGNORED;
+    }
+
+    return flags;
+  }
+
+#ifdef GEOPX_TRACK_CANDIDATE_SSE2
+  inline __m128d Select(__m128d mask, __m128d a, __m128d b)
+  {
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+  }
+
+  /*! Pseudo angle of two candidates at once */
+  inline __m128d PseudoAngle(__m128d dx, __m128d dy)
+  {
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d absMask = _mm_castsi128_pd(_mm_set_epi32(0x7fffffff, -1, 0x7fffffff, -1));
+
+    __m128d sum = _mm_add_pd(_mm_and_pd(dx, absMask), _mm_and_pd(dy, absMask));
+
+    //zero when both deltas are zero (avoids the 0/0)
+    __m128d t = _mm_andnot_pd(_mm_cmpeq_pd(sum, zero), _mm_div_pd(dy, sum));
+
+    __m128d negX = _mm_cmplt_pd(dx, zero);
+    __m128d negY = _mm_andnot_pd(negX, _mm_cmplt_pd(dy, zero));
+
+    t = Select(negX, _mm_sub_pd(_mm_set1_pd(2.0), t), t);
+    t = Select(negY, _mm_add_pd(_mm_set1_pd(4.0), t), t);
+
+    return _mm_mul_pd(t, _mm_set1_pd(90.0));
+  }
+#endif
+}
+
+void geopx::tools::ComputeTrackAngles(const double* xs, const double* ys, const std::size_t* candidates, std::size_t size,
+                                      double x, double y, bool toPoint, double* angles)
+{
+  std::size_t t = 0;
+
+#ifdef GEOPX_TRACK_CANDIDATE_SSE2
+  const __m128d vx = _mm_set1_pd(x);
+  const __m128d vy = _mm_set1_pd(y);
+
+  for(; t + 2 <= size; t += 2)
+  {
+    __m128d cx = _mm_set_pd(xs[candidates[t + 1]], xs[candidates[t]]);
+    __m128d cy = _mm_set_pd(ys[candidates[t + 1]], ys[candidates[t]]);
+
+    if(toPoint)
+      _mm_storeu_pd(angles + t, PseudoAngle(_mm_sub_pd(vx, cx), _mm_sub_pd(vy, cy)));
+    else
+      _mm_storeu_pd(angles + t, PseudoAngle(_mm_sub_pd(cx, vx), _mm_sub_pd(cy, vy)));
+  }
+#endif
+
+  for(; t < size; ++t)
+  {
+    if(toPoint)
+      angles[t] = PseudoAngle(x - xs[candidates[t]], y - ys[candidates[t]]);
+    else
+      angles[t] = PseudoAngle(xs[candidates[t]] - x, ys[candidates[t]] - y);
+  }
+}
+
+void geopx::tools::FilterTrackCandidates(const double* xs, const double* ys, const std::size_t* candidates, std::size_t size,
+                                         double x, double y, double minDist, double maxDist, double angle, double tolAngle,
+                                         const unsigned char* state, unsigned char* flags)
+{
+  std::size_t t = 0;
+
+#ifdef GEOPX_TRACK_CANDIDATE_SSE2
+  const __m128d vx = _mm_set1_pd(x);
+  const __m128d vy = _mm_set1_pd(y);
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d vMinDist = _mm_set1_pd(minDist);
+  const __m128d vMaxDist = _mm_set1_pd(maxDist);
+  const __m128d vAngle = _mm_set1_pd(angle);
+  const __m128d vTolAngle = _mm_set1_pd(tolAngle);
+  const __m128d absMask = _mm_castsi128_pd(_mm_set_epi32(0x7fffffff, -1, 0x7fffffff, -1));
+
+  //inverted angle windows
+  const __m128d minus180a = _mm_set1_pd(angle - 180. - tolAngle);
+  const __m128d minus180b = _mm_set1_pd(angle - 180. + tolAngle);
+  const __m128d plus180a = _mm_set1_pd(angle + 180. - tolAngle);
+  const __m128d plus180b = _mm_set1_pd(angle + 180. + tolAngle);
+
+  for(; t + 2 <= size; t += 2)
+  {
+    __m128d dx = _mm_sub_pd(_mm_set_pd(xs[candidates[t + 1]], xs[candidates[t]]), vx);
+    __m128d dy = _mm_sub_pd(_mm_set_pd(ys[candidates[t + 1]], ys[candidates[t]]), vy);
+
+    __m128d dist = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+    __m128d a = PseudoAngle(dx, dy);
+
+    int inBand = _mm_movemask_pd(_mm_and_pd(_mm_cmpgt_pd(dist, vMinDist), _mm_cmplt_pd(dist, vMaxDist)));
+    int close = _mm_movemask_pd(_mm_and_pd(_mm_cmplt_pd(dist, vMinDist), _mm_cmpneq_pd(dist, zero)));
+    int sameTrack = _mm_movemask_pd(_mm_cmple_pd(_mm_and_pd(_mm_sub_pd(vAngle, a), absMask), vTolAngle));
+    int inverted = _mm_movemask_pd(_mm_or_pd(_mm_and_pd(_mm_cmpgt_pd(a, minus180a), _mm_cmplt_pd(a, minus180b)),
+                                             _mm_and_pd(_mm_cmpgt_pd(a, plus180a), _mm_cmplt_pd(a, plus180b))));
+
+    for(int lane = 0; lane < 2; ++lane)
+    {
+      int bit = 1 << lane;
+
+      unsigned char f = state[candidates[t + lane]] & (TRACK_CANDIDATE_IGNORED | TRACK_CANDIDATE_USED);
+
+      if(inBand & bit)
+      {
+        if(sameTrack & bit)
+        {
+          if(!f)
+            f |= TRACK_CANDIDATE_ACCEPTED;
+        }
+        else if(!(inverted & bit))
+        {
+          f |= TRACK_CANDIDATE_IGNORED;
+        }
+      }
+      else if(close & bit)
+      {
+        f |= TRACK_CANDIDATE_IGNORED;
+      }
+
+      flags[t + lane] = f;
+    }
+  }
+#endif
+
+  for(; t < size; ++t)
+  {
+    double dx = xs[candidates[t]] - x;
+    double dy = ys[candidates[t]] - y;
+
+    double dist = std::sqrt(dx * dx + dy * dy);
+
+    flags[t] = CandidateFlags(dist, PseudoAngle(dx, dy), minDist, maxDist, angle, tolAngle, state[candidates[t]]);
+  }
+}
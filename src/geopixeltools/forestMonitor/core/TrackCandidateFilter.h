@@ -0,0 +1,66 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackCandidateFilter.h
+
+  \brief This file contains batch functions used to evaluate the track candidates of a centroid.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKCANDIDATEFILTER_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKCANDIDATEFILTER_H
+
+#include "../../Config.h"
+
+//STL Includes
+#include <cstddef>
+
+#define TRACK_CANDIDATE_ACCEPTED  0x01    //!< Candidate inside the distance band and in the track direction.
+#define TRACK_CANDIDATE_IGNORED   0x02    //!< Candidate already ignored or that must be ignored from now on.
+#define TRACK_CANDIDATE_USED      0x04    //!< Candidate already used by a track.
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \brief Computes the pseudo angle (0 to 360) from a point to each candidate (or from each candidate to the point).
+
+      \param xs          The x coordinates of all centroids.
+      \param ys          The y coordinates of all centroids.
+      \param candidates  The positions of the candidates in the coordinates arrays.
+      \param size        The number of candidates.
+      \param x           The x coordinate of the start point.
+      \param y           The y coordinate of the start point.
+      \param toPoint     If true the angles are computed from each candidate to the point.
+      \param angles      Output array with size elements.
+    */
+    void ComputeTrackAngles(const double* xs, const double* ys, const std::size_t* candidates, std::size_t size,
+                            double x, double y, bool toPoint, double* angles);
+
+    /*!
+      \brief Evaluates the distance and angle rules for the neighbor candidates of a centroid.
+
+      A candidate is accepted when its distance is inside (minDist, maxDist), its angle is inside
+      the tolerance of the track angle and it is not flagged in the state array. Candidates inside
+      the band that are neither in the track angle nor in the inverted angle (+/-180) and candidates
+      closer than minDist are flagged as ignored.
+
+      \param xs          The x coordinates of all centroids.
+      \param ys          The y coordinates of all centroids.
+      \param candidates  The positions of the candidates in the coordinates arrays.
+      \param size        The number of candidates.
+      \param x           The x coordinate of the centroid.
+      \param y           The y coordinate of the centroid.
+      \param minDist     The minimum distance.
+      \param maxDist     The maximum distance.
+      \param angle       The track angle.
+      \param tolAngle    The angle tolerance.
+      \param state       The current flags of all centroids (TRACK_CANDIDATE_IGNORED and TRACK_CANDIDATE_USED).
+      \param flags       Output array with size elements.
+    */
+    void FilterTrackCandidates(const double* xs, const double* ys, const std::size_t* candidates, std::size_t size,
+                               double x, double y, double minDist, double maxDist, double angle, double tolAngle,
+                               const unsigned char* state, unsigned char* flags);
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKCANDIDATEFILTER_H
@@ -0,0 +1,256 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackCorridor.cpp
+
+  \brief This file contains a class used to test points against the buffer of a track line.
+*/
+
+#include "TrackCorridor.h"
+#include "SpatialIndex.h"
+
+//TerraLib Includes
+#include <terralib/geometry/LineString.h>
+
+//STL Includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+  /*! Expands the envelope to include the box of a disk */
+  void Expand(te::gm::Envelope& box, double x, double y, double radius)
+  {
+    box.m_llx = std::min(box.m_llx, x - radius);
+    box.m_lly = std::min(box.m_lly, y - radius);
+    box.m_urx = std::max(box.m_urx, x + radius);
+    box.m_ury = std::max(box.m_ury, y + radius);
+  }
+}
+
+geopx::tools::TrackCorridor::TrackCorridor(const double* xs, const double* ys, std::size_t size, double halfWidth) :
+  m_halfWidth(halfWidth)
+{
+  init(xs, ys, size);
+}
+
+geopx::tools::TrackCorridor::TrackCorridor(const te::gm::LineString* line, double halfWidth) :
+  m_halfWidth(halfWidth)
+{
+  std::size_t size = line->size();
+
+  std::vector<double> xs(size);
+  std::vector<double> ys(size);
+
+  for(std::size_t t = 0; t < size; ++t)
+  {
+    xs[t] = line->getX(t);
+    ys[t] = line->getY(t);
+  }
+
+  init(xs.data(), ys.data(), size);
+}
+
+geopx::tools::TrackCorridor::TrackCorridor(double x0, double y0, double x1, double y1, double halfWidth) :
+  m_halfWidth(halfWidth)
+{
+  double xs[2] = { x0, x1 };
+  double ys[2] = { y0, y1 };
+
+  init(xs, ys, 2);
+}
+
+geopx::tools::TrackCorridor::~TrackCorridor()
+{
+}
+
+void geopx::tools::TrackCorridor::init(const double* xs, const double* ys, std::size_t size)
+{
+  m_mbr.m_llx = std::numeric_limits<double>::max();
+  m_mbr.m_lly = std::numeric_limits<double>::max();
+  m_mbr.m_urx = -std::numeric_limits<double>::max();
+  m_mbr.m_ury = -std::numeric_limits<double>::max();
+
+  for(std::size_t t = 1; t < size; ++t)
+  {
+    double dx = xs[t] - xs[t - 1];
+    double dy = ys[t] - ys[t - 1];
+
+    double length = std::sqrt(dx * dx + dy * dy);
+
+    if(length == 0.)
+      continue;
+
+    Segment seg;
+    seg.m_x = xs[t - 1];
+    seg.m_y = ys[t - 1];
+    seg.m_ux = dx / length;
+    seg.m_uy = dy / length;
+    seg.m_length = length;
+
+    //the rectangle corners are the segment ends moved by the normal
+    double nx = -seg.m_uy * m_halfWidth;
+    double ny = seg.m_ux * m_halfWidth;
+
+    seg.m_mbr.m_llx = std::min(xs[t - 1], xs[t]) - std::abs(nx);
+    seg.m_mbr.m_lly = std::min(ys[t - 1], ys[t]) - std::abs(ny);
+    seg.m_mbr.m_urx = std::max(xs[t - 1], xs[t]) + std::abs(nx);
+    seg.m_mbr.m_ury = std::max(ys[t - 1], ys[t]) + std::abs(ny);
+
+    //the joins are round, the segments after the first one add the disk of their first vertex
+    if(!m_segments.empty())
+    {
+      m_xs.push_back(xs[t - 1]);
+      m_ys.push_back(ys[t - 1]);
+
+      //the disk is searched by both segments that share the vertex
+      Expand(m_segments.back().m_mbr, xs[t - 1], ys[t - 1], m_halfWidth);
+      Expand(seg.m_mbr, xs[t - 1], ys[t - 1], m_halfWidth);
+    }
+
+    m_segments.push_back(seg);
+  }
+
+  for(std::size_t t = 0; t < m_segments.size(); ++t)
+  {
+    m_mbr.m_llx = std::min(m_mbr.m_llx, m_segments[t].m_mbr.m_llx);
+    m_mbr.m_lly = std::min(m_mbr.m_lly, m_segments[t].m_mbr.m_lly);
+    m_mbr.m_urx = std::max(m_mbr.m_urx, m_segments[t].m_mbr.m_urx);
+    m_mbr.m_ury = std::max(m_mbr.m_ury, m_segments[t].m_mbr.m_ury);
+  }
+}
+
+const te::gm::Envelope& geopx::tools::TrackCorridor::getMBR() const
+{
+  return m_mbr;
+}
+
+bool geopx::tools::TrackCorridor::isStraight() const
+{
+  return m_segments.size() == 1;
+}
+
+bool geopx::tools::TrackCorridor::contains(double x, double y) const
+{
+  if(x < m_mbr.m_llx || x > m_mbr.m_urx || y < m_mbr.m_lly || y > m_mbr.m_ury)
+    return false;
+
+  for(std::size_t t = 0; t < m_segments.size(); ++t)
+  {
+    if(segmentContains(t, x, y))
+      return true;
+  }
+
+  for(std::size_t t = 0; t < m_xs.size(); ++t)
+  {
+    if(jointContains(t, x, y))
+      return true;
+  }
+
+  return false;
+}
+
+bool geopx::tools::TrackCorridor::covers(const TrackCorridor& corridor) const
+{
+  if(!isStraight() || !corridor.isStraight())
+    return false;
+
+  const Segment& s = corridor.m_segments[0];
+
+  //the rectangle corners are the segment ends moved by the normal
+  double nx = -s.m_uy * corridor.m_halfWidth;
+  double ny = s.m_ux * corridor.m_halfWidth;
+
+  double x1 = s.m_x + s.m_ux * s.m_length;
+  double y1 = s.m_y + s.m_uy * s.m_length;
+
+  return segmentContains(0, s.m_x + nx, s.m_y + ny) && segmentContains(0, s.m_x - nx, s.m_y - ny) &&
+         segmentContains(0, x1 + nx, y1 + ny) && segmentContains(0, x1 - nx, y1 - ny);
+}
+
+void geopx::tools::TrackCorridor::search(const SpatialIndex& index, std::vector<std::size_t>& results) const
+{
+  results.clear();
+
+  std::vector<std::size_t> candidates;
+
+  std::size_t first = 0;
+
+  while(first < m_segments.size())
+  {
+    //consecutive segments share one index query while their MBRs are not much smaller than the group MBR
+    te::gm::Envelope groupMBR = m_segments[first].m_mbr;
+    double segmentsArea = groupMBR.getArea();
+
+    std::size_t last = first + 1;
+
+    for(; last < m_segments.size(); ++last)
+    {
+      te::gm::Envelope mbr = groupMBR;
+      mbr.Union(m_segments[last].m_mbr);
+
+      if(mbr.getArea() > TRACK_CORRIDOR_GROUP_FACTOR * (segmentsArea + m_segments[last].m_mbr.getArea()))
+        break;
+
+      groupMBR = mbr;
+      segmentsArea += m_segments[last].m_mbr.getArea();
+    }
+
+    index.search(groupMBR, candidates);
+
+    for(std::size_t i = 0; i < candidates.size(); ++i)
+    {
+      double x = index.getX(candidates[i]);
+      double y = index.getY(candidates[i]);
+
+      //the segments of the group or the joins at their ends (joint t - 1 is the first vertex of segment t)
+      for(std::size_t t = first; t < last; ++t)
+      {
+        if(segmentContains(t, x, y) || (t > 0 && jointContains(t - 1, x, y)) || (t < m_xs.size() && jointContains(t, x, y)))
+        {
+          results.push_back(candidates[i]);
+          break;
+        }
+      }
+    }
+
+    candidates.clear();
+
+    first = last;
+  }
+
+  if(m_segments.size() > 1)
+  {
+    std::sort(results.begin(), results.end());
+    results.erase(std::unique(results.begin(), results.end()), results.end());
+  }
+  else
+  {
+    std::sort(results.begin(), results.end());
+  }
+}
+
+bool geopx::tools::TrackCorridor::segmentContains(std::size_t seg, double x, double y) const
+{
+  const Segment& s = m_segments[seg];
+
+  double dx = x - s.m_x;
+  double dy = y - s.m_y;
+
+  //distance along the segment and distance from the segment line
+  double along = dx * s.m_ux + dy * s.m_uy;
+
+  if(along < 0. || along > s.m_length)
+    return false;
+
+  double across = dx * s.m_uy - dy * s.m_ux;
+
+  return std::abs(across) <= m_halfWidth;
+}
+
+bool geopx::tools::TrackCorridor::jointContains(std::size_t vertex, double x, double y) const
+{
+  double dx = x - m_xs[vertex];
+  double dy = y - m_ys[vertex];
+
+  return (dx * dx + dy * dy) <= m_halfWidth * m_halfWidth;
+}
@@ -0,0 +1,118 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackCorridor.h
+
+  \brief This file contains a class used to test points against the buffer of a track line.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKCORRIDOR_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKCORRIDOR_H
+
+#include "../../Config.h"
+
+// TerraLib
+#include <terralib/geometry/Envelope.h>
+
+//STL Includes
+#include <vector>
+
+#define TRACK_CORRIDOR_GROUP_FACTOR 2.0
+
+namespace te { namespace gm { class LineString; } }
+
+namespace geopx
+{
+  namespace tools
+  {
+    class SpatialIndex;
+
+    /*!
+      \class TrackCorridor
+
+      \brief A prepared buffer of a track line, with butt caps and round joins (the shape of
+             LineString::buffer(d, n, CapButtType)).
+
+      Each segment is kept as a rotated rectangle (origin, unit direction and length), so
+      testing a point against a straight track is a dot and a cross product. Tracks with
+      more vertices also test the disks of the inner vertices.
+    */
+    class GEOPXTOOLSEXPORT TrackCorridor
+    {
+      public:
+
+        /*!
+          \param xs         The x coordinates of the track vertices.
+          \param ys         The y coordinates of the track vertices.
+          \param size       The number of vertices.
+          \param halfWidth  The buffer distance.
+        */
+        TrackCorridor(const double* xs, const double* ys, std::size_t size, double halfWidth);
+
+        /*! \brief Creates the corridor of a line. */
+        TrackCorridor(const te::gm::LineString* line, double halfWidth);
+
+        /*! \brief Creates the corridor of a straight segment. */
+        TrackCorridor(double x0, double y0, double x1, double y1, double halfWidth);
+
+        ~TrackCorridor();
+
+      public:
+
+        const te::gm::Envelope& getMBR() const;
+
+        bool isStraight() const;
+
+        /*! \brief Returns true if the point is inside the corridor. */
+        bool contains(double x, double y) const;
+
+        /*!
+          \brief Returns true if the other corridor is inside this one.
+
+          Only straight corridors are tested (both are rectangles, so the test is done with
+          the corners of the other one), false is returned for tracks with more vertices.
+        */
+        bool covers(const TrackCorridor& corridor) const;
+
+        /*!
+          \brief Searches the index items inside the corridor.
+
+          Consecutive segments are searched by one index query while the MBR of the group is
+          at most TRACK_CORRIDOR_GROUP_FACTOR times the area of their own MBRs, so straight
+          tracks need few queries and long bent tracks do not test the items of the whole
+          track MBR.
+
+          \param index    The index (point items).
+          \param results  Output, the positions of the items inside the corridor in ascending order.
+        */
+        void search(const SpatialIndex& index, std::vector<std::size_t>& results) const;
+
+      protected:
+
+        void init(const double* xs, const double* ys, std::size_t size);
+
+        bool segmentContains(std::size_t seg, double x, double y) const;
+
+        bool jointContains(std::size_t vertex, double x, double y) const;
+
+      protected:
+
+        struct Segment
+        {
+          double m_x;                 //!< Origin x.
+          double m_y;                 //!< Origin y.
+          double m_ux;                //!< Unit direction x.
+          double m_uy;                //!< Unit direction y.
+          double m_length;            //!< Segment length.
+          te::gm::Envelope m_mbr;     //!< MBR of the segment rectangle.
+        };
+
+        double m_halfWidth;                   //!< The buffer distance.
+        std::vector<Segment> m_segments;      //!< The segments with length greater than zero.
+        std::vector<double> m_xs;             //!< The x coordinates of the inner vertices (round joins).
+        std::vector<double> m_ys;             //!< The y coordinates of the inner vertices (round joins).
+        te::gm::Envelope m_mbr;               //!< The corridor MBR.
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKCORRIDOR_H
@@ -0,0 +1,718 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackEngine.cpp
+
+  \brief This file contains the track following algorithm used by the track classifier tools.
+*/
+
+#include "TrackEngine.h"
+#include "ClassificationCache.h"
+#include "NdviSampler.h"
+#include "RowDirectionEstimator.h"
+#include "SpatialIndex.h"
+#include "TrackCorridor.h"
+
+//TerraLib Includes
+#include <terralib/geometry/Envelope.h>
+#include <terralib/geometry/Geometry.h>
+#include <terralib/geometry/Point.h>
+
+//STL Includes
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <list>
+#include <set>
+#include <utility>
+
+geopx::tools::TrackParameters::TrackParameters() :
+  m_distance(2.0),
+  m_distanceTrack(3.0),
+  m_toleranceFactor(0.2),
+  m_trackToleranceFactor(0.3),
+  m_polyAreaMin(0.1),
+  m_polyAreaMax(2.0),
+  m_maxDead(6),
+  m_deltaTol(0.1),
+  m_ndviThreshold(120.0),
+  m_adjustTrack(false),
+  m_adjustTrackSteps(0),
+  m_predictor(TRACK_PREDICTOR_STEP),
+  m_fitPoints(5),
+  m_batchSteps(TRACK_BATCH_STEPS),
+  m_minDirectionConfidence(TRACK_MIN_DIRECTION_CONFIDENCE),
+  m_hasDirection(false),
+  m_dirX(0.),
+  m_dirY(0.)
+{
+}
+
+geopx::tools::TrackParcel::TrackParcel() :
+  m_id(0),
+  m_hasDirection(false),
+  m_dirX(0.),
+  m_dirY(0.)
+{
+}
+
+geopx::tools::TrackEngine::TrackEngine(const SpatialIndex& centroidIndex, const ClassificationCache& classCache, NdviSampler* sampler, const TrackParameters& params) :
+  m_centroidIndex(centroidIndex),
+  m_classCache(classCache),
+  m_sampler(sampler),
+  m_params(params)
+{
+}
+
+geopx::tools::TrackEngine::~TrackEngine()
+{
+}
+
+void geopx::tools::TrackEngine::classifyParcel(const TrackParcel& parcel, std::vector<TrackResult>& results) const
+{
+  if(!parcel.m_geom.get() || parcel.m_roots.empty())
+    return;
+
+  double stepX = 0.;
+  double stepY = 0.;
+
+  if(!getStep(parcel, parcel.m_roots[0], stepX, stepY))
+    return;
+
+  //classification made by the tracks of this parcel
+  TypeOverlay overlay;
+
+  for(std::size_t t = 0; t < parcel.m_roots.size(); ++t)
+  {
+    TrackResult result;
+    result.m_parcelId = parcel.m_id;
+
+    if(!classifyTrack(parcel, parcel.m_roots[t], stepX, stepY, overlay, result))
+      continue;
+
+    for(std::size_t i = 0; i < result.m_live.size(); ++i)
+      overlay[result.m_live[i]] = CLASSIFICATION_LIVE;
+
+    for(std::size_t i = 0; i < result.m_intruders.size(); ++i)
+      overlay[result.m_intruders[i]] = CLASSIFICATION_INTRUDER;
+
+    results.push_back(std::move(result));
+  }
+}
+
+bool geopx::tools::TrackEngine::classifyRoot(const TrackParcel& parcel, std::size_t rootPos, TrackResult& result) const
+{
+  if(!parcel.m_geom.get())
+    return false;
+
+  double stepX = 0.;
+  double stepY = 0.;
+
+  if(!getStep(parcel, rootPos, stepX, stepY))
+    return false;
+
+  TypeOverlay overlay;
+
+  result.m_parcelId = parcel.m_id;
+
+  return classifyTrack(parcel, rootPos, stepX, stepY, overlay, result);
+}
+
+bool geopx::tools::TrackEngine::classifySegment(int parcelId, double x0, double y0, double x1, double y1, const std::size_t* rootPos, TrackResult& result) const
+{
+  double totalDistance = std::sqrt((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+
+  if(totalDistance == 0. || m_params.m_distance <= 0.)
+    return false;
+
+  result.m_parcelId = parcelId;
+
+  double dx = m_params.m_distance * (x1 - x0) / totalDistance;
+  double dy = m_params.m_distance * (y1 - y0) / totalDistance;
+
+  double rootX = x0;
+  double rootY = y0;
+
+  std::vector<double> xs;
+  std::vector<double> ys;
+
+  xs.push_back(rootX);
+  ys.push_back(rootY);
+
+  std::set<std::size_t> trackPos;
+
+  unsigned int deadCount = 0;
+
+  if(rootPos)
+    trackPos.insert(*rootPos);
+  else
+    createTree(rootX, rootY, deadCount, result);
+
+  deadCount = 0;
+
+  CorridorBatch batch;
+
+  while(true)
+  {
+    double guessX = rootX + dx;
+    double guessY = rootY + dy;
+
+    //adjust tolerance for dead trees
+    double toleranceFactor = m_params.m_toleranceFactor + (deadCount * m_params.m_deltaTol);
+
+    //stop criteria
+    double curDistance = std::sqrt((guessX - x0) * (guessX - x0) + (guessY - y0) * (guessY - y0));
+
+    if(curDistance > (totalDistance + toleranceFactor))
+      break;
+
+    std::vector<std::size_t> corridor;
+
+    searchStep(rootX + (dx - (dx * toleranceFactor)), rootY + (dy - (dy * toleranceFactor)),
+               rootX + (dx + (dx * toleranceFactor)), rootY + (dy + (dy * toleranceFactor)),
+               m_params.m_distanceTrack * m_params.m_trackToleranceFactor, dx, dy, batch, corridor);
+
+    std::size_t candidatePos = 0;
+
+    if(!corridor.empty() && getSegmentCandidate(rootX, rootY, guessX, guessY, corridor, candidatePos))
+    {
+      //live point
+      rootX = m_centroidIndex.getX(candidatePos);
+      rootY = m_centroidIndex.getY(candidatePos);
+
+      trackPos.insert(candidatePos);
+
+      deadCount = 0;
+    }
+    else
+    {
+      //dead point
+      rootX = guessX;
+      rootY = guessY;
+
+      createTree(rootX, rootY, deadCount, result);
+    }
+
+    xs.push_back(rootX);
+    ys.push_back(rootY);
+
+    //move the root back to the segment line (perpendicular projection)
+    double t = ((rootX - x0) * (x1 - x0) + (rootY - y0) * (y1 - y0)) / (totalDistance * totalDistance);
+
+    rootX = x0 + t * (x1 - x0);
+    rootY = y0 + t * (y1 - y0);
+  }
+
+  if(xs.size() < 2)
+    return false;
+
+  TrackCorridor buffer(xs.data(), ys.data(), xs.size(), m_params.m_distanceTrack / 2.);
+
+  std::vector<std::size_t> resultsTree;
+
+  buffer.search(m_centroidIndex, resultsTree);
+
+  for(std::size_t t = 0; t < resultsTree.size(); ++t)
+  {
+    if(trackPos.find(resultsTree[t]) != trackPos.end())
+      result.m_live.push_back(resultsTree[t]);
+    else if(m_classCache.getType(resultsTree[t]) == CLASSIFICATION_DEAD)
+      result.m_removed.push_back(resultsTree[t]);
+    else
+      result.m_intruders.push_back(resultsTree[t]);
+  }
+
+  return true;
+}
+
+unsigned char geopx::tools::TrackEngine::getType(const TypeOverlay& overlay, std::size_t pos) const
+{
+  TypeOverlay::const_iterator it = overlay.find(pos);
+
+  if(it != overlay.end())
+    return it->second;
+
+  return m_classCache.getType(pos);
+}
+
+bool geopx::tools::TrackEngine::getStep(const TrackParcel& parcel, std::size_t rootPos, double& dx, double& dy) const
+{
+  double dirX = parcel.m_dirX;
+  double dirY = parcel.m_dirY;
+
+  double distance = m_params.m_distance;
+
+  if(!parcel.m_hasDirection)
+  {
+    //no direction line for this parcel, estimate the rows direction from the centroids
+    int srid = parcel.m_geom->getSRID();
+
+    std::vector<std::size_t> results;
+
+    m_centroidIndex.search(*parcel.m_geom->getMBR(), results);
+
+    std::vector<double> xs;
+    std::vector<double> ys;
+
+    for(std::size_t t = 0; t < results.size(); ++t)
+    {
+      te::gm::Point p(m_centroidIndex.getX(results[t]), m_centroidIndex.getY(results[t]), srid);
+
+      if(!parcel.m_geom->covers(&p))
+        continue;
+
+      xs.push_back(p.getX());
+      ys.push_back(p.getY());
+    }
+
+    std::vector<std::size_t> positions(xs.size());
+
+    for(std::size_t t = 0; t < positions.size(); ++t)
+      positions[t] = t;
+
+    RowDirectionEstimator estimator;
+
+    if(estimator.estimate(xs.data(), ys.data(), positions.data(), positions.size()) &&
+       estimator.getConfidence() >= m_params.m_minDirectionConfidence)
+    {
+      dirX = estimator.getDx();
+      dirY = estimator.getDy();
+
+      if(estimator.getSpacing() > 0.)
+        distance = estimator.getSpacing();
+    }
+    else if(m_params.m_hasDirection)
+    {
+      //a weak histogram peak does not show the rows
+      dirX = m_params.m_dirX;
+      dirY = m_params.m_dirY;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  double length = std::sqrt(dirX * dirX + dirY * dirY);
+
+  if(length == 0.)
+    return false;
+
+  dx = distance * dirX / length;
+  dy = distance * dirY / length;
+
+  return true;
+}
+
+bool geopx::tools::TrackEngine::classifyTrack(const TrackParcel& parcel, std::size_t rootPos, double stepX, double stepY, TypeOverlay& overlay, TrackResult& result) const
+{
+  int srid = parcel.m_geom->getSRID();
+
+  double starterX = m_centroidIndex.getX(rootPos);
+  double starterY = m_centroidIndex.getY(rootPos);
+
+  double rootX = starterX;
+  double rootY = starterY;
+
+  std::list<std::pair<double, double> > track;
+  track.push_back(std::make_pair(rootX, rootY));
+
+  std::set<std::size_t> trackPos;
+  trackPos.insert(rootPos);
+
+  std::deque<std::pair<double, double> > adjustPoints;
+
+  CorridorBatch batch;
+
+  double dx = stepX;
+  double dy = stepY;
+
+  //the step length may be the spacing estimated for the parcel
+  double distance = std::sqrt(stepX * stepX + stepY * stepY);
+
+  unsigned int deadCount = 0;
+
+  bool invert = false;
+  bool insideParcel = true;
+
+  while(insideParcel)
+  {
+    bool finishSide = false;
+
+    //the next tree is predicted from the last one
+    double baseX = rootX;
+    double baseY = rootY;
+
+    if(m_params.m_predictor == TRACK_PREDICTOR_LINE_FIT)
+    {
+      //running line over the last trees, the prediction starts at the projection of the last tree
+      adjustPoints.push_back(std::make_pair(rootX, rootY));
+
+      if(adjustPoints.size() > m_params.m_fitPoints)
+        adjustPoints.pop_front();
+
+      if(adjustPoints.size() == m_params.m_fitPoints)
+        fitLine(adjustPoints, dx, dy, baseX, baseY);
+    }
+    else if(m_params.m_adjustTrack)
+    {
+      adjustPoints.push_back(std::make_pair(rootX, rootY));
+
+      if(adjustPoints.size() == m_params.m_adjustTrackSteps)
+      {
+        double bigDx = rootX - adjustPoints.front().first;
+        double bigDy = rootY - adjustPoints.front().second;
+        double bigDistance = std::sqrt(bigDx * bigDx + bigDy * bigDy);
+
+        if(bigDistance > 0.)
+        {
+          dx = distance * bigDx / bigDistance;
+          dy = distance * bigDy / bigDistance;
+        }
+
+        adjustPoints.pop_front();
+      }
+    }
+
+    double guessX = baseX + dx;
+    double guessY = baseY + dy;
+
+    //adjust tolerance for dead trees
+    double toleranceFactor = m_params.m_toleranceFactor + (deadCount * m_params.m_deltaTol);
+
+    //filter using a line buffer (a rotated rectangle, the buffer of a segment with butt caps)
+    std::vector<std::size_t> corridor;
+
+    searchStep(baseX + (dx - (dx * toleranceFactor)), baseY + (dy - (dy * toleranceFactor)),
+               baseX + (dx + (dx * toleranceFactor)), baseY + (dy + (dy * toleranceFactor)),
+               m_params.m_distanceTrack * m_params.m_trackToleranceFactor, dx, dy, batch, corridor);
+
+    bool addRoot = false;
+
+    if(corridor.empty())
+    {
+      //dead point
+      rootX = guessX;
+      rootY = guessY;
+
+      te::gm::Point root(rootX, rootY, srid);
+
+      insideParcel = parcel.m_geom->covers(&root);
+
+      if(insideParcel)
+      {
+        createTree(rootX, rootY, deadCount, result);
+
+        addRoot = true;
+      }
+      else
+      {
+        finishSide = true;
+      }
+    }
+    else
+    {
+      //live point
+      bool found = false;
+      std::size_t candidatePos = 0;
+
+      if(!getCandidate(overlay, rootX, rootY, guessX, guessY, corridor, found, candidatePos))
+      {
+        if(invert)
+          break;
+
+        finishSide = true;
+      }
+      else
+      {
+        if(!found)
+        {
+          rootX = guessX;
+          rootY = guessY;
+
+          createTree(rootX, rootY, deadCount, result);
+        }
+        else
+        {
+          rootX = m_centroidIndex.getX(candidatePos);
+          rootY = m_centroidIndex.getY(candidatePos);
+
+          trackPos.insert(candidatePos);
+
+          deadCount = 0;
+        }
+
+        te::gm::Point root(rootX, rootY, srid);
+
+        insideParcel = parcel.m_geom->covers(&root);
+
+        if(insideParcel)
+          addRoot = true;
+        else
+          finishSide = true;
+      }
+    }
+
+    if(addRoot)
+    {
+      if(!invert)
+        track.push_back(std::make_pair(rootX, rootY));
+      else
+        track.push_front(std::make_pair(rootX, rootY));
+    }
+
+    if(!finishSide && deadCount >= m_params.m_maxDead)
+    {
+      if(invert)
+        break;
+
+      finishSide = true;
+    }
+
+    //walk from the root in the inverted direction
+    if(finishSide && !invert)
+    {
+      invert = true;
+      insideParcel = true;
+      dx = -stepX;
+      dy = -stepY;
+      adjustPoints.clear();
+      batch.m_corridor.reset();
+      rootX = starterX;
+      rootY = starterY;
+      deadCount = 0;
+    }
+  }
+
+  if(track.size() < 2)
+    return false;
+
+  //create buffer
+  std::vector<double> xs;
+  std::vector<double> ys;
+
+  for(std::list<std::pair<double, double> >::const_iterator it = track.begin(); it != track.end(); ++it)
+  {
+    xs.push_back(it->first);
+    ys.push_back(it->second);
+  }
+
+  TrackCorridor buffer(xs.data(), ys.data(), xs.size(), m_params.m_distanceTrack / 2.);
+
+  std::vector<std::size_t> resultsTree;
+
+  buffer.search(m_centroidIndex, resultsTree);
+
+  for(std::size_t t = 0; t < resultsTree.size(); ++t)
+  {
+    if(trackPos.find(resultsTree[t]) != trackPos.end())
+      result.m_live.push_back(resultsTree[t]);
+    else
+      result.m_intruders.push_back(resultsTree[t]);
+  }
+
+  return true;
+}
+
+bool geopx::tools::TrackEngine::fitLine(const std::deque<std::pair<double, double> >& points, double& dx, double& dy, double& rootX, double& rootY) const
+{
+  std::size_t size = points.size();
+
+  if(size < 2)
+    return false;
+
+  double meanX = 0.;
+  double meanY = 0.;
+
+  for(std::size_t t = 0; t < size; ++t)
+  {
+    meanX += points[t].first;
+    meanY += points[t].second;
+  }
+
+  meanX /= size;
+  meanY /= size;
+
+  double sxx = 0.;
+  double sxy = 0.;
+  double syy = 0.;
+
+  for(std::size_t t = 0; t < size; ++t)
+  {
+    double vx = points[t].first - meanX;
+    double vy = points[t].second - meanY;
+
+    sxx += vx * vx;
+    sxy += vx * vy;
+    syy += vy * vy;
+  }
+
+  if(sxx + syy == 0.)
+    return false;
+
+  //principal axis of the points
+  double angle = 0.5 * std::atan2(2. * sxy, sxx - syy);
+
+  double ux = std::cos(angle);
+  double uy = std::sin(angle);
+
+  //keep the walk orientation
+  if(ux * dx + uy * dy < 0.)
+  {
+    ux = -ux;
+    uy = -uy;
+  }
+
+  double along = (rootX - meanX) * ux + (rootY - meanY) * uy;
+
+  rootX = meanX + along * ux;
+  rootY = meanY + along * uy;
+
+  double distance = std::sqrt(dx * dx + dy * dy);
+
+  dx = distance * ux;
+  dy = distance * uy;
+
+  return true;
+}
+
+void geopx::tools::TrackEngine::searchStep(double x0, double y0, double x1, double y1, double halfWidth, double dx, double dy,
+                                           CorridorBatch& batch, std::vector<std::size_t>& corridor) const
+{
+  TrackCorridor stepCorridor(x0, y0, x1, y1, halfWidth);
+
+  corridor.clear();
+
+  if(m_params.m_batchSteps < 2)
+  {
+    stepCorridor.search(m_centroidIndex, corridor);
+    return;
+  }
+
+  if(!batch.m_corridor.get() || !batch.m_corridor->covers(stepCorridor))
+  {
+    //half a step of margin behind the step and m_batchSteps - 1 steps ahead of it
+    double ahead = static_cast<double>(m_params.m_batchSteps - 1);
+
+    batch.m_corridor.reset(new TrackCorridor(x0 - dx / 2., y0 - dy / 2., x1 + ahead * dx, y1 + ahead * dy, 2. * halfWidth));
+
+    batch.m_corridor->search(m_centroidIndex, batch.m_items);
+
+    if(!batch.m_corridor->covers(stepCorridor))
+    {
+      batch.m_corridor.reset();
+
+      stepCorridor.search(m_centroidIndex, corridor);
+      return;
+    }
+  }
+
+  for(std::size_t t = 0; t < batch.m_items.size(); ++t)
+  {
+    if(stepCorridor.contains(m_centroidIndex.getX(batch.m_items[t]), m_centroidIndex.getY(batch.m_items[t])))
+      corridor.push_back(batch.m_items[t]);
+  }
+}
+
+bool geopx::tools::TrackEngine::getCandidate(const TypeOverlay& overlay, double rootX, double rootY, double guessX, double guessY,
+                                             const std::vector<std::size_t>& corridor, bool& found, std::size_t& candidatePos) const
+{
+  double lowerDistance = std::numeric_limits<double>::max();
+
+  found = false;
+
+  for(std::size_t t = 0; t < corridor.size(); ++t)
+  {
+    unsigned char type = getType(overlay, corridor[t]);
+
+    if(type != CLASSIFICATION_CREATED && type != CLASSIFICATION_UNKNOWN)
+      return false;
+
+    double area = (type == CLASSIFICATION_UNKNOWN) ? m_classCache.getArea(corridor[t]) : 0.;
+
+    if(!((area > m_params.m_polyAreaMin && area < m_params.m_polyAreaMax) || area == 0.))
+      continue;
+
+    double x = m_centroidIndex.getX(corridor[t]);
+    double y = m_centroidIndex.getY(corridor[t]);
+
+    if(x == rootX && y == rootY)
+      continue;
+
+    //check for lower distance from guest point
+    double dist = std::sqrt((x - guessX) * (x - guessX) + (y - guessY) * (y - guessY));
+
+    if(dist < lowerDistance)
+    {
+      lowerDistance = dist;
+      candidatePos = corridor[t];
+      found = true;
+    }
+  }
+
+  return true;
+}
+
+bool geopx::tools::TrackEngine::getSegmentCandidate(double rootX, double rootY, double guessX, double guessY,
+                                                    const std::vector<std::size_t>& corridor, std::size_t& candidatePos) const
+{
+  double lowerDistance = std::numeric_limits<double>::max();
+
+  bool found = false;
+
+  for(std::size_t t = 0; t < corridor.size(); ++t)
+  {
+    unsigned char type = m_classCache.getType(corridor[t]);
+
+    if(type == CLASSIFICATION_DEAD || type == CLASSIFICATION_REMOVED)
+      continue;
+
+    double area = (type == CLASSIFICATION_UNKNOWN) ? m_classCache.getArea(corridor[t]) : 0.;
+
+    if(!((area > m_params.m_polyAreaMin && area < m_params.m_polyAreaMax) || area == 0.))
+      continue;
+
+    double x = m_centroidIndex.getX(corridor[t]);
+    double y = m_centroidIndex.getY(corridor[t]);
+
+    if(x == rootX && y == rootY)
+      continue;
+
+    //check for lower distance from guest point
+    double dist = std::sqrt((x - guessX) * (x - guessX) + (y - guessY) * (y - guessY));
+
+    if(dist < lowerDistance)
+    {
+      lowerDistance = dist;
+      candidatePos = corridor[t];
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+void geopx::tools::TrackEngine::createTree(double x, double y, unsigned int& deadCount, TrackResult& result) const
+{
+  double value = 0.;
+
+  m_sampler->sample(x, y, value);
+
+  CreatedTree tree;
+  tree.m_x = x;
+  tree.m_y = y;
+
+  if(value > m_params.m_ndviThreshold)
+  {
+    tree.m_type = CLASSIFICATION_LIVE;
+
+    deadCount = 0;
+  }
+  else
+  {
+    tree.m_type = CLASSIFICATION_DEAD;
+
+    ++deadCount;
+  }
+
+  result.m_created.push_back(tree);
+}
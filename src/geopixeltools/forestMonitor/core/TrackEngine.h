@@ -0,0 +1,263 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackEngine.h
+
+  \brief This file contains the track following algorithm used by the track classifier tools.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKENGINE_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKENGINE_H
+
+#include "../../Config.h"
+
+//STL Includes
+#include <deque>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#define TRACK_BATCH_STEPS 8
+#define TRACK_MIN_DIRECTION_CONFIDENCE 0.1
+
+namespace te { namespace gm { class Geometry; } }
+
+namespace geopx
+{
+  namespace tools
+  {
+    class ClassificationCache;
+    class NdviSampler;
+    class SpatialIndex;
+    class TrackCorridor;
+
+    enum TrackPredictorMode
+    {
+      TRACK_PREDICTOR_STEP,         //!< The next tree is one step from the last tree (the step may be adjusted with the last trees).
+      TRACK_PREDICTOR_LINE_FIT      //!< The next tree is one step from the last tree projected on the line fitted to the last trees.
+    };
+
+    /*!
+      \struct TrackParameters
+
+      \brief The parameters of the track classification (the values of the tool bar line edits).
+    */
+    struct GEOPXTOOLSEXPORT TrackParameters
+    {
+      TrackParameters();
+
+      double m_distance;                //!< Distance between the trees of a track.
+      double m_distanceTrack;           //!< Distance between the tracks.
+      double m_toleranceFactor;         //!< Tolerance factor of the distance between trees.
+      double m_trackToleranceFactor;    //!< Tolerance factor of the distance between tracks.
+      double m_polyAreaMin;             //!< Minimum area of a candidate polygon.
+      double m_polyAreaMax;             //!< Maximum area of a candidate polygon.
+      unsigned int m_maxDead;           //!< Number of consecutive dead trees that finishes a track side.
+      double m_deltaTol;                //!< Tolerance factor increment for each consecutive dead tree.
+      double m_ndviThreshold;           //!< NDVI value above which a created tree is live.
+      bool m_adjustTrack;               //!< Adjusts the track direction with the last trees found.
+      std::size_t m_adjustTrackSteps;   //!< Number of trees used to adjust the track direction.
+      TrackPredictorMode m_predictor;   //!< How the next tree of the track is predicted.
+      std::size_t m_fitPoints;          //!< Number of trees used to fit the track line (TRACK_PREDICTOR_LINE_FIT).
+      std::size_t m_batchSteps;         //!< Number of steps searched by one index query (1 searches each step).
+      double m_minDirectionConfidence;  //!< Minimum confidence of a rows direction estimated from the centroids.
+      bool m_hasDirection;              //!< True if m_dirX and m_dirY are the rows direction given by the user.
+      double m_dirX;                    //!< The x component of the user rows direction, used when the estimated direction is not confident.
+      double m_dirY;                    //!< The y component of the user rows direction, used when the estimated direction is not confident.
+    };
+
+    /*!
+      \struct TrackParcel
+
+      \brief A parcel to be classified: its geometry, the rows direction and the roots of its tracks.
+    */
+    struct GEOPXTOOLSEXPORT TrackParcel
+    {
+      TrackParcel();
+
+      int m_id;                                     //!< The parcel id.
+      std::shared_ptr<const te::gm::Geometry> m_geom;   //!< The parcel geometry (in the centroid index SRID), shared with the parcel cache.
+      bool m_hasDirection;                          //!< False if the direction must be estimated from the parcel centroids.
+      double m_dirX;                                //!< The x component of the rows direction.
+      double m_dirY;                                //!< The y component of the rows direction.
+      std::vector<std::size_t> m_roots;             //!< Index positions of the track roots, in processing order.
+    };
+
+    /*!
+      \struct CreatedTree
+
+      \brief A tree created where the track did not find a centroid.
+    */
+    struct GEOPXTOOLSEXPORT CreatedTree
+    {
+      double m_x;
+      double m_y;
+      unsigned char m_type;                         //!< CLASSIFICATION_LIVE or CLASSIFICATION_DEAD (from the NDVI value).
+    };
+
+    /*!
+      \struct TrackResult
+
+      \brief The classification produced by one track.
+    */
+    struct GEOPXTOOLSEXPORT TrackResult
+    {
+      int m_parcelId;
+      std::vector<std::size_t> m_live;              //!< Index positions of the centroids of the track.
+      std::vector<std::size_t> m_intruders;         //!< Index positions of the other centroids inside the track buffer.
+      std::vector<std::size_t> m_removed;           //!< Index positions of the dead centroids inside the buffer of a dead track.
+      std::vector<CreatedTree> m_created;           //!< The trees created by the track.
+    };
+
+    /*!
+      \class TrackEngine
+
+      \brief Follows the plantation rows from root centroids and classifies the centroids of
+             each track, using only the in-memory centroid index, the classification cache and
+             the NDVI sampler.
+
+      The engine does not change the index nor the cache: the classification made by the
+      tracks of a parcel is kept in a local overlay while the parcel is processed. Parcels
+      never share centroids, so different parcels can be classified concurrently with the
+      same engine.
+    */
+    class GEOPXTOOLSEXPORT TrackEngine
+    {
+      public:
+
+        /*!
+          \param centroidIndex  The centroid index.
+          \param classCache     The classification of the centroids (index positions).
+          \param sampler        The NDVI sampler, must accept calls from more than one thread.
+          \param params         The classification parameters.
+        */
+        TrackEngine(const SpatialIndex& centroidIndex, const ClassificationCache& classCache, NdviSampler* sampler, const TrackParameters& params);
+
+        ~TrackEngine();
+
+      public:
+
+        /*!
+          \brief Classifies the tracks that start at the roots of the parcel.
+
+          \param parcel   The parcel.
+          \param results  Output, one result for each track created (tracks with less than two trees are dropped).
+        */
+        void classifyParcel(const TrackParcel& parcel, std::vector<TrackResult>& results) const;
+
+        /*!
+          \brief Classifies the track that starts at one root of the parcel (the roots of the parcel are not used).
+
+          \param parcel   The parcel.
+          \param rootPos  The index position of the root.
+          \param result   Output, the track result.
+
+          \return False if the track was dropped (unknown direction or less than two trees).
+        */
+        bool classifyRoot(const TrackParcel& parcel, std::size_t rootPos, TrackResult& result) const;
+
+        /*!
+          \brief Classifies a dead track: the track walks from the first to the last point of a
+                 segment, each tree found is moved back to the segment line and the dead
+                 centroids inside the track buffer are removed.
+
+          The track does not finish after m_maxDead dead trees nor at the parcel boundary.
+
+          \param parcelId  The id of the parcel of the track (origin id of the created trees).
+          \param x0       The x coordinate of the first point.
+          \param y0       The y coordinate of the first point.
+          \param x1       The x coordinate of the last point.
+          \param y1       The y coordinate of the last point.
+          \param rootPos  The index position of the centroid at the first point, or null if a tree must be created there.
+          \param result   Output, the track result.
+
+          \return False if the track was dropped (empty segment or less than two trees).
+        */
+        bool classifySegment(int parcelId, double x0, double y0, double x1, double y1, const std::size_t* rootPos, TrackResult& result) const;
+
+      protected:
+
+        typedef std::map<std::size_t, unsigned char> TypeOverlay;
+
+        /*!
+          \brief The centroids of the corridor of the next steps, read by one index query.
+
+          The corridor of each step is filtered from these centroids while it is covered by
+          the batch corridor, so the results are the same of a query for each step.
+        */
+        struct CorridorBatch
+        {
+          std::unique_ptr<TrackCorridor> m_corridor;    //!< The corridor of the batch, null if there is no batch.
+          std::vector<std::size_t> m_items;             //!< Index positions of the centroids inside the batch corridor (ascending).
+        };
+
+        unsigned char getType(const TypeOverlay& overlay, std::size_t pos) const;
+
+        /*!
+          \brief Gets the rows step of the parcel, returns false if the direction is unknown.
+
+          A parcel without direction gets the direction and the tree spacing estimated from its
+          centroids, or the user direction when the estimate is not confident.
+        */
+        bool getStep(const TrackParcel& parcel, std::size_t rootPos, double& dx, double& dy) const;
+
+        bool classifyTrack(const TrackParcel& parcel, std::size_t rootPos, double stepX, double stepY, TypeOverlay& overlay, TrackResult& result) const;
+
+        /*!
+          \brief Fits a line to the last trees of the track (orthogonal least squares).
+
+          \param points The last trees.
+          \param dx     Input, the current step; output, the step along the fitted line (same length and orientation).
+          \param dy     Input, the current step; output, the step along the fitted line (same length and orientation).
+          \param rootX  Input, the last tree; output, the last tree projected on the fitted line.
+          \param rootY  Input, the last tree; output, the last tree projected on the fitted line.
+
+          \return False if the trees do not define a line (the inputs are not changed).
+        */
+        bool fitLine(const std::deque<std::pair<double, double> >& points, double& dx, double& dy, double& rootX, double& rootY) const;
+
+        /*!
+          \brief Searches the centroids inside the corridor of a step (a segment buffer with butt caps).
+
+          If the step is not covered by the batch, a new batch from the step to m_batchSteps
+          steps ahead (with twice the corridor width) is read from the index.
+
+          \param x0         The x coordinate of the first point of the step corridor.
+          \param y0         The y coordinate of the first point of the step corridor.
+          \param x1         The x coordinate of the last point of the step corridor.
+          \param y1         The y coordinate of the last point of the step corridor.
+          \param halfWidth  The buffer distance.
+          \param dx         The step.
+          \param dy         The step.
+          \param batch      The current batch.
+          \param corridor   Output, the index positions of the centroids inside the step corridor (ascending).
+        */
+        void searchStep(double x0, double y0, double x1, double y1, double halfWidth, double dx, double dy,
+                        CorridorBatch& batch, std::vector<std::size_t>& corridor) const;
+
+        /*!
+          \brief Finds the centroid nearest to the guess point.
+
+          \return False if the corridor has a classified centroid (the track side must finish).
+        */
+        bool getCandidate(const TypeOverlay& overlay, double rootX, double rootY, double guessX, double guessY,
+                          const std::vector<std::size_t>& corridor, bool& found, std::size_t& candidatePos) const;
+
+        /*! \brief Finds the centroid nearest to the guess point, the dead and removed centroids are skipped. */
+        bool getSegmentCandidate(double rootX, double rootY, double guessX, double guessY,
+                                 const std::vector<std::size_t>& corridor, std::size_t& candidatePos) const;
+
+        /*! \brief Creates a tree at the location, its type comes from the NDVI value. */
+        void createTree(double x, double y, unsigned int& deadCount, TrackResult& result) const;
+
+      protected:
+
+        const SpatialIndex& m_centroidIndex;          //!< The centroid index.
+        const ClassificationCache& m_classCache;      //!< The classification of the centroids.
+        NdviSampler* m_sampler;                       //!< The NDVI sampler.
+        TrackParameters m_params;                     //!< The classification parameters.
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKENGINE_H
@@ -0,0 +1,113 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackParcels.cpp
+
+  \brief This file contains functions used to read the parcels and the rows direction used by the track classifiers.
+*/
+
+#include "TrackParcels.h"
+#include "ClassificationCache.h"
+#include "ParcelCache.h"
+#include "SpatialIndex.h"
+
+// TerraLib
+#include <terralib/geometry/Envelope.h>
+#include <terralib/geometry/Geometry.h>
+#include <terralib/geometry/LineString.h>
+#include <terralib/geometry/Point.h>
+
+//STL Includes
+#include <algorithm>
+#include <memory>
+
+bool geopx::tools::GetParcelDirection(const te::gm::Geometry* parcelGeom, te::map::AbstractLayerPtr dirLayer, const SpatialIndex& angleIndex,
+                                      int srid, double& dirX, double& dirY)
+{
+  if(!dirLayer.get())
+    return false;
+
+  int dirSrid = dirLayer->getSRID();
+
+  std::unique_ptr<te::gm::Geometry> dirParcelGeom(dynamic_cast<te::gm::Geometry*>(parcelGeom->clone()));
+
+  if(dirParcelGeom->getSRID() != dirSrid)
+    dirParcelGeom->transform(dirSrid);
+
+  std::vector<std::size_t> results;
+
+  angleIndex.search(*dirParcelGeom->getMBR(), results);
+
+  for(std::size_t t = 0; t < results.size(); ++t)
+  {
+    te::gm::LineString line(2, te::gm::LineStringType, dirSrid);
+    line.setPoint(0, angleIndex.getX(results[t]), angleIndex.getY(results[t]));
+    line.setPoint(1, angleIndex.getX1(results[t]), angleIndex.getY1(results[t]));
+
+    if(!dirParcelGeom->contains(&line))
+      continue;
+
+    te::gm::Point first(angleIndex.getX(results[t]), angleIndex.getY(results[t]), dirSrid);
+    te::gm::Point last(angleIndex.getX1(results[t]), angleIndex.getY1(results[t]), dirSrid);
+
+    if(first.getSRID() != srid)
+      first.transform(srid);
+
+    if(last.getSRID() != srid)
+      last.transform(srid);
+
+    dirX = last.getX() - first.getX();
+    dirY = last.getY() - first.getY();
+
+    return true;
+  }
+
+  return false;
+}
+
+void geopx::tools::GetTrackParcels(const ParcelCache& parcelCache, const SpatialIndex& centroidIndex, const ClassificationCache& classCache,
+                                   te::map::AbstractLayerPtr dirLayer, const SpatialIndex& angleIndex, std::vector<TrackParcel>& parcels)
+{
+  int srid = parcelCache.getSRID();
+
+  //each created centroid is the root of a track in the first parcel that covers it
+  std::vector<bool> assigned(centroidIndex.size(), false);
+
+  for(std::size_t pos = 0; pos < parcelCache.size(); ++pos)
+  {
+    TrackParcel parcel;
+
+    parcel.m_id = parcelCache.getId(pos);
+    parcel.m_geom = parcelCache.getGeometry(pos);
+
+    std::vector<std::size_t> results;
+
+    centroidIndex.search(*parcel.m_geom->getMBR(), results);
+
+    for(std::size_t t = 0; t < results.size(); ++t)
+    {
+      if(assigned[results[t]] || classCache.getType(results[t]) != CLASSIFICATION_CREATED)
+        continue;
+
+      te::gm::Point p(centroidIndex.getX(results[t]), centroidIndex.getY(results[t]), srid);
+
+      if(!parcel.m_geom->covers(&p))
+        continue;
+
+      parcel.m_roots.push_back(results[t]);
+
+      assigned[results[t]] = true;
+    }
+
+    if(parcel.m_roots.empty())
+      continue;
+
+    //keep the layer order of the roots
+    std::sort(parcel.m_roots.begin(), parcel.m_roots.end(), [&centroidIndex](std::size_t a, std::size_t b)
+    {
+      return centroidIndex.getId(a) < centroidIndex.getId(b);
+    });
+
+    parcel.m_hasDirection = GetParcelDirection(parcel.m_geom.get(), dirLayer, angleIndex, srid, parcel.m_dirX, parcel.m_dirY);
+
+    parcels.push_back(std::move(parcel));
+  }
+}
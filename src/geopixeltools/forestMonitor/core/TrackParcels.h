@@ -0,0 +1,64 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackParcels.h
+
+  \brief This file contains functions used to read the parcels and the rows direction used by the track classifiers.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKPARCELS_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKPARCELS_H
+
+#include "../../Config.h"
+#include "TrackEngine.h"
+
+// TerraLib
+#include <terralib/maptools/AbstractLayer.h>
+
+//STL Includes
+#include <vector>
+
+namespace te { namespace gm { class Geometry; } }
+
+namespace geopx
+{
+  namespace tools
+  {
+    class ClassificationCache;
+    class ParcelCache;
+    class SpatialIndex;
+
+    /*!
+      \brief Gets the rows direction of a parcel from the first direction line inside it.
+
+      \param parcelGeom  The parcel geometry.
+      \param dirLayer    The direction layer.
+      \param angleIndex  The spatial index of the direction lines (first and second vertices).
+      \param srid        The SRID of the returned direction.
+      \param dirX        Output, the x component of the direction.
+      \param dirY        Output, the y component of the direction.
+
+      \return False if no direction line is inside the parcel.
+    */
+    GEOPXTOOLSEXPORT bool GetParcelDirection(const te::gm::Geometry* parcelGeom, te::map::AbstractLayerPtr dirLayer, const SpatialIndex& angleIndex,
+                                             int srid, double& dirX, double& dirY);
+
+    /*!
+      \brief Gets the parcels that have created centroids, each created centroid is the root of a
+             track in the first parcel that covers it.
+
+      The roots of each parcel keep the layer order. Parcels without a direction line are returned
+      without direction (the engine estimates it from the parcel centroids).
+
+      \param parcelCache    The parcels (in the SRID of the centroid index).
+      \param centroidIndex  The centroid index.
+      \param classCache     The classification of the centroids.
+      \param dirLayer       The direction layer, may be empty.
+      \param angleIndex     The spatial index of the direction lines.
+      \param parcels        Output, the parcels in the layer order.
+    */
+    GEOPXTOOLSEXPORT void GetTrackParcels(const ParcelCache& parcelCache, const SpatialIndex& centroidIndex, const ClassificationCache& classCache,
+                                          te::map::AbstractLayerPtr dirLayer, const SpatialIndex& angleIndex, std::vector<TrackParcel>& parcels);
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKPARCELS_H
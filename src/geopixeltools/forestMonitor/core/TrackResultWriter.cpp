@@ -0,0 +1,257 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackResultWriter.cpp
+
+  \brief This file contains a class used to write the track results of the track engine into the classified layer.
+*/
+
+#include "TrackResultWriter.h"
+#include "ClassificationCache.h"
+#include "SpatialIndex.h"
+#include "TrackEngine.h"
+
+//TerraLib Includes
+#include <terralib/dataaccess/dataset/DataSetType.h>
+#include <terralib/dataaccess/dataset/PrimaryKey.h>
+#include <terralib/dataaccess/query_h.h>
+#include <terralib/dataaccess/utils/Utils.h>
+#include <terralib/datatype/SimpleProperty.h>
+#include <terralib/datatype/StringProperty.h>
+#include <terralib/geometry/GeometryProperty.h>
+#include <terralib/geometry/Point.h>
+#include <terralib/memory/DataSet.h>
+#include <terralib/memory/DataSetItem.h>
+
+//STL Includes
+#include <cstdlib>
+
+geopx::tools::TrackResultWriter::TrackResultWriter(te::da::DataSourcePtr ds, const te::da::DataSetType* dsType, const SpatialIndex& centroidIndex, int srid, int firstId,
+                                                   std::size_t batchSize) :
+  m_ds(ds),
+  m_centroidIndex(centroidIndex),
+  m_srid(srid),
+  m_firstId(firstId),
+  m_nextId(firstId),
+  m_dsType(dynamic_cast<te::da::DataSetType*>(dsType->clone())),
+  m_treeDsType(CreateTreeDataSetType(dsType->getName(), srid))
+{
+  m_typePos = te::da::GetPropertyPos(m_dsType.get(), "type");
+
+  m_batch.reset(new TrackWriteBatch(ds, m_dsType.get(), m_treeDsType.get(), batchSize));
+
+  m_pending.reset(new te::mem::DataSet(m_treeDsType.get()));
+  m_created.reset(new te::mem::DataSet(m_treeDsType.get()));
+}
+
+geopx::tools::TrackResultWriter::~TrackResultWriter()
+{
+}
+
+std::unique_ptr<te::da::DataSetType> geopx::tools::TrackResultWriter::CreateTreeDataSetType(const std::string& name, int srid)
+{
+  //create dataset type
+  std::unique_ptr<te::da::DataSetType> dataSetType(new te::da::DataSetType(name));
+
+  //create id property
+  te::dt::SimpleProperty* idProperty = new te::dt::SimpleProperty("id", te::dt::INT32_TYPE);
+  dataSetType->add(idProperty);
+
+  //create origin id property
+  te::dt::SimpleProperty* originIdProperty = new te::dt::SimpleProperty("originId", te::dt::INT32_TYPE);
+  dataSetType->add(originIdProperty);
+
+  //create area property
+  te::dt::SimpleProperty* areaProperty = new te::dt::SimpleProperty("area", te::dt::DOUBLE_TYPE);
+  dataSetType->add(areaProperty);
+
+  //create forest type
+  te::dt::StringProperty* typeProperty = new te::dt::StringProperty("type");
+  dataSetType->add(typeProperty);
+
+  //create geometry property
+  te::gm::GeometryProperty* geomProperty = new te::gm::GeometryProperty("geom", srid, te::gm::PointType);
+  dataSetType->add(geomProperty);
+
+  return dataSetType;
+}
+
+void geopx::tools::TrackResultWriter::GetTypes(const TrackResult& result, std::vector<std::pair<std::size_t, unsigned char> >& types)
+{
+  for(std::size_t t = 0; t < result.m_live.size(); ++t)
+    types.push_back(std::make_pair(result.m_live[t], static_cast<unsigned char>(CLASSIFICATION_LIVE)));
+
+  for(std::size_t t = 0; t < result.m_intruders.size(); ++t)
+    types.push_back(std::make_pair(result.m_intruders[t], static_cast<unsigned char>(CLASSIFICATION_INTRUDER)));
+
+  for(std::size_t t = 0; t < result.m_removed.size(); ++t)
+    types.push_back(std::make_pair(result.m_removed[t], static_cast<unsigned char>(CLASSIFICATION_REMOVED)));
+}
+
+void geopx::tools::TrackResultWriter::add(const TrackResult& result)
+{
+  std::vector<std::pair<std::size_t, unsigned char> > types;
+
+  GetTypes(result, types);
+
+  //only the key (FID) and the type are written by the update
+  if(!types.empty())
+  {
+    te::mem::DataSet classDS(m_dsType.get());
+
+    for(std::size_t t = 0; t < types.size(); ++t)
+    {
+      te::mem::DataSetItem* item = new te::mem::DataSetItem(&classDS);
+
+      //fid
+      item->setInt32(0, m_centroidIndex.getId(types[t].first));
+
+      //forest type
+      item->setString(m_typePos, ClassificationCache::GetTypeName(types[t].second));
+
+      classDS.add(item);
+    }
+
+    m_batch->addUpdates(&classDS);
+
+    m_pendingTypes.insert(m_pendingTypes.end(), types.begin(), types.end());
+  }
+
+  if(result.m_created.empty())
+    return;
+
+  te::mem::DataSet treeDS(m_treeDsType.get());
+
+  for(std::size_t t = 0; t < result.m_created.size(); ++t)
+  {
+    te::mem::DataSetItem* item = new te::mem::DataSetItem(&treeDS);
+
+    //set id
+    item->setInt32(0, m_nextId);
+
+    //set origin id
+    item->setInt32(1, result.m_parcelId);
+
+    //set area
+    item->setDouble(2, 0.);
+
+    //forest type
+    item->setString(3, ClassificationCache::GetTypeName(result.m_created[t].m_type));
+
+    //set geometry
+    item->setGeometry(4, new te::gm::Point(result.m_created[t].m_x, result.m_created[t].m_y, m_srid));
+
+    treeDS.add(item);
+
+    ++m_nextId;
+  }
+
+  m_batch->addInserts(&treeDS);
+
+  treeDS.moveBeforeFirst();
+
+  m_pending->copy(treeDS);
+}
+
+bool geopx::tools::TrackResultWriter::endTrack()
+{
+  if(!m_batch->endTrack())
+    return false;
+
+  commitPending();
+
+  return true;
+}
+
+void geopx::tools::TrackResultWriter::flush()
+{
+  try
+  {
+    m_batch->flush();
+  }
+  catch(...)
+  {
+    m_pendingTypes.clear();
+    m_pending->clear();
+
+    throw;
+  }
+
+  commitPending();
+}
+
+void geopx::tools::TrackResultWriter::discard()
+{
+  m_batch->discard();
+
+  m_pendingTypes.clear();
+  m_pending->clear();
+}
+
+const std::vector<std::pair<std::size_t, unsigned char> >& geopx::tools::TrackResultWriter::getCommittedTypes() const
+{
+  return m_committedTypes;
+}
+
+te::mem::DataSet* geopx::tools::TrackResultWriter::getCreated() const
+{
+  return m_created.get();
+}
+
+int geopx::tools::TrackResultWriter::getNextId() const
+{
+  return m_nextId;
+}
+
+void geopx::tools::TrackResultWriter::getCreatedKeys(std::map<int, int>& keys) const
+{
+  keys.clear();
+
+  if(m_created->isEmpty())
+    return;
+
+  te::da::PrimaryKey* pk = m_dsType->getPrimaryKey();
+
+  std::string pkName = pk->getProperties()[0]->getName();
+
+  //select pk, id from dataset where id >= firstId and id < nextId
+  te::da::Fields* fields = new te::da::Fields;
+  fields->push_back(new te::da::Field(pkName));
+  fields->push_back(new te::da::Field("id"));
+
+  te::da::From* from = new te::da::From;
+  from->push_back(new te::da::DataSetName(m_dsType->getName()));
+
+  te::da::Expression* first = new te::da::GreaterThanOrEqualTo(new te::da::PropertyName("id"), new te::da::LiteralInt32(m_firstId));
+  te::da::Expression* next = new te::da::LessThan(new te::da::PropertyName("id"), new te::da::LiteralInt32(m_nextId));
+
+  te::da::Select select(fields, from, new te::da::Where(new te::da::And(first, next)));
+
+  std::unique_ptr<te::da::DataSet> ds = m_ds->query(select);
+
+  //the values are read as strings, the key type depends on the data source (see CreateDataSetIndex)
+  while(ds->moveNext())
+  {
+    if(ds->isNull(0) || ds->isNull(1))
+      continue;
+
+    int key = atoi(ds->getAsString(0).c_str());
+
+    std::size_t pos;
+
+    if(m_centroidIndex.find(key, pos))
+      continue;
+
+    keys[atoi(ds->getAsString(1).c_str())] = key;
+  }
+}
+
+void geopx::tools::TrackResultWriter::commitPending()
+{
+  m_committedTypes.insert(m_committedTypes.end(), m_pendingTypes.begin(), m_pendingTypes.end());
+  m_pendingTypes.clear();
+
+  m_pending->moveBeforeFirst();
+
+  m_created->copy(*m_pending);
+
+  m_pending->clear();
+}
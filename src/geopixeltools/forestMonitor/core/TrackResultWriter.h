@@ -0,0 +1,132 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackResultWriter.h
+
+  \brief This file contains a class used to write the track results of the track engine into the classified layer.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKRESULTWRITER_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKRESULTWRITER_H
+
+#include "../../Config.h"
+#include "TrackWriteBatch.h"
+
+//TerraLib Includes
+#include <terralib/dataaccess/datasource/DataSource.h>
+
+//STL Includes
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace te
+{
+  namespace da { class DataSetType; }
+  namespace mem { class DataSet; }
+}
+
+namespace geopx
+{
+  namespace tools
+  {
+    class SpatialIndex;
+    struct TrackResult;
+
+    /*!
+      \class TrackResultWriter
+
+      \brief Writes the track results with a TrackWriteBatch: the type of the classified
+             centroids is updated and the created trees are inserted with new ids.
+
+      The type changes and the created trees of the written batches are kept, so the caller
+      can update the classification cache and the centroid index after the run. The created
+      trees are indexed by the primary key values assigned by the data source, read back
+      with getCreatedKeys().
+    */
+    class GEOPXTOOLSEXPORT TrackResultWriter
+    {
+      public:
+
+        /*!
+          \param ds             The data source of the classified layer.
+          \param dsType         The classified layer schema.
+          \param centroidIndex  The centroid index (the ids are the primary key values).
+          \param srid           The SRID of the created trees.
+          \param firstId        The id of the first created tree.
+          \param batchSize      Number of tracks written in each transaction.
+        */
+        TrackResultWriter(te::da::DataSourcePtr ds, const te::da::DataSetType* dsType, const SpatialIndex& centroidIndex, int srid, int firstId,
+                          std::size_t batchSize = TRACK_WRITE_BATCH_TRACKS);
+
+        ~TrackResultWriter();
+
+      public:
+
+        /*! \brief Creates the dataset type of the created trees (id, originId, area, type and geom). */
+        static std::unique_ptr<te::da::DataSetType> CreateTreeDataSetType(const std::string& name, int srid);
+
+        /*! \brief Gets the type changes of a track result (index position and new type). */
+        static void GetTypes(const TrackResult& result, std::vector<std::pair<std::size_t, unsigned char> >& types);
+
+        /*! \brief Adds the classification of a track. */
+        void add(const TrackResult& result);
+
+        /*! \brief Finishes a track, returns true if the batch was written. */
+        bool endTrack();
+
+        /*! \brief Writes the pending tracks. Rolls back, drops them and throws on error. */
+        void flush();
+
+        /*! \brief Drops the tracks not written yet. */
+        void discard();
+
+        /*! \brief Returns the type changes of the written tracks. */
+        const std::vector<std::pair<std::size_t, unsigned char> >& getCommittedTypes() const;
+
+        /*! \brief Returns the trees created by the written tracks (items of the tree dataset type). */
+        te::mem::DataSet* getCreated() const;
+
+        /*! \brief Returns the id of the next created tree. */
+        int getNextId() const;
+
+        /*!
+          \brief Reads the primary key values the data source assigned to the written trees.
+
+          The rows are queried by the range of their id attribute, the rows whose key is
+          already in the centroid index (trees of previous runs with the same ids) are skipped.
+
+          \param keys  Filled with the id attribute of each created tree and its key value.
+        */
+        void getCreatedKeys(std::map<int, int>& keys) const;
+
+      protected:
+
+        /*! \brief Moves the pending changes to the written ones. */
+        void commitPending();
+
+      protected:
+
+        te::da::DataSourcePtr m_ds;                                                 //!< The data source of the classified layer.
+        const SpatialIndex& m_centroidIndex;                                        //!< The centroid index.
+        int m_srid;                                                                 //!< The SRID of the created trees.
+        int m_firstId;                                                              //!< The id of the first created tree.
+        int m_nextId;                                                               //!< The id of the next created tree.
+
+        std::unique_ptr<te::da::DataSetType> m_dsType;                              //!< The classified layer schema.
+        std::unique_ptr<te::da::DataSetType> m_treeDsType;                          //!< The dataset type of the created trees.
+        std::size_t m_typePos;                                                      //!< Position of the type property.
+
+        std::unique_ptr<TrackWriteBatch> m_batch;                                   //!< The batch writer.
+
+        std::vector<std::pair<std::size_t, unsigned char> > m_pendingTypes;         //!< Type changes of the tracks not written yet.
+        std::vector<std::pair<std::size_t, unsigned char> > m_committedTypes;       //!< Type changes of the written tracks.
+
+        std::unique_ptr<te::mem::DataSet> m_pending;                                //!< Trees created by the tracks not written yet.
+        std::unique_ptr<te::mem::DataSet> m_created;                                //!< Trees created by the written tracks.
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKRESULTWRITER_H
@@ -0,0 +1,15 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackSink.cpp
+
+  \brief This file contains the interface used by the track builder to output the tracks.
+*/
+
+#include "TrackSink.h"
+
+geopx::tools::TrackSink::TrackSink()
+{
+}
+
+geopx::tools::TrackSink::~TrackSink()
+{
+}
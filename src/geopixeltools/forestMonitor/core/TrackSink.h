@@ -0,0 +1,54 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackSink.h
+
+  \brief This file contains the interface used by the track builder to output the tracks.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKSINK_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKSINK_H
+
+#include "../../Config.h"
+
+namespace te
+{
+  namespace gm { class LineString; }
+}
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \class TrackSink
+
+      \brief The destination of the tracks created by the track builder.
+
+      \note Implementations must accept add() calls from more than one thread.
+    */
+    class GEOPXTOOLSEXPORT TrackSink
+    {
+      public:
+
+        TrackSink();
+
+        virtual ~TrackSink();
+
+      public:
+
+        /*!
+          \brief Adds a track.
+
+          \param trackId   The track id.
+          \param parcelId  The id of the parcel that contains the track.
+          \param line      The track line. The sink takes its ownership.
+        */
+        virtual void add(int trackId, int parcelId, te::gm::LineString* line) = 0;
+
+        /*! \brief Waits until all tracks added are stored. */
+        virtual void flush() = 0;
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKSINK_H
@@ -0,0 +1,136 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackWriteBatch.cpp
+
+  \brief This file contains a class used to write the classification of many tracks in one transaction.
+*/
+
+#include "TrackWriteBatch.h"
+
+//TerraLib Includes
+#include <terralib/dataaccess/dataset/DataSetType.h>
+#include <terralib/dataaccess/datasource/DataSourceTransactor.h>
+#include <terralib/dataaccess/utils/Utils.h>
+#include <terralib/memory/DataSet.h>
+
+//STL Includes
+#include <cassert>
+#include <map>
+#include <set>
+#include <vector>
+
+geopx::tools::TrackWriteBatch::TrackWriteBatch(te::da::DataSourcePtr ds, const te::da::DataSetType* dsType, const te::da::DataSetType* insertType,
+                                               std::size_t batchSize) :
+  m_ds(ds),
+  m_dataSetName(dsType->getName()),
+  m_typePos(te::da::GetPropertyPos(dsType, "type")),
+  m_updates(new te::mem::DataSet(dsType)),
+  m_inserts(new te::mem::DataSet(insertType)),
+  m_batchSize(batchSize ? batchSize : 1),
+  m_pendingTracks(0)
+{
+  assert(m_ds.get());
+}
+
+geopx::tools::TrackWriteBatch::~TrackWriteBatch()
+{
+}
+
+void geopx::tools::TrackWriteBatch::addUpdates(te::da::DataSet* ds)
+{
+  assert(ds);
+
+  ds->moveBeforeFirst();
+
+  m_updates->copy(*ds);
+}
+
+void geopx::tools::TrackWriteBatch::addInserts(te::da::DataSet* ds)
+{
+  assert(ds);
+
+  ds->moveBeforeFirst();
+
+  m_inserts->copy(*ds);
+}
+
+bool geopx::tools::TrackWriteBatch::endTrack()
+{
+  ++m_pendingTracks;
+
+  if(m_pendingTracks < m_batchSize)
+    return false;
+
+  flush();
+
+  return true;
+}
+
+void geopx::tools::TrackWriteBatch::flush()
+{
+  if(m_updates->isEmpty() && m_inserts->isEmpty())
+  {
+    m_pendingTracks = 0;
+    return;
+  }
+
+  std::unique_ptr<te::da::DataSourceTransactor> transactor = m_ds->getTransactor();
+
+  transactor->begin();
+
+  try
+  {
+    //update the type of all classified items (the first property is the key)
+    if(!m_updates->isEmpty())
+    {
+      std::set<int> setPos;
+      setPos.insert(static_cast<int>(m_typePos));
+
+      std::vector< std::set<int> > properties(m_updates->size(), setPos);
+
+      std::vector<std::size_t> ids;
+      ids.push_back(0);
+
+      m_updates->moveBeforeFirst();
+
+      transactor->update(m_dataSetName, m_updates.get(), properties, ids);
+    }
+
+    //insert the new items
+    if(!m_inserts->isEmpty())
+    {
+      std::map<std::string, std::string> options;
+
+      m_inserts->moveBeforeFirst();
+
+      transactor->add(m_dataSetName, m_inserts.get(), options);
+    }
+
+    transactor->commit();
+  }
+  catch(...)
+  {
+    transactor->rollBack();
+
+    discard();
+
+    throw;
+  }
+
+  m_updates->clear();
+  m_inserts->clear();
+
+  m_pendingTracks = 0;
+}
+
+void geopx::tools::TrackWriteBatch::discard()
+{
+  m_updates->clear();
+  m_inserts->clear();
+
+  m_pendingTracks = 0;
+}
+
+std::size_t geopx::tools::TrackWriteBatch::getPendingTracks() const
+{
+  return m_pendingTracks;
+}
@@ -0,0 +1,92 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/core/TrackWriteBatch.h
+
+  \brief This file contains a class used to write the classification of many tracks in one transaction.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKWRITEBATCH_H
+#define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKWRITEBATCH_H
+
+#include "../../Config.h"
+
+//TerraLib Includes
+#include <terralib/dataaccess/datasource/DataSource.h>
+
+//STL Includes
+#include <memory>
+#include <string>
+
+#define TRACK_WRITE_BATCH_TRACKS 100
+
+namespace te
+{
+  namespace da { class DataSet; class DataSetType; }
+  namespace mem { class DataSet; }
+}
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \class TrackWriteBatch
+
+      \brief Accumulates the type updates and the new trees of several tracks and writes them
+             with one update and one insert call inside a single transaction.
+
+      The tools call addUpdates() and addInserts() for each track and endTrack() after it,
+      the batch is written every time the number of tracks reaches the batch size. discard()
+      drops the tracks not written yet (used when the operation is canceled).
+    */
+    class GEOPXTOOLSEXPORT TrackWriteBatch
+    {
+      public:
+
+        /*!
+          \param ds           The data source of the classified layer.
+          \param dsType       The classified layer schema, the first property is the primary key and the updated property is "type".
+          \param insertType   The dataset type used by the inserted items.
+          \param batchSize    Number of tracks written in each transaction.
+        */
+        TrackWriteBatch(te::da::DataSourcePtr ds, const te::da::DataSetType* dsType, const te::da::DataSetType* insertType,
+                        std::size_t batchSize = TRACK_WRITE_BATCH_TRACKS);
+
+        ~TrackWriteBatch();
+
+      public:
+
+        /*! \brief Adds the items whose type must be updated (items of the layer schema). */
+        void addUpdates(te::da::DataSet* ds);
+
+        /*! \brief Adds new items (items of the insert dataset type). */
+        void addInserts(te::da::DataSet* ds);
+
+        /*! \brief Finishes a track, returns true if the batch was written. */
+        bool endTrack();
+
+        /*! \brief Writes the pending items in one transaction. Rolls back and throws on error. */
+        void flush();
+
+        /*! \brief Drops the pending items. */
+        void discard();
+
+        /*! \brief Returns the number of tracks not written yet. */
+        std::size_t getPendingTracks() const;
+
+      protected:
+
+        te::da::DataSourcePtr m_ds;                       //!< The data source of the classified layer.
+        std::string m_dataSetName;                        //!< The classified dataset name.
+        std::size_t m_typePos;                            //!< Position of the type property.
+
+        std::unique_ptr<te::mem::DataSet> m_updates;      //!< Items with the new type values.
+        std::unique_ptr<te::mem::DataSet> m_inserts;      //!< New items.
+
+        std::size_t m_batchSize;
+        std::size_t m_pendingTracks;
+    };
+
+  }  // end namespace tools
+}  // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKWRITEBATCH_H
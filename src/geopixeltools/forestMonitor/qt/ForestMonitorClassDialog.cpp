@@ -546,137 +546,12 @@ void geopx::tools::ForestMonitorClassDialog::onOkPushButtonClicked()
 
   try
   {
-    std::map<std::string, std::string> rInfo;
-    //rInfo["FORCE_MEM_DRIVER"] = "TRUE";
-
-    //std::string type = "MEM";
-    std::string type = "GDAL";
-
     std::vector<geopx::tools::CentroidInfo*> centroidsVec;
 
-    std::unique_ptr<te::da::DataSet> dataSet = vecLayer->getData();
-    std::unique_ptr<te::da::DataSetType> dataSetType = vecLayer->getSchema();
-
-    std::size_t gpos = te::da::GetFirstPropertyPos(dataSet.get(), te::dt::GEOMETRY_TYPE);
-    te::gm::GeometryProperty* geomProp = te::da::GetFirstGeomProperty(dataSetType.get());
-
-    bool remap = false;
-
-    if (vecLayer->getSRID() != ndviRst->getSRID())
-      remap = true;
-
-    te::da::PrimaryKey* pk = dataSetType->getPrimaryKey();
-    std::string name = pk->getProperties()[0]->getName();
-
-    std::size_t size = dataSet->size();
-
-    dataSet->moveBeforeFirst();
-
-    te::common::TaskProgress task("Associating Centroids");
-    task.setTotalSteps(size);
-
     std::vector<te::gm::Geometry*> fullGeomVec;
 
-    //get geometries
-    while (dataSet->moveNext())
-    {
-      if (!task.isActive())
-      {
-        break;
-      }
-
-      std::unique_ptr<te::gm::Geometry> g(dataSet->getGeometry(gpos));
-
-      if (!g->isValid())
-      {
-        continue;
-      }
-
-      g->setSRID(vecLayer->getSRID());
-
-      if (remap)
-        g->transform(ndviRst->getSRID());
-
-      int parcelId = dataSet->getInt32(name);
-
-      te::gm::Polygon* poly = 0;
-
-      if (g->getGeomTypeId() == te::gm::MultiPolygonType)
-      {
-        te::gm::MultiPolygon* mPoly = dynamic_cast<te::gm::MultiPolygon*>(g.get());
-
-        poly = dynamic_cast<te::gm::Polygon*>(mPoly->getGeometryN(0));
-      }
-      else if (g->getGeomTypeId() == te::gm::PolygonType)
-      {
-        poly = dynamic_cast<te::gm::Polygon*>(g.get());
-      }
-
-      if (!poly || !poly->isValid())
-        continue;
-
-      //create raster crop from parcel
-      rInfo["URI"] = repName + "_parcel_" + te::common::Convert2String(parcelId) + ".tif";
-      te::rst::RasterPtr parcelRaster(te::rst::CropRaster(*ndviRst.get(), *poly, rInfo, type));
-
-      //create threshold raster
-      rInfo["URI"] = repName + "_threshold_" + te::common::Convert2String(parcelId) + ".tif";
-      std::unique_ptr<te::rst::Raster> outputRaster = GenerateThresholdRaster(parcelRaster.get(), ndviBand, threshold, type, rInfo);
-
-      //create erosion raster
-      if (dilation > 0)
-      {
-        rInfo["URI"] = repName + "_erosion_" + te::common::Convert2String(parcelId) + ".tif";
-        std::unique_ptr<te::rst::Raster> erosionRaster = GenerateFilterRaster(outputRaster.get(), 0, dilation, te::rp::Filter::InputParameters::DilationFilterT, type, rInfo);
-
-        outputRaster.reset(0);
-
-        outputRaster = std::move(erosionRaster);
-      }
-
-      //create dilation raster
-      if (erosion > 0)
-      {
-        rInfo["URI"] = repName + "_dilation_" + te::common::Convert2String(parcelId) + ".tif";
-        std::unique_ptr<te::rst::Raster> dilationRaster = GenerateFilterRaster(outputRaster.get(), 0, erosion, te::rp::Filter::InputParameters::ErosionFilterT, type, rInfo);
-
-        outputRaster.reset(0);
-
-        outputRaster = std::move(dilationRaster);
-      }
-
-      //export image
-      if (m_ui->m_saveResultImageCheckBox->isChecked())
-      {
-        std::string repName = m_ui->m_repositoryLineEdit->text().toStdString();
-
-        std::size_t idx = repName.find(".");
-        if (idx != std::string::npos)
-          repName = repName.substr(0, idx);
-
-        std::string rasterFileName = repName + "_" + te::common::Convert2String(parcelId) + ".tif";
-
-        geopx::tools::ExportRaster(outputRaster.get(), rasterFileName);
-      }
-
-      //create geometries
-      std::vector<te::gm::Geometry*> geomVec = geopx::tools::Raster2Vector(outputRaster.get(), 0);
-
-      outputRaster.reset(0);
-
-      //get centroids
-      geopx::tools::ExtractCentroids(geomVec, centroidsVec, parcelId);
-
-      if (geomVec.size() > 2)
-      {
-        for (std::size_t t = 1; t < geomVec.size(); ++t)
-        {
-          fullGeomVec.push_back(geomVec[t]);
-        }
-      }
-
-      geomVec.clear();
-    }
+    geopx::tools::ClassifyParcels(ndviRst.get(), ndviBand, vecLayer, threshold, dilation, erosion, repName,
+                                  m_ui->m_saveResultImageCheckBox->isChecked(), centroidsVec, fullGeomVec);
 
     //export data
     geopx::tools::ExportVector(centroidsVec, dataSetName, "OGR", outputDataSource->getConnectionInfo(), ndviRst->getSRID());
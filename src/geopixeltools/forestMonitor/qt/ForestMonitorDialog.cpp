@@ -62,6 +62,9 @@ void geopx::tools::ForestMonitorDialog::setLayerList(std::list<te::map::Abstract
   m_ui->m_parceLayerComboBox->clear();
   m_ui->m_angleLayerComboBox->clear();
 
+  //the direction layer is optional, the angle can be estimated from the centroids
+  m_ui->m_angleLayerComboBox->addItem(tr("Estimate from centroids"), QVariant());
+
   //fill combos
   std::list<te::map::AbstractLayerPtr>::iterator it = list.begin();
 
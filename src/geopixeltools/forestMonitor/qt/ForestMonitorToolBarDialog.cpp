@@ -54,6 +54,9 @@ void geopx::tools::ForestMonitorToolBarDialog::setLayerList(std::list<te::map::A
   m_ui->m_layerPolyComboBox->clear();
   m_ui->m_layerDirComboBox->clear();
 
+  //the direction layer is optional, the angle can be estimated from the centroids
+  m_ui->m_layerDirComboBox->addItem(tr("Estimate from centroids"), QVariant());
+
   //fill combos
   std::list<te::map::AbstractLayerPtr>::iterator it = list.begin();
 
@@ -307,6 +310,7 @@ void geopx::tools::ForestMonitorToolBarDialog::onTrackAutoClassifierToolButtonCl
   geopx::tools::TrackAutoClassifier* tool = new geopx::tools::TrackAutoClassifier(m_appDisplay->getDisplay(), Qt::ArrowCursor, layerPoints, layerParcel, layerPoly, layerDir);
   tool->setLineEditComponents(m_ui->m_distLineEdit, m_ui->m_distTrackLineEdit, m_ui->m_distTolLineEdit, m_ui->m_distTrackTolLineEdit,  m_ui->m_polyAreaMinLineEdit, m_ui->m_polyAreaMaxLineEdit, m_ui->m_maxDeadLineEdit, m_ui->m_deadTolLineEdit, m_ui->m_thresholdLineEdit);
   tool->setAdjustTrack(m_ui->m_adaptTrackCheckBox->isChecked(), m_ui->m_adjustTrackSpinBox->value());
+  tool->setFitTrack(m_ui->m_fitTrackCheckBox->isChecked(), m_ui->m_fitTrackSpinBox->value());
   m_appDisplay->getDisplay()->setCurrentTool(tool);
 
   m_clearTool = true;
@@ -5,6 +5,10 @@
 */
 
 #include "TrackAutoClassifier.h"
+#include "../../core/LayerIndex.h"
+#include "../../core/ParallelTrackClassifier.h"
+#include "../../core/TrackParcels.h"
+#include "../../core/TrackResultWriter.h"
 
 // TerraLib
 #include <terralib/common/STLUtils.h>
@@ -44,25 +48,16 @@
 #include <QMouseEvent>
 
 // STL
+#include <algorithm>
 #include <cassert>
 #include <memory>
-
-#define DISTANCE 2.0
-#define DISTANCE_TRACK 3.0
-#define TOLERANCE_FACTOR 0.2
-#define TRACK_TOLERANCE_FACTOR 0.3
-#define POLY_AREA_MIN 0.1
-#define POLY_AREA_MAX 2.0
-#define MAX_DEAD 6
-#define DELTA_TOL 0.1
-#define NDVI_THRESHOLD 120.0
+#include <utility>
 
 geopx::tools::TrackAutoClassifier::TrackAutoClassifier(te::qt::widgets::MapDisplay* display, const QCursor& cursor, te::map::AbstractLayerPtr coordLayer, te::map::AbstractLayerPtr parcelLayer, te::map::AbstractLayerPtr rasterLayer, te::map::AbstractLayerPtr dirLayer, QObject* parent)
   : AbstractTool(display, parent),
   m_coordLayer(coordLayer),
   m_parcelLayer(parcelLayer),
   m_dirLayer(dirLayer),
-  m_track(0),
   m_point0(0),
   m_objId0(0),
   m_point1(0),
@@ -75,15 +70,9 @@ geopx::tools::TrackAutoClassifier::TrackAutoClassifier(te::qt::widgets::MapDispl
   m_distanceTrackLineEdit = 0;
   m_distanceToleranceFactorLineEdit = 0;
 
-  m_dx = 0.;
-  m_dy = 0.;
-  m_distance = DISTANCE;
-
-  m_maxDead = MAX_DEAD;
-  m_deadCount = 0;
-  m_deltaTol = DELTA_TOL;
-
   m_adjustTrack = false;
+  m_fitTrack = false;
+  m_fitTrackPoints = 5;
 
   m_classify = false;
 
@@ -99,27 +88,28 @@ geopx::tools::TrackAutoClassifier::TrackAutoClassifier(te::qt::widgets::MapDispl
   std::unique_ptr<te::da::DataSet> ds = rasterLayer->getData();
 
   m_ndviRaster = ds->getRaster(0).release();
+
+  m_ndviSampler.reset(new geopx::tools::NdviSampler(m_ndviRaster));
+
+  connect(this, SIGNAL(autoClassifyFinished()), this, SLOT(onAutoClassifyFinished()), Qt::QueuedConnection);
 }
 
 geopx::tools::TrackAutoClassifier::~TrackAutoClassifier()
 {
+  //the thread uses the indexes and the sampler
+  if (m_autoThread.joinable())
+    m_autoThread.join();
+
   QPixmap* draft = m_display->getDraftPixmap();
   draft->fill(Qt::transparent);
 
-  m_adjustTrackPoints.clear();
-
-  m_centroidRtree.clear();
-  te::common::FreeContents(m_centroidGeomMap);
-  te::common::FreeContents(m_centroidObjIdMap);
-
-  m_angleRtree.clear();
-  te::common::FreeContents(m_angleGeomMap);
-
   delete m_point0;
   delete m_point1;
 
   delete m_roots;
 
+  m_ndviSampler.reset();
+
   delete m_ndviRaster;
 }
 
@@ -142,6 +132,12 @@ void geopx::tools::TrackAutoClassifier::setAdjustTrack(bool adjust, int nSteps)
   m_adjustTrackSteps = nSteps;
 }
 
+void geopx::tools::TrackAutoClassifier::setFitTrack(bool fit, int nPoints)
+{
+  m_fitTrack = fit;
+  m_fitTrackPoints = nPoints;
+}
+
 bool geopx::tools::TrackAutoClassifier::eventFilter(QObject* watched, QEvent* e)
 {
   if (e->type() == QEvent::MouseButtonRelease)
@@ -152,7 +148,9 @@ bool geopx::tools::TrackAutoClassifier::eventFilter(QObject* watched, QEvent* e)
 
     if (event->button() == Qt::LeftButton)
     {
-      selectObjects(event);
+      //the selection is not changed while the auto classification runs
+      if (!m_autoThread.joinable())
+        selectObjects(event);
 
       return true;
     }
@@ -177,6 +175,10 @@ bool geopx::tools::TrackAutoClassifier::eventFilter(QObject* watched, QEvent* e)
   {
     QKeyEvent* event = static_cast<QKeyEvent*>(e);
 
+    //the classification changes the indexes used by the auto classification thread
+    if (m_autoThread.joinable())
+      return true;
+
     if ((event->key() == Qt::Key_Return || event->key() == Qt::Key_Control) && m_point1 && m_point0)
       classifyObjects();
 
@@ -321,12 +323,111 @@ void geopx::tools::TrackAutoClassifier::classifyObjects()
 
 void geopx::tools::TrackAutoClassifier::autoClassifyObjects()
 {
-  //get restriction
-  te::da::Where* whereClause = getRestriction();
+  te::map::DataSetLayer* dsLayer = dynamic_cast<te::map::DataSetLayer*>(m_coordLayer.get());
+
+  if (!dsLayer || m_autoThread.joinable())
+    return;
+
+  std::unique_ptr<te::da::DataSetType> dsType(m_coordLayer->getSchema());
+
+  te::da::DataSourcePtr dataSource = te::da::GetDataSource(dsLayer->getDataSourceId());
+
+  try
+  {
+    //the roots are the created centroids, grouped by parcel
+    m_autoParcels.clear();
+
+    getParcels(m_autoParcels);
+
+    m_autoEngine.reset(new geopx::tools::TrackEngine(m_centroidIndex, m_classCache, m_ndviSampler.get(), getParameters()));
+
+    m_autoWriter.reset(new geopx::tools::TrackResultWriter(dataSource, dsType.get(), m_centroidIndex, m_coordLayer->getSRID(), m_starterId));
+  }
+  catch (std::exception& e)
+  {
+    m_autoWriter.reset();
+    m_autoEngine.reset();
+    m_autoParcels.clear();
+
+    QMessageBox::critical(m_display, tr("Error"), QString(tr("Error auto classifying track. Details:") + " %1.").arg(e.what()));
+
+    return;
+  }
+
+  m_autoError.clear();
+
+  //the display is kept responsive, the run is canceled by the progress
+  QApplication::setOverrideCursor(Qt::BusyCursor);
+
+  m_autoThread = std::thread([this]()
+  {
+    try
+    {
+      geopx::tools::ParallelTrackClassifier classifier(*m_autoEngine);
+
+      //the parcels are classified by the workers and written here, the cache is updated after the run
+      bool finished = classifier.run(m_autoParcels, [this](const geopx::tools::TrackParcel& parcel, std::vector<geopx::tools::TrackResult>& results)
+      {
+        for (std::size_t t = 0; t < results.size(); ++t)
+        {
+          m_autoWriter->add(results[t]);
+
+          m_autoWriter->endTrack();
+        }
+      });
+
+      //on cancel the tracks not written yet are dropped, the batches already written are kept
+      if (!finished)
+        m_autoWriter->discard();
+
+      m_autoWriter->flush();
+    }
+    catch (std::exception& e)
+    {
+      //a failed flush was rolled back, the tracks of a failed classification not written yet are dropped
+      m_autoWriter->discard();
+
+      m_autoError = e.what();
+    }
+    catch (...)
+    {
+      m_autoWriter->discard();
+
+      m_autoError = "unknown error";
+    }
+
+    emit autoClassifyFinished();
+  });
+}
+
+void geopx::tools::TrackAutoClassifier::onAutoClassifyFinished()
+{
+  if (!m_autoThread.joinable())
+    return;
+
+  m_autoThread.join();
+
+  QApplication::restoreOverrideCursor();
+
+  if (!m_autoError.empty())
+    QMessageBox::critical(m_display, tr("Error"), QString(tr("Error auto classifying track. Details:") + " %1.").arg(m_autoError.c_str()));
+
+  const std::vector<std::pair<std::size_t, unsigned char> >& types = m_autoWriter->getCommittedTypes();
 
-  std::unique_ptr<te::da::DataSet> dsResult = m_coordLayer->getData(whereClause->getExp());
+  for (std::size_t t = 0; t < types.size(); ++t)
+    m_classCache.setType(types[t].first, types[t].second);
 
-  processDataSet(dsResult.get());
+  m_classCache.commit();
+
+  indexCreatedObjects(*m_autoWriter);
+
+  m_starterId = m_autoWriter->getNextId();
+
+  m_classify = true;
+
+  m_autoWriter.reset();
+  m_autoEngine.reset();
+  m_autoParcels.clear();
 
   //repaint the layer
   te::qt::widgets::MultiThreadMapDisplay* mtmp = dynamic_cast<te::qt::widgets::MultiThreadMapDisplay*>(m_display);
@@ -359,12 +460,6 @@ void geopx::tools::TrackAutoClassifier::cancelOperation(bool restart)
 
   delete m_roots;
   m_roots = 0;
-  
-  m_dataSet.reset();
-
-  std::unique_ptr<te::da::DataSetType> schema = m_coordLayer->getSchema();
-
-  te::da::GetEmptyOIDSet(schema.get(), m_track);
 
   //repaint the layer
   m_display->repaint();
@@ -455,1170 +550,279 @@ void geopx::tools::TrackAutoClassifier::drawSelecteds()
   }
 }
 
-te::gm::Geometry* geopx::tools::TrackAutoClassifier::createBuffer(te::gm::Point* rootPoint, te::da::ObjectId* objIdRoot, int srid, std::string gpName, te::gm::LineString*& lineBuffer, std::list<te::gm::Point*>& track)
+void geopx::tools::TrackAutoClassifier::createRTree()
 {
-  std::unique_ptr<te::da::DataSetType> schema = m_coordLayer->getSchema();
+  QApplication::setOverrideCursor(Qt::WaitCursor);
 
-  std::vector<std::string> pnames;
-  te::da::GetOIDPropertyNames(schema.get(), pnames);
+  //the layers are read only if their index snapshots are out of date
+  geopx::tools::CreateLayerIndex(m_coordLayer, m_centroidIndex);
 
-  //get max dead info
-  if (m_maxDeadLineEdit->text().isEmpty())
-  {
-    m_maxDead = MAX_DEAD;
-  }
-  else
-  {
-    m_maxDead = m_maxDeadLineEdit->text().toInt();
-  }
+  if (m_dirLayer.get())
+    geopx::tools::CreateLayerIndex(m_dirLayer, m_angleIndex);
 
-  if (m_deadTolLineEdit->text().isEmpty())
-  {
-    m_deltaTol = DELTA_TOL;
-  }
-  else
-  {
-    m_deltaTol = m_deadTolLineEdit->text().toDouble();
-  }
+  //the classification is read once and kept up to date by processDataSet
+  m_classCache.load(m_coordLayer, m_centroidIndex);
 
-  //get distance buffer info
-  double distanceTrack = 0.;
+  //the parcels are decoded once, in the coord layer SRID
+  if (m_parcelLayer.get())
+    m_parcelCache.load(m_parcelLayer, m_coordLayer->getSRID());
 
-  if (m_distanceTrackLineEdit->text().isEmpty())
-  {
-    distanceTrack = DISTANCE_TRACK;
-  }
-  else
-  {
-    distanceTrack = m_distanceTrackLineEdit->text().toDouble();
-  }
+  QApplication::restoreOverrideCursor();
+}
 
-  double distanceTrackTol = 0.;
+te::gm::Point* geopx::tools::TrackAutoClassifier::getPoint(te::gm::Geometry* g)
+{
+  te::gm::Point* point = 0;
 
-  if (m_distanceTrackToleranceFactorLineEdit->text().isEmpty())
+  if (g->getGeomTypeId() == te::gm::MultiPointType)
   {
-    distanceTrackTol = TRACK_TOLERANCE_FACTOR;
+    te::gm::MultiPoint* mPoint = dynamic_cast<te::gm::MultiPoint*>(g);
+    point = dynamic_cast<te::gm::Point*>(mPoint->getGeometryN(0));
   }
-  else
+  else if (g->getGeomTypeId() == te::gm::PointType)
   {
-    distanceTrackTol = m_distanceTrackToleranceFactorLineEdit->text().toDouble();
+    point = dynamic_cast<te::gm::Point*>(g);
   }
 
-  //get parcel geom
-  int parcelId;
-  std::unique_ptr<te::gm::Geometry> parcelGeom = getParcelGeeom(rootPoint, parcelId);
-
-  if (!parcelGeom.get())
-    return 0;
-
-  parcelGeom->setSRID(srid);
+  return point;
+}
 
-  te::da::GetEmptyOIDSet(schema.get(), m_track);
+void geopx::tools::TrackAutoClassifier::getStartIdValue()
+{
+  if (!m_coordLayer.get())
+    throw;
 
-  track.push_back(new te::gm::Point(*rootPoint));
+  //the index keeps the primary key values
+  if (m_centroidIndex.getMaxId() > m_starterId)
+    m_starterId = m_centroidIndex.getMaxId();
 
-  te::gm::Point* starter = new te::gm::Point(*rootPoint);
+  ++m_starterId;
+}
 
-  m_track->add(objIdRoot);
+void geopx::tools::TrackAutoClassifier::processDataSet(te::da::DataSet* ds)
+{
+  te::map::DataSetLayer* dsLayer = dynamic_cast<te::map::DataSetLayer*>(m_coordLayer.get());
 
-  bool invert = false;
+  if (!dsLayer)
+    return;
 
   QApplication::setOverrideCursor(Qt::WaitCursor);
 
-  //calculate track info angle
-  if (m_point0 && m_point1)
-  {
-    getTrackInfo(m_point0, m_point1);
-  }
-  else
-  {
-    if (parcelGeom->getSRID() != m_dirLayer->getSRID())
-      parcelGeom->transform(m_dirLayer->getSRID());
-
-    te::gm::Envelope ext(*parcelGeom->getMBR());
-
-    std::vector<int> results;
-
-    m_angleRtree.search(ext, results);
-
-    for (size_t t = 0; t < results.size(); ++t)
-    {
-      std::map<int, te::gm::Geometry*>::iterator it = m_angleGeomMap.find(results[t]);
-
-      if (it != m_angleGeomMap.end())
-      {
-        if (parcelGeom->contains(it->second))
-        {
-          te::gm::MultiLineString* mLine = dynamic_cast<te::gm::MultiLineString*>(it->second);
-
-          if (mLine && mLine->getNumGeometries() != 0)
-          {
-            te::gm::LineString* line = dynamic_cast<te::gm::LineString*>(mLine->getGeometryN(0));
-
-            if (line && line->size() >= 2)
-            {
-              std::unique_ptr<te::gm::Point> first(line->getPointN(0));
-              std::unique_ptr<te::gm::Point> last(line->getPointN(1));
-
-              if (first->getSRID() != m_coordLayer->getSRID())
-                first->transform(m_coordLayer->getSRID());
+  std::unique_ptr<te::da::DataSetType> dsType(m_coordLayer->getSchema());
 
-              if (last->getSRID() != m_coordLayer->getSRID())
-                last->transform(m_coordLayer->getSRID());
+  te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(dsType.get());
 
-              getTrackInfo(first.get(), last.get());
+  std::vector<std::string> pnames;
+  te::da::GetOIDPropertyNames(dsType.get(), pnames);
 
-              break;
-            }
-          }
-        }
-      }
-    }
-  }
-  
+  //the classification of many tracks is written in a single transaction
+  te::da::DataSourcePtr dataSource = te::da::GetDataSource(dsLayer->getDataSourceId());
 
-  double dx = m_dx;
-  double dy = m_dy;
+  geopx::tools::TrackResultWriter writer(dataSource, dsType.get(), m_centroidIndex, m_coordLayer->getSRID(), m_starterId);
 
-  m_deadCount = 0;
+  geopx::tools::TrackEngine engine(m_centroidIndex, m_classCache, m_ndviSampler.get(), getParameters());
 
-  if (parcelGeom->getSRID() != rootPoint->getSRID())
-    parcelGeom->transform(rootPoint->getSRID());
+  m_classCache.commit();
 
-  bool insideParcel = true;
+  te::common::TaskProgress task("Auto Classifier");
+  task.setTotalSteps(ds->size());
 
-  m_adjustTrackPoints.clear();
+  ds->moveBeforeFirst();
 
-  while (insideParcel)
+  while (ds->moveNext())
   {
-    //adjust track
-    if (m_adjustTrack)
-      adjustTrack(rootPoint, dx, dy);
-
-    te::gm::Point* guestPoint = createGuessPoint(rootPoint, dx, dy, srid);
-
-    //create envelope to find if guest point exist
-    //te::gm::Envelope ext(guestPoint->getX(), guestPoint->getY(), guestPoint->getX(), guestPoint->getY());
-
-    double toleranceFactor = 0.;
-
-    if (m_distanceToleranceFactorLineEdit->text().isEmpty())
-    {
-      toleranceFactor = TOLERANCE_FACTOR;
-    }
-    else
-    {
-      toleranceFactor = m_distanceToleranceFactorLineEdit->text().toDouble();
-    }
-
-    //adjust tolerance for dead trees
-    toleranceFactor = toleranceFactor + (m_deadCount * m_deltaTol);
-
-    //ext.m_llx -= (m_distance * toleranceFactor);
-    //ext.m_lly -= (m_distance * toleranceFactor);
-    //ext.m_urx += (m_distance * toleranceFactor);
-    //ext.m_ury += (m_distance * toleranceFactor);
-
-    //filter using a line buffer
-    std::unique_ptr<te::gm::LineString> lineSearchBuffer(new te::gm::LineString(2, te::gm::LineStringType, srid));
-    lineSearchBuffer->setPoint(0, rootPoint->getX() + (dx - (dx*toleranceFactor)), rootPoint->getY() + (dy - (dy*toleranceFactor)));
-    lineSearchBuffer->setPoint(1, rootPoint->getX() + (dx + (dx*toleranceFactor)), rootPoint->getY() + (dy + (dy*toleranceFactor)));
-    te::gm::Geometry* geomLineSearchBuffer = lineSearchBuffer->buffer(distanceTrack * distanceTrackTol, 4, te::gm::CapButtType);
-
-    //check on tree
-    te::gm::Envelope ext(*geomLineSearchBuffer->getMBR());
-
-    std::vector<int> resultsTreeObjs;
-
-    m_centroidRtree.search(ext, resultsTreeObjs);
-
-    std::vector<int> resultsTree;
-
-    for (std::size_t t = 0; t < resultsTreeObjs.size(); ++t)
+    if (!task.isActive())
     {
-      std::map<int, te::gm::Geometry*>::iterator it = m_centroidGeomMap.find(resultsTreeObjs[t]);
+      //the tracks not written yet are dropped
+      writer.discard();
 
-      if (it != m_centroidGeomMap.end())
-      {
-        te::gm::Geometry* g = it->second;
+      m_classCache.rollback();
 
-        if (geomLineSearchBuffer->covers(g))
-        {
-          resultsTree.push_back(resultsTreeObjs[t]);
-        }
-      }
+      break;
     }
 
-    if (resultsTree.empty())
+    try
     {
-      //dead point
-      rootPoint = guestPoint;
+      //the roots are items of the layer, the index keeps the primary key value
+      std::size_t rootPos = 0;
 
-      insideParcel = parcelGeom->covers(rootPoint);
+      std::unique_ptr<te::gm::Geometry> g(ds->getGeometry(gp->getName()));
 
-      if (insideParcel)
+      te::gm::Point* rootPoint = getPoint(g.get());
+
+      if (rootPoint && m_centroidIndex.find(ds->getInt32(pnames[0]), rootPos))
       {
-        te::gm::Point* pGuessCalculated = calculateGuessPoint(rootPoint, parcelId);
+        if (rootPoint->getSRID() == TE_UNKNOWN_SRS)
+          rootPoint->setSRID(m_coordLayer->getSRID());
+
+        std::size_t parcelPos = 0;
 
-        if (pGuessCalculated)
+        if (m_parcelCache.find(rootPoint->getX(), rootPoint->getY(), parcelPos))
         {
-          rootPoint = pGuessCalculated;
+          geopx::tools::TrackParcel parcel;
 
-          if (!invert)
+          parcel.m_id = m_parcelCache.getId(parcelPos);
+          parcel.m_geom = m_parcelCache.getGeometry(parcelPos);
+
+          //rows direction: the track defined by the user, a direction line or (in the engine) the parcel centroids
+          if (m_point0 && m_point1)
           {
-            track.push_back(new te::gm::Point(*rootPoint));
+            parcel.m_hasDirection = true;
+            parcel.m_dirX = m_point1->getX() - m_point0->getX();
+            parcel.m_dirY = m_point1->getY() - m_point0->getY();
           }
           else
           {
-            track.push_front(new te::gm::Point(*rootPoint));
+            parcel.m_hasDirection = geopx::tools::GetParcelDirection(parcel.m_geom.get(), m_dirLayer, m_angleIndex, m_coordLayer->getSRID(), parcel.m_dirX, parcel.m_dirY);
           }
-        }
-      }
-      else
-      {
-        if (!invert)
-        {
-          invert = true;
-          insideParcel = true;
-          dx = m_dx * -1;
-          dy = m_dy * -1;
-          m_adjustTrackPoints.clear();
-          rootPoint = starter;
-          m_deadCount = 0;
-        }
-      }
-
-    }
-    else
-    {
-      //live point
-      te::da::ObjectId* objIdCandidate = 0;
-      bool abort = false;
-      te::gm::Point* pCandidate = getCandidatePoint(rootPoint, guestPoint, srid, resultsTree, objIdCandidate, abort);
-
-      if (abort)
-      {
-        if (!invert)
-        {
-          invert = true;
-          insideParcel = true;
-          dx = m_dx * -1;
-          dy = m_dy * -1;
-          m_adjustTrackPoints.clear();
-          rootPoint = starter;
-          m_deadCount = 0;
-        }
-        else
-        {
-          break;
-        }
-      }
-      else
-      {
-        if (!pCandidate)
-        {
-          te::gm::Point* pGuessCalculated = calculateGuessPoint(guestPoint, parcelId);
 
-          rootPoint = pGuessCalculated;
-        }
-        else
-        {
-          rootPoint = pCandidate;
+          geopx::tools::TrackResult result;
 
-          m_track->add(objIdCandidate);
+          if (engine.classifyRoot(parcel, rootPos, result))
+          {
+            writer.add(result);
 
-          m_deadCount = 0;
-        }
+            //the next roots see the classification of this track
+            std::vector<std::pair<std::size_t, unsigned char> > types;
 
-        insideParcel = parcelGeom->covers(rootPoint);
+            geopx::tools::TrackResultWriter::GetTypes(result, types);
 
-        if (insideParcel)
-        {
-          if (!invert)
-          {
-            track.push_back(new te::gm::Point(*rootPoint));
-          }
-          else
-          {
-            track.push_front(new te::gm::Point(*rootPoint));
-          }
-        }
-        else
-        {
-          if (!invert)
-          {
-            invert = true;
-            insideParcel = true;
-            dx = m_dx * -1;
-            dy = m_dy * -1;
-            m_adjustTrackPoints.clear();
-            rootPoint = starter;
-            m_deadCount = 0;
+            for (std::size_t t = 0; t < types.size(); ++t)
+              m_classCache.setType(types[t].first, types[t].second);
           }
         }
       }
-    }
 
-    if (m_deadCount >= m_maxDead)
-    {
-      if (!invert)
-      {
-        invert = true;
-        insideParcel = true;
-        dx = m_dx * -1;
-        dy = m_dy * -1;
-        m_adjustTrackPoints.clear();
-        rootPoint = starter;
-        m_deadCount = 0;
-      }
-      else
-      {
-        break;
-      }
+      if (writer.endTrack())
+        m_classCache.commit();
     }
-  }
+    catch (std::exception& e)
+    {
+      writer.discard();
 
-  QApplication::restoreOverrideCursor();
+      m_classCache.rollback();
 
-  delete starter;
+      QApplication::restoreOverrideCursor();
 
-  if (track.size() < 2)
-  {
-    return 0;
+      QMessageBox::critical(m_display, tr("Error"), QString(tr("Error auto classifying track. Details:") + " %1.").arg(e.what()));
+      break;
+    }
+
+    task.pulse();
   }
 
-  //create buffer
-  lineBuffer = new te::gm::LineString(track.size(), te::gm::LineStringType, srid);
+  try
+  {
+    writer.flush();
 
-  int count = 0;
-  std::list<te::gm::Point*>::iterator it = track.begin();
-  while (it != track.end())
+    m_classCache.commit();
+  }
+  catch (std::exception& e)
   {
-    lineBuffer->setPoint(count, (*it)->getX(), (*it)->getY());
+    m_classCache.rollback();
 
-    ++count;
-    ++it;
+    QMessageBox::critical(m_display, tr("Error"), QString(tr("Error auto classifying track. Details:") + " %1.").arg(e.what()));
   }
 
-  return lineBuffer->buffer(distanceTrack / 2., 16, te::gm::CapButtType);
+  m_classify = true;
+
+  //the index is updated in place instead of reading the layer again
+  indexCreatedObjects(writer);
+
+  m_starterId = writer.getNextId();
+
+  QApplication::restoreOverrideCursor();
 }
 
-void geopx::tools::TrackAutoClassifier::getTrackInfo(te::gm::Point* point0, te::gm::Point* point1)
+void geopx::tools::TrackAutoClassifier::indexCreatedObjects(const geopx::tools::TrackResultWriter& writer)
 {
-  if (m_distLineEdit->text().isEmpty())
-    m_distance = DISTANCE;
-  else
-    m_distance = m_distLineEdit->text().toDouble();
-  
-  double bigDistance = point0->distance(point1);
+  //the index holds the primary key values, the data source may assign them apart from the id attribute
+  std::map<int, int> keys;
 
-  double big_dx = point1->getX() - point0->getX();
-  double big_dy = point1->getY() - point0->getY();
+  writer.getCreatedKeys(keys);
 
-  m_dx = m_distance * big_dx / bigDistance;
-  m_dy = m_distance * big_dy / bigDistance;
+  te::mem::DataSet* ds = writer.getCreated();
 
-  m_classify = true;
-}
+  ds->moveBeforeFirst();
 
-std::unique_ptr<te::gm::Geometry> geopx::tools::TrackAutoClassifier::getParcelGeeom(te::gm::Geometry* root, int& parcelId)
-{
-  if (!m_parcelLayer.get())
-    throw;
+  while (ds->moveNext())
+  {
+    std::unique_ptr<te::gm::Geometry> g(ds->getGeometry(4));
 
-  // Bulding the query box
-  te::gm::Envelope envelope(*root->getMBR());
+    te::gm::Point* point = getPoint(g.get());
 
-  te::gm::Envelope reprojectedEnvelope(envelope);
+    if (!point)
+      continue;
 
-  if ((root->getSRID() != TE_UNKNOWN_SRS) && (m_parcelLayer->getSRID() != TE_UNKNOWN_SRS) && (root->getSRID() != m_parcelLayer->getSRID()))
-    reprojectedEnvelope.transform(root->getSRID(), m_parcelLayer->getSRID());
+    std::map<int, int>::const_iterator it = keys.find(ds->getInt32(0));
 
-  if (!reprojectedEnvelope.intersects(m_parcelLayer->getExtent()))
-    throw;
+    if (it == keys.end())
+      continue;
 
-  // Gets the layer schema
-  std::unique_ptr<const te::map::LayerSchema> schema(m_parcelLayer->getSchema());
+    std::size_t pos = m_centroidIndex.insert(it->second, point->getX(), point->getY());
 
-  if (!schema->hasGeom())
-    throw;
+    m_classCache.insert(pos, geopx::tools::ClassificationCache::GetType(ds->getString(3)), ds->getDouble(2));
+  }
 
-  te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(schema.get());
+  ds->clear();
+}
 
-  te::da::PrimaryKey* pk = schema->getPrimaryKey();
-  std::string name = pk->getProperties()[0]->getName();
+geopx::tools::TrackParameters geopx::tools::TrackAutoClassifier::getParameters()
+{
+  geopx::tools::TrackParameters params;
 
-  // Gets the dataset
-  std::unique_ptr<te::da::DataSet> dataset = m_parcelLayer->getData(gp->getName(), &reprojectedEnvelope, te::gm::INTERSECTS);
+  if (!m_distLineEdit->text().isEmpty())
+    params.m_distance = m_distLineEdit->text().toDouble();
 
-  assert(dataset.get());
+  if (!m_distanceTrackLineEdit->text().isEmpty())
+    params.m_distanceTrack = m_distanceTrackLineEdit->text().toDouble();
 
-  dataset->moveBeforeFirst();
+  if (!m_distanceToleranceFactorLineEdit->text().isEmpty())
+    params.m_toleranceFactor = m_distanceToleranceFactorLineEdit->text().toDouble();
 
-  std::unique_ptr<te::gm::Geometry> g;
+  if (!m_distanceTrackToleranceFactorLineEdit->text().isEmpty())
+    params.m_trackToleranceFactor = m_distanceTrackToleranceFactorLineEdit->text().toDouble();
 
-  while (dataset->moveNext())
-  {
-    g = dataset->getGeometry(gp->getName());
+  if (!m_polyAreaMin->text().isEmpty())
+    params.m_polyAreaMin = m_polyAreaMin->text().toDouble();
 
-    if (g->getSRID() == TE_UNKNOWN_SRS)
-      g->setSRID(m_parcelLayer->getSRID());
+  if (!m_polyAreaMax->text().isEmpty())
+    params.m_polyAreaMax = m_polyAreaMax->text().toDouble();
 
-    if (g->getSRID() != root->getSRID())
-      g->transform(root->getSRID());
+  if (!m_maxDeadLineEdit->text().isEmpty())
+    params.m_maxDead = m_maxDeadLineEdit->text().toInt();
 
-    if (g->covers(root))
-    {
-      parcelId = dataset->getInt32(name);
+  if (!m_deadTolLineEdit->text().isEmpty())
+    params.m_deltaTol = m_deadTolLineEdit->text().toDouble();
 
-      break;
-    }
-  }
+  if (!m_thresholdLineEdit->text().isEmpty())
+    params.m_ndviThreshold = m_thresholdLineEdit->text().toDouble();
+
+  params.m_adjustTrack = m_adjustTrack;
+  params.m_adjustTrackSteps = m_adjustTrackSteps;
+  params.m_predictor = m_fitTrack ? geopx::tools::TRACK_PREDICTOR_LINE_FIT : geopx::tools::TRACK_PREDICTOR_STEP;
+  params.m_fitPoints = m_fitTrackPoints;
 
-  return g;
+  return params;
 }
 
-te::gm::Point* geopx::tools::TrackAutoClassifier::createGuessPoint(te::gm::Point* p, double dx, double dy, int srid)
+void geopx::tools::TrackAutoClassifier::getParcels(std::vector<geopx::tools::TrackParcel>& parcels)
 {
-  return new te::gm::Point(p->getX() + dx, p->getY() + dy, srid);
-}
-
-void geopx::tools::TrackAutoClassifier::getClassDataSets(te::da::DataSetType* dsType, te::mem::DataSet*& liveDataSet, te::mem::DataSet*& intruderDataSet, te::gm::Geometry* buffer)
-{
-  // Bulding the query box
-  te::gm::Envelope envelope(*buffer->getMBR());
-
-  te::gm::Envelope reprojectedEnvelope(envelope);
-
-  if ((m_coordLayer->getSRID() != TE_UNKNOWN_SRS) && (m_display->getSRID() != TE_UNKNOWN_SRS) && (m_coordLayer->getSRID() != m_display->getSRID()))
-    reprojectedEnvelope.transform(m_display->getSRID(), m_coordLayer->getSRID());
-
-  if (!reprojectedEnvelope.intersects(m_coordLayer->getExtent()))
-    throw;
-
-  // Gets the layer schema
-  std::unique_ptr<const te::map::LayerSchema> schema(m_coordLayer->getSchema());
-
-  if (!schema->hasGeom())
-    throw;
-
-  try
-  {
-    te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(schema.get());
-
-    // Gets the dataset
-    std::unique_ptr<te::da::DataSet> dataset = m_coordLayer->getData(gp->getName(), &reprojectedEnvelope, te::gm::INTERSECTS);
-    assert(dataset.get());
-
-    std::vector<std::string> pnames;
-    te::da::GetOIDPropertyNames(schema.get(), pnames);
-
-    // Generates a geometry from the given extent. It will be used to refine the results
-    std::unique_ptr<te::gm::Geometry> geometryFromEnvelope(te::gm::GetGeomFromEnvelope(&reprojectedEnvelope, m_coordLayer->getSRID()));
-
-    while (dataset->moveNext())
-    {
-      std::unique_ptr<te::gm::Geometry> g(dataset->getGeometry(gp->getName()));
-
-      if (g->getSRID() == TE_UNKNOWN_SRS)
-        g->setSRID(m_coordLayer->getSRID());
-
-      if (!buffer->contains(g.get()))
-        continue;
-
-      // Feature found
-      te::da::ObjectId* objId = te::da::GenerateOID(dataset.get(), pnames);
-
-      if (m_track->contains(objId))//live
-      {
-        if (!liveDataSet)
-        {
-          liveDataSet = new te::mem::DataSet(dsType);
-        }
-
-        //create dataset item
-        te::mem::DataSetItem* item = new te::mem::DataSetItem(liveDataSet);
-
-        //fid
-        item->setInt32(0, dataset->getInt32("FID"));
-
-        //set id
-        item->setInt32(1, dataset->getInt32("id"));
-
-        //set origin id
-        item->setInt32(2, dataset->getInt32("originId"));
-
-        //set area
-        item->setDouble(3, dataset->getDouble("area"));
-
-        //forest type
-        item->setString(4, "LIVE");
-
-        //set geometry
-        item->setGeometry(5, g.release());
-
-        liveDataSet->add(item);
-      }
-      else//intruder
-      {
-        if (!intruderDataSet)
-        {
-          intruderDataSet = new te::mem::DataSet(dsType);
-        }
-
-        //create dataset item
-        te::mem::DataSetItem* item = new te::mem::DataSetItem(intruderDataSet);
-
-        //fid
-        item->setInt32(0, dataset->getInt32("FID"));
-
-        //set id
-        item->setInt32(1, dataset->getInt32("id"));
-
-        //set origin id
-        item->setInt32(2, dataset->getInt32("originId"));
-
-        //set area
-        item->setDouble(3, dataset->getDouble("area"));
-
-        //forest type
-        item->setString(4, "INTRUDER");
-
-        //set geometry
-        item->setGeometry(5, g.release());
-
-        intruderDataSet->add(item);
-      }
-    }
-  }
-  catch (std::exception& e)
-  {
-    QMessageBox::critical(m_display, tr("Error"), QString(tr("Error getting geometry. Details:") + " %1.").arg(e.what()));
-    throw;
-  }
-}
-
-void geopx::tools::TrackAutoClassifier::createRTree()
-{
-  QApplication::setOverrideCursor(Qt::WaitCursor);
-
-  te::common::FreeContents(m_centroidGeomMap);
-  te::common::FreeContents(m_centroidObjIdMap);
-  te::common::FreeContents(m_angleGeomMap);
-
-  m_centroidRtree.clear();
-  m_centroidGeomMap.clear();
-  m_centroidObjIdMap.clear();
-  m_angleRtree.clear();
-  m_angleGeomMap.clear();
-
-  //create rtree
-  std::unique_ptr<const te::map::LayerSchema> schema(m_coordLayer->getSchema());
-  std::unique_ptr<te::da::DataSet> ds(m_coordLayer->getData());
-
-  std::vector<std::string> pnames;
-  te::da::GetOIDPropertyNames(schema.get(), pnames);
-
-  //geom property info
-  te::gm::GeometryProperty* gmProp = te::da::GetFirstGeomProperty(schema.get());
-
-  int geomIdx = te::da::GetPropertyPos(schema.get(), gmProp->getName());
-
-  //id info
-  te::da::PrimaryKey* pk = schema->getPrimaryKey();
-
-  int idIdx = te::da::GetPropertyPos(schema.get(), pk->getProperties()[0]->getName());
-
-  ds->moveBeforeFirst();
-
-  while (ds->moveNext())
-  {
-    std::string strId = ds->getAsString(idIdx);
-
-    int id = atoi(strId.c_str());
-
-    te::gm::Geometry* g = ds->getGeometry(geomIdx).release();
-    const te::gm::Envelope* box = g->getMBR();
-
-    m_centroidRtree.insert(*box, id);
-
-    m_centroidGeomMap.insert(std::map<int, te::gm::Geometry*>::value_type(id, g));
-
-    m_centroidObjIdMap.insert(std::map<int, te::da::ObjectId*>::value_type(id, te::da::GenerateOID(ds.get(), pnames)));
-  }
-
-  //get direction geometries
-  std::unique_ptr<const te::map::LayerSchema> schemaDir(m_dirLayer->getSchema());
-  std::unique_ptr<te::da::DataSet> dsDir(m_dirLayer->getData());
-
-  te::gm::GeometryProperty* gmPropDir = te::da::GetFirstGeomProperty(schemaDir.get());
-  int geomDirIdx = te::da::GetPropertyPos(schemaDir.get(), gmPropDir->getName());
-
-  te::da::PrimaryKey* pkDir = schemaDir->getPrimaryKey();
-  int idDirIdx = te::da::GetPropertyPos(schemaDir.get(), pkDir->getProperties()[0]->getName());
-
-  dsDir->moveBeforeFirst();
-
-  while (dsDir->moveNext())
-  {
-    std::string strId = dsDir->getAsString(idDirIdx);
-
-    int id = atoi(strId.c_str());
-
-    te::gm::Geometry* g = dsDir->getGeometry(geomDirIdx).release();
-    const te::gm::Envelope* box = g->getMBR();
-
-    m_angleRtree.insert(*box, id);
-
-    m_angleGeomMap.insert(std::map<int, te::gm::Geometry*>::value_type(id, g));
-  }
-
-  QApplication::restoreOverrideCursor();
-}
-
-te::gm::Point* geopx::tools::TrackAutoClassifier::getPoint(te::gm::Geometry* g)
-{
-  te::gm::Point* point = 0;
-
-  if (g->getGeomTypeId() == te::gm::MultiPointType)
-  {
-    te::gm::MultiPoint* mPoint = dynamic_cast<te::gm::MultiPoint*>(g);
-    point = dynamic_cast<te::gm::Point*>(mPoint->getGeometryN(0));
-  }
-  else if (g->getGeomTypeId() == te::gm::PointType)
-  {
-    point = dynamic_cast<te::gm::Point*>(g);
-  }
-
-  return point;
-}
-
-void geopx::tools::TrackAutoClassifier::getStartIdValue()
-{
-  if (!m_coordLayer.get())
-    throw;
-
-  QApplication::setOverrideCursor(Qt::WaitCursor);
-
-  std::unique_ptr<te::da::DataSet> dataset = m_coordLayer->getData();
-  std::unique_ptr<te::da::DataSetType> dataSetType = m_coordLayer->getSchema();
-
-  te::da::PrimaryKey* pk = dataSetType->getPrimaryKey();
-  std::string name = pk->getProperties()[0]->getName();
-
-  dataset->moveBeforeFirst();
-
-  while (dataset->moveNext())
-  {
-    int id = dataset->getInt32(name);
-
-    if (id > m_starterId)
-      m_starterId = id;
-  }
-
-  QApplication::restoreOverrideCursor();
-
-  ++m_starterId;
-}
-
-bool geopx::tools::TrackAutoClassifier::isClassified(te::da::ObjectId* objId, double& area, std::string& classValue)
-{
-  if (!m_coordLayer.get())
-    throw;
-
-  std::unique_ptr<te::da::DataSetType> schema = m_coordLayer->getSchema();
-
-  te::da::ObjectIdSet* objIdSet;
-
-  te::da::GetEmptyOIDSet(schema.get(), objIdSet);
-
-  objIdSet->add(objId);
-
-  std::unique_ptr<te::da::DataSet> ds = m_coordLayer->getData(objIdSet);
-
-  if (!ds->isEmpty())
-  {
-    ds->moveFirst();
-
-    classValue = ds->getString("type");
-
-    if (classValue == "CREATED")
-      return false;
-
-    if (classValue == "UNKNOWN")
-    {
-      //get area attribute and check threshold
-      area = ds->getDouble("area");
-
-      return false;
-    }
-  }
-
-  return true;
-}
-
-te::gm::Point* geopx::tools::TrackAutoClassifier::calculateGuessPoint(te::gm::Point* p, int parcelId)
-{
-  if (!m_dataSet.get())
-  {
-    std::unique_ptr<te::da::DataSetType> dsType = m_coordLayer->getSchema();
-
-    //create dataset type
-    std::unique_ptr<te::da::DataSetType> dataSetType = createTreeDataSetType();
-
-    m_dataSet.reset(new te::mem::DataSet(dataSetType.get()));
-  }
-
-  double toleranceFactor = 0.;
-
-  if (m_distanceToleranceFactorLineEdit->text().isEmpty())
-  {
-    toleranceFactor = TOLERANCE_FACTOR;
-  }
-  else
-  {
-    toleranceFactor = m_distanceToleranceFactorLineEdit->text().toDouble();
-  }
-
-  double thresholdValue = NDVI_THRESHOLD;
-
-  if (!m_thresholdLineEdit->text().isEmpty())
-  {
-    thresholdValue = m_thresholdLineEdit->text().toDouble();
-  }
-
-  m_ndviRaster->getGrid()->setSRID(p->getSRID());
-
-  std::string forestType = "UNKNOWN";
-
-  te::gm::Point* pGuess = 0;
-
-  //try guess point
-  te::gm::Coord2D coordGuess = m_ndviRaster->getGrid()->geoToGrid(p->getX(), p->getY());
-
-  double valueGuess = 0.;
-
-  m_ndviRaster->getValue(coordGuess.getX(), coordGuess.getY(), valueGuess);
-
-  ////try ll guess point
-  //te::gm::Coord2D coordGuessLL = m_ndviRaster->getGrid()->geoToGrid(p->getX() - (m_dx * toleranceFactor), p->getY() - (m_dy * toleranceFactor));
-
-  //double valueGuessLL = 0.;
-
-  //m_ndviRaster->getValue(coordGuessLL.getX(), coordGuessLL.getY(), valueGuessLL);
-
-  ////try lr guess point
-  //te::gm::Coord2D coordGuessLR = m_ndviRaster->getGrid()->geoToGrid(p->getX() + (m_dx * toleranceFactor), p->getY() + (m_dy * toleranceFactor));
-
-  //double valueGuessLR = 0.;
-
-  //m_ndviRaster->getValue(coordGuessLR.getX(), coordGuessLR.getY(), valueGuessLR);
-
-  ////try ul guess point
-  //te::gm::Coord2D coordGuessUL = m_ndviRaster->getGrid()->geoToGrid(p->getX() - (m_dy * toleranceFactor), p->getY() + (m_dx * toleranceFactor));
-
-  //double valueGuessUL = 0.;
+  //the direction lines are not used when the user defined the track
+  bool userTrack = m_point0 && m_point1;
 
-  //m_ndviRaster->getValue(coordGuessUL.getX(), coordGuessUL.getY(), valueGuessUL);
+  geopx::tools::GetTrackParcels(m_parcelCache, m_centroidIndex, m_classCache,
+                                userTrack ? te::map::AbstractLayerPtr() : m_dirLayer, m_angleIndex, parcels);
 
-  ////try ur guess point
-  //te::gm::Coord2D coordGuessUR = m_ndviRaster->getGrid()->geoToGrid(p->getX() + (m_dy * toleranceFactor), p->getY() - (m_dx * toleranceFactor));
-
-  //double valueGuessUR = 0.;
-
-  //m_ndviRaster->getValue(coordGuessUR.getX(), coordGuessUR.getY(), valueGuessUR);
-
-
-  if (valueGuess > thresholdValue)
-  {
-    forestType = "LIVE";
-
-    m_deadCount = 0;
-
-    pGuess = p;
-  }
-  /*else if (valueGuessLL > thresholdValue)
-  {
-    forestType = "LIVE";
-
-    m_deadCount = 0;
-
-    pGuess = new te::gm::Point(p->getX() - (m_dx * toleranceFactor), p->getY() - (m_dy * toleranceFactor), p->getSRID());
-  }
-  else if (valueGuessLR > thresholdValue)
-  {
-    forestType = "LIVE";
-
-    m_deadCount = 0;
-
-    pGuess = new te::gm::Point(p->getX() + (m_dx * toleranceFactor), p->getY() + (m_dy * toleranceFactor), p->getSRID());
-  }
-  else if (valueGuessUL > thresholdValue)
-  {
-    forestType = "LIVE";
-
-    m_deadCount = 0;
-
-    pGuess = new te::gm::Point(p->getX() - (m_dy * toleranceFactor), p->getY() + (m_dx * toleranceFactor), p->getSRID());
-  }
-  else if (valueGuessUR > thresholdValue)
-  {
-    forestType = "LIVE";
-
-    m_deadCount = 0;
-
-    pGuess = new te::gm::Point(p->getX() + (m_dy * toleranceFactor), p->getY() - (m_dx * toleranceFactor), p->getSRID());
-  }*/
-  else
-  {
-    forestType = "DEAD";
-
-    ++m_deadCount;
-
-    pGuess = p;
-  }
-
-  //create dataset item
-  te::mem::DataSetItem* item = new te::mem::DataSetItem(m_dataSet.get());
-
-  //set id
-  item->setInt32(0, m_starterId);
-
-  //set origin id
-  item->setInt32(1, parcelId);
-
-  //set area
-  item->setDouble(2, 0.);
-
-  //forest type
-  item->setString(3, forestType);
-
-  //set geometry
-  item->setGeometry(4, new te::gm::Point(*pGuess));
-
-  m_dataSet->add(item);
-
-  ++m_starterId;
-
-  return pGuess;
-}
-
-te::gm::Point* geopx::tools::TrackAutoClassifier::getCandidatePoint(te::gm::Point* pRoot, te::gm::Point* pGuess, int srid, std::vector<int>& resultsTree, te::da::ObjectId*& candidateOjbId, bool& abort)
-{
-  double lowerDistance = std::numeric_limits<double>::max();
-
-  double polyAreaMin = 0.;
-  double polyAreaMax = 0.;
-
-  if (m_polyAreaMin->text().isEmpty())
-  {
-    polyAreaMin = POLY_AREA_MIN;
-  }
-  else
-  {
-    polyAreaMin = m_polyAreaMin->text().toDouble();
-  }
-
-  if (m_polyAreaMax->text().isEmpty())
-  {
-    polyAreaMax = POLY_AREA_MAX;
-  }
-  else
-  {
-    polyAreaMax = m_polyAreaMax->text().toDouble();
-  }
-
-  te::gm::Point* point = 0;
-
-  for (std::size_t t = 0; t < resultsTree.size(); ++t)
-  {
-    std::map<int, te::gm::Geometry*>::iterator it = m_centroidGeomMap.find(resultsTree[t]);
-
-    std::map<int, te::da::ObjectId*>::iterator itObjId = m_centroidObjIdMap.find(resultsTree[t]);
-
-    double area = 0.;
-
-    std::string classValue = "";
-
-    if (!isClassified(itObjId->second, area, classValue))
-    {
-      if ((area > polyAreaMin && area < polyAreaMax) || area == 0.)
-      {
-        te::gm::Point* pCandidate = getPoint(it->second);
-
-        pCandidate->setSRID(srid);
-
-        if (pRoot->getX() != pCandidate->getX() || pRoot->getY() != pCandidate->getY())
-        {
-          //check for lower distance from guest point
-          double dist = std::abs(pGuess->distance(pCandidate));
-
-          if (dist < lowerDistance)
-          {
-            lowerDistance = dist;
-            point = pCandidate;
-            candidateOjbId = itObjId->second;
-          }
-        }
-      }
-    }
-    else
-    {
-      abort = true;
-
-      return 0;
-    }
-  }
-
-  abort = false;
-
-  return point;
-}
-
-void geopx::tools::TrackAutoClassifier::adjustTrack(te::gm::Point* point, double& dx, double& dy)
-{
-  m_adjustTrackPoints.push_back(point);
-
-  if (m_adjustTrackPoints.size() == m_adjustTrackSteps)
-  {
-    te::gm::Point* p0 = m_adjustTrackPoints.front();
-
-    double bigDistance = p0->distance(point);
-
-    double big_dx = point->getX() - p0->getX();
-    double big_dy = point->getY() - p0->getY();
-
-    dx = m_distance * big_dx / bigDistance;
-    dy = m_distance * big_dy / bigDistance;
-
-    m_adjustTrackPoints.pop_front();
-  }
-}
-
-std::unique_ptr<te::da::DataSetType> geopx::tools::TrackAutoClassifier::createTreeDataSetType()
-{
-  std::unique_ptr<te::da::DataSetType> dsType = m_coordLayer->getSchema();
-
-  //create dataset type
-  std::unique_ptr<te::da::DataSetType> dataSetType(new te::da::DataSetType(dsType->getName()));
-
-  //create id property
-  te::dt::SimpleProperty* idProperty = new te::dt::SimpleProperty("id", te::dt::INT32_TYPE);
-  dataSetType->add(idProperty);
-
-  //create origin id property
-  te::dt::SimpleProperty* originIdProperty = new te::dt::SimpleProperty("originId", te::dt::INT32_TYPE);
-  dataSetType->add(originIdProperty);
-
-  //create area property
-  te::dt::SimpleProperty* areaProperty = new te::dt::SimpleProperty("area", te::dt::DOUBLE_TYPE);
-  dataSetType->add(areaProperty);
-
-  //create forest type
-  te::dt::StringProperty* typeProperty = new te::dt::StringProperty("type");
-  dataSetType->add(typeProperty);
-
-  //create geometry property
-  te::gm::GeometryProperty* geomProperty = new te::gm::GeometryProperty("geom", m_coordLayer->getSRID(), te::gm::PointType);
-  dataSetType->add(geomProperty);
-
-  return dataSetType;
-}
-
-te::da::Where* geopx::tools::TrackAutoClassifier::getRestriction()
-{
-  // select * from pontos where (originId = X E ( tipo = CREATED OR (tipo = UNKNOWN E (area > 0.8 E area < 1.0))) order by tipo
-
-  ////area1
-  //te::da::PropertyName* propArea1 = new te::da::PropertyName("area");
-
-  ////0.8
-  //te::da::Literal* minorAreaValue = new te::da::LiteralDouble(0.6);
-
-  ////area > 0.8
-  //te::da::GreaterThan* greaterThanArea = new te::da::GreaterThan(propArea1, minorAreaValue);
-
-  ////area2
-  //te::da::PropertyName* propArea2 = new te::da::PropertyName("area");
-
-  ////1.0
-  //te::da::Literal* majorAreaValue = new te::da::LiteralDouble(1.3);
-
-  ////area < 1.0
-  //te::da::LessThan* lessThanArea = new te::da::LessThan(propArea2, majorAreaValue);
-
-  ////area > 0.8 E area < 1.0
-  //te::da::And* andArea = new te::da::And(greaterThanArea, lessThanArea);
-
-  ////tipo = UNKNOWN
-  //te::da::PropertyName* propTypeUnknown = new te::da::PropertyName("type");
-
-  ////UNKNOWN
-  //te::da::Literal* typeUnknownValue = new te::da::LiteralString("UNKNOWN");
-
-  ////type equal
-  //te::da::EqualTo* typeUnknownEqual = new te::da::EqualTo(propTypeUnknown, typeUnknownValue);
-
-  ////tipo = UNKNOWN E (area > 0.8 E area < 1.0)
-  //te::da::And* andType = new te::da::And(typeUnknownEqual, andArea);
-
-  //tipo = CREATED
-  te::da::PropertyName* propTypeCreated = new te::da::PropertyName("type");
-
-  //UNKNOWN
-  te::da::Literal* typeCreatedValue = new te::da::LiteralString("CREATED");
-
-  //type equal
-  te::da::EqualTo* typeCreatedEqual = new te::da::EqualTo(propTypeCreated, typeCreatedValue);
-
-  ////tipo = CREATED OR (tipo = UNKNOWN E (area > 0.8 E area < 1.0))
-  //te::da::Or* orType = new te::da::Or(typeCreatedEqual, andType);
-
-  ////originId = X
-  //te::da::PropertyName* propOriginId = new te::da::PropertyName("originId");
-
-  ////UNKNOWN
-  //te::da::Literal* originIdValue = new te::da::LiteralInt32(originId);
-
-  ////type equal
-  //te::da::EqualTo* originEqual = new te::da::EqualTo(propOriginId, originIdValue);
-
-  ////originId = X E ( tipo = CREATED OR (tipo = UNKNOWN E (area > 0.8 E area < 1.0)))
-  //te::da::And* andOrigin = new te::da::And(originEqual, typeCreatedEqual);
-
-  //create where
-  te::da::Where* where = new te::da::Where(typeCreatedEqual);
-
-  return where;
-}
-
-void geopx::tools::TrackAutoClassifier::processDataSet(te::da::DataSet* ds)
-{
-  QApplication::setOverrideCursor(Qt::WaitCursor);
-
-  std::unique_ptr<te::da::DataSetType> dsType(m_coordLayer->getSchema());
-
-  te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(dsType.get());
-
-  // Let's generate the oid
-  std::vector<std::string> pnames;
-  te::da::GetOIDPropertyNames(dsType.get(), pnames);
-
-  te::common::TaskProgress task("Auto Classifier");
-  task.setTotalSteps(ds->size());
-
-  ds->moveBeforeFirst();
+  if (!userTrack)
+    return;
 
-  while (ds->moveNext())
+  for (std::size_t t = 0; t < parcels.size(); ++t)
   {
-    if (!task.isActive())
-    {
-      break;
-    }
-
-    m_dataSet.reset();
-
-    std::unique_ptr<te::gm::Geometry> g(ds->getGeometry(gp->getName()));
-
-    te::gm::Point* rootPoint = getPoint(g.get());
-
-    te::da::ObjectId* objIdRoot = te::da::GenerateOID(ds, pnames);
-
-    te::gm::LineString* line = 0;
-
-    std::list<te::gm::Point*> track;
-
-    try
-    {
-      std::unique_ptr<te::gm::Geometry> buffer(createBuffer(rootPoint, objIdRoot, m_coordLayer->getSRID(), gp->getName(), line, track));
-
-      if (buffer.get())
-      {
-        //create dataset type
-        te::mem::DataSet* liveDS = 0;
-        te::mem::DataSet* intruderDS = 0;
-
-        getClassDataSets(dsType.get(), liveDS, intruderDS, buffer.get());
-
-        //class
-        te::map::DataSetLayer* dsLayer = dynamic_cast<te::map::DataSetLayer*>(m_coordLayer.get());
-
-        if (dsLayer)
-        {
-          te::da::DataSourcePtr dataSource = te::da::GetDataSource(dsLayer->getDataSourceId());
-
-          //update live dataset
-          std::vector<size_t> ids;
-          ids.push_back(0);
-
-          if (liveDS)
-          {
-            std::vector< std::set<int> > properties;
-            std::size_t dsSize = liveDS->size();
-
-            for (std::size_t t = 0; t < dsSize; ++t)
-            {
-              std::set<int> setPos;
-              setPos.insert(4);
-
-              properties.push_back(setPos);
-            }
-
-            liveDS->moveBeforeFirst();
-
-            dataSource->update(dsType->getName(), liveDS, properties, ids);
-          }
-
-          //update intruder dataset
-          if (intruderDS)
-          {
-            std::vector< std::set<int> > properties;
-            std::size_t dsSize = intruderDS->size();
-
-            for (std::size_t t = 0; t < dsSize; ++t)
-            {
-              std::set<int> setPos;
-              setPos.insert(4);
-
-              properties.push_back(setPos);
-            }
-
-            intruderDS->moveBeforeFirst();
-
-            dataSource->update(dsType->getName(), intruderDS, properties, ids);
-          }
-
-          //add dead dataset
-          if (m_dataSet.get())
-          {
-            std::map<std::string, std::string> options;
-
-            m_dataSet->moveBeforeFirst();
-
-            dataSource->add(dsType->getName(), m_dataSet.get(), options);
-
-            m_dataSet.reset();
-          }
-        }
-      }
-    }
-    catch (std::exception& e)
-    {
-      QApplication::restoreOverrideCursor();
-
-      QMessageBox::critical(m_display, tr("Error"), QString(tr("Error auto classifying track. Details:") + " %1.").arg(e.what()));
-      break;
-    }
-    
-
-    task.pulse();
+    parcels[t].m_hasDirection = true;
+    parcels[t].m_dirX = m_point1->getX() - m_point0->getX();
+    parcels[t].m_dirY = m_point1->getY() - m_point0->getY();
   }
-
-  m_classify = true;
-
-  createRTree();
-
-  QApplication::restoreOverrideCursor();
 }
 
 bool geopx::tools::TrackAutoClassifier::panMousePressEvent(QMouseEvent* e)
@@ -8,6 +8,11 @@
 #define __GEOPXDESKTOP_TOOLS_FORESTMONITOR_TRACKAUTOCLASSIFIER_H
 
 #include "../../../Config.h"
+#include "../../core/ClassificationCache.h"
+#include "../../core/NdviSampler.h"
+#include "../../core/ParcelCache.h"
+#include "../../core/SpatialIndex.h"
+#include "../../core/TrackEngine.h"
 
 // TerraLib
 #include <terralib/dataaccess/dataset/ObjectIdSet.h>
@@ -16,8 +21,10 @@
 #include <terralib/qt/widgets/tools/AbstractTool.h>
 
 // STL
-#include <list>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 // QT
 #include <QLineEdit>
@@ -43,6 +50,7 @@ namespace geopx
 {
   namespace tools
   {
+    class TrackResultWriter;
 
     /*!
       \class TrackClassifier
@@ -83,6 +91,9 @@ namespace geopx
 
       void setAdjustTrack(bool adjust, int nSteps);
 
+      /*! \brief Predicts the next tree of the tracks from the line fitted to the last nPoints trees. */
+      void setFitTrack(bool fit, int nPoints);
+
       //@}
 
       /** @name AbstractTool Methods
@@ -94,47 +105,42 @@ namespace geopx
 
       //@}
 
+    signals:
+
+      /*! \brief Emitted by the auto classification thread when it finishes. */
+      void autoClassifyFinished();
+
+    protected slots:
+
+      /*! \brief Joins the auto classification thread and applies its results to the caches and the display. */
+      void onAutoClassifyFinished();
+
     protected:
 
       void selectObjects(QMouseEvent* e);
 
       void classifyObjects();
           
+      /*! \brief Starts the classification of the created centroids in a thread, the tool ignores new classifications until it finishes. */
       void autoClassifyObjects();
 
       void cancelOperation(bool restart = false);
 
       void drawSelecteds();
 
-      te::gm::Geometry* createBuffer(te::gm::Point* rootPoint, te::da::ObjectId* objIdRoot, int srid, std::string gpName, te::gm::LineString*& lineBuffer, std::list<te::gm::Point*>& track);
-
-      void getTrackInfo(te::gm::Point* point0, te::gm::Point* point1);
-
-      std::unique_ptr<te::gm::Geometry> getParcelGeeom(te::gm::Geometry* root, int& parcelId);
-
-      te::gm::Point* createGuessPoint(te::gm::Point* p, double dx, double dy, int srid);
-
-      void getClassDataSets(te::da::DataSetType* dsType, te::mem::DataSet*& liveDataSet, te::mem::DataSet*& intruderDataSet, te::gm::Geometry* buffer);
-
       void createRTree();
 
       te::gm::Point* getPoint(te::gm::Geometry* g);
 
       void getStartIdValue();
 
-      bool isClassified(te::da::ObjectId* objId, double& area, std::string& classValue);
-
-      te::gm::Point* calculateGuessPoint(te::gm::Point* p, int parcelId);
-
-      te::gm::Point* getCandidatePoint(te::gm::Point* pRoot, te::gm::Point* pGuess, int srid, std::vector<int>& resultsTree, te::da::ObjectId*& candidateOjbId, bool& abort);
+      void processDataSet(te::da::DataSet* ds);
 
-      void adjustTrack(te::gm::Point* point, double& dx, double& dy);
+      void indexCreatedObjects(const geopx::tools::TrackResultWriter& writer);
 
-      std::unique_ptr<te::da::DataSetType> createTreeDataSetType();
+      TrackParameters getParameters();
 
-      te::da::Where* getRestriction();
-
-      void processDataSet(te::da::DataSet* ds);
+      void getParcels(std::vector<TrackParcel>& parcels);
 
       bool panMousePressEvent(QMouseEvent* e);
 
@@ -148,9 +154,9 @@ namespace geopx
       te::map::AbstractLayerPtr m_parcelLayer;        //!<The layer with geometry restriction.
       te::map::AbstractLayerPtr m_dirLayer;           //!<The layer with direction information.
 
-      te::sam::rtree::Index<int> m_centroidRtree;
-      std::map<int, te::gm::Geometry*> m_centroidGeomMap;
-      std::map<int, te::da::ObjectId*> m_centroidObjIdMap;
+      SpatialIndex m_centroidIndex;                   //!<The spatial index of the coord layer (id is the primary key value).
+      ClassificationCache m_classCache;               //!<The type and area of the coord layer objects (index positions).
+      ParcelCache m_parcelCache;                      //!<The parcel polygons in the coord layer SRID.
 
       te::gm::Point* m_point0;
       te::da::ObjectId* m_objId0;
@@ -158,12 +164,8 @@ namespace geopx
       te::gm::Point* m_point1;
       te::da::ObjectId* m_objId1;
 
-      te::da::ObjectIdSet* m_track;
-
       te::da::ObjectIdSet* m_roots;
 
-      std::unique_ptr<te::mem::DataSet> m_dataSet;
-
       int m_starterId;
 
       QLineEdit* m_distLineEdit;
@@ -176,24 +178,25 @@ namespace geopx
       QLineEdit* m_deadTolLineEdit;
       QLineEdit* m_thresholdLineEdit;
 
-      double m_dx;
-      double m_dy;
-      double m_distance;
-
       bool m_adjustTrack;
       int m_adjustTrackSteps;
-      std::list<te::gm::Point*> m_adjustTrackPoints;
 
-      bool m_classify;
+      bool m_fitTrack;
+      int m_fitTrackPoints;
 
-      unsigned int m_maxDead;
-      unsigned int m_deadCount;
-      double m_deltaTol;
+      bool m_classify;
 
       te::rst::Raster* m_ndviRaster;
+      std::unique_ptr<NdviSampler> m_ndviSampler;     //!<Reads the NDVI values of the guess points.
+
+      SpatialIndex m_angleIndex;                      //!<The spatial index of the direction lines (first and second vertices).
 
-      te::sam::rtree::Index<int> m_angleRtree;
-      std::map<int, te::gm::Geometry*> m_angleGeomMap;
+      //auto classification attributes, used by the thread while it runs
+      std::vector<TrackParcel> m_autoParcels;         //!<The parcels classified.
+      std::unique_ptr<TrackEngine> m_autoEngine;      //!<The track engine.
+      std::unique_ptr<TrackResultWriter> m_autoWriter; //!<Writes the tracks.
+      std::string m_autoError;                        //!<The error of the classification, if any.
+      std::thread m_autoThread;                       //!<The classification thread, joinable while the classification is not applied.
 
       //pan attributes
       bool m_panStarted;      //!< Flag that indicates if pan operation was started.
@@ -5,6 +5,7 @@
 */
 
 #include "TrackClassifier.h"
+#include "../../core/LayerIndex.h"
 
 // TerraLib
 #include <terralib/common/STLUtils.h>
@@ -72,13 +73,6 @@ geopx::tools::TrackClassifier::~TrackClassifier()
   QPixmap* draft = m_display->getDraftPixmap();
   draft->fill(Qt::transparent);
 
-  m_polyRtree.clear();
-  te::common::FreeContents(m_polyGeomMap);
-  
-  m_centroidRtree.clear();
-  te::common::FreeContents(m_centroidGeomMap);
-  te::common::FreeContents(m_centroidObjIdMap);
-
   delete m_buffer;
 
   delete m_point0;
@@ -447,8 +441,12 @@ void geopx::tools::TrackClassifier::drawSelecteds()
 
       m_buffer = createBuffer(m_coordLayer->getSRID(), gp->getName(), line, track);
 
+      m_corridor.reset();
+
       if (m_buffer)
       {
+        m_corridor.reset(new TrackCorridor(line, DISTANCE_BUFFER));
+
         te::gm::Polygon* poly = dynamic_cast<te::gm::Polygon*>(m_buffer);
 
         if (poly && poly->isValid() && poly->getNumRings() > 0)
@@ -486,10 +484,14 @@ te::gm::Geometry* geopx::tools::TrackClassifier::createBuffer(int srid, std::str
   getTrackInfo(distance, dx, dy);
 
   //get parcel geom
-  int parcelId;
-  std::unique_ptr<te::gm::Geometry> parcelGeom = getParcelGeeom(m_point0, parcelId);
+  std::size_t parcelPos = 0;
+
+  if (!m_parcelCache.find(m_point0->getX(), m_point0->getY(), parcelPos))
+    return 0;
+
+  int parcelId = m_parcelCache.getId(parcelPos);
 
-  parcelGeom->setSRID(srid);
+  std::shared_ptr<const te::gm::Geometry> parcelGeom = m_parcelCache.getGeometry(parcelPos);
 
   te::da::GetEmptyOIDSet(schema.get(), m_track);
 
@@ -522,9 +524,9 @@ te::gm::Geometry* geopx::tools::TrackClassifier::createBuffer(int srid, std::str
     ext.m_ury += (distance * TOLERANCE_FACTOR);
 
     //check on tree
-    std::vector<int> resultsTree;
+    std::vector<std::size_t> resultsTree;
 
-    m_centroidRtree.search(ext, resultsTree);
+    m_centroidIndex.search(ext, resultsTree);
 
     if (resultsTree.empty())
     {
@@ -579,9 +581,9 @@ te::gm::Geometry* geopx::tools::TrackClassifier::createBuffer(int srid, std::str
 
         te::gm::Envelope extPoint(guestPoint->getX(), guestPoint->getY(), guestPoint->getX(), guestPoint->getY());
 
-        std::vector<int> resultsPolyTree;
+        std::vector<std::size_t> resultsPolyTree;
 
-        m_polyRtree.search(extPoint, resultsPolyTree);
+        m_polyIndex.search(extPoint, resultsPolyTree);
 
         if (resultsPolyTree.empty())
         {
@@ -656,20 +658,13 @@ te::gm::Geometry* geopx::tools::TrackClassifier::createBuffer(int srid, std::str
       bool found = false;
 
       double lowerDistance = std::numeric_limits<double>::max();
-      te::gm::Point* newCandidate = 0;
-      te::da::ObjectId* newObjIdCandidate = 0;
+      std::size_t newCandidatePos = 0;
 
       for (std::size_t t = 0; t < resultsTree.size(); ++t)
       {
-        std::map<int, te::gm::Geometry*>::iterator it = m_centroidGeomMap.find(resultsTree[t]);
-
-        std::map<int, te::da::ObjectId*>::iterator itObjId = m_centroidObjIdMap.find(resultsTree[t]);
-
-        if (!isClassified(itObjId->second))
+        if (!isClassified(geopx::tools::CreateObjectId(schema.get(), m_centroidIndex, resultsTree[t])))
         {
-          pCandidate = getPoint(it->second);
-
-          pCandidate->setSRID(srid);
+          pCandidate = new te::gm::Point(m_centroidIndex.getX(resultsTree[t]), m_centroidIndex.getY(resultsTree[t]), srid);
 
           if (rootPoint->getX() != pCandidate->getX() || rootPoint->getY() != pCandidate->getY())
           {
@@ -679,11 +674,12 @@ te::gm::Geometry* geopx::tools::TrackClassifier::createBuffer(int srid, std::str
             if (dist < lowerDistance)
             {
               lowerDistance = dist;
-              newCandidate = pCandidate;
-              newObjIdCandidate = itObjId->second;
+              newCandidatePos = resultsTree[t];
               found = true;
             }
           }
+
+          delete pCandidate;
         }
       }
 
@@ -693,8 +689,8 @@ te::gm::Geometry* geopx::tools::TrackClassifier::createBuffer(int srid, std::str
       }
       else
       {
-        rootPoint = newCandidate;
-        m_track->add(newObjIdCandidate);
+        rootPoint = new te::gm::Point(m_centroidIndex.getX(newCandidatePos), m_centroidIndex.getY(newCandidatePos), srid);
+        m_track->add(geopx::tools::CreateObjectId(schema.get(), m_centroidIndex, newCandidatePos));
       }
 
       insideParcel = parcelGeom->covers(rootPoint);
@@ -761,60 +757,6 @@ void geopx::tools::TrackClassifier::getTrackInfo(double& distance, double& dx, d
   dy = distance * big_dy / bigDistance;
 }
 
-std::unique_ptr<te::gm::Geometry> geopx::tools::TrackClassifier::getParcelGeeom(te::gm::Geometry* root, int& parcelId)
-{
-  if (!m_parcelLayer.get())
-    throw;
-
-  // Bulding the query box
-  te::gm::Envelope envelope(*root->getMBR());
-
-  te::gm::Envelope reprojectedEnvelope(envelope);
-
-  if ((m_parcelLayer->getSRID() != TE_UNKNOWN_SRS) && (m_display->getSRID() != TE_UNKNOWN_SRS) && (m_parcelLayer->getSRID() != m_display->getSRID()))
-    reprojectedEnvelope.transform(m_display->getSRID(), m_parcelLayer->getSRID());
-
-  if (!reprojectedEnvelope.intersects(m_parcelLayer->getExtent()))
-    throw;
-
-  // Gets the layer schema
-  std::unique_ptr<const te::map::LayerSchema> schema(m_parcelLayer->getSchema());
-
-  if (!schema->hasGeom())
-    throw;
-
-  te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(schema.get());
-
-  te::da::PrimaryKey* pk = schema->getPrimaryKey();
-  std::string name = pk->getProperties()[0]->getName();
-
-  // Gets the dataset
-  std::unique_ptr<te::da::DataSet> dataset = m_parcelLayer->getData(gp->getName(), &reprojectedEnvelope, te::gm::INTERSECTS);
-
-  assert(dataset.get());
-
-  dataset->moveBeforeFirst();
-
-  std::unique_ptr<te::gm::Geometry> g;
-
-  while (dataset->moveNext())
-  {
-    g = dataset->getGeometry(gp->getName());
-
-    if (g->getSRID() == TE_UNKNOWN_SRS)
-      g->setSRID(m_coordLayer->getSRID());
-
-    if (g->covers(root))
-    {
-      parcelId = dataset->getInt32(name);
-
-      break;
-    }
-  }
-
-  return g;
-}
-
 te::gm::Point* geopx::tools::TrackClassifier::createGuessPoint(te::gm::Point* p, double dx, double dy, int srid)
 {
   return new te::gm::Point(p->getX() + dx, p->getY() + dy, srid);
@@ -822,99 +764,43 @@ te::gm::Point* geopx::tools::TrackClassifier::createGuessPoint(te::gm::Point* p,
 
 te::da::ObjectIdSet* geopx::tools::TrackClassifier::getBufferObjIdSet()
 {
-  // Bulding the query box
-  te::gm::Envelope envelope(*m_buffer->getMBR());
-
-  te::gm::Envelope reprojectedEnvelope(envelope);
-
-  if ((m_coordLayer->getSRID() != TE_UNKNOWN_SRS) && (m_display->getSRID() != TE_UNKNOWN_SRS) && (m_coordLayer->getSRID() != m_display->getSRID()))
-    reprojectedEnvelope.transform(m_display->getSRID(), m_coordLayer->getSRID());
-
-  if (!reprojectedEnvelope.intersects(m_coordLayer->getExtent()))
-    throw;
-
-  // Gets the layer schema
-  std::unique_ptr<const te::map::LayerSchema> schema(m_coordLayer->getSchema());
-
-  if (!schema->hasGeom())
-    throw;
-
-  te::da::ObjectIdSet* oids = 0;
-
-  try
-  {
-    te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(schema.get());
+  //the buffer is tested against the centroid index, the layer is not read
+  std::vector<std::size_t> resultsTree;
 
-    // Gets the dataset
-    std::unique_ptr<te::da::DataSet> dataset = m_coordLayer->getData(gp->getName(), &reprojectedEnvelope, te::gm::INTERSECTS);
-    assert(dataset.get());
+  m_corridor->search(m_centroidIndex, resultsTree);
 
-    // Let's generate the oids
-    te::da::GetEmptyOIDSet(schema.get(), oids);
-    assert(oids);
-
-    std::vector<std::string> pnames;
-    te::da::GetOIDPropertyNames(schema.get(), pnames);
-
-    // Generates a geometry from the given extent. It will be used to refine the results
-    std::unique_ptr<te::gm::Geometry> geometryFromEnvelope(te::gm::GetGeomFromEnvelope(&reprojectedEnvelope, m_coordLayer->getSRID()));
-
-    while (dataset->moveNext())
-    {
-      std::unique_ptr<te::gm::Geometry> g(dataset->getGeometry(gp->getName()));
-
-      if (g->getSRID() == TE_UNKNOWN_SRS)
-        g->setSRID(m_coordLayer->getSRID());
-
-      if (!m_buffer->contains(g.get()))
-        continue;
-
-      // Feature found
-      oids->add(te::da::GenerateOID(dataset.get(), pnames));
-    }
-  }
-  catch (std::exception& e)
-  {
-    QMessageBox::critical(m_display, tr("Error"), QString(tr("Error getting geometry. Details:") + " %1.").arg(e.what()));
-    throw;
-  }
-
-  return oids;
+  return geopx::tools::CreateObjectIdSet(m_coordLayer, m_centroidIndex, resultsTree);
 }
 
 void geopx::tools::TrackClassifier::getClassDataSets(te::da::DataSetType* dsType, te::mem::DataSet*& liveDataSet, te::mem::DataSet*& intruderDataSet)
 {
-  // Bulding the query box
-  te::gm::Envelope envelope(*m_buffer->getMBR());
-
-  te::gm::Envelope reprojectedEnvelope(envelope);
-
-  if ((m_coordLayer->getSRID() != TE_UNKNOWN_SRS) && (m_display->getSRID() != TE_UNKNOWN_SRS) && (m_coordLayer->getSRID() != m_display->getSRID()))
-    reprojectedEnvelope.transform(m_display->getSRID(), m_coordLayer->getSRID());
-
-  if (!reprojectedEnvelope.intersects(m_coordLayer->getExtent()))
-    throw;
-
   // Gets the layer schema
   std::unique_ptr<const te::map::LayerSchema> schema(m_coordLayer->getSchema());
 
   if (!schema->hasGeom())
     throw;
 
+  //the buffer is tested against the centroid index, only the features inside it are read
+  std::vector<std::size_t> resultsTree;
+
+  m_corridor->search(m_centroidIndex, resultsTree);
+
+  if (resultsTree.empty())
+    return;
+
   try
   {
     te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(schema.get());
 
+    std::unique_ptr<te::da::ObjectIdSet> oids(geopx::tools::CreateObjectIdSet(m_coordLayer, m_centroidIndex, resultsTree));
+
     // Gets the dataset
-    std::unique_ptr<te::da::DataSet> dataset = m_coordLayer->getData(gp->getName(), &reprojectedEnvelope, te::gm::INTERSECTS);
+    std::unique_ptr<te::da::DataSet> dataset = m_coordLayer->getData(oids.get());
     assert(dataset.get());
 
     std::vector<std::string> pnames;
     te::da::GetOIDPropertyNames(schema.get(), pnames);
 
-    // Generates a geometry from the given extent. It will be used to refine the results
-    std::unique_ptr<te::gm::Geometry> geometryFromEnvelope(te::gm::GetGeomFromEnvelope(&reprojectedEnvelope, m_coordLayer->getSRID()));
-
     while (dataset->moveNext())
     {
       std::unique_ptr<te::gm::Geometry> g(dataset->getGeometry(gp->getName()));
@@ -922,9 +808,6 @@ void geopx::tools::TrackClassifier::getClassDataSets(te::da::DataSetType* dsType
       if (g->getSRID() == TE_UNKNOWN_SRS)
         g->setSRID(m_coordLayer->getSRID());
 
-      if (!m_buffer->contains(g.get()))
-        continue;
-
       // Feature found
       te::da::ObjectId* objId = te::da::GenerateOID(dataset.get(), pnames);
 
@@ -1001,80 +884,16 @@ void geopx::tools::TrackClassifier::createRTree()
 {
   QApplication::setOverrideCursor(Qt::WaitCursor);
 
-  te::common::FreeContents(m_centroidGeomMap);
-  te::common::FreeContents(m_centroidObjIdMap);
+  //the layers are read only if their index snapshots are out of date
+  geopx::tools::CreateLayerIndex(m_coordLayer, m_centroidIndex);
 
-  m_centroidRtree.clear();
-  m_centroidGeomMap.clear();
-  m_centroidObjIdMap.clear();
+  //create polygons index
+  if (m_polyIndex.isEmpty())
+    geopx::tools::CreateLayerIndex(m_polyLayer, m_polyIndex);
 
-  //create rtree
-  std::unique_ptr<const te::map::LayerSchema> schema(m_coordLayer->getSchema());
-  std::unique_ptr<te::da::DataSet> ds(m_coordLayer->getData());
-
-  std::vector<std::string> pnames;
-  te::da::GetOIDPropertyNames(schema.get(), pnames);
-
-  //geom property info
-  te::gm::GeometryProperty* gmProp = te::da::GetFirstGeomProperty(schema.get());
-
-  int geomIdx = te::da::GetPropertyPos(schema.get(), gmProp->getName());
-
-  //id info
-  te::da::PrimaryKey* pk = schema->getPrimaryKey();
-
-  int idIdx = te::da::GetPropertyPos(schema.get(), pk->getProperties()[0]->getName());
-
-  ds->moveBeforeFirst();
-
-  while (ds->moveNext())
-  {
-    std::string strId = ds->getAsString(idIdx);
-
-    int id = atoi(strId.c_str());
-
-    te::gm::Geometry* g = ds->getGeometry(geomIdx).release();
-    const te::gm::Envelope* box = g->getMBR();
-
-    m_centroidRtree.insert(*box, id);
-
-    m_centroidGeomMap.insert(std::map<int, te::gm::Geometry*>::value_type(id, g));
-
-    m_centroidObjIdMap.insert(std::map<int, te::da::ObjectId*>::value_type(id, te::da::GenerateOID(ds.get(), pnames)));
-  }
-
-  //create polygons rtree
-  if (m_polyGeomMap.empty())
-  {
-    std::unique_ptr<const te::map::LayerSchema> schema(m_polyLayer->getSchema());
-    std::unique_ptr<te::da::DataSet> ds(m_polyLayer->getData());
-
-    //geom property info
-    te::gm::GeometryProperty* gmProp = te::da::GetFirstGeomProperty(schema.get());
-
-    int geomIdx = te::da::GetPropertyPos(schema.get(), gmProp->getName());
-
-    //id info
-    te::da::PrimaryKey* pk = schema->getPrimaryKey();
-
-    int idIdx = te::da::GetPropertyPos(schema.get(), pk->getProperties()[0]->getName());
-
-    ds->moveBeforeFirst();
-
-    while (ds->moveNext())
-    {
-      std::string strId = ds->getAsString(idIdx);
-
-      int id = atoi(strId.c_str());
-
-      te::gm::Geometry* g = ds->getGeometry(geomIdx).release();
-      const te::gm::Envelope* box = g->getMBR();
-
-      m_polyRtree.insert(*box, id);
-
-      m_polyGeomMap.insert(std::map<int, te::gm::Geometry*>::value_type(id, g));
-    }
-  }
+  //the parcels are decoded once, in the coord layer SRID
+  if (m_parcelCache.isEmpty() && m_parcelLayer.get())
+    m_parcelCache.load(m_parcelLayer, m_coordLayer->getSRID());
 
   QApplication::restoreOverrideCursor();
 }
@@ -1101,21 +920,9 @@ void geopx::tools::TrackClassifier::getStartIdValue()
   if (!m_coordLayer.get())
     throw;
 
-  std::unique_ptr<te::da::DataSet> dataset = m_coordLayer->getData();
-  std::unique_ptr<te::da::DataSetType> dataSetType = m_coordLayer->getSchema();
-
-  te::da::PrimaryKey* pk = dataSetType->getPrimaryKey();
-  std::string name = pk->getProperties()[0]->getName();
-
-  dataset->moveBeforeFirst();
-
-  while (dataset->moveNext())
-  {
-    int id = dataset->getInt32(name);
-
-    if (id > m_starterId)
-      m_starterId = id;
-  }
+  //the index keeps the primary key values
+  if (m_centroidIndex.getMaxId() > m_starterId)
+    m_starterId = m_centroidIndex.getMaxId();
 
   ++m_starterId;
 }
@@ -13,9 +13,13 @@
 #include <terralib/memory/DataSet.h>
 #include <terralib/qt/widgets/tools/AbstractTool.h>
 #include "../../../Config.h"
+#include "../../core/ParcelCache.h"
+#include "../../core/SpatialIndex.h"
+#include "../../core/TrackCorridor.h"
 
 // STL
 #include <list>
+#include <memory>
 #include <string>
 
 namespace te
@@ -94,8 +98,6 @@ namespace geopx
 
       void getTrackInfo(double& distance, double& dx, double& dy);
 
-      std::unique_ptr<te::gm::Geometry> getParcelGeeom(te::gm::Geometry* root, int& parcelId);
-
       te::gm::Point* createGuessPoint(te::gm::Point* p, double dx, double dy, int srid);
 
       te::da::ObjectIdSet* getBufferObjIdSet();
@@ -118,12 +120,11 @@ namespace geopx
 
       te::da::ObjectIdSet* m_objIdTrackSet;
 
-      te::sam::rtree::Index<int> m_polyRtree;
-      std::map<int, te::gm::Geometry*> m_polyGeomMap;
+      SpatialIndex m_polyIndex;                       //!<The spatial index of the polygons MBR.
+
+      SpatialIndex m_centroidIndex;                   //!<The spatial index of the coord layer (id is the primary key value).
 
-      te::sam::rtree::Index<int> m_centroidRtree;
-      std::map<int, te::gm::Geometry*> m_centroidGeomMap;
-      std::map<int, te::da::ObjectId*> m_centroidObjIdMap;
+      ParcelCache m_parcelCache;                      //!<The parcel polygons in the coord layer SRID.
 
       te::gm::Point* m_point0;
       te::da::ObjectId* m_objId0;
@@ -135,6 +136,7 @@ namespace geopx
       te::da::ObjectId* m_objId2;
 
       te::gm::Geometry* m_buffer;
+      std::unique_ptr<TrackCorridor> m_corridor;      //!<The buffer of the track line used to search the coord layer index.
       te::da::ObjectIdSet* m_track;
 
       std::unique_ptr<te::mem::DataSet> m_dataSet;
@@ -5,6 +5,9 @@
 */
 
 #include "TrackDeadClassifier.h"
+#include "../../core/LayerIndex.h"
+#include "../../core/TrackEngine.h"
+#include "../../core/TrackResultWriter.h"
 
 // TerraLib
 #include <terralib/common/STLUtils.h>
@@ -12,6 +15,7 @@
 #include <terralib/dataaccess/dataset/DataSet.h>
 #include <terralib/dataaccess/dataset/DataSetType.h>
 #include <terralib/dataaccess/dataset/ObjectId.h>
+#include <terralib/dataaccess/dataset/ObjectIdSet.h>
 #include <terralib/dataaccess/query_h.h>
 #include <terralib/dataaccess/utils/Utils.h>
 #include <terralib/datatype/StringProperty.h>
@@ -47,22 +51,10 @@
 #include <cassert>
 #include <memory>
 
-#define DISTANCE 2.0
-#define DISTANCE_TRACK 3.0
-#define TOLERANCE_FACTOR 0.2
-#define TRACK_TOLERANCE_FACTOR 0.3
-#define POLY_AREA_MIN 0.1
-#define POLY_AREA_MAX 2.0
-#define DELTA_TOL 0.1
-#define NDVI_THRESHOLD 120.0
-
-double TePerpendicularDistance(const te::gm::Point& first, const te::gm::Point& last, te::gm::Point& pin, te::gm::Point*& pinter);
-
 geopx::tools::TrackDeadClassifier::TrackDeadClassifier(te::qt::widgets::MapDisplay* display, const QCursor& cursor, te::map::AbstractLayerPtr coordLayer, te::map::AbstractLayerPtr parcelLayer, te::map::AbstractLayerPtr rasterLayer, QObject* parent)
   : AbstractTool(display, parent),
   m_coordLayer(coordLayer),
   m_parcelLayer(parcelLayer),
-  m_track(0),
   m_point0(0),
   m_objId0(0),
   m_point1(0),
@@ -73,13 +65,6 @@ geopx::tools::TrackDeadClassifier::TrackDeadClassifier(te::qt::widgets::MapDispl
   m_distanceTrackLineEdit = 0;
   m_distanceToleranceFactorLineEdit = 0;
 
-  m_dx = 0.;
-  m_dy = 0.;
-  m_distance = DISTANCE;
-
-  m_deadCount = 0;
-  m_deltaTol = DELTA_TOL;
-
   m_classify = false;
 
   setCursor(cursor);
@@ -95,7 +80,7 @@ geopx::tools::TrackDeadClassifier::TrackDeadClassifier(te::qt::widgets::MapDispl
 
   m_ndviRaster = ds->getRaster(0).release();
 
-  m_totalDistance = 0;
+  m_ndviSampler.reset(new geopx::tools::NdviSampler(m_ndviRaster));
 }
 
 geopx::tools::TrackDeadClassifier::~TrackDeadClassifier()
@@ -103,13 +88,11 @@ geopx::tools::TrackDeadClassifier::~TrackDeadClassifier()
   QPixmap* draft = m_display->getDraftPixmap();
   draft->fill(Qt::transparent);
 
-  m_centroidRtree.clear();
-  te::common::FreeContents(m_centroidGeomMap);
-  te::common::FreeContents(m_centroidObjIdMap);
-
   delete m_point0;
   delete m_point1;
 
+  m_ndviSampler.reset();
+
   delete m_ndviRaster;
 }
 
@@ -281,7 +264,6 @@ void geopx::tools::TrackDeadClassifier::selectObjects(QMouseEvent* e)
       else if (!m_point1)
       {
         m_point1 = pClicked;
-        m_totalDistance = m_point0->distance(m_point1);
 
         delete objId;
       }
@@ -336,10 +318,6 @@ void geopx::tools::TrackDeadClassifier::cancelOperation()
 
   m_dataSet.reset();
 
-  std::unique_ptr<te::da::DataSetType> schema = m_coordLayer->getSchema();
-
-  te::da::GetEmptyOIDSet(schema.get(), m_track);
-
   //repaint the layer
   m_display->repaint();
 }
@@ -350,110 +328,71 @@ void geopx::tools::TrackDeadClassifier::deleteOperation()
 
   //create dataset type
   m_dataSet.reset(new te::mem::DataSet(dsType.get()));
-  
 
-  //get dead tolerance info
-  if (m_deadTolLineEdit->text().isEmpty())
-  {
-    m_deltaTol = DELTA_TOL;
-  }
-  else
-  {
-    m_deltaTol = m_deadTolLineEdit->text().toDouble();
-  }
+  geopx::tools::TrackParameters params = getParameters();
 
-  //get distance buffer info
-  double distanceTrack = 0.;
+  //create line buffer
+  TrackCorridor corridor(m_point0->getX(), m_point0->getY(), m_point1->getX(), m_point1->getY(), params.m_distanceTrack / 2.);
 
-  if (m_distanceTrackLineEdit->text().isEmpty())
-  {
-    distanceTrack = DISTANCE_TRACK;
-  }
-  else
-  {
-    distanceTrack = m_distanceTrackLineEdit->text().toDouble();
-  }
+  //check on tree, only the dead ones are read from the layer
+  std::vector<std::size_t> resultsTreeObjs;
 
-  double distanceTrackTol = 0.;
+  corridor.search(m_centroidIndex, resultsTreeObjs);
 
-  if (m_distanceTrackToleranceFactorLineEdit->text().isEmpty())
-  {
-    distanceTrackTol = TRACK_TOLERANCE_FACTOR;
-  }
-  else
+  std::vector<std::size_t> deadObjs;
+
+  for (std::size_t t = 0; t < resultsTreeObjs.size(); ++t)
   {
-    distanceTrackTol = m_distanceTrackToleranceFactorLineEdit->text().toDouble();
+    if (m_classCache.getType(resultsTreeObjs[t]) == CLASSIFICATION_DEAD)
+      deadObjs.push_back(resultsTreeObjs[t]);
   }
 
-  //create line buffer
-  std::unique_ptr<te::gm::LineString> lineSearchBuffer(new te::gm::LineString(2, te::gm::LineStringType, m_coordLayer->getSRID()));
-  lineSearchBuffer->setPoint(0, m_point0->getX(), m_point0->getY());
-  lineSearchBuffer->setPoint(1, m_point1->getX(), m_point1->getY());
-  te::gm::Geometry* geomLineSearchBuffer = lineSearchBuffer->buffer(distanceTrack / 2., 4, te::gm::CapButtType);
-
-  //check on tree
-  te::gm::Envelope ext(*geomLineSearchBuffer->getMBR());
-
-  std::vector<int> resultsTreeObjs;
+  if (!deadObjs.empty())
+  {
+    std::unique_ptr<const te::map::LayerSchema> schema(m_coordLayer->getSchema());
 
-  m_centroidRtree.search(ext, resultsTreeObjs);
+    te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(schema.get());
 
-  std::unique_ptr<const te::map::LayerSchema> schema(m_coordLayer->getSchema());
+    std::unique_ptr<te::da::ObjectIdSet> oids(geopx::tools::CreateObjectIdSet(m_coordLayer, m_centroidIndex, deadObjs));
 
-  te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(schema.get());
-
-  for (std::size_t t = 0; t < resultsTreeObjs.size(); ++t)
-  {
-    std::map<int, te::gm::Geometry*>::iterator it = m_centroidGeomMap.find(resultsTreeObjs[t]);
+    // Gets the dataset
+    std::unique_ptr<te::da::DataSet> dataset = m_coordLayer->getData(oids.get());
+    assert(dataset.get());
 
-    if (it != m_centroidGeomMap.end())
+    while (dataset->moveNext())
     {
-      te::gm::Geometry* g = it->second;
+      std::string type = dataset->getString(4);
 
-      if (geomLineSearchBuffer->covers(g))
+      if (type == "DEAD")
       {
-        // Gets the dataset
-        std::unique_ptr<te::da::DataSet> dataset = m_coordLayer->getData(gp->getName(), g, te::gm::INTERSECTS);
-        assert(dataset.get());
-
-        while (dataset->moveNext())
-        {
-          std::string type = dataset->getString(4);
-
-          if (type == "DEAD")
-          {
-            //create dataset item
-            te::mem::DataSetItem* item = new te::mem::DataSetItem(m_dataSet.get());
+        //create dataset item
+        te::mem::DataSetItem* item = new te::mem::DataSetItem(m_dataSet.get());
 
-            //fid
-            item->setInt32(0, dataset->getInt32("FID"));
+        //fid
+        item->setInt32(0, dataset->getInt32("FID"));
 
-            //set id
-            item->setInt32(1, dataset->getInt32("id"));
+        //set id
+        item->setInt32(1, dataset->getInt32("id"));
 
-            //set origin id
-            item->setInt32(2, dataset->getInt32("originId"));
+        //set origin id
+        item->setInt32(2, dataset->getInt32("originId"));
 
-            //set area
-            item->setDouble(3, dataset->getDouble("area"));
+        //set area
+        item->setDouble(3, dataset->getDouble("area"));
 
-            //forest type
-            item->setString(4, "REMOVED");
+        //forest type
+        item->setString(4, "REMOVED");
 
-            //set geometry
-            item->setGeometry(5, dataset->getGeometry(gp->getName()).release());
+        //set geometry
+        item->setGeometry(5, dataset->getGeometry(gp->getName()).release());
 
-            m_dataSet->add(item);
-          }
-        }
+        m_dataSet->add(item);
       }
     }
   }
 
   removeObjects();
 
-  createRTree();
-
   cancelOperation();
 
   //repaint the layer
@@ -496,6 +435,21 @@ void geopx::tools::TrackDeadClassifier::removeObjects()
         }
 
         dataSource->update(schema->getName(), m_dataSet.get(), properties, ids);
+
+        updateClassCache(m_dataSet.get(), CLASSIFICATION_REMOVED);
+
+        m_classCache.commit();
+
+        //only attributes were changed, the index snapshot is still valid for the new layer files
+        try
+        {
+          geopx::tools::SaveLayerIndex(m_coordLayer, m_centroidIndex);
+        }
+        catch (std::exception& e)
+        {
+          //the classification was saved, only the next start will be slower
+          QMessageBox::warning(m_display, tr("Warning"), QString(tr("Error saving the spatial index. Details:") + " %1.").arg(e.what()));
+        }
       }
     }
   }
@@ -558,460 +512,19 @@ void geopx::tools::TrackDeadClassifier::drawSelecteds()
   }
 }
 
-te::gm::Geometry* geopx::tools::TrackDeadClassifier::createBuffer(te::gm::Point* rootPoint, te::da::ObjectId* objIdRoot, int srid, std::string gpName, te::gm::LineString*& lineBuffer, std::list<te::gm::Point*>& track)
-{
-  std::unique_ptr<te::da::DataSetType> schema = m_coordLayer->getSchema();
-
-  std::vector<std::string> pnames;
-  te::da::GetOIDPropertyNames(schema.get(), pnames);
-
-  //get dead tolerance info
-  if (m_deadTolLineEdit->text().isEmpty())
-  {
-    m_deltaTol = DELTA_TOL;
-  }
-  else
-  {
-    m_deltaTol = m_deadTolLineEdit->text().toDouble();
-  }
-
-  //get distance buffer info
-  double distanceTrack = 0.;
-
-  if (m_distanceTrackLineEdit->text().isEmpty())
-  {
-    distanceTrack = DISTANCE_TRACK;
-  }
-  else
-  {
-    distanceTrack = m_distanceTrackLineEdit->text().toDouble();
-  }
-
-  double distanceTrackTol = 0.;
-
-  if (m_distanceTrackToleranceFactorLineEdit->text().isEmpty())
-  {
-    distanceTrackTol = TRACK_TOLERANCE_FACTOR;
-  }
-  else
-  {
-    distanceTrackTol = m_distanceTrackToleranceFactorLineEdit->text().toDouble();
-  }
-
-  //get parcel geom
-  int parcelId;
-  std::unique_ptr<te::gm::Geometry> parcelGeom = getParcelGeeom(rootPoint, parcelId);
-
-  if (!parcelGeom.get())
-    return 0;
-
-  parcelGeom->setSRID(srid);
-
-  te::da::GetEmptyOIDSet(schema.get(), m_track);
-
-  track.push_back(new te::gm::Point(*rootPoint));
-
-  if (objIdRoot)
-  {
-    m_track->add(objIdRoot);
-  }
-  else
-  {
-    calculateGuessPoint(rootPoint, parcelId);
-  }
-
-  QApplication::setOverrideCursor(Qt::WaitCursor);
-
-  //calculate track info angle
-  if (m_point0 && m_point1)
-  {
-    getTrackInfo(m_point0, m_point1);
-  }
- 
-  double dx = m_dx;
-  double dy = m_dy;
-
-  m_deadCount = 0;
-
-  if (parcelGeom->getSRID() != rootPoint->getSRID())
-    parcelGeom->transform(rootPoint->getSRID());
-
-  te::gm::Point* newRoot = 0;
-
-  while (true)
-  {
-    te::gm::Point* guestPoint = createGuessPoint(rootPoint, dx, dy, srid);
-
-    //create envelope to find if guest point exist
-    double toleranceFactor = 0.;
-
-    if (m_distanceToleranceFactorLineEdit->text().isEmpty())
-    {
-      toleranceFactor = TOLERANCE_FACTOR;
-    }
-    else
-    {
-      toleranceFactor = m_distanceToleranceFactorLineEdit->text().toDouble();
-    }
-
-    //adjust tolerance for dead trees
-    toleranceFactor = toleranceFactor + (m_deadCount * m_deltaTol);
-
-    //stop criteria
-    double curDistance = m_point0->distance(guestPoint);
-
-    if (curDistance > (m_totalDistance + toleranceFactor))
-      break;
-
-    //filter using a line buffer
-    std::unique_ptr<te::gm::LineString> lineSearchBuffer(new te::gm::LineString(2, te::gm::LineStringType, srid));
-    lineSearchBuffer->setPoint(0, rootPoint->getX() + (dx - (dx*toleranceFactor)), rootPoint->getY() + (dy - (dy*toleranceFactor)));
-    lineSearchBuffer->setPoint(1, rootPoint->getX() + (dx + (dx*toleranceFactor)), rootPoint->getY() + (dy + (dy*toleranceFactor)));
-    te::gm::Geometry* geomLineSearchBuffer = lineSearchBuffer->buffer(distanceTrack * distanceTrackTol, 4, te::gm::CapButtType);
-
-    //check on tree
-    te::gm::Envelope ext(*geomLineSearchBuffer->getMBR());
-
-    std::vector<int> resultsTreeObjs;
-
-    m_centroidRtree.search(ext, resultsTreeObjs);
-
-    std::vector<int> resultsTree;
-
-    for (std::size_t t = 0; t < resultsTreeObjs.size(); ++t)
-    {
-      std::map<int, te::gm::Geometry*>::iterator it = m_centroidGeomMap.find(resultsTreeObjs[t]);
-
-      if (it != m_centroidGeomMap.end())
-      {
-        te::gm::Geometry* g = it->second;
-
-        if (geomLineSearchBuffer->covers(g))
-        {
-          resultsTree.push_back(resultsTreeObjs[t]);
-        }
-      }
-    }
-
-    if (resultsTree.empty())
-    {
-      //dead point
-      rootPoint = guestPoint;
-
-      te::gm::Point* pGuessCalculated = calculateGuessPoint(rootPoint, parcelId);
-
-      if (pGuessCalculated)
-      {
-        rootPoint = pGuessCalculated;
-
-        track.push_back(new te::gm::Point(*rootPoint));
-      }
-    }
-    else
-    {
-      //live point
-      te::da::ObjectId* objIdCandidate = 0;
-
-      te::gm::Point* pCandidate = getCandidatePoint(rootPoint, guestPoint, srid, resultsTree, objIdCandidate);
-
-      if (!pCandidate)
-      {
-        te::gm::Point* pGuessCalculated = calculateGuessPoint(guestPoint, parcelId);
-
-        rootPoint = pGuessCalculated;
-      }
-      else
-      {
-        rootPoint = pCandidate;
-
-        m_track->add(objIdCandidate);
-
-        m_deadCount = 0;
-      }
-
-      track.push_back(new te::gm::Point(*rootPoint));
-    }
-
-    //adjust root point to directional line
-    if (newRoot)
-      delete newRoot;
-
-    double dist = TePerpendicularDistance(*m_point0, *m_point1, *rootPoint, newRoot);
-
-    rootPoint = newRoot;
-  }
-
-  delete newRoot;
-
-  QApplication::restoreOverrideCursor();
-
-  if (track.size() < 2)
-  {
-    return 0;
-  }
-
-  //create buffer
-  lineBuffer = new te::gm::LineString(track.size(), te::gm::LineStringType, srid);
-
-  int count = 0;
-  std::list<te::gm::Point*>::iterator it = track.begin();
-  while (it != track.end())
-  {
-    lineBuffer->setPoint(count, (*it)->getX(), (*it)->getY());
-
-    ++count;
-    ++it;
-  }
-
-  return lineBuffer->buffer(distanceTrack / 2., 16, te::gm::CapButtType);
-}
-
-void geopx::tools::TrackDeadClassifier::getTrackInfo(te::gm::Point* point0, te::gm::Point* point1)
-{
-  if (m_distLineEdit->text().isEmpty())
-    m_distance = DISTANCE;
-  else
-    m_distance = m_distLineEdit->text().toDouble();
-  
-  double bigDistance = point0->distance(point1);
-
-  double big_dx = point1->getX() - point0->getX();
-  double big_dy = point1->getY() - point0->getY();
-
-  m_dx = m_distance * big_dx / bigDistance;
-  m_dy = m_distance * big_dy / bigDistance;
-
-  m_classify = true;
-}
-
-std::unique_ptr<te::gm::Geometry> geopx::tools::TrackDeadClassifier::getParcelGeeom(te::gm::Geometry* root, int& parcelId)
-{
-  if (!m_parcelLayer.get())
-    throw;
-
-  // Bulding the query box
-  te::gm::Envelope envelope(*root->getMBR());
-
-  te::gm::Envelope reprojectedEnvelope(envelope);
-
-  if ((root->getSRID() != TE_UNKNOWN_SRS) && (m_parcelLayer->getSRID() != TE_UNKNOWN_SRS) && (root->getSRID() != m_parcelLayer->getSRID()))
-    reprojectedEnvelope.transform(root->getSRID(), m_parcelLayer->getSRID());
-
-  if (!reprojectedEnvelope.intersects(m_parcelLayer->getExtent()))
-    throw;
-
-  // Gets the layer schema
-  std::unique_ptr<const te::map::LayerSchema> schema(m_parcelLayer->getSchema());
-
-  if (!schema->hasGeom())
-    throw;
-
-  te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(schema.get());
-
-  te::da::PrimaryKey* pk = schema->getPrimaryKey();
-  std::string name = pk->getProperties()[0]->getName();
-
-  // Gets the dataset
-  std::unique_ptr<te::da::DataSet> dataset = m_parcelLayer->getData(gp->getName(), &reprojectedEnvelope, te::gm::INTERSECTS);
-
-  assert(dataset.get());
-
-  dataset->moveBeforeFirst();
-
-  std::unique_ptr<te::gm::Geometry> g;
-
-  while (dataset->moveNext())
-  {
-    g = dataset->getGeometry(gp->getName());
-
-    if (g->getSRID() == TE_UNKNOWN_SRS)
-      g->setSRID(m_parcelLayer->getSRID());
-
-    if (g->getSRID() != root->getSRID())
-      g->transform(root->getSRID());
-
-    if (g->covers(root))
-    {
-      parcelId = dataset->getInt32(name);
-
-      break;
-    }
-  }
-
-  return g;
-}
-
-te::gm::Point* geopx::tools::TrackDeadClassifier::createGuessPoint(te::gm::Point* p, double dx, double dy, int srid)
-{
-  return new te::gm::Point(p->getX() + dx, p->getY() + dy, srid);
-}
-
-void geopx::tools::TrackDeadClassifier::getClassDataSets(te::da::DataSetType* dsType, te::mem::DataSet*& liveDataSet, te::mem::DataSet*& intruderDataSet, te::gm::Geometry* buffer)
-{
-  // Bulding the query box
-  te::gm::Envelope envelope(*buffer->getMBR());
-
-  te::gm::Envelope reprojectedEnvelope(envelope);
-
-  if ((m_coordLayer->getSRID() != TE_UNKNOWN_SRS) && (m_display->getSRID() != TE_UNKNOWN_SRS) && (m_coordLayer->getSRID() != m_display->getSRID()))
-    reprojectedEnvelope.transform(m_display->getSRID(), m_coordLayer->getSRID());
-
-  if (!reprojectedEnvelope.intersects(m_coordLayer->getExtent()))
-    throw;
-
-  // Gets the layer schema
-  std::unique_ptr<const te::map::LayerSchema> schema(m_coordLayer->getSchema());
-
-  if (!schema->hasGeom())
-    throw;
-
-  try
-  {
-    te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(schema.get());
-
-    // Gets the dataset
-    std::unique_ptr<te::da::DataSet> dataset = m_coordLayer->getData(gp->getName(), &reprojectedEnvelope, te::gm::INTERSECTS);
-    assert(dataset.get());
-
-    std::vector<std::string> pnames;
-    te::da::GetOIDPropertyNames(schema.get(), pnames);
-
-    // Generates a geometry from the given extent. It will be used to refine the results
-    std::unique_ptr<te::gm::Geometry> geometryFromEnvelope(te::gm::GetGeomFromEnvelope(&reprojectedEnvelope, m_coordLayer->getSRID()));
-
-    while (dataset->moveNext())
-    {
-      std::unique_ptr<te::gm::Geometry> g(dataset->getGeometry(gp->getName()));
-
-      if (g->getSRID() == TE_UNKNOWN_SRS)
-        g->setSRID(m_coordLayer->getSRID());
-
-      if (!buffer->contains(g.get()))
-        continue;
-
-      // Feature found
-      te::da::ObjectId* objId = te::da::GenerateOID(dataset.get(), pnames);
-
-      if (m_track->contains(objId))//live
-      {
-        if (!liveDataSet)
-        {
-          liveDataSet = new te::mem::DataSet(dsType);
-        }
-
-        //create dataset item
-        te::mem::DataSetItem* item = new te::mem::DataSetItem(liveDataSet);
-
-        //fid
-        item->setInt32(0, dataset->getInt32("FID"));
-
-        //set id
-        item->setInt32(1, dataset->getInt32("id"));
-
-        //set origin id
-        item->setInt32(2, dataset->getInt32("originId"));
-
-        //set area
-        item->setDouble(3, dataset->getDouble("area"));
-
-        //forest type
-        item->setString(4, "LIVE");
-
-        //set geometry
-        item->setGeometry(5, g.release());
-
-        liveDataSet->add(item);
-      }
-      else//intruder
-      {
-        if (!intruderDataSet)
-        {
-          intruderDataSet = new te::mem::DataSet(dsType);
-        }
-
-        //create dataset item
-        te::mem::DataSetItem* item = new te::mem::DataSetItem(intruderDataSet);
-
-        //fid
-        item->setInt32(0, dataset->getInt32("FID"));
-
-        //set id
-        item->setInt32(1, dataset->getInt32("id"));
-
-        //set origin id
-        item->setInt32(2, dataset->getInt32("originId"));
-
-        //set area
-        item->setDouble(3, dataset->getDouble("area"));
-
-        //forest type
-        std::string curClass = dataset->getString(4);
-        if (curClass == "DEAD")
-        {
-          item->setString(4, "REMOVED");
-        }
-        else
-          item->setString(4, "INTRUDER");
-
-        //set geometry
-        item->setGeometry(5, g.release());
-
-        intruderDataSet->add(item);
-      }
-    }
-  }
-  catch (std::exception& e)
-  {
-    QMessageBox::critical(m_display, tr("Error"), QString(tr("Error getting geometry. Details:") + " %1.").arg(e.what()));
-    throw;
-  }
-}
-
 void geopx::tools::TrackDeadClassifier::createRTree()
 {
   QApplication::setOverrideCursor(Qt::WaitCursor);
 
-  te::common::FreeContents(m_centroidGeomMap);
-  te::common::FreeContents(m_centroidObjIdMap);
-
-  m_centroidRtree.clear();
-  m_centroidGeomMap.clear();
-  m_centroidObjIdMap.clear();
-
-  //create rtree
-  std::unique_ptr<const te::map::LayerSchema> schema(m_coordLayer->getSchema());
-  std::unique_ptr<te::da::DataSet> ds(m_coordLayer->getData());
+  //the layer is read only if its index snapshot is out of date
+  geopx::tools::CreateLayerIndex(m_coordLayer, m_centroidIndex);
 
-  std::vector<std::string> pnames;
-  te::da::GetOIDPropertyNames(schema.get(), pnames);
+  //the classification is read once and kept up to date by processDataSet and removeObjects
+  m_classCache.load(m_coordLayer, m_centroidIndex);
 
-  //geom property info
-  te::gm::GeometryProperty* gmProp = te::da::GetFirstGeomProperty(schema.get());
-
-  int geomIdx = te::da::GetPropertyPos(schema.get(), gmProp->getName());
-
-  //id info
-  te::da::PrimaryKey* pk = schema->getPrimaryKey();
-
-  int idIdx = te::da::GetPropertyPos(schema.get(), pk->getProperties()[0]->getName());
-
-  ds->moveBeforeFirst();
-
-  while (ds->moveNext())
-  {
-    std::string strId = ds->getAsString(idIdx);
-
-    int id = atoi(strId.c_str());
-
-    te::gm::Geometry* g = ds->getGeometry(geomIdx).release();
-    const te::gm::Envelope* box = g->getMBR();
-
-    m_centroidRtree.insert(*box, id);
-
-    m_centroidGeomMap.insert(std::map<int, te::gm::Geometry*>::value_type(id, g));
-
-    m_centroidObjIdMap.insert(std::map<int, te::da::ObjectId*>::value_type(id, te::da::GenerateOID(ds.get(), pnames)));
-  }
+  //the parcels are decoded once, in the coord layer SRID
+  if (m_parcelLayer.get())
+    m_parcelCache.load(m_parcelLayer, m_coordLayer->getSRID());
 
   QApplication::restoreOverrideCursor();
 }
@@ -1038,344 +551,165 @@ void geopx::tools::TrackDeadClassifier::getStartIdValue()
   if (!m_coordLayer.get())
     throw;
 
-  QApplication::setOverrideCursor(Qt::WaitCursor);
-
-  std::unique_ptr<te::da::DataSet> dataset = m_coordLayer->getData();
-  std::unique_ptr<te::da::DataSetType> dataSetType = m_coordLayer->getSchema();
-
-  te::da::PrimaryKey* pk = dataSetType->getPrimaryKey();
-  std::string name = pk->getProperties()[0]->getName();
-
-  dataset->moveBeforeFirst();
-
-  while (dataset->moveNext())
-  {
-    int id = dataset->getInt32(name);
-
-    if (id > m_starterId)
-      m_starterId = id;
-  }
-
-  QApplication::restoreOverrideCursor();
+  //the index keeps the primary key values
+  if (m_centroidIndex.getMaxId() > m_starterId)
+    m_starterId = m_centroidIndex.getMaxId();
 
   ++m_starterId;
 }
 
-bool geopx::tools::TrackDeadClassifier::isDead(te::da::ObjectId* objId, double& area)
+void geopx::tools::TrackDeadClassifier::processDataSet()
 {
-  if (!m_coordLayer.get())
-    throw;
+  te::map::DataSetLayer* dsLayer = dynamic_cast<te::map::DataSetLayer*>(m_coordLayer.get());
 
-  std::unique_ptr<te::da::DataSetType> schema = m_coordLayer->getSchema();
+  if (!dsLayer)
+    return;
 
-  te::da::ObjectIdSet* objIdSet;
+  QApplication::setOverrideCursor(Qt::WaitCursor);
 
-  te::da::GetEmptyOIDSet(schema.get(), objIdSet);
+  std::unique_ptr<te::da::DataSetType> dsType(m_coordLayer->getSchema());
 
-  objIdSet->add(objId);
+  te::da::DataSourcePtr dataSource = te::da::GetDataSource(dsLayer->getDataSourceId());
 
-  std::unique_ptr<te::da::DataSet> ds = m_coordLayer->getData(objIdSet);
+  geopx::tools::TrackResultWriter writer(dataSource, dsType.get(), m_centroidIndex, m_coordLayer->getSRID(), m_starterId);
 
-  if (!ds->isEmpty())
+  try
   {
-    ds->moveFirst();
+    //get parcel id, it is the origin id of the created trees
+    std::size_t parcelPos = 0;
 
-    std::string classValue = ds->getString("type");
-
-    if (classValue == "DEAD" || classValue == "REMOVED")
-      return true;
-
-    if (classValue == "UNKNOWN")
+    if (m_parcelCache.find(m_point0->getX(), m_point0->getY(), parcelPos))
     {
-      //get area attribute and check threshold
-      area = ds->getDouble("area");
-    }
-  }
-
-  return false;
-}
+      int parcelId = m_parcelCache.getId(parcelPos);
 
-te::gm::Point* geopx::tools::TrackDeadClassifier::calculateGuessPoint(te::gm::Point* p, int parcelId)
-{
-  if (!m_dataSet.get())
-  {
-    std::unique_ptr<te::da::DataSetType> dsType = m_coordLayer->getSchema();
-
-    //create dataset type
-    std::unique_ptr<te::da::DataSetType> dataSetType = createTreeDataSetType();
-
-    m_dataSet.reset(new te::mem::DataSet(dataSetType.get()));
-  }
-
-  double toleranceFactor = 0.;
+      //the first point is a tree of the layer if it was selected over a feature
+      std::size_t rootPos = 0;
+      bool hasRoot = false;
 
-  if (m_distanceToleranceFactorLineEdit->text().isEmpty())
-  {
-    toleranceFactor = TOLERANCE_FACTOR;
-  }
-  else
-  {
-    toleranceFactor = m_distanceToleranceFactorLineEdit->text().toDouble();
-  }
-
-  double thresholdValue = NDVI_THRESHOLD;
+      if (m_objId0)
+      {
+        std::vector<std::size_t> results;
 
-  if (!m_thresholdLineEdit->text().isEmpty())
-  {
-    thresholdValue = m_thresholdLineEdit->text().toDouble();
-  }
+        m_centroidIndex.search(te::gm::Envelope(m_point0->getX(), m_point0->getY(), m_point0->getX(), m_point0->getY()), results);
 
-  m_ndviRaster->getGrid()->setSRID(p->getSRID());
+        for (std::size_t t = 0; t < results.size(); ++t)
+        {
+          if (m_centroidIndex.getX(results[t]) == m_point0->getX() && m_centroidIndex.getY(results[t]) == m_point0->getY())
+          {
+            rootPos = results[t];
+            hasRoot = true;
+            break;
+          }
+        }
+      }
 
-  std::string forestType = "UNKNOWN";
+      geopx::tools::TrackEngine engine(m_centroidIndex, m_classCache, m_ndviSampler.get(), getParameters());
 
-  te::gm::Point* pGuess = 0;
+      geopx::tools::TrackResult result;
 
-  //try guess point
-  te::gm::Coord2D coordGuess = m_ndviRaster->getGrid()->geoToGrid(p->getX(), p->getY());
+      if (engine.classifySegment(parcelId, m_point0->getX(), m_point0->getY(), m_point1->getX(), m_point1->getY(), hasRoot ? &rootPos : 0, result))
+      {
+        writer.add(result);
 
-  double valueGuess = 0.;
+        writer.flush();
 
-  m_ndviRaster->getValue(coordGuess.getX(), coordGuess.getY(), valueGuess);
+        const std::vector<std::pair<std::size_t, unsigned char> >& types = writer.getCommittedTypes();
 
-  if (valueGuess > thresholdValue)
-  {
-    forestType = "LIVE";
+        for (std::size_t t = 0; t < types.size(); ++t)
+          m_classCache.setType(types[t].first, types[t].second);
 
-    m_deadCount = 0;
+        //the index is updated in place instead of reading the layer again
+        indexCreatedObjects(writer);
 
-    pGuess = p;
+        m_starterId = writer.getNextId();
+      }
+    }
   }
-  else
+  catch (std::exception& e)
   {
-    forestType = "DEAD";
-
-    ++m_deadCount;
+    QApplication::restoreOverrideCursor();
 
-    pGuess = p;
+    QMessageBox::critical(m_display, tr("Error"), QString(tr("Error auto classifying track. Details:") + " %1.").arg(e.what()));
   }
 
-  //create dataset item
-  te::mem::DataSetItem* item = new te::mem::DataSetItem(m_dataSet.get());
-
-  //set id
-  item->setInt32(0, m_starterId);
+  m_classCache.commit();
 
-  //set origin id
-  item->setInt32(1, parcelId);
-
-  //set area
-  item->setDouble(2, 0.);
-
-  //forest type
-  item->setString(3, forestType);
-
-  //set geometry
-  item->setGeometry(4, new te::gm::Point(*pGuess));
-
-  m_dataSet->add(item);
-
-  ++m_starterId;
+  m_classify = true;
 
-  return pGuess;
+  QApplication::restoreOverrideCursor();
 }
 
-te::gm::Point* geopx::tools::TrackDeadClassifier::getCandidatePoint(te::gm::Point* pRoot, te::gm::Point* pGuess, int srid, std::vector<int>& resultsTree, te::da::ObjectId*& candidateOjbId)
+geopx::tools::TrackParameters geopx::tools::TrackDeadClassifier::getParameters()
 {
-  double lowerDistance = std::numeric_limits<double>::max();
+  geopx::tools::TrackParameters params;
 
-  double polyAreaMin = 0.;
-  double polyAreaMax = 0.;
+  if (!m_distLineEdit->text().isEmpty())
+    params.m_distance = m_distLineEdit->text().toDouble();
 
-  if (m_polyAreaMin->text().isEmpty())
-  {
-    polyAreaMin = POLY_AREA_MIN;
-  }
-  else
-  {
-    polyAreaMin = m_polyAreaMin->text().toDouble();
-  }
-
-  if (m_polyAreaMax->text().isEmpty())
-  {
-    polyAreaMax = POLY_AREA_MAX;
-  }
-  else
-  {
-    polyAreaMax = m_polyAreaMax->text().toDouble();
-  }
-
-  te::gm::Point* point = 0;
-
-  for (std::size_t t = 0; t < resultsTree.size(); ++t)
-  {
-    std::map<int, te::gm::Geometry*>::iterator it = m_centroidGeomMap.find(resultsTree[t]);
+  if (!m_distanceTrackLineEdit->text().isEmpty())
+    params.m_distanceTrack = m_distanceTrackLineEdit->text().toDouble();
 
-    std::map<int, te::da::ObjectId*>::iterator itObjId = m_centroidObjIdMap.find(resultsTree[t]);
+  if (!m_distanceToleranceFactorLineEdit->text().isEmpty())
+    params.m_toleranceFactor = m_distanceToleranceFactorLineEdit->text().toDouble();
 
-    double area = 0.;
+  if (!m_distanceTrackToleranceFactorLineEdit->text().isEmpty())
+    params.m_trackToleranceFactor = m_distanceTrackToleranceFactorLineEdit->text().toDouble();
 
-    if (!isDead(itObjId->second, area))
-    {
-      if ((area > polyAreaMin && area < polyAreaMax) || area == 0.)
-      {
-        te::gm::Point* pCandidate = getPoint(it->second);
+  if (!m_polyAreaMin->text().isEmpty())
+    params.m_polyAreaMin = m_polyAreaMin->text().toDouble();
 
-        pCandidate->setSRID(srid);
+  if (!m_polyAreaMax->text().isEmpty())
+    params.m_polyAreaMax = m_polyAreaMax->text().toDouble();
 
-        if (pRoot->getX() != pCandidate->getX() || pRoot->getY() != pCandidate->getY())
-        {
-          //check for lower distance from guest point
-          double dist = std::abs(pGuess->distance(pCandidate));
+  if (!m_deadTolLineEdit->text().isEmpty())
+    params.m_deltaTol = m_deadTolLineEdit->text().toDouble();
 
-          if (dist < lowerDistance)
-          {
-            lowerDistance = dist;
-            point = pCandidate;
-            candidateOjbId = itObjId->second;
-          }
-        }
-      }
-    }
-  }
+  if (!m_thresholdLineEdit->text().isEmpty())
+    params.m_ndviThreshold = m_thresholdLineEdit->text().toDouble();
 
-  return point;
+  return params;
 }
 
-std::unique_ptr<te::da::DataSetType> geopx::tools::TrackDeadClassifier::createTreeDataSetType()
+void geopx::tools::TrackDeadClassifier::updateClassCache(te::mem::DataSet* ds, unsigned char type)
 {
-  std::unique_ptr<te::da::DataSetType> dsType = m_coordLayer->getSchema();
-
-  //create dataset type
-  std::unique_ptr<te::da::DataSetType> dataSetType(new te::da::DataSetType(dsType->getName()));
-
-  //create id property
-  te::dt::SimpleProperty* idProperty = new te::dt::SimpleProperty("id", te::dt::INT32_TYPE);
-  dataSetType->add(idProperty);
-
-  //create origin id property
-  te::dt::SimpleProperty* originIdProperty = new te::dt::SimpleProperty("originId", te::dt::INT32_TYPE);
-  dataSetType->add(originIdProperty);
-
-  //create area property
-  te::dt::SimpleProperty* areaProperty = new te::dt::SimpleProperty("area", te::dt::DOUBLE_TYPE);
-  dataSetType->add(areaProperty);
-
-  //create forest type
-  te::dt::StringProperty* typeProperty = new te::dt::StringProperty("type");
-  dataSetType->add(typeProperty);
-
-  //create geometry property
-  te::gm::GeometryProperty* geomProperty = new te::gm::GeometryProperty("geom", m_coordLayer->getSRID(), te::gm::PointType);
-  dataSetType->add(geomProperty);
+  //the first property is the primary key (FID)
+  ds->moveBeforeFirst();
 
-  return dataSetType;
+  while (ds->moveNext())
+  {
+    m_classCache.setTypeById(ds->getInt32(0), type);
+  }
 }
 
-void geopx::tools::TrackDeadClassifier::processDataSet()
+void geopx::tools::TrackDeadClassifier::indexCreatedObjects(const geopx::tools::TrackResultWriter& writer)
 {
-  QApplication::setOverrideCursor(Qt::WaitCursor);
-
-  std::unique_ptr<te::da::DataSetType> dsType(m_coordLayer->getSchema());
+  //the index holds the primary key values, the data source may assign them apart from the id attribute
+  std::map<int, int> keys;
 
-  te::gm::GeometryProperty* gp = te::da::GetFirstGeomProperty(dsType.get());
+  writer.getCreatedKeys(keys);
 
-  // Let's generate the oid
-  std::vector<std::string> pnames;
-  te::da::GetOIDPropertyNames(dsType.get(), pnames);
+  te::mem::DataSet* ds = writer.getCreated();
 
-  m_dataSet.reset();
-
-  te::gm::LineString* line = 0;
-
-  std::list<te::gm::Point*> track;
+  ds->moveBeforeFirst();
 
-  try
+  while (ds->moveNext())
   {
-    std::unique_ptr<te::gm::Geometry> buffer(createBuffer(m_point0, m_objId0, m_coordLayer->getSRID(), gp->getName(), line, track));
-
-    if (buffer.get())
-    {
-      //create dataset type
-      te::mem::DataSet* liveDS = 0;
-      te::mem::DataSet* intruderDS = 0;
-
-      getClassDataSets(dsType.get(), liveDS, intruderDS, buffer.get());
-
-      //class
-      te::map::DataSetLayer* dsLayer = dynamic_cast<te::map::DataSetLayer*>(m_coordLayer.get());
-
-      if (dsLayer)
-      {
-        te::da::DataSourcePtr dataSource = te::da::GetDataSource(dsLayer->getDataSourceId());
+    std::unique_ptr<te::gm::Geometry> g(ds->getGeometry(4));
 
-        //update live dataset
-        std::vector<size_t> ids;
-        ids.push_back(0);
-
-        if (liveDS)
-        {
-          std::vector< std::set<int> > properties;
-          std::size_t dsSize = liveDS->size();
+    te::gm::Point* point = getPoint(g.get());
 
-          for (std::size_t t = 0; t < dsSize; ++t)
-          {
-            std::set<int> setPos;
-            setPos.insert(4);
-
-            properties.push_back(setPos);
-          }
+    if (!point)
+      continue;
 
-          liveDS->moveBeforeFirst();
+    std::map<int, int>::const_iterator it = keys.find(ds->getInt32(0));
 
-          dataSource->update(dsType->getName(), liveDS, properties, ids);
-        }
+    if (it == keys.end())
+      continue;
 
-        //update intruder dataset
-        if (intruderDS)
-        {
-          std::vector< std::set<int> > properties;
-          std::size_t dsSize = intruderDS->size();
-
-          for (std::size_t t = 0; t < dsSize; ++t)
-          {
-            std::set<int> setPos;
-            setPos.insert(4);
-
-            properties.push_back(setPos);
-          }
-
-          intruderDS->moveBeforeFirst();
-
-          dataSource->update(dsType->getName(), intruderDS, properties, ids);
-        }
-
-        //add dead dataset
-        if (m_dataSet.get())
-        {
-          std::map<std::string, std::string> options;
-
-          m_dataSet->moveBeforeFirst();
-
-          dataSource->add(dsType->getName(), m_dataSet.get(), options);
-
-          m_dataSet.reset();
-        }
-      }
-    }
-  }
-  catch (std::exception& e)
-  {
-    QApplication::restoreOverrideCursor();
+    std::size_t pos = m_centroidIndex.insert(it->second, point->getX(), point->getY());
 
-    QMessageBox::critical(m_display, tr("Error"), QString(tr("Error auto classifying track. Details:") + " %1.").arg(e.what()));
+    m_classCache.insert(pos, geopx::tools::ClassificationCache::GetType(ds->getString(3)), ds->getDouble(2));
   }
-
-  m_classify = true;
-
-  createRTree();
-
-  QApplication::restoreOverrideCursor();
 }
 
 bool geopx::tools::TrackDeadClassifier::deadTrackMouseMove(QMouseEvent* e)
@@ -1501,48 +835,3 @@ bool geopx::tools::TrackDeadClassifier::panMouseReleaseEvent(QMouseEvent* e)
 
   return true;
 }
-
-double TePerpendicularDistance(const te::gm::Point& first, const te::gm::Point& last, te::gm::Point& pin, te::gm::Point*& pinter)
-{
-  double d12, xmin, ymin;
-
-  double xi = first.getX();
-  double xf = last.getX();
-  double yi = first.getY();
-  double yf = last.getY();
-  double x = pin.getX();
-  double y = pin.getY();
-
-  double dx = xf - xi;
-  double dy = yf - yi;
-  double a2 = (y - yi) * dx - (x - xi)*dy;
-
-  if (dx == 0. && dy == 0.)
-  {
-    d12 = sqrt(((x - xi) * (x - xi)) + ((y - yi) * (y - yi)));
-    d12 *= d12;
-  }
-  else
-    d12 = a2 * a2 / (dx * dx + dy * dy);
-
-  if (dx == 0.)
-  {
-    xmin = xi;
-    ymin = y;
-  }
-  else if (dy == 0.)
-  {
-    xmin = x;
-    ymin = yi;
-  }
-  else
-  {
-    double alfa = dy / dx;
-    xmin = (x + alfa * (y - yi) + alfa * alfa * xi) / (1. + alfa * alfa);
-    ymin = (x - xmin) / alfa + y;
-  }
-
-  pinter = new te::gm::Point(xmin, ymin, pin.getSRID());
-
-  return (sqrt(d12));
-}
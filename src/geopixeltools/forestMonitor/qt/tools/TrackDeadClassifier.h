@@ -13,9 +13,15 @@
 #include <terralib/memory/DataSet.h>
 #include <terralib/qt/widgets/tools/AbstractTool.h>
 #include "../../../Config.h"
+#include "../../core/ClassificationCache.h"
+#include "../../core/NdviSampler.h"
+#include "../../core/ParcelCache.h"
+#include "../../core/SpatialIndex.h"
+#include "../../core/TrackCorridor.h"
+#include "../../core/TrackEngine.h"
 
 // STL
-#include <list>
+#include <memory>
 #include <string>
 
 // QT
@@ -42,6 +48,7 @@ namespace geopx
 {
   namespace tools
   {
+    class TrackResultWriter;
 
     /*!
       \class TrackClassifier
@@ -105,31 +112,19 @@ namespace geopx
 
       void drawSelecteds();
 
-      te::gm::Geometry* createBuffer(te::gm::Point* rootPoint, te::da::ObjectId* objIdRoot, int srid, std::string gpName, te::gm::LineString*& lineBuffer, std::list<te::gm::Point*>& track);
-
-      void getTrackInfo(te::gm::Point* point0, te::gm::Point* point1);
-
-      std::unique_ptr<te::gm::Geometry> getParcelGeeom(te::gm::Geometry* root, int& parcelId);
-
-      te::gm::Point* createGuessPoint(te::gm::Point* p, double dx, double dy, int srid);
-
-      void getClassDataSets(te::da::DataSetType* dsType, te::mem::DataSet*& liveDataSet, te::mem::DataSet*& intruderDataSet, te::gm::Geometry* buffer);
-
       void createRTree();
 
       te::gm::Point* getPoint(te::gm::Geometry* g);
 
       void getStartIdValue();
 
-      bool isDead(te::da::ObjectId* objId, double& area);
-
-      te::gm::Point* calculateGuessPoint(te::gm::Point* p, int parcelId);
+      void processDataSet();
 
-      te::gm::Point* getCandidatePoint(te::gm::Point* pRoot, te::gm::Point* pGuess, int srid, std::vector<int>& resultsTree, te::da::ObjectId*& candidateOjbId);
+      TrackParameters getParameters();
 
-      std::unique_ptr<te::da::DataSetType> createTreeDataSetType();
+      void updateClassCache(te::mem::DataSet* ds, unsigned char type);
 
-      void processDataSet();
+      void indexCreatedObjects(const geopx::tools::TrackResultWriter& writer);
 
       bool deadTrackMouseMove(QMouseEvent* e);
 
@@ -144,17 +139,15 @@ namespace geopx
       te::map::AbstractLayerPtr m_coordLayer;         //!<The layer that will be classified.
       te::map::AbstractLayerPtr m_parcelLayer;        //!<The layer with geometry restriction.
 
-      te::sam::rtree::Index<int> m_centroidRtree;
-      std::map<int, te::gm::Geometry*> m_centroidGeomMap;
-      std::map<int, te::da::ObjectId*> m_centroidObjIdMap;
+      SpatialIndex m_centroidIndex;                   //!<The spatial index of the coord layer (id is the primary key value).
+      ClassificationCache m_classCache;               //!<The type and area of the coord layer objects (index positions).
+      ParcelCache m_parcelCache;                      //!<The parcel polygons in the coord layer SRID.
 
       te::gm::Point* m_point0;
       te::da::ObjectId* m_objId0;
 
       te::gm::Point* m_point1;
 
-      te::da::ObjectIdSet* m_track;
-
       std::unique_ptr<te::mem::DataSet> m_dataSet;
 
       int m_starterId;
@@ -168,18 +161,10 @@ namespace geopx
       QLineEdit* m_deadTolLineEdit;
       QLineEdit* m_thresholdLineEdit;
 
-      double m_dx;
-      double m_dy;
-      double m_distance;
-
       bool m_classify;
 
-      unsigned int m_deadCount;
-      double m_deltaTol;
-
-      double m_totalDistance;
-
       te::rst::Raster* m_ndviRaster;
+      std::unique_ptr<NdviSampler> m_ndviSampler;     //!<Reads the NDVI values of the guess points.
 
       //pan attributes
       bool m_panStarted;      //!< Flag that indicates if pan operation was started.
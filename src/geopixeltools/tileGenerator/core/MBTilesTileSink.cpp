@@ -0,0 +1,479 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/MBTilesTileSink.cpp
+
+  \brief This file contains a tile sink that stores the tiles in a MBTiles file.
+*/
+
+#include "MBTilesTileSink.h"
+#include "TileStatistics.h"
+
+//TerraLib Includes
+#include <terralib/core/Exception.h>
+
+//STL Includes
+#include <utility>
+
+//SQLite Includes
+#include <sqlite3.h>
+
+//Qt Includes
+#include <QCryptographicHash>
+
+geopx::tools::MBTilesTileSink::MBTilesTileSink(const std::string& fileName, std::size_t queueSize, std::size_t transactionSize) :
+  m_db(0),
+  m_insertMap(0),
+  m_deleteMap(0),
+  m_insertImage(0),
+  m_selectTile(0),
+  m_existsTile(0),
+  m_selectLevel(0),
+  m_insertMetadata(0),
+  m_queueSize(queueSize ? queueSize : 1),
+  m_transactionSize(transactionSize ? transactionSize : 1),
+  m_pending(0),
+  m_inTransaction(false),
+  m_commit(false),
+  m_hadTiles(false),
+  m_removed(false),
+  m_stop(false)
+{
+  if(sqlite3_open_v2(fileName.c_str(), &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0) != SQLITE_OK)
+  {
+    std::string error = m_db ? sqlite3_errmsg(m_db) : "out of memory";
+
+    sqlite3_close(m_db);
+
+    throw te::core::Exception() << te::ErrorDescription("Error opening the MBTiles file " + fileName + ": " + error);
+  }
+
+  try
+  {
+    //the file is a cache that can be created again, so it is not synced after each transaction
+    execute("PRAGMA synchronous=OFF");
+
+    execute("CREATE TABLE IF NOT EXISTS map (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_id TEXT)");
+    execute("CREATE UNIQUE INDEX IF NOT EXISTS map_index ON map (zoom_level, tile_column, tile_row)");
+    execute("CREATE TABLE IF NOT EXISTS images (tile_data BLOB, tile_id TEXT)");
+    execute("CREATE UNIQUE INDEX IF NOT EXISTS images_id ON images (tile_id)");
+    execute("CREATE TABLE IF NOT EXISTS metadata (name TEXT, value TEXT)");
+    execute("CREATE UNIQUE INDEX IF NOT EXISTS name ON metadata (name)");
+    execute("CREATE VIEW IF NOT EXISTS tiles AS SELECT map.zoom_level AS zoom_level, map.tile_column AS tile_column, "
+            "map.tile_row AS tile_row, images.tile_data AS tile_data FROM map JOIN images ON images.tile_id = map.tile_id");
+
+    m_insertMap = prepare("INSERT OR REPLACE INTO map (zoom_level, tile_column, tile_row, tile_id) VALUES (?, ?, ?, ?)");
+    m_deleteMap = prepare("DELETE FROM map WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?");
+    m_insertImage = prepare("INSERT OR IGNORE INTO images (tile_data, tile_id) VALUES (?, ?)");
+    m_selectTile = prepare("SELECT tile_data FROM tiles WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?");
+    m_existsTile = prepare("SELECT 1 FROM map WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?");
+    m_selectLevel = prepare("SELECT tile_column, tile_row FROM map WHERE zoom_level = ?");
+    m_insertMetadata = prepare("INSERT OR REPLACE INTO metadata (name, value) VALUES (?, ?)");
+
+    //a tile rewritten may leave its old image without references
+    sqlite3_stmt* anyTile = prepare("SELECT 1 FROM map LIMIT 1");
+
+    m_hadTiles = sqlite3_step(anyTile) == SQLITE_ROW;
+
+    sqlite3_finalize(anyTile);
+  }
+  catch(...)
+  {
+    sqlite3_finalize(m_insertMap);
+    sqlite3_finalize(m_deleteMap);
+    sqlite3_finalize(m_insertImage);
+    sqlite3_finalize(m_selectTile);
+    sqlite3_finalize(m_existsTile);
+    sqlite3_finalize(m_selectLevel);
+    sqlite3_close(m_db);
+
+    throw;
+  }
+
+  m_writer = std::thread(&MBTilesTileSink::run, this);
+}
+
+geopx::tools::MBTilesTileSink::~MBTilesTileSink()
+{
+  stop();
+
+  sqlite3_finalize(m_insertMap);
+  sqlite3_finalize(m_deleteMap);
+  sqlite3_finalize(m_insertImage);
+  sqlite3_finalize(m_selectTile);
+  sqlite3_finalize(m_existsTile);
+  sqlite3_finalize(m_selectLevel);
+  sqlite3_finalize(m_insertMetadata);
+
+  sqlite3_close(m_db);
+}
+
+void geopx::tools::MBTilesTileSink::write(int level, long x, long y, const QByteArray& data)
+{
+  TileData tile;
+  tile.m_level = level;
+  tile.m_x = x;
+  tile.m_y = y;
+  tile.m_data = data;
+  tile.m_remove = false;
+
+  enqueue(tile);
+}
+
+void geopx::tools::MBTilesTileSink::remove(int level, long x, long y)
+{
+  TileData tile;
+  tile.m_level = level;
+  tile.m_x = x;
+  tile.m_y = y;
+  tile.m_remove = true;
+
+  enqueue(tile);
+}
+
+void geopx::tools::MBTilesTileSink::enqueue(const TileData& tile)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  m_notFull.wait(lock, [this] { return m_queue.size() < m_queueSize || !m_error.empty() || m_stop; });
+
+  if(!m_error.empty())
+    throw te::core::Exception() << te::ErrorDescription(m_error);
+
+  if(m_stop)
+    throw te::core::Exception() << te::ErrorDescription("Tile sink already closed.");
+
+  m_queue.push_back(tile);
+
+  lock.unlock();
+
+  m_notEmpty.notify_one();
+}
+
+bool geopx::tools::MBTilesTileSink::read(int level, long x, long y, QByteArray& data)
+{
+  std::lock_guard<std::mutex> lock(m_dbMutex);
+
+  sqlite3_bind_int(m_selectTile, 1, level);
+  sqlite3_bind_int64(m_selectTile, 2, x);
+  sqlite3_bind_int64(m_selectTile, 3, getTMSRow(level, y));
+
+  bool found = false;
+
+  if(sqlite3_step(m_selectTile) == SQLITE_ROW)
+  {
+    const char* blob = static_cast<const char*>(sqlite3_column_blob(m_selectTile, 0));
+
+    data = QByteArray(blob, sqlite3_column_bytes(m_selectTile, 0));
+
+    found = true;
+  }
+
+  sqlite3_reset(m_selectTile);
+
+  return found;
+}
+
+bool geopx::tools::MBTilesTileSink::exists(int level, long x, long y)
+{
+  std::lock_guard<std::mutex> lock(m_dbMutex);
+
+  sqlite3_bind_int(m_existsTile, 1, level);
+  sqlite3_bind_int64(m_existsTile, 2, x);
+  sqlite3_bind_int64(m_existsTile, 3, getTMSRow(level, y));
+
+  bool found = sqlite3_step(m_existsTile) == SQLITE_ROW;
+
+  sqlite3_reset(m_existsTile);
+
+  return found;
+}
+
+void geopx::tools::MBTilesTileSink::getStoredTiles(int level, std::set<std::pair<long, long> >& tiles)
+{
+  std::lock_guard<std::mutex> lock(m_dbMutex);
+
+  sqlite3_bind_int(m_selectLevel, 1, level);
+
+  int ret;
+
+  while((ret = sqlite3_step(m_selectLevel)) == SQLITE_ROW)
+    tiles.insert(std::make_pair(static_cast<long>(sqlite3_column_int64(m_selectLevel, 0)), getTMSRow(level, static_cast<long>(sqlite3_column_int64(m_selectLevel, 1)))));
+
+  sqlite3_reset(m_selectLevel);
+
+  if(ret != SQLITE_DONE)
+    throwError("Error reading the tiles of a level");
+}
+
+void geopx::tools::MBTilesTileSink::flush()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  if(m_error.empty() && !m_stop)
+  {
+    m_commit = true;
+
+    m_notEmpty.notify_one();
+
+    m_idle.wait(lock, [this] { return !m_commit || !m_error.empty(); });
+  }
+
+  if(!m_error.empty())
+    throw te::core::Exception() << te::ErrorDescription(m_error);
+}
+
+void geopx::tools::MBTilesTileSink::setMetadata(const std::string& name, const std::string& value)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_metadata[name] = value;
+}
+
+void geopx::tools::MBTilesTileSink::run()
+{
+  std::vector<TileData> tiles;
+
+  while(true)
+  {
+    bool stop = false;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+
+      m_notEmpty.wait(lock, [this] { return !m_queue.empty() || m_commit || m_stop; });
+
+      //get all tiles queued
+      while(!m_queue.empty())
+      {
+        tiles.push_back(std::move(m_queue.front()));
+        m_queue.pop_front();
+      }
+
+      stop = tiles.empty() && m_stop;
+    }
+
+    m_notFull.notify_all();
+
+    try
+    {
+      if(!tiles.empty())
+        insert(tiles);
+      else
+        commit();
+    }
+    catch(const boost::exception& e)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      const std::string* description = boost::get_error_info<te::ErrorDescription>(e);
+
+      m_error = description ? *description : "Error writing the tiles.";
+    }
+    catch(const std::exception& e)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      m_error = e.what();
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      m_error = "Error writing the tiles.";
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if(!m_error.empty())
+    {
+      m_queue.clear();
+
+      lock.unlock();
+
+      m_notFull.notify_all();
+      m_idle.notify_all();
+      return;
+    }
+
+    //the queue was empty, so the commit asked is done
+    if(tiles.empty())
+    {
+      m_commit = false;
+
+      lock.unlock();
+
+      m_idle.notify_all();
+    }
+
+    tiles.clear();
+
+    if(stop)
+      return;
+  }
+}
+
+void geopx::tools::MBTilesTileSink::insert(std::vector<TileData>& tiles)
+{
+  std::lock_guard<std::mutex> lock(m_dbMutex);
+
+  for(std::size_t t = 0; t < tiles.size(); ++t)
+  {
+    //the write time of the tile includes the transaction commit it completes
+    TileStageTimer timer(m_statistics, TILE_STAGE_WRITE, tiles[t].m_level);
+
+    if(!m_inTransaction)
+    {
+      execute("BEGIN TRANSACTION");
+
+      m_inTransaction = true;
+    }
+
+    if(tiles[t].m_remove)
+    {
+      sqlite3_bind_int(m_deleteMap, 1, tiles[t].m_level);
+      sqlite3_bind_int64(m_deleteMap, 2, tiles[t].m_x);
+      sqlite3_bind_int64(m_deleteMap, 3, getTMSRow(tiles[t].m_level, tiles[t].m_y));
+
+      int ret = sqlite3_step(m_deleteMap);
+
+      sqlite3_reset(m_deleteMap);
+
+      if(ret != SQLITE_DONE)
+        throwError("Error removing a tile");
+
+      m_removed = true;
+    }
+    else
+    {
+      //identical images share the same row of the images table
+      QByteArray id = QCryptographicHash::hash(tiles[t].m_data, QCryptographicHash::Md5).toHex();
+
+      sqlite3_bind_blob(m_insertImage, 1, tiles[t].m_data.constData(), tiles[t].m_data.size(), SQLITE_STATIC);
+      sqlite3_bind_text(m_insertImage, 2, id.constData(), id.size(), SQLITE_STATIC);
+
+      int ret = sqlite3_step(m_insertImage);
+
+      sqlite3_reset(m_insertImage);
+
+      if(ret != SQLITE_DONE)
+        throwError("Error inserting a tile image");
+
+      sqlite3_bind_int(m_insertMap, 1, tiles[t].m_level);
+      sqlite3_bind_int64(m_insertMap, 2, tiles[t].m_x);
+      sqlite3_bind_int64(m_insertMap, 3, getTMSRow(tiles[t].m_level, tiles[t].m_y));
+      sqlite3_bind_text(m_insertMap, 4, id.constData(), id.size(), SQLITE_STATIC);
+
+      ret = sqlite3_step(m_insertMap);
+
+      sqlite3_reset(m_insertMap);
+
+      if(ret != SQLITE_DONE)
+        throwError("Error inserting a tile");
+    }
+
+    if(++m_pending >= m_transactionSize)
+    {
+      execute("COMMIT TRANSACTION");
+
+      m_inTransaction = false;
+      m_pending = 0;
+    }
+  }
+}
+
+void geopx::tools::MBTilesTileSink::commit()
+{
+  std::map<std::string, std::string> metadata;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    metadata = m_metadata;
+  }
+
+  std::lock_guard<std::mutex> lock(m_dbMutex);
+
+  //the commit is not spent on a level, so only the stage time is added
+  TileStageTimer timer(m_statistics, TILE_STAGE_WRITE, -1);
+
+  if(!m_inTransaction)
+  {
+    execute("BEGIN TRANSACTION");
+
+    m_inTransaction = true;
+  }
+
+  //the tiles of a new file are written once, so only a file updated can have orphan images
+  if(m_hadTiles || m_removed)
+  {
+    execute("DELETE FROM images WHERE tile_id NOT IN (SELECT tile_id FROM map)");
+
+    m_removed = false;
+  }
+
+  for(std::map<std::string, std::string>::const_iterator it = metadata.begin(); it != metadata.end(); ++it)
+  {
+    sqlite3_bind_text(m_insertMetadata, 1, it->first.c_str(), static_cast<int>(it->first.size()), SQLITE_STATIC);
+    sqlite3_bind_text(m_insertMetadata, 2, it->second.c_str(), static_cast<int>(it->second.size()), SQLITE_STATIC);
+
+    int ret = sqlite3_step(m_insertMetadata);
+
+    sqlite3_reset(m_insertMetadata);
+
+    if(ret != SQLITE_DONE)
+      throwError("Error inserting the metadata");
+  }
+
+  execute("COMMIT TRANSACTION");
+
+  m_inTransaction = false;
+  m_pending = 0;
+}
+
+void geopx::tools::MBTilesTileSink::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_stop = true;
+  }
+
+  m_notEmpty.notify_all();
+  m_notFull.notify_all();
+
+  if(m_writer.joinable())
+    m_writer.join();
+}
+
+void geopx::tools::MBTilesTileSink::execute(const std::string& sql)
+{
+  char* error = 0;
+
+  if(sqlite3_exec(m_db, sql.c_str(), 0, 0, &error) != SQLITE_OK)
+  {
+    std::string message = error ? error : "unknown error";
+
+    sqlite3_free(error);
+
+    throw te::core::Exception() << te::ErrorDescription("Error executing " + sql + ": " + message);
+  }
+}
+
+sqlite3_stmt* geopx::tools::MBTilesTileSink::prepare(const std::string& sql)
+{
+  sqlite3_stmt* stmt = 0;
+
+  if(sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, 0) != SQLITE_OK)
+    throwError("Error preparing " + sql);
+
+  return stmt;
+}
+
+long geopx::tools::MBTilesTileSink::getTMSRow(int level, long y)
+{
+  return (1L << level) - 1 - y;
+}
+
+void geopx::tools::MBTilesTileSink::throwError(const std::string& message)
+{
+  throw te::core::Exception() << te::ErrorDescription(message + ": " + sqlite3_errmsg(m_db));
+}
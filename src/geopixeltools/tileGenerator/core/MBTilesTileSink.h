@@ -0,0 +1,166 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/MBTilesTileSink.h
+
+  \brief This file contains a tile sink that stores the tiles in a MBTiles file.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_TILEGENERATOR_MBTILESTILESINK_H
+#define __GEOPXDESKTOP_TOOLS_TILEGENERATOR_MBTILESTILESINK_H
+
+#include "../../Config.h"
+#include "TileSink.h"
+
+//STL Includes
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MBTILES_SINK_QUEUE_SIZE 256
+#define MBTILES_SINK_TRANSACTION_SIZE 10000
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \class MBTilesTileSink
+
+      \brief A sink that stores the tiles in a single MBTiles (SQLite) file.
+
+      The file uses the deduplicated MBTiles layout: the map table points each tile to a row
+      of the images table by the hash of its data, so identical tiles (water, empty land)
+      are stored once. The tiles view gives the standard MBTiles access. The tile rows are
+      stored in the TMS order (row 0 at the south).
+
+      The tiles are kept in a bounded queue and a single writer thread inserts them, committing
+      a transaction for each block of tiles. write() blocks while the queue is full. The write
+      times given to the statistics are measured by the writer thread, for the inserts and the commits.
+
+      When tiles are rewritten or removed, the images no longer referenced by the map table
+      are deleted by flush.
+    */
+    class MBTilesTileSink : public TileSink
+    {
+      public:
+
+        /*!
+          \brief Opens or creates the file and starts the writer thread.
+
+          \param fileName         The MBTiles file.
+          \param queueSize        Maximum number of tiles waiting to be written.
+          \param transactionSize  Number of tiles inserted by each transaction.
+        */
+        MBTilesTileSink(const std::string& fileName, std::size_t queueSize = MBTILES_SINK_QUEUE_SIZE,
+                        std::size_t transactionSize = MBTILES_SINK_TRANSACTION_SIZE);
+
+        /*! \brief Writes the pending tiles, stops the writer thread and closes the file. */
+        ~MBTilesTileSink();
+
+      public:
+
+        /*! \brief Adds a tile to the queue. Throws if the writer has failed. */
+        void write(int level, long x, long y, const QByteArray& data);
+
+        /*! \brief Adds the removal of a tile to the queue, its image is deleted by flush if no other tile uses it. */
+        void remove(int level, long x, long y);
+
+        /*! \brief Reads a tile, the tiles written are found after flush. */
+        bool read(int level, long x, long y, QByteArray& data);
+
+        bool exists(int level, long x, long y);
+
+        /*! \brief Reads the tiles of the level from the map table, the tiles written are found after flush. */
+        void getStoredTiles(int level, std::set<std::pair<long, long> >& tiles);
+
+        /*! \brief Writes the pending tiles and the metadata, deletes the orphan images and commits them. Throws if the writer has failed. */
+        void flush();
+
+        /*! \brief Sets a value of the metadata table (name, format, bounds, minzoom, maxzoom...), written by flush. */
+        void setMetadata(const std::string& name, const std::string& value);
+
+      protected:
+
+        struct TileData
+        {
+          int m_level;
+          long m_x;
+          long m_y;
+          QByteArray m_data;
+          bool m_remove;                                  //!< True if the tile is removed.
+        };
+
+        /*! \brief Adds a tile to the queue, waiting while it is full. */
+        void enqueue(const TileData& tile);
+
+        /*! \brief Writer thread loop. */
+        void run();
+
+        /*! \brief Inserts or removes the tiles, a transaction is started if there is none. */
+        void insert(std::vector<TileData>& tiles);
+
+        /*! \brief Deletes the orphan images, writes the metadata and commits the current transaction. */
+        void commit();
+
+        /*! \brief Stops the writer thread after the queue is empty. */
+        void stop();
+
+        /*! \brief Runs a statement without results. */
+        void execute(const std::string& sql);
+
+        /*! \brief Prepares a statement. */
+        sqlite3_stmt* prepare(const std::string& sql);
+
+        /*! \brief Converts the tile row to the TMS row stored. */
+        static long getTMSRow(int level, long y);
+
+        /*! \brief Throws an exception with the last SQLite error. */
+        void throwError(const std::string& message);
+
+      protected:
+
+        sqlite3* m_db;                                    //!< The MBTiles file.
+
+        sqlite3_stmt* m_insertMap;                        //!< Inserts a tile into the map table.
+        sqlite3_stmt* m_deleteMap;                        //!< Removes a tile from the map table.
+        sqlite3_stmt* m_insertImage;                      //!< Inserts a blob into the images table (ignored if it exists).
+        sqlite3_stmt* m_selectTile;                       //!< Reads a tile.
+        sqlite3_stmt* m_existsTile;                       //!< Checks if a tile exists.
+        sqlite3_stmt* m_selectLevel;                      //!< Reads the tiles of a level.
+        sqlite3_stmt* m_insertMetadata;                   //!< Inserts a metadata value.
+
+        std::mutex m_dbMutex;                             //!< Protects the file and the statements.
+
+        std::size_t m_queueSize;
+        std::size_t m_transactionSize;
+
+        std::deque<TileData> m_queue;                     //!< Tiles waiting to be written.
+        std::size_t m_pending;                            //!< Tiles inserted and not committed (used by the writer).
+        bool m_inTransaction;                             //!< True if a transaction is open (used by the writer).
+        bool m_commit;                                    //!< Asks the writer to commit after the queue is empty.
+        bool m_hadTiles;                                  //!< True if the file had tiles when opened, so they may be rewritten.
+        bool m_removed;                                   //!< True if tiles were removed since the last commit (used by the writer).
+
+        std::map<std::string, std::string> m_metadata;    //!< The metadata values.
+
+        std::mutex m_mutex;                               //!< Protects the queue, the metadata and the state.
+        std::condition_variable m_notEmpty;               //!< Signaled when a tile is added, a commit is asked or the sink is stopped.
+        std::condition_variable m_notFull;                //!< Signaled when the writer removes tiles from the queue.
+        std::condition_variable m_idle;                   //!< Signaled when the writer commits.
+
+        bool m_stop;                                      //!< Flag used to finish the writer thread.
+        std::string m_error;                              //!< The writer error, if any.
+
+        std::thread m_writer;                             //!< The writer thread.
+    };
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_TILEGENERATOR_MBTILESTILESINK_H
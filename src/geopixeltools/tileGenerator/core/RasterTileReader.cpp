@@ -0,0 +1,367 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/RasterTileReader.cpp
+
+  \brief This file contains a class used to create the tiles reading the raster data directly.
+*/
+
+#include "RasterTileReader.h"
+
+//TerraLib Includes
+#include <terralib/datatype/Enums.h>
+#include <terralib/raster/Band.h>
+#include <terralib/raster/BandProperty.h>
+#include <terralib/raster/Grid.h>
+#include <terralib/raster/Raster.h>
+#include <terralib/se/ChannelSelection.h>
+#include <terralib/se/ContrastEnhancement.h>
+#include <terralib/se/RasterSymbolizer.h>
+#include <terralib/se/SelectedChannel.h>
+#include <terralib/se/Style.h>
+#include <terralib/se/Utils.h>
+#include <terralib/srs/Converter.h>
+
+//STL Includes
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+  /*! Converts an 8 bit value, the no data values are marked */
+  inline unsigned short GetValue(double value, double noDataValue)
+  {
+    if(value == noDataValue)
+      return RASTER_TILE_READER_NODATA;
+
+    return static_cast<unsigned short>(value);
+  }
+
+  /*! Returns true if the parameter is not set or has the value that does not change the pixels */
+  bool IsNeutral(const te::se::ParameterValue* param, double neutral)
+  {
+    return !param || te::se::GetDouble(param) == neutral;
+  }
+
+  /*! Returns true if the contrast enhancement is not set or does not change the pixels */
+  bool IsNeutral(const te::se::ContrastEnhancement* contrast)
+  {
+    return !contrast || contrast->getGammaValue() == 1.;
+  }
+
+  /*! Gets the band of a channel, returns false if it is not a band of the raster or its contrast is changed */
+  bool GetChannelBand(const te::se::SelectedChannel* channel, std::size_t nBands, std::size_t& band)
+  {
+    if(!channel || !IsNeutral(channel->getContrastEnhancement()))
+      return false;
+
+    const std::string& name = channel->getSourceChannelName();
+
+    char* end = 0;
+
+    long value = std::strtol(name.c_str(), &end, 10);
+
+    if(name.empty() || *end != '\0' || value < 0 || static_cast<std::size_t>(value) >= nBands)
+      return false;
+
+    band = static_cast<std::size_t>(value);
+
+    return true;
+  }
+}
+
+geopx::tools::RasterTileReader::RasterTileReader(te::rst::Raster* raster, const std::vector<std::size_t>& bands, const QColor& background,
+                                                 std::size_t maxBlocks) :
+  m_raster(raster),
+  m_srid(raster->getSRID()),
+  m_background(qPremultiply(background.rgba())),
+  m_maxBlocks(maxBlocks ? maxBlocks : 1)
+{
+  assert(m_raster);
+  assert(bands.size() == 1 || bands.size() == 3);
+
+  for(std::size_t t = 0; t < bands.size(); ++t)
+    m_bands.push_back(m_raster->getBand(bands[t]));
+
+  te::rst::Grid* grid = m_raster->getGrid();
+
+  //the transform is affine, three locations are enough to get its coefficients
+  double x0 = grid->getExtent()->getLowerLeftX();
+  double y0 = grid->getExtent()->getLowerLeftY();
+
+  te::gm::Coord2D c0 = grid->geoToGrid(x0, y0);
+  te::gm::Coord2D cx = grid->geoToGrid(x0 + 1., y0);
+  te::gm::Coord2D cy = grid->geoToGrid(x0, y0 + 1.);
+
+  m_geoT[1] = cx.getX() - c0.getX();
+  m_geoT[2] = cy.getX() - c0.getX();
+  m_geoT[0] = c0.getX() - m_geoT[1] * x0 - m_geoT[2] * y0;
+  m_geoT[4] = cx.getY() - c0.getY();
+  m_geoT[5] = cy.getY() - c0.getY();
+  m_geoT[3] = c0.getY() - m_geoT[4] * x0 - m_geoT[5] * y0;
+
+  m_nCols = static_cast<int>(m_raster->getNumberOfColumns());
+  m_nRows = static_cast<int>(m_raster->getNumberOfRows());
+
+  //all bands are read with the block layout of the first one
+  const te::rst::BandProperty* prop = m_bands[0]->getProperty();
+
+  m_blkw = prop->m_blkw > 0 ? prop->m_blkw : m_nCols;
+  m_blkh = prop->m_blkh > 0 ? prop->m_blkh : 1;
+  m_nBlocksX = (m_nCols + m_blkw - 1) / m_blkw;
+  m_nBlocksY = (m_nRows + m_blkh - 1) / m_blkh;
+}
+
+geopx::tools::RasterTileReader::~RasterTileReader()
+{
+}
+
+QImage geopx::tools::RasterTileReader::read(const te::gm::Envelope& env, int srid, int width, int height)
+{
+  QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+
+  image.fill(m_background);
+
+  std::unique_ptr<te::srs::Converter> converter;
+
+  if(srid != m_srid)
+    converter.reset(new te::srs::Converter(srid, m_srid));
+
+  double pixelWidth = env.getWidth() / width;
+  double pixelHeight = env.getHeight() / height;
+
+  //the blocks used by the last pixel, most pixels use the same blocks of their neighbours
+  std::vector<Block> blocks(m_bands.size());
+  int lastBx = -1;
+  int lastBy = -1;
+
+  for(int r = 0; r < height; ++r)
+  {
+    //the grid coordinates of the first and last pixel centers of the row, the other pixels are interpolated
+    double y = env.m_ury - (r + 0.5) * pixelHeight;
+    double xFirst = env.m_llx + 0.5 * pixelWidth;
+    double xLast = env.m_llx + (width - 0.5) * pixelWidth;
+
+    double yFirst = y;
+    double yLast = y;
+
+    if(converter.get())
+    {
+      if(!converter->convert(xFirst, y, xFirst, yFirst) || !converter->convert(xLast, y, xLast, yLast))
+        continue;
+    }
+
+    double colFirst = m_geoT[0] + m_geoT[1] * xFirst + m_geoT[2] * yFirst;
+    double rowFirst = m_geoT[3] + m_geoT[4] * xFirst + m_geoT[5] * yFirst;
+    double colLast = m_geoT[0] + m_geoT[1] * xLast + m_geoT[2] * yLast;
+    double rowLast = m_geoT[3] + m_geoT[4] * xLast + m_geoT[5] * yLast;
+
+    double colStep = width > 1 ? (colLast - colFirst) / (width - 1) : 0.;
+    double rowStep = width > 1 ? (rowLast - rowFirst) / (width - 1) : 0.;
+
+    QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(r));
+
+    for(int c = 0; c < width; ++c)
+    {
+      //pixel centers are at the integer grid coordinates
+      double col = std::floor(colFirst + c * colStep + 0.5);
+      double row = std::floor(rowFirst + c * rowStep + 0.5);
+
+      if(col < 0. || row < 0. || col >= m_nCols || row >= m_nRows)
+        continue;
+
+      int ic = static_cast<int>(col);
+      int ir = static_cast<int>(row);
+
+      int bx = ic / m_blkw;
+      int by = ir / m_blkh;
+
+      if(bx != lastBx || by != lastBy)
+      {
+        for(std::size_t b = 0; b < m_bands.size(); ++b)
+          blocks[b] = getBlock(b, bx, by);
+
+        lastBx = bx;
+        lastBy = by;
+      }
+
+      std::size_t idx = static_cast<std::size_t>(ir - by * m_blkh) * m_blkw + (ic - bx * m_blkw);
+
+      unsigned short v0 = (*blocks[0])[idx];
+
+      if(m_bands.size() == 1)
+      {
+        if(v0 != RASTER_TILE_READER_NODATA)
+          line[c] = qRgb(v0, v0, v0);
+
+        continue;
+      }
+
+      unsigned short v1 = (*blocks[1])[idx];
+      unsigned short v2 = (*blocks[2])[idx];
+
+      if(v0 != RASTER_TILE_READER_NODATA && v1 != RASTER_TILE_READER_NODATA && v2 != RASTER_TILE_READER_NODATA)
+        line[c] = qRgb(v0, v1, v2);
+    }
+  }
+
+  return image;
+}
+
+bool geopx::tools::RasterTileReader::GetBands(te::rst::Raster* raster, te::se::Style* style, std::vector<std::size_t>& bands)
+{
+  bands.clear();
+
+  std::size_t nBands = raster->getNumberOfBands();
+
+  if(nBands == 0)
+    return false;
+
+  te::se::RasterSymbolizer* rs = style ? te::se::GetRasterSymbolizer(style) : 0;
+
+  if(!rs)
+  {
+    //the default style of the layer drawing
+    if(nBands >= 3)
+    {
+      bands.push_back(0);
+      bands.push_back(1);
+      bands.push_back(2);
+    }
+    else
+    {
+      bands.push_back(0);
+    }
+  }
+  else
+  {
+    //the drawing changes the values of the bands
+    if(rs->getColorMap() || !IsNeutral(rs->getContrastEnhancement()) || !IsNeutral(rs->getOpacity(), 1.) ||
+       !IsNeutral(rs->getGain(), 1.) || !IsNeutral(rs->getOffset(), 0.))
+      return false;
+
+    const te::se::ChannelSelection* cs = rs->getChannelSelection();
+
+    if(!cs)
+      return false;
+
+    std::size_t band = 0;
+
+    if(cs->getColorCompositionType() == te::se::RGB_COMPOSITION)
+    {
+      if(!GetChannelBand(cs->getRedChannel(), nBands, band))
+        return false;
+
+      bands.push_back(band);
+
+      if(!GetChannelBand(cs->getGreenChannel(), nBands, band))
+        return false;
+
+      bands.push_back(band);
+
+      if(!GetChannelBand(cs->getBlueChannel(), nBands, band))
+        return false;
+
+      bands.push_back(band);
+    }
+    else if(cs->getColorCompositionType() == te::se::GRAY_COMPOSITION)
+    {
+      if(!GetChannelBand(cs->getGrayChannel(), nBands, band))
+        return false;
+
+      bands.push_back(band);
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  //other data types are stretched by the drawing
+  for(std::size_t t = 0; t < bands.size(); ++t)
+  {
+    if(raster->getBand(bands[t])->getProperty()->m_type != te::dt::UCHAR_TYPE)
+      return false;
+  }
+
+  return true;
+}
+
+geopx::tools::RasterTileReader::Block geopx::tools::RasterTileReader::getBlock(std::size_t band, int bx, int by)
+{
+  long long key = (static_cast<long long>(band) * m_nBlocksY + by) * m_nBlocksX + bx;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  std::map<long long, std::pair<Block, std::list<long long>::iterator> >::iterator it = m_blocks.find(key);
+
+  if(it != m_blocks.end())
+  {
+    //move to the front of the LRU list
+    m_lru.splice(m_lru.begin(), m_lru, it->second.second);
+
+    return it->second.first;
+  }
+
+  //a block removed from the cache is kept by the threads still using it
+  if(m_blocks.size() >= m_maxBlocks * m_bands.size())
+  {
+    m_blocks.erase(m_lru.back());
+    m_lru.pop_back();
+  }
+
+  std::shared_ptr<std::vector<unsigned short> > values(new std::vector<unsigned short>());
+
+  decodeBlock(band, bx, by, *values);
+
+  m_lru.push_front(key);
+
+  std::pair<Block, std::list<long long>::iterator>& entry = m_blocks[key];
+
+  entry.first = values;
+  entry.second = m_lru.begin();
+
+  return entry.first;
+}
+
+void geopx::tools::RasterTileReader::decodeBlock(std::size_t band, int bx, int by, std::vector<unsigned short>& values)
+{
+  te::rst::Band* rstBand = m_bands[band];
+
+  const te::rst::BandProperty* prop = rstBand->getProperty();
+
+  std::size_t size = static_cast<std::size_t>(m_blkw) * static_cast<std::size_t>(m_blkh);
+
+  values.assign(size, RASTER_TILE_READER_NODATA);
+
+  //other block layouts are read pixel by pixel
+  if(prop->m_blkw != m_blkw || prop->m_blkh != m_blkh)
+  {
+    int c0 = bx * m_blkw;
+    int r0 = by * m_blkh;
+    int c1 = std::min(c0 + m_blkw, m_nCols);
+    int r1 = std::min(r0 + m_blkh, m_nRows);
+
+    for(int r = r0; r < r1; ++r)
+    {
+      for(int c = c0; c < c1; ++c)
+      {
+        double value;
+
+        rstBand->getValue(c, r, value);
+
+        values[(r - r0) * m_blkw + (c - c0)] = GetValue(value, prop->m_noDataValue);
+      }
+    }
+
+    return;
+  }
+
+  //the bands are 8 bit unsigned (see GetBands)
+  m_buffer.resize(size);
+
+  rstBand->read(bx, by, m_buffer.data());
+
+  for(std::size_t t = 0; t < size; ++t)
+    values[t] = GetValue(static_cast<double>(m_buffer[t]), prop->m_noDataValue);
+}
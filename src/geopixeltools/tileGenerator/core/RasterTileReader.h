@@ -0,0 +1,133 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/RasterTileReader.h
+
+  \brief This file contains a class used to create the tiles reading the raster data directly.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_TILEGENERATOR_RASTERTILEREADER_H
+#define __GEOPXDESKTOP_TOOLS_TILEGENERATOR_RASTERTILEREADER_H
+
+#include "../../Config.h"
+
+//TerraLib Includes
+#include <terralib/geometry/Envelope.h>
+
+//STL Includes
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//QT Includes
+#include <QColor>
+#include <QImage>
+
+#define RASTER_TILE_READER_BLOCKS 256
+#define RASTER_TILE_READER_NODATA 256
+
+namespace te { namespace rst { class Band; class Raster; } }
+namespace te { namespace se { class Style; } }
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \class RasterTileReader
+
+      \brief Creates the tile images reading the blocks of a raster, without the layer drawing.
+
+      For each row of a tile the raster grid coordinates of its first and last pixels are
+      computed (reprojecting them if the raster has another SRID) and the other pixels are
+      interpolated, then the pixels are resampled by the nearest neighbour. The raster blocks
+      are decoded once and kept in a LRU cache shared by the threads.
+
+      The bands are read as RGB (three bands) or gray (one band) with their 8 bit values, the
+      no data pixels are transparent. GetBands() tells if a raster drawn with a style can be
+      read this way, with the same result of the layer drawing.
+
+      \note read() can be called by many threads at the same time.
+    */
+    class GEOPXTOOLSEXPORT RasterTileReader
+    {
+      public:
+
+        /*!
+          \param raster     The raster, it must be valid while the reader is used.
+          \param bands      The red, green and blue bands or the gray band (see GetBands).
+          \param background The color of the pixels outside the raster or without data.
+          \param maxBlocks  Maximum number of decoded blocks kept in memory (for each band).
+        */
+        RasterTileReader(te::rst::Raster* raster, const std::vector<std::size_t>& bands, const QColor& background,
+                         std::size_t maxBlocks = RASTER_TILE_READER_BLOCKS);
+
+        ~RasterTileReader();
+
+      public:
+
+        /*!
+          \brief Reads the image of a box.
+
+          \param env    The box.
+          \param srid   The SRID of the box.
+          \param width  The image width.
+          \param height The image height.
+        */
+        QImage read(const te::gm::Envelope& env, int srid, int width, int height);
+
+        /*!
+          \brief Gets the bands of a raster selected by the style of its layer.
+
+          The raster can be read only if the bands are 8 bit unsigned and the style (RGB or gray
+          channel selection) has no contrast enhancement, color map, gain, offset or opacity, as the
+          drawing of the layer would change the values. Without a style the default of the layer
+          drawing is used: RGB with the bands 0, 1 and 2, or gray with the band 0.
+
+          \param raster The raster.
+          \param style  The layer style, it can be null.
+          \param bands  The bands read.
+
+          \return False if the raster must be drawn by the layer.
+        */
+        static bool GetBands(te::rst::Raster* raster, te::se::Style* style, std::vector<std::size_t>& bands);
+
+      protected:
+
+        /*! \brief A decoded block, the values are 0..255 or RASTER_TILE_READER_NODATA. */
+        typedef std::shared_ptr<const std::vector<unsigned short> > Block;
+
+        /*! \brief Gets a decoded block from the cache, reading it if needed. */
+        Block getBlock(std::size_t band, int bx, int by);
+
+        /*! \brief Reads and decodes a block of a band. */
+        void decodeBlock(std::size_t band, int bx, int by, std::vector<unsigned short>& values);
+
+      protected:
+
+        te::rst::Raster* m_raster;                      //!< The raster read.
+        std::vector<te::rst::Band*> m_bands;            //!< The gray band or the RGB bands.
+
+        int m_srid;                                     //!< The raster SRID.
+        double m_geoT[6];                               //!< Geographic to grid transform: col = t0 + t1 * x + t2 * y, row = t3 + t4 * x + t5 * y.
+
+        int m_nCols;
+        int m_nRows;
+        int m_blkw;                                     //!< Block width in pixels.
+        int m_blkh;                                     //!< Block height in pixels.
+        int m_nBlocksX;                                 //!< Number of blocks in a block row.
+        int m_nBlocksY;                                 //!< Number of blocks in a block column.
+
+        QRgb m_background;                              //!< The background pixel (premultiplied).
+
+        std::size_t m_maxBlocks;
+        std::list<long long> m_lru;                                                   //!< Block keys, most recently used first.
+        std::map<long long, std::pair<Block, std::list<long long>::iterator> > m_blocks;  //!< Decoded blocks and their LRU entries.
+        std::vector<unsigned char> m_buffer;                                          //!< Raw block buffer.
+        std::mutex m_mutex;                                                           //!< Protects the blocks and the raster.
+    };
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_TILEGENERATOR_RASTERTILEREADER_H
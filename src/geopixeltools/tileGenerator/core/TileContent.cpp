@@ -0,0 +1,41 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileContent.cpp
+
+  \brief This file contains functions used to find the tiles without content.
+*/
+
+#include "TileContent.h"
+
+geopx::tools::TileContentType geopx::tools::GetTileContent(const QImage& image, QRgb& color)
+{
+  color = 0;
+
+  if(image.isNull())
+    return TILE_CONTENT_EMPTY;
+
+  QImage argb = image;
+
+  if(argb.format() != QImage::Format_ARGB32_Premultiplied && argb.format() != QImage::Format_ARGB32 && argb.format() != QImage::Format_RGB32)
+    argb = argb.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+  color = reinterpret_cast<const QRgb*>(argb.constScanLine(0))[0];
+
+  int width = argb.width();
+
+  for(int r = 0; r < argb.height(); ++r)
+  {
+    const QRgb* line = reinterpret_cast<const QRgb*>(argb.constScanLine(r));
+
+    for(int c = 0; c < width; ++c)
+    {
+      if(line[c] != color)
+        return TILE_CONTENT_MIXED;
+    }
+  }
+
+  //RGB32 images are opaque, the alpha byte is not used
+  if(argb.format() != QImage::Format_RGB32 && qAlpha(color) == 0)
+    return TILE_CONTENT_EMPTY;
+
+  return TILE_CONTENT_SINGLE_COLOR;
+}
@@ -0,0 +1,45 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileContent.h
+
+  \brief This file contains functions used to find the tiles without content.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILECONTENT_H
+#define __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILECONTENT_H
+
+#include "../../Config.h"
+
+//QT Includes
+#include <QImage>
+#include <QRgb>
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \enum TileContentType
+
+      \brief The content of a tile image.
+    */
+    enum TileContentType
+    {
+      TILE_CONTENT_EMPTY,           //!< All pixels are transparent.
+      TILE_CONTENT_SINGLE_COLOR,    //!< All pixels have the same color.
+      TILE_CONTENT_MIXED            //!< The tile has more than one color.
+    };
+
+    /*!
+      \brief Gets the content of a tile image, the scan stops at the first pixel that differs from the first one.
+
+      \param image  The tile image.
+      \param color  Output, the color of the first pixel (premultiplied if the image format is).
+
+      \return The content type, a null image is empty.
+    */
+    TileContentType GetTileContent(const QImage& image, QRgb& color);
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILECONTENT_H
@@ -0,0 +1,140 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileEncoder.cpp
+
+  \brief This file contains the encoders used by the tile generator to create the tile data.
+*/
+
+#include "TileEncoder.h"
+
+//TerraLib Includes
+#include <terralib/core/Exception.h>
+
+//STL Includes
+#include <algorithm>
+#include <unordered_map>
+
+//Qt Includes
+#include <QBuffer>
+#include <QImageWriter>
+#include <QVector>
+
+geopx::tools::TileEncoder::TileEncoder()
+{
+}
+
+geopx::tools::TileEncoder::~TileEncoder()
+{
+}
+
+geopx::tools::ImageTileEncoder::ImageTileEncoder(const std::string& format, int quality) :
+  m_format(format),
+  m_isPNG(QByteArray(format.c_str()).toLower() == "png"),
+  m_quality(quality),
+  m_compression(-1)
+{
+  if(!QImageWriter::supportedImageFormats().contains(QByteArray(format.c_str()).toLower()))
+    throw te::core::Exception() << te::ErrorDescription("The image format " + format + " is not supported.");
+}
+
+geopx::tools::ImageTileEncoder::~ImageTileEncoder()
+{
+}
+
+void geopx::tools::ImageTileEncoder::setCompression(int level)
+{
+  m_compression = level >= 0 ? std::min(level, 9) : -1;
+}
+
+QByteArray geopx::tools::ImageTileEncoder::encode(const QImage& image) const
+{
+  QByteArray data;
+
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::WriteOnly);
+
+  QImageWriter writer(&buffer, m_format.c_str());
+
+  //the Qt PNG writer maps the quality 100..0 to the zlib levels 0..9
+  if(!m_isPNG)
+    writer.setQuality(m_quality);
+  else if(m_compression >= 0)
+    writer.setQuality(100 - (m_compression * 91 + 8) / 9);
+
+  if(!writer.write(image))
+    throw te::core::Exception() << te::ErrorDescription("Error encoding the tile image.");
+
+  return data;
+}
+
+geopx::tools::PaletteTileEncoder::PaletteTileEncoder(int colors, int compression) :
+  m_png("png"),
+  m_colors(std::max(1, std::min(colors, 256)))
+{
+  m_png.setCompression(compression);
+}
+
+geopx::tools::PaletteTileEncoder::~PaletteTileEncoder()
+{
+}
+
+QByteArray geopx::tools::PaletteTileEncoder::encode(const QImage& image) const
+{
+  QImage indexed = getExactPalette(image);
+
+  if(indexed.isNull())
+    indexed = image.convertToFormat(QImage::Format_Indexed8);
+
+  return m_png.encode(indexed);
+}
+
+QImage geopx::tools::PaletteTileEncoder::getExactPalette(const QImage& image) const
+{
+  //the palette keeps the alpha, so the colors are not premultiplied
+  QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+
+  QImage indexed(argb.width(), argb.height(), QImage::Format_Indexed8);
+
+  QVector<QRgb> colorTable;
+
+  std::unordered_map<QRgb, uchar> indexes;
+
+  for(int r = 0; r < argb.height(); ++r)
+  {
+    const QRgb* line = reinterpret_cast<const QRgb*>(argb.constScanLine(r));
+
+    uchar* out = indexed.scanLine(r);
+
+    //the runs of the same color are common in the classified layers
+    QRgb last = line[0];
+    uchar lastIndex = 0;
+    bool hasLast = false;
+
+    for(int c = 0; c < argb.width(); ++c)
+    {
+      if(!hasLast || line[c] != last)
+      {
+        std::unordered_map<QRgb, uchar>::const_iterator it = indexes.find(line[c]);
+
+        if(it == indexes.end())
+        {
+          if(colorTable.size() == m_colors)
+            return QImage();
+
+          it = indexes.insert(std::make_pair(line[c], static_cast<uchar>(colorTable.size()))).first;
+
+          colorTable.push_back(line[c]);
+        }
+
+        last = line[c];
+        lastIndex = it->second;
+        hasLast = true;
+      }
+
+      out[c] = lastIndex;
+    }
+  }
+
+  indexed.setColorTable(colorTable);
+
+  return indexed;
+}
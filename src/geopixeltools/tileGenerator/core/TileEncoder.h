@@ -0,0 +1,115 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileEncoder.h
+
+  \brief This file contains the encoders used by the tile generator to create the tile data.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILEENCODER_H
+#define __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILEENCODER_H
+
+#include "../../Config.h"
+
+//STL Includes
+#include <string>
+
+//QT Includes
+#include <QByteArray>
+#include <QImage>
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \class TileEncoder
+
+      \brief Encodes the tile images in the data stored by the tile sinks.
+
+      \note encode() is called by many threads at the same time.
+    */
+    class GEOPXTOOLSEXPORT TileEncoder
+    {
+      public:
+
+        TileEncoder();
+
+        virtual ~TileEncoder();
+
+      public:
+
+        /*! \brief Encodes the image, throws if it can not be encoded. */
+        virtual QByteArray encode(const QImage& image) const = 0;
+    };
+
+    /*!
+      \class ImageTileEncoder
+
+      \brief Encodes the tiles with the Qt image writers (PNG, JPEG, WebP...).
+    */
+    class GEOPXTOOLSEXPORT ImageTileEncoder : public TileEncoder
+    {
+      public:
+
+        /*!
+          \param format  The image format, it must be supported by the Qt image writers.
+          \param quality The quality (0 to 100) used by the lossy formats (JPEG, WebP), -1 to use the format default.
+                         The PNG format uses the compression level instead.
+        */
+        ImageTileEncoder(const std::string& format, int quality = -1);
+
+        ~ImageTileEncoder();
+
+      public:
+
+        /*! \brief Sets the zlib compression level (0 to 9) used by the PNG format, -1 to use the default. Other formats ignore it. */
+        void setCompression(int level);
+
+        QByteArray encode(const QImage& image) const;
+
+      protected:
+
+        std::string m_format;             //!< The image format.
+        bool m_isPNG;                     //!< True for the PNG format, its writer takes the compression level as quality.
+        int m_quality;                    //!< The quality of the lossy formats.
+        int m_compression;                //!< The zlib compression level of the PNG format.
+    };
+
+    /*!
+      \class PaletteTileEncoder
+
+      \brief Encodes the tiles as PNG images with a palette of 8 bits.
+
+      The tiles with a few colors (classified layers) are encoded with their exact colors.
+      The other tiles are quantized to 256 colors by Qt.
+    */
+    class PaletteTileEncoder : public TileEncoder
+    {
+      public:
+
+        /*!
+          \param colors       The maximum number of exact colors (up to 256).
+          \param compression  The zlib compression level (0 to 9), -1 to use the default.
+        */
+        PaletteTileEncoder(int colors = 256, int compression = -1);
+
+        ~PaletteTileEncoder();
+
+      public:
+
+        QByteArray encode(const QImage& image) const;
+
+      protected:
+
+        /*! \brief Builds the indexed image with the exact colors, returns a null image if there are too many colors. */
+        QImage getExactPalette(const QImage& image) const;
+
+      protected:
+
+        ImageTileEncoder m_png;           //!< Writes the indexed images.
+        int m_colors;                     //!< The maximum number of exact colors.
+    };
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILEENCODER_H
@@ -0,0 +1,136 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileEncoderPool.cpp
+
+  \brief This file contains a pool of threads that encode the tiles and write them to a sink.
+*/
+
+#include "TileEncoderPool.h"
+#include "TileEncoder.h"
+#include "TileSink.h"
+#include "TileStatistics.h"
+
+//STL Includes
+#include <algorithm>
+#include <utility>
+
+geopx::tools::TileEncoderPool::TileEncoderPool(const TileEncoder& encoder, TileSink& sink, std::size_t nThreads, TileStatistics* statistics,
+                                                 std::size_t queueSize) :
+  m_encoder(encoder),
+  m_sink(sink),
+  m_statistics(statistics),
+  m_queueSize(queueSize ? queueSize : 1),
+  m_stop(false)
+{
+  if(nThreads == 0)
+    nThreads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+
+  for(std::size_t t = 0; t < nThreads; ++t)
+    m_threads.push_back(std::thread(&TileEncoderPool::run, this));
+}
+
+geopx::tools::TileEncoderPool::~TileEncoderPool()
+{
+  finish();
+}
+
+void geopx::tools::TileEncoderPool::add(int level, long x, long y, const QImage& image)
+{
+  TileImage tile;
+  tile.m_level = level;
+  tile.m_x = x;
+  tile.m_y = y;
+  tile.m_image = image;
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  {
+    TileStageTimer timer(m_queue.size() < m_queueSize ? 0 : m_statistics, TILE_STAGE_QUEUE, level);
+
+    m_notFull.wait(lock, [this] { return m_queue.size() < m_queueSize || m_stop; });
+  }
+
+  //the pool was finished, the tile is encoded by the calling thread
+  if(m_stop)
+  {
+    lock.unlock();
+
+    store(tile);
+
+    return;
+  }
+
+  m_queue.push_back(std::move(tile));
+
+  lock.unlock();
+
+  m_notEmpty.notify_one();
+}
+
+void geopx::tools::TileEncoderPool::finish()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_stop = true;
+  }
+
+  m_notEmpty.notify_all();
+  m_notFull.notify_all();
+
+  for(std::size_t t = 0; t < m_threads.size(); ++t)
+  {
+    if(m_threads[t].joinable())
+      m_threads[t].join();
+  }
+}
+
+void geopx::tools::TileEncoderPool::run()
+{
+  while(true)
+  {
+    TileImage tile;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+
+      m_notEmpty.wait(lock, [this] { return !m_queue.empty() || m_stop; });
+
+      //the queue is emptied before the thread finishes
+      if(m_queue.empty())
+        return;
+
+      tile = std::move(m_queue.front());
+      m_queue.pop_front();
+    }
+
+    m_notFull.notify_one();
+
+    store(tile);
+  }
+}
+
+void geopx::tools::TileEncoderPool::store(const TileImage& tile)
+{
+  try
+  {
+    QByteArray data;
+
+    {
+      TileStageTimer timer(m_statistics, TILE_STAGE_ENCODE, tile.m_level);
+
+      data = m_encoder.encode(tile.m_image);
+    }
+
+    //the sink times the write
+    m_sink.write(tile.m_level, tile.m_x, tile.m_y, data);
+
+    if(m_statistics)
+      m_statistics->addStored(tile.m_level, static_cast<std::size_t>(data.size()));
+  }
+  catch(...)
+  {
+    //the tile is skipped
+    if(m_statistics)
+      m_statistics->addFailed(tile.m_level);
+  }
+}
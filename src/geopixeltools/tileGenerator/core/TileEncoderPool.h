@@ -0,0 +1,107 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileEncoderPool.h
+
+  \brief This file contains a pool of threads that encode the tiles and write them to a sink.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILEENCODERPOOL_H
+#define __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILEENCODERPOOL_H
+
+#include "../../Config.h"
+
+//STL Includes
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//QT Includes
+#include <QImage>
+
+#define TILE_ENCODER_QUEUE_SIZE 64
+
+namespace geopx
+{
+  namespace tools
+  {
+    //forward declarations
+    class TileEncoder;
+    class TileSink;
+    class TileStatistics;
+
+    /*!
+      \class TileEncoderPool
+
+      \brief Encodes the tiles drawn and writes them to a sink, using its own threads.
+
+      The images are kept in a bounded queue, so the threads that draw the tiles only wait
+      for the encoders when the queue is full. A tile that can not be encoded or written is
+      skipped.
+    */
+    class GEOPXTOOLSEXPORT TileEncoderPool
+    {
+      public:
+
+        /*!
+          \brief Starts the encoder threads.
+
+          \param encoder    The encoder, it must be valid until the pool is finished.
+          \param sink       The sink, it must be valid until the pool is finished.
+          \param nThreads   The number of threads, 0 to use the hardware threads.
+          \param statistics The statistics where the tiles and the queue, encode and write times are added, if not null.
+          \param queueSize  Maximum number of images waiting to be encoded.
+        */
+        TileEncoderPool(const TileEncoder& encoder, TileSink& sink, std::size_t nThreads, TileStatistics* statistics = 0,
+                        std::size_t queueSize = TILE_ENCODER_QUEUE_SIZE);
+
+        /*! \brief Encodes the images queued and stops the threads. */
+        ~TileEncoderPool();
+
+      public:
+
+        /*! \brief Adds a tile image to the queue, waiting while it is full. */
+        void add(int level, long x, long y, const QImage& image);
+
+        /*! \brief Waits until all tiles added are encoded and written, and stops the threads. */
+        void finish();
+
+      protected:
+
+        struct TileImage
+        {
+          int m_level;
+          long m_x;
+          long m_y;
+          QImage m_image;
+        };
+
+        /*! \brief Encoder thread loop. */
+        void run();
+
+        /*! \brief Encodes a tile and writes it to the sink, a tile that fails is skipped. */
+        void store(const TileImage& tile);
+
+      protected:
+
+        const TileEncoder& m_encoder;                     //!< Encodes the images.
+        TileSink& m_sink;                                 //!< Stores the tiles.
+        TileStatistics* m_statistics;                     //!< Counts the tiles, if not null.
+
+        std::size_t m_queueSize;
+
+        std::deque<TileImage> m_queue;                    //!< Images waiting to be encoded.
+
+        std::mutex m_mutex;                               //!< Protects the queue and the state.
+        std::condition_variable m_notEmpty;               //!< Signaled when an image is added or the pool is finished.
+        std::condition_variable m_notFull;                //!< Signaled when an encoder removes an image from the queue.
+
+        bool m_stop;                                      //!< Flag used to finish the encoder threads.
+
+        std::vector<std::thread> m_threads;               //!< The encoder threads.
+    };
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILEENCODERPOOL_H
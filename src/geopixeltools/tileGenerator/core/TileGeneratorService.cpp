@@ -5,29 +5,54 @@
 */
 
 #define GOOGLE_SRID 3857
+#define WGS84_SRID 4326
 
 #include "TileGeneratorService.h"
+#include "MBTilesTileSink.h"
+#include "RasterTileReader.h"
 #include "Tile.h"
+#include "TileContent.h"
+#include "TileEncoder.h"
+#include "TileEncoderPool.h"
+#include "TilePyramid.h"
 
 //TerraLib Includes
 #include <terralib/common/progress/TaskProgress.h>
 #include <terralib/common/StringUtils.h>
 #include <terralib/core/Exception.h>
+#include <terralib/core/logger/Logger.h>
+#include <terralib/dataaccess/dataset/DataSet.h>
+#include <terralib/dataaccess/utils/Utils.h>
+#include <terralib/datatype/Enums.h>
+#include <terralib/raster/Raster.h>
 #include <terralib/raster/Utils.h>
-#include <terralib/qt/widgets/canvas/MapDisplay.h>
 
 //STL Includes
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <exception>
 #include <iosfwd>
+#include <mutex>
 #include <stdio.h>
+#include <thread>
 
 //Qt Includes
 #include <QDir>
-#include <QPainter>
+#include <QRect>
 
 geopx::tools::TileGeneratorService::TileGeneratorService():
-  m_display(0),
+  m_threads(0),
+  m_metatileSize(1),
+  m_metatileBuffer(TILE_METATILE_BUFFER),
+  m_storeType(TILE_STORE_DIRECTORY),
+  m_encoderThreads(0),
+  m_backgroundColor(Qt::white),
+  m_skipEmptyTiles(false),
+  m_linkDuplicateTiles(false),
+  m_directRaster(false),
   m_zoomLevelMin(-1),
   m_zoomLevelMax(-1),
   m_tileSize(0),
@@ -39,7 +64,6 @@ geopx::tools::TileGeneratorService::TileGeneratorService():
 
 geopx::tools::TileGeneratorService::~TileGeneratorService()
 {
-  delete m_display;
 }
 
 void geopx::tools::TileGeneratorService::setInputParameters(std::list<te::map::AbstractLayerPtr> layers, te::gm::Envelope env, int srid, int zoomLevelMin, int zoomLevelMax, int tileSize, std::string path, std::string format)
@@ -56,7 +80,10 @@ void geopx::tools::TileGeneratorService::setInputParameters(std::list<te::map::A
 
   m_env.transform(m_srid, GOOGLE_SRID);
 
-  buildDisplay();
+  //the default encoder uses the format
+  m_encoder.reset();
+
+  buildRenderer();
 }
 
 void geopx::tools::TileGeneratorService::runValidation(bool createMissingTiles)
@@ -64,6 +91,14 @@ void geopx::tools::TileGeneratorService::runValidation(bool createMissingTiles)
   //check input parameters
   checkParameters();
 
+  m_statistics.start(m_zoomLevelMin, m_zoomLevelMax);
+
+  buildSink();
+
+  buildEncoder();
+
+  buildRasterReader(false);
+
   m_logFile = m_path + "/ValidationLog.txt";
 
   //create file
@@ -76,52 +111,72 @@ void geopx::tools::TileGeneratorService::runValidation(bool createMissingTiles)
 
   fprintf(fp, "Missing Tiles:\n");
 
-  //generate tiles
+  //the tiles stored are listed once for each level and compared with the expected tiles in memory
+  std::vector<TileRequest> missing;
+
   for(int i = m_zoomLevelMax; i >= m_zoomLevelMin; --i)
   {
-    Tile* tile = new Tile(i, m_tileSize);
+    std::vector<TileRequest> requests;
 
-    long tIdxX1, tIdxY1, tIdxX2, tIdxY2;
+    getLevelTiles(i, requests);
+
+    std::set<std::pair<long, long> > stored;
+
+    m_sink->getStoredTiles(i, stored);
 
-    tile->tileMatrix(m_env, tIdxX1, tIdxY1, tIdxX2, tIdxY2);
-    
-    for (int k = tIdxY2; k <= tIdxY1; ++k)
+    for(std::size_t t = 0; t < requests.size(); ++t)
     {
-      for (int j = tIdxX1; j <= tIdxX2; ++j)
-      {
-        te::gm::Envelope env = tile->tileBox(j, k);
+      const TileRequest& request = requests[t];
 
-        if(env.isValid())
-        {
-          try
-          {
-            bool isValid;
-
-            validateTile(fp, tile, i, j, k, isValid);
-
-            if(!isValid && createMissingTiles)
-            {
-              QPixmap* pix = drawTile(env);
-
-              if(pix)
-                savePixmap(tile, pix, i, j, k);
-            }
-          }
-          catch(...)
-          {
-            fprintf(fp, "\n\t Unexpected error. Level: %d Y: %d X: %d \n", i, k, j);
-            continue;
-          }
-        }
-        else
-        {
-          fprintf(fp, "\n\t Invalid Box. Level: %d Y: %d X: %d \n", i, k, j);
-        }
+      if(!request.m_env.isValid())
+      {
+        fprintf(fp, "\n\t Invalid Box. Level: %d Y: %ld X: %ld \n", i, request.m_y, request.m_x);
+        continue;
       }
+
+      if(stored.count(std::make_pair(request.m_x, request.m_y)))
+        continue;
+
+      fprintf(fp, "\n\t Tile: Level: %d X: %ld Y: %ld \n", i, request.m_x, request.m_y);
+
+      missing.push_back(request);
     }
+  }
+
+  if(createMissingTiles && !missing.empty())
+  {
+    std::mutex logMutex;
+
+    te::common::TaskProgress progress("Tile Validation");
+    progress.setTotalSteps(static_cast<int>(missing.size()));
 
-    delete tile;
+    processTiles(missing, progress, [this, fp, &logMutex](const TileRequest& request)
+    {
+      try
+      {
+        QImage image = drawTile(request.m_level, request.m_env);
+
+        if(!image.isNull())
+          saveImage(image, request.m_level, request.m_x, request.m_y);
+      }
+      catch(...)
+      {
+        m_statistics.addFailed(request.m_level);
+
+        std::lock_guard<std::mutex> lock(logMutex);
+
+        fprintf(fp, "\n\t Unexpected error. Level: %d Y: %ld X: %ld \n", request.m_level, request.m_y, request.m_x);
+      }
+    });
   }
+
+  fclose(fp);
+
+  m_encoderPool->finish();
+
+  m_sink->flush();
+
+  writeReport();
 }
 
 void geopx::tools::TileGeneratorService::runService(bool isRaster)
@@ -129,86 +184,404 @@ void geopx::tools::TileGeneratorService::runService(bool isRaster)
   //check input parameters
   checkParameters();
 
+  m_statistics.start(m_zoomLevelMin, m_zoomLevelMax);
+
+  buildSink();
+
+  buildEncoder();
+
+  buildRasterReader(isRaster);
+
+  if(MBTilesTileSink* sink = dynamic_cast<MBTilesTileSink*>(m_sink.get()))
+    setMetadata(sink, isRaster);
+
+  if(isRaster)
+    generateFromRaster();
+  else
+    generateFromVector();
+
+  m_encoderPool->finish();
+
+  m_sink->flush();
+
+  writeReport();
+}
+
+void geopx::tools::TileGeneratorService::runIncremental(const std::vector<te::gm::Envelope>& changed, bool isRaster)
+{
+  //check input parameters
+  checkParameters();
+
+  std::vector<std::set<std::pair<long, long> > > tiles;
+
+  getChangedTiles(changed, tiles);
+
+  m_statistics.start(m_zoomLevelMin, m_zoomLevelMax);
+
+  //the report tells that nothing was regenerated
+  if(tiles.empty() || tiles.back().empty())
+  {
+    writeReport();
+    return;
+  }
+
+  //the metadata of the store is kept
+  buildSink();
+
+  buildEncoder();
+
+  buildRasterReader(isRaster);
+
+  if(isRaster)
+    regenerateFromRaster(tiles);
+  else
+    regenerateFromVector(tiles);
+
+  m_encoderPool->finish();
+
+  m_sink->flush();
+
+  writeReport();
+}
+
+void geopx::tools::TileGeneratorService::setNumberOfThreads(std::size_t nThreads)
+{
+  m_threads = nThreads;
+}
+
+void geopx::tools::TileGeneratorService::setEncoder(TileEncoder* encoder)
+{
+  m_encoder.reset(encoder);
+}
+
+void geopx::tools::TileGeneratorService::setNumberOfEncoderThreads(std::size_t nThreads)
+{
+  m_encoderThreads = nThreads;
+}
+
+void geopx::tools::TileGeneratorService::setStoreType(TileStoreType type)
+{
+  m_storeType = type;
+}
+
+void geopx::tools::TileGeneratorService::setMetatileSize(int size)
+{
+  m_metatileSize = std::max(1, size);
+}
+
+void geopx::tools::TileGeneratorService::setMetatileBuffer(int pixels)
+{
+  m_metatileBuffer = std::max(0, pixels);
+}
+
+void geopx::tools::TileGeneratorService::setDirectRasterReading(bool direct)
+{
+  m_directRaster = direct;
+}
+
+void geopx::tools::TileGeneratorService::setBackgroundColor(const QColor& color)
+{
+  m_backgroundColor = color;
+
+  if(m_renderer.get())
+    m_renderer->setBackgroundColor(color);
+}
+
+void geopx::tools::TileGeneratorService::setSkipEmptyTiles(bool skip)
+{
+  m_skipEmptyTiles = skip;
+}
+
+void geopx::tools::TileGeneratorService::setLinkDuplicateTiles(bool link)
+{
+  m_linkDuplicateTiles = link;
+}
+
+const geopx::tools::TileStatistics& geopx::tools::TileGeneratorService::getStatistics() const
+{
+  return m_statistics;
+}
+
+void geopx::tools::TileGeneratorService::generateFromRaster()
+{
+  //the maximum level is drawn in Z-order, so the parents built in memory are completed soon
+  std::vector<TileRequest> requests;
+
+  getLevelMetatiles(m_zoomLevelMax, requests);
+
+  std::sort(requests.begin(), requests.end(), [this](const TileRequest& a, const TileRequest& b)
+  {
+    return TilePyramid::getZOrder(a.m_x / m_metatileSize, a.m_y / m_metatileSize) < TilePyramid::getZOrder(b.m_x / m_metatileSize, b.m_y / m_metatileSize);
+  });
+
+  TilePyramid pyramid(m_env, m_zoomLevelMin, m_zoomLevelMax, m_tileSize, &m_statistics);
+
+  TilePyramid::Consumer save = [this](int level, long x, long y, const QImage& image)
+  {
+    try
+    {
+      saveImage(image, level, x, y);
+    }
+    catch(...)
+    {
+      //the tile is skipped
+      m_statistics.addFailed(level);
+    }
+  };
+
+  te::common::TaskProgress progress("Tile Generator");
+  progress.setTotalSteps(static_cast<int>(requests.size()));
+
+  processTiles(requests, progress, [this, &pyramid, &save](const TileRequest& metatile)
+  {
+    //a tile that could not be drawn is transparent in its parent
+    drawMetatile(metatile, [&pyramid, &save](const TileRequest& request, const QImage& image)
+    {
+      if(!image.isNull())
+        save(request.m_level, request.m_x, request.m_y, image);
+
+      pyramid.add(request.m_level, request.m_x, request.m_y, image, save);
+    });
+  });
+}
+
+void geopx::tools::TileGeneratorService::generateFromVector()
+{
+  std::vector<std::vector<TileRequest> > levels;
+
   //progress
-  int totalSteps = 0;
+  std::size_t totalSteps = 0;
 
-  for (int i = m_zoomLevelMax; i >= m_zoomLevelMin; --i)
+  for(int i = m_zoomLevelMax; i >= m_zoomLevelMin; --i)
   {
-    std::unique_ptr<Tile> tile(new Tile(i, m_tileSize));
+    levels.push_back(std::vector<TileRequest>());
 
-    long tIdxX1, tIdxY1, tIdxX2, tIdxY2;
+    getLevelMetatiles(i, levels.back());
 
-    tile->tileMatrix(m_env, tIdxX1, tIdxY1, tIdxX2, tIdxY2);
+    totalSteps += levels.back().size();
+  }
+
+  te::common::TaskProgress progress("Tile Generator");
+  progress.setTotalSteps(static_cast<int>(totalSteps));
 
-    for (int k = tIdxY2; k <= tIdxY1; ++k)
+  //each level is drawn from the original data
+  for(std::size_t i = 0; i < levels.size(); ++i)
+  {
+    bool finished = processTiles(levels[i], progress, [this](const TileRequest& metatile)
     {
-      for (int j = tIdxX1; j <= tIdxX2; ++j)
+      drawMetatile(metatile, [this](const TileRequest& request, const QImage& image)
       {
-        ++totalSteps;
-      }
+        if(image.isNull())
+          return;
+
+        try
+        {
+          saveImage(image, request.m_level, request.m_x, request.m_y);
+        }
+        catch(...)
+        {
+          //the tile is skipped
+          m_statistics.addFailed(request.m_level);
+        }
+      });
+    });
+
+    if(!finished)
+      return;
+  }
+}
+
+void geopx::tools::TileGeneratorService::getChangedTiles(const std::vector<te::gm::Envelope>& changed, std::vector<std::set<std::pair<long, long> > >& tiles)
+{
+  tiles.assign(static_cast<std::size_t>(m_zoomLevelMax - m_zoomLevelMin + 1), std::set<std::pair<long, long> >());
+
+  Tile tile(m_zoomLevelMax, m_tileSize);
+
+  for(std::size_t t = 0; t < changed.size(); ++t)
+  {
+    te::gm::Envelope env(changed[t]);
+
+    if(!env.isValid())
+      continue;
+
+    env.transform(m_srid, GOOGLE_SRID);
+
+    if(!env.intersects(m_env))
+      continue;
+
+    env = env.intersection(m_env);
+
+    long tIdxX1, tIdxY1, tIdxX2, tIdxY2;
+
+    tile.tileMatrix(env, tIdxX1, tIdxY1, tIdxX2, tIdxY2);
+
+    for(long k = tIdxY2; k <= tIdxY1; ++k)
+    {
+      for(long j = tIdxX1; j <= tIdxX2; ++j)
+        tiles.back().insert(std::make_pair(j, k));
     }
   }
 
-  te::common::TaskProgress progress("Tile Generator");
-  progress.setTotalSteps(totalSteps);
+  //the ancestors of the changed tiles
+  for(std::size_t i = tiles.size() - 1; i > 0; --i)
+  {
+    for(std::set<std::pair<long, long> >::const_iterator it = tiles[i].begin(); it != tiles[i].end(); ++it)
+      tiles[i - 1].insert(std::make_pair(it->first / 2, it->second / 2));
+  }
+}
 
-  //generate tiles
-  for(int i = m_zoomLevelMax; i >= m_zoomLevelMin; --i)
+void geopx::tools::TileGeneratorService::regenerateFromRaster(const std::vector<std::set<std::pair<long, long> > >& tiles)
+{
+  //the stored siblings of the changed tiles, inside the service box
+  std::vector<TileRequest> siblings;
+
+  for(std::size_t i = 1; i < tiles.size(); ++i)
   {
-    std::unique_ptr<Tile> tile(new Tile(i, m_tileSize));
+    int level = m_zoomLevelMin + static_cast<int>(i);
+
+    Tile tile(level, m_tileSize);
 
     long tIdxX1, tIdxY1, tIdxX2, tIdxY2;
 
-    tile->tileMatrix(m_env, tIdxX1, tIdxY1, tIdxX2, tIdxY2);
-    
-    for (int k = tIdxY2; k <= tIdxY1; ++k)
+    tile.tileMatrix(m_env, tIdxX1, tIdxY1, tIdxX2, tIdxY2);
+
+    for(std::set<std::pair<long, long> >::const_iterator it = tiles[i - 1].begin(); it != tiles[i - 1].end(); ++it)
     {
-      for (int j = tIdxX1; j <= tIdxX2; ++j)
+      for(long k = 2 * it->second; k <= 2 * it->second + 1; ++k)
       {
-        te::gm::Envelope env = tile->tileBox(j, k);
-
-        if(env.isValid())
+        for(long j = 2 * it->first; j <= 2 * it->first + 1; ++j)
         {
-          try
-          {
-            if(isRaster)
-            {
-              if(i == m_zoomLevelMax)// use original images
-              {
-                QPixmap* pix = drawTile(env);
-
-                if(pix)
-                  savePixmap(tile.get(), pix, i, j, k);
-              }
-              else //use generated tiles
-              {
-                QPixmap pix = drawTile(env, i + 1);
-
-                if(!pix.isNull())
-                  savePixmap(tile.get(), &pix, i, j, k);
-              }
-            }
-            else
-            {
-              QPixmap* pix = drawTile(env);
-
-                if(pix)
-                  savePixmap(tile.get(), pix, i, j, k);
-            }
-          }
-          catch(...)
-          {
+          if(j < tIdxX1 || j > tIdxX2 || k < tIdxY2 || k > tIdxY1 || tiles[i].count(std::make_pair(j, k)))
             continue;
-          }
+
+          TileRequest request;
+          request.m_level = level;
+          request.m_x = j;
+          request.m_y = k;
+
+          siblings.push_back(request);
         }
+      }
+    }
+  }
 
-        progress.pulse();
+  Tile tile(m_zoomLevelMax, m_tileSize);
 
-        if (!progress.isActive())
-          return;
+  std::vector<TileRequest> requests;
 
-      }
+  for(std::set<std::pair<long, long> >::const_iterator it = tiles.back().begin(); it != tiles.back().end(); ++it)
+  {
+    TileRequest request;
+    request.m_level = m_zoomLevelMax;
+    request.m_x = it->first;
+    request.m_y = it->second;
+    request.m_env = tile.tileBox(it->first, it->second);
+
+    requests.push_back(request);
+  }
+
+  std::sort(requests.begin(), requests.end(), [](const TileRequest& a, const TileRequest& b)
+  {
+    return TilePyramid::getZOrder(a.m_x, a.m_y) < TilePyramid::getZOrder(b.m_x, b.m_y);
+  });
+
+  TilePyramid pyramid(m_env, m_zoomLevelMin, m_zoomLevelMax, m_tileSize, &m_statistics);
+
+  TilePyramid::Consumer save = [this](int level, long x, long y, const QImage& image)
+  {
+    try
+    {
+      saveImage(image, level, x, y);
+    }
+    catch(...)
+    {
+      //the tile is skipped
+      m_statistics.addFailed(level);
     }
+  };
+
+  te::common::TaskProgress progress("Tile Generator");
+  progress.setTotalSteps(static_cast<int>(siblings.size() + requests.size()));
+
+  //a sibling not stored (an empty tile skipped) is transparent in its parent
+  bool finished = processTiles(siblings, progress, [this, &pyramid, &save](const TileRequest& request)
+  {
+    QImage image;
+    QByteArray data;
+
+    if(m_sink->read(request.m_level, request.m_x, request.m_y, data))
+      image.loadFromData(data);
+
+    pyramid.add(request.m_level, request.m_x, request.m_y, image, save);
+  });
+
+  if(!finished)
+    return;
+
+  processTiles(requests, progress, [this, &pyramid, &save](const TileRequest& request)
+  {
+    QImage image;
+
+    try
+    {
+      if(request.m_env.isValid())
+        image = drawTile(request.m_level, request.m_env);
+    }
+    catch(...)
+    {
+      //the tile is transparent in its parent
+      m_statistics.addFailed(request.m_level);
+    }
+
+    if(!image.isNull())
+      save(request.m_level, request.m_x, request.m_y, image);
+
+    pyramid.add(request.m_level, request.m_x, request.m_y, image, save);
+  });
+}
+
+void geopx::tools::TileGeneratorService::regenerateFromVector(const std::vector<std::set<std::pair<long, long> > >& tiles)
+{
+  std::size_t totalSteps = 0;
+
+  for(std::size_t i = 0; i < tiles.size(); ++i)
+    totalSteps += tiles[i].size();
+
+  te::common::TaskProgress progress("Tile Generator");
+  progress.setTotalSteps(static_cast<int>(totalSteps));
+
+  for(int i = m_zoomLevelMax; i >= m_zoomLevelMin; --i)
+  {
+    const std::set<std::pair<long, long> >& levelTiles = tiles[static_cast<std::size_t>(i - m_zoomLevelMin)];
+
+    Tile tile(i, m_tileSize);
+
+    std::vector<TileRequest> requests;
+
+    for(std::set<std::pair<long, long> >::const_iterator it = levelTiles.begin(); it != levelTiles.end(); ++it)
+    {
+      TileRequest request;
+      request.m_level = i;
+      request.m_x = it->first;
+      request.m_y = it->second;
+      request.m_env = tile.tileBox(it->first, it->second);
+
+      requests.push_back(request);
+    }
+
+    bool finished = processTiles(requests, progress, [this](const TileRequest& request)
+    {
+      if(!request.m_env.isValid())
+        return;
+
+      QImage image = drawTile(request.m_level, request.m_env);
+
+      if(!image.isNull())
+        saveImage(image, request.m_level, request.m_x, request.m_y);
+    });
+
+    if(!finished)
+      return;
   }
 }
 
@@ -237,148 +610,421 @@ void geopx::tools::TileGeneratorService::checkParameters()
     throw te::core::Exception() << te::ErrorDescription("Invalid format value.");
 }
 
-void geopx::tools::TileGeneratorService::buildDisplay()
+void geopx::tools::TileGeneratorService::buildRenderer()
+{
+  m_renderer.reset(new TileRenderer(m_layers, GOOGLE_SRID));
+  m_renderer->setBackgroundColor(m_backgroundColor);
+}
+
+void geopx::tools::TileGeneratorService::buildSink()
 {
-  m_display = new te::qt::widgets::MapDisplay(QSize(m_tileSize, m_tileSize));
+  m_encoderPool.reset();
 
-  m_display->setLayerList(m_layers);
+  m_sink.reset();
 
-  m_display->setSRID(GOOGLE_SRID, false);
+  m_colorTiles.clear();
+
+  if(m_storeType == TILE_STORE_MBTILES)
+  {
+    //the MBTiles file always stores the identical tiles once
+    m_sink.reset(new MBTilesTileSink(m_path + "/" + TILE_MBTILES_FILE));
+  }
+  else
+  {
+    DirectoryTileSink* sink = new DirectoryTileSink(m_path, m_format);
+    sink->setLinkDuplicates(m_linkDuplicateTiles);
+
+    m_sink.reset(sink);
+  }
+
+  m_sink->setStatistics(&m_statistics);
 }
 
-QPixmap* geopx::tools::TileGeneratorService::drawTile(te::gm::Envelope env)
+void geopx::tools::TileGeneratorService::buildEncoder()
 {
-  m_display->setExtent(env, true);
+  if(!m_encoder.get())
+    m_encoder.reset(new ImageTileEncoder(m_format));
 
-  return m_display->getDisplayPixmap();
+  m_encoderPool.reset(new TileEncoderPool(*m_encoder, *m_sink, m_encoderThreads, &m_statistics));
 }
 
-QPixmap geopx::tools::TileGeneratorService::drawTile(te::gm::Envelope env, int level)
+void geopx::tools::TileGeneratorService::buildRasterReader(bool isRaster)
 {
-  Tile* tileGroup = new Tile(level, m_tileSize);
+  m_rasterReader.reset();
+  m_raster.reset();
 
-  long tIdxX1, tIdxY1, tIdxX2, tIdxY2;
+  if(!isRaster || !m_directRaster)
+    return;
 
-  tileGroup->tileMatrix(env, tIdxX1, tIdxY1, tIdxX2, tIdxY2);
+  //only a single raster layer can be read directly
+  te::map::AbstractLayerPtr layer;
 
-  int width = (tIdxX2 - tIdxX1 + 1) * m_tileSize;
-  int height = (tIdxY1 - tIdxY2 + 1) * m_tileSize;
+  for(std::list<te::map::AbstractLayerPtr>::const_iterator it = m_layers.begin(); it != m_layers.end(); ++it)
+  {
+    if((*it)->getVisibility() == te::map::NOT_VISIBLE)
+      continue;
 
-  QPixmap pixGroup(width, height);
-  pixGroup.fill(Qt::transparent);
+    if(layer.get())
+      return;
 
-  QPainter painter(&pixGroup);
+    layer = *it;
+  }
+
+  if(!layer.get())
+    return;
 
-  int countY = 0;
-  for (int k = tIdxY2; k <= tIdxY1; ++k)
+  //the layers are drawn if the raster can not be read
+  try
   {
-    int countX = 0;
-    for (int j = tIdxX1; j <= tIdxX2; ++j)
-    {
-      std::string tileFileName = getOSMTileFilePath(tileGroup, level, j, k, false);
+    std::unique_ptr<te::da::DataSet> ds = layer->getData();
 
-      QPixmap pixGroupItem(tileFileName.c_str());
+    if(!ds.get())
+      return;
 
-      if(!pixGroupItem.isNull())
-      {
-        painter.drawPixmap(countX * m_tileSize, countY * m_tileSize, m_tileSize, m_tileSize, pixGroupItem);
-      }
+    std::size_t rpos = te::da::GetFirstPropertyPos(ds.get(), te::dt::RASTER_TYPE);
+
+    if(rpos == std::string::npos)
+      return;
 
-      countX++;
+    m_raster = ds->getRaster(rpos);
+
+    //the raster is drawn if the reader would not give the colors of the layer style
+    std::vector<std::size_t> bands;
+
+    if(m_raster.get() && RasterTileReader::GetBands(m_raster.get(), layer->getStyle(), bands))
+      m_rasterReader.reset(new RasterTileReader(m_raster.get(), bands, m_backgroundColor));
+    else
+      m_raster.reset();
+  }
+  catch(...)
+  {
+    m_rasterReader.reset();
+    m_raster.reset();
+  }
+}
+
+void geopx::tools::TileGeneratorService::writeReport()
+{
+  m_statistics.stop();
+
+  //the tiles are already stored, so a report not written does not fail the run
+  try
+  {
+    m_statistics.writeReport(m_path + "/" + TILE_REPORT_FILE, m_path + "/" + TILE_REPORT_JSON_FILE);
+  }
+  catch(const boost::exception& e)
+  {
+    const std::string* description = boost::get_error_info<te::ErrorDescription>(e);
+
+    TE_LOG_WARN("Could not write the tile generation report: " + (description ? *description : std::string("unknown error")));
+  }
+  catch(const std::exception& e)
+  {
+    TE_LOG_WARN(std::string("Could not write the tile generation report: ") + e.what());
+  }
+}
+
+void geopx::tools::TileGeneratorService::setMetadata(MBTilesTileSink* sink, bool isRaster)
+{
+  std::string format = te::common::Convert2LCase(m_format);
+
+  te::gm::Envelope bounds(m_env);
+  bounds.transform(GOOGLE_SRID, WGS84_SRID);
+
+  sink->setMetadata("name", QDir(m_path.c_str()).dirName().toStdString());
+  sink->setMetadata("format", format == "jpeg" ? "jpg" : format);
+  sink->setMetadata("type", isRaster ? "baselayer" : "overlay");
+  sink->setMetadata("version", "1.0");
+  sink->setMetadata("minzoom", te::common::Convert2String(m_zoomLevelMin));
+  sink->setMetadata("maxzoom", te::common::Convert2String(m_zoomLevelMax));
+  sink->setMetadata("bounds", te::common::Convert2String(bounds.m_llx, 6) + "," + te::common::Convert2String(bounds.m_lly, 6) + "," +
+                              te::common::Convert2String(bounds.m_urx, 6) + "," + te::common::Convert2String(bounds.m_ury, 6));
+}
+
+void geopx::tools::TileGeneratorService::getLevelTiles(int level, std::vector<TileRequest>& requests)
+{
+  Tile tile(level, m_tileSize);
+
+  long tIdxX1, tIdxY1, tIdxX2, tIdxY2;
+
+  tile.tileMatrix(m_env, tIdxX1, tIdxY1, tIdxX2, tIdxY2);
+
+  for(long k = tIdxY2; k <= tIdxY1; ++k)
+  {
+    for(long j = tIdxX1; j <= tIdxX2; ++j)
+    {
+      TileRequest request;
+      request.m_level = level;
+      request.m_x = j;
+      request.m_y = k;
+      request.m_env = tile.tileBox(j, k);
+
+      requests.push_back(request);
     }
+  }
+}
+
+void geopx::tools::TileGeneratorService::getLevelMetatiles(int level, std::vector<TileRequest>& requests)
+{
+  Tile tile(level, m_tileSize);
+
+  long tIdxX1, tIdxY1, tIdxX2, tIdxY2;
+
+  tile.tileMatrix(m_env, tIdxX1, tIdxY1, tIdxX2, tIdxY2);
+
+  //the blocks are aligned to the tile matrix, so the same block is drawn for any service box
+  for(long k = tIdxY2 / m_metatileSize; k <= tIdxY1 / m_metatileSize; ++k)
+  {
+    for(long j = tIdxX1 / m_metatileSize; j <= tIdxX2 / m_metatileSize; ++j)
+    {
+      TileRequest request;
+      request.m_level = level;
+      request.m_x = j * m_metatileSize;
+      request.m_y = k * m_metatileSize;
 
-    countY++;
+      requests.push_back(request);
+    }
   }
+}
 
-  painter.end();
+void geopx::tools::TileGeneratorService::drawMetatile(const TileRequest& metatile, const std::function<void(const TileRequest&, const QImage&)>& consumer)
+{
+  Tile tile(metatile.m_level, m_tileSize);
 
-  delete tileGroup;
+  long tIdxX1, tIdxY1, tIdxX2, tIdxY2;
 
-  //smoth scale
-  return pixGroup.scaled(m_tileSize, m_tileSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+  tile.tileMatrix(m_env, tIdxX1, tIdxY1, tIdxX2, tIdxY2);
+
+  //the tiles of the block inside the service box
+  long x1 = std::max(metatile.m_x, tIdxX1);
+  long x2 = std::min(metatile.m_x + m_metatileSize - 1, tIdxX2);
+  long y1 = std::max(metatile.m_y, tIdxY2);
+  long y2 = std::min(metatile.m_y + m_metatileSize - 1, tIdxY1);
+
+  if(x1 > x2 || y1 > y2)
+    return;
+
+  int buffer = (x1 == x2 && y1 == y2) ? 0 : m_metatileBuffer;
+
+  te::gm::Envelope lowerLeft = tile.tileBox(x1, y2);
+  te::gm::Envelope upperRight = tile.tileBox(x2, y1);
+
+  double pixelSize = lowerLeft.getWidth() / m_tileSize;
+
+  te::gm::Envelope env(lowerLeft.m_llx - buffer * pixelSize, lowerLeft.m_lly - buffer * pixelSize,
+                       upperRight.m_urx + buffer * pixelSize, upperRight.m_ury + buffer * pixelSize);
+
+  int width = static_cast<int>(x2 - x1 + 1) * m_tileSize + 2 * buffer;
+  int height = static_cast<int>(y2 - y1 + 1) * m_tileSize + 2 * buffer;
+
+  QImage image;
+
+  try
+  {
+    if(env.isValid())
+      image = drawImage(metatile.m_level, env, width, height);
+  }
+  catch(...)
+  {
+    //the tiles of the block are not drawn
+  }
+
+  if(image.isNull())
+    m_statistics.addFailed(metatile.m_level, static_cast<std::size_t>((x2 - x1 + 1) * (y2 - y1 + 1)));
+
+  for(long k = y1; k <= y2; ++k)
+  {
+    for(long j = x1; j <= x2; ++j)
+    {
+      TileRequest request;
+      request.m_level = metatile.m_level;
+      request.m_x = j;
+      request.m_y = k;
+      request.m_env = tile.tileBox(j, k);
+
+      if(image.isNull() || (x1 == x2 && y1 == y2 && buffer == 0))
+        consumer(request, image);
+      else
+        consumer(request, image.copy(QRect(buffer + static_cast<int>(j - x1) * m_tileSize, buffer + static_cast<int>(k - y1) * m_tileSize, m_tileSize, m_tileSize)));
+    }
+  }
 }
 
-void geopx::tools::TileGeneratorService::validateTile(FILE* file, Tile* tile, int level, int tileIdxX, int tileIdxY, bool& isValid)
+bool geopx::tools::TileGeneratorService::processTiles(const std::vector<TileRequest>& requests, te::common::TaskProgress& progress,
+                                                      const std::function<void(const TileRequest&)>& work)
 {
-////change tile index to google system
-//  long tileIdxXOSM;
-//  long tileIdxYOSM;
-//
-//  tile->OSMTile(tileIdxX, tileIdxY, tileIdxXOSM, tileIdxYOSM);
+  if(requests.empty())
+    return true;
+
+  std::size_t nThreads = m_threads;
+
+  if(nThreads == 0)
+    nThreads = std::thread::hardware_concurrency();
 
-  isValid = false;
+  nThreads = std::max<std::size_t>(1, std::min(nThreads, requests.size()));
 
-  //file info
-  //std::string pathOSM   = m_path + "/MapquestOSM";
-  std::string pathLevel   = m_path + "/" + te::common::Convert2String(level);
-  std::string pathColumn  = pathLevel + "/" + te::common::Convert2String(tileIdxX);
-  std::string fileName    = pathColumn + "/" + te::common::Convert2String(tileIdxY)+ "." + te::common::Convert2LCase(m_format);
+  //each thread draws its own copy of the layers, the layers that can not be copied are drawn by one thread at a time
+  if(!m_rasterReader.get())
+    m_renderer->reserve(nThreads);
 
-  //check MapquestOSM directory
-  //QDir dirOSM(pathOSM.c_str());
-  //if(dirOSM.exists())
-  //{
-    //check dir level
-    QDir dirLevel(pathLevel.c_str());
-    if(dirLevel.exists())
+  std::atomic<std::size_t> next(0);
+  std::atomic<bool> stop(false);
+
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::size_t processed = 0;
+  std::size_t runningWorkers = nThreads;
+
+  auto worker = [&]()
+  {
+    while(!stop)
     {
-      //check dir column
-      QDir dirColumn(pathColumn.c_str());
-      if(dirColumn.exists())
-      {
-        //check file
-        QFile file(fileName.c_str());
+      std::size_t idx = next++;
+
+      if(idx >= requests.size())
+        break;
 
-        isValid = file.exists();
+      try
+      {
+        work(requests[idx]);
+      }
+      catch(...)
+      {
+        //the tile is skipped
+        m_statistics.addFailed(requests[idx].m_level);
       }
+
+      std::lock_guard<std::mutex> lock(mutex);
+
+      ++processed;
+
+      finished.notify_one();
     }
-  //}
 
-  //check validation
-  if(!isValid)
+    std::lock_guard<std::mutex> lock(mutex);
+
+    --runningWorkers;
+
+    finished.notify_one();
+  };
+
+  std::vector<std::thread> threads;
+
+  for(std::size_t t = 0; t < nThreads; ++t)
+    threads.push_back(std::thread(worker));
+
+  std::size_t pulsed = 0;
+
+  bool canceled = false;
+
+  while(true)
   {
-    fprintf(file, "\n\t Tile File: %s \n", fileName.c_str());
+    std::size_t done = 0;
+
+    bool running = true;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      //wake up from time to time to keep the progress viewer alive
+      finished.wait_for(lock, std::chrono::milliseconds(100), [&]() { return processed != pulsed || runningWorkers == 0; });
+
+      done = processed;
+
+      running = runningWorkers != 0;
+    }
+
+    for(; pulsed < done; ++pulsed)
+      progress.pulse();
+
+    if(!progress.isActive() && !stop)
+    {
+      canceled = true;
+
+      stop = true;
+    }
+
+    if(!running)
+      break;
   }
+
+  for(std::size_t t = 0; t < threads.size(); ++t)
+    threads[t].join();
+
+  return !canceled;
 }
 
-void geopx::tools::TileGeneratorService::savePixmap(Tile* tile, QPixmap* pix, int level, int tileIdxX, int tileIdxY)
+QImage geopx::tools::TileGeneratorService::drawTile(int level, const te::gm::Envelope& env)
 {
-  //create file
-  std::string fileName = getOSMTileFilePath(tile, level, tileIdxX, tileIdxY, true);
+  return drawImage(level, env, m_tileSize, m_tileSize);
+}
+
+QImage geopx::tools::TileGeneratorService::drawImage(int level, const te::gm::Envelope& env, int width, int height)
+{
+  TileStageTimer timer(&m_statistics, TILE_STAGE_DRAW, level);
+
+  if(m_rasterReader.get())
+    return m_rasterReader->read(env, GOOGLE_SRID, width, height);
+
+  bool cancel = false;
 
-  pix->save(fileName.c_str(), m_format.c_str());
+  return m_renderer->draw(env, width, height, &cancel);
 }
 
-std::string geopx::tools::TileGeneratorService::getOSMTileFilePath(Tile* tile, int level, int tileIdxX, int tileIdxY, bool save)
+void geopx::tools::TileGeneratorService::saveImage(const QImage& image, int level, long tileIdxX, long tileIdxY)
 {
-////change tile index to google system
-//  long tileIdxXOSM;
-//  long tileIdxYOSM;
-//
-//  tile->OSMTile(tileIdxX, tileIdxY, tileIdxXOSM, tileIdxYOSM);
+  QRgb color;
 
-  // MapquestOSM directory
-  //std::string pathOSM = m_path + "/MapquestOSM";
-  //QDir dirOSM(pathOSM.c_str());
-  //if(!dirOSM.exists() && save)
-  //  dirOSM.mkdir(pathOSM.c_str());
+  TileContentType content = GetTileContent(image, color);
 
-  //create dir level
-  std::string pathLevel = m_path + "/" + te::common::Convert2String(level);
-  QDir dirLevel(pathLevel.c_str());
-  if(!dirLevel.exists() && save)
-    dirLevel.mkdir(pathLevel.c_str());
+  //a tile stored before (a previous run) is removed
+  if(content == TILE_CONTENT_EMPTY && m_skipEmptyTiles)
+  {
+    m_statistics.addEmpty(level);
 
-  //create dir column
-  std::string pathColumn = pathLevel + "/" + te::common::Convert2String(tileIdxX);
-  QDir dirColumn(pathColumn.c_str());
-  if(!dirColumn.exists() && save)
-    dirColumn.mkdir(pathColumn.c_str());
+    m_sink->remove(level, tileIdxX, tileIdxY);
+    return;
+  }
 
-  //create file
-  std::string fileName = pathColumn + "/" + te::common::Convert2String(tileIdxY)+ "." + te::common::Convert2LCase(m_format);
+  if(content == TILE_CONTENT_MIXED)
+  {
+    m_encoderPool->add(level, tileIdxX, tileIdxY, image);
+    return;
+  }
+
+  QByteArray data = encodeColor(image, color, level);
+
+  m_sink->write(level, tileIdxX, tileIdxY, data);
+
+  m_statistics.addSingleColor(level);
+  m_statistics.addStored(level, static_cast<std::size_t>(data.size()));
+}
+
+QByteArray geopx::tools::TileGeneratorService::encodeColor(const QImage& image, QRgb color, int level)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_colorMutex);
+
+    std::map<QRgb, QByteArray>::const_iterator it = m_colorTiles.find(color);
+
+    if(it != m_colorTiles.end())
+      return it->second;
+  }
+
+  //two threads can encode the same color, the data is the same
+  QByteArray data;
+
+  {
+    TileStageTimer timer(&m_statistics, TILE_STAGE_ENCODE, level);
+
+    data = m_encoder->encode(image);
+  }
+
+  std::lock_guard<std::mutex> lock(m_colorMutex);
+
+  m_colorTiles[color] = data;
 
-  return fileName;
+  return data;
 }
 
 /*
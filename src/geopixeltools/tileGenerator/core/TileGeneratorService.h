@@ -8,24 +8,71 @@
 #define __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILEGENERATORSERVICE_H
 
 #include "../../Config.h"
+#include "TileRenderer.h"
+#include "TileSink.h"
+#include "TileStatistics.h"
 
 //TerraLib Includes
 #include <terralib/maptools/AbstractLayer.h>
 #include <terralib/geometry/Envelope.h>
-#include <terralib/qt/widgets/canvas/MapDisplay.h>
 
 //STL Includes
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 //QT Includes
-#include <QPixmap>
+#include <QByteArray>
+#include <QColor>
+#include <QImage>
+
+#define TILE_MBTILES_FILE "tiles.mbtiles"
+#define TILE_METATILE_BUFFER 64
+#define TILE_REPORT_FILE "TileReport.txt"
+#define TILE_REPORT_JSON_FILE "TileReport.json"
+
+namespace te { namespace common { class TaskProgress; } }
+namespace te { namespace rst { class Raster; } }
 
 namespace geopx
 {
   namespace tools
   {
     //forward declarations
+    class MBTilesTileSink;
+    class RasterTileReader;
     class Tile;
+    class TileEncoder;
+    class TileEncoderPool;
+
+    /*!
+      \enum TileStoreType
+
+      \brief Where the tiles are stored.
+    */
+    enum TileStoreType
+    {
+      TILE_STORE_DIRECTORY,       //!< One file for each tile, path/level/x/y.format.
+      TILE_STORE_MBTILES          //!< A single MBTiles file, path/tiles.mbtiles.
+    };
+
+    /*!
+      \struct TileRequest
+
+      \brief A tile to be created by the service.
+    */
+    struct TileRequest
+    {
+      int m_level;                //!< The zoom level.
+      long m_x;                   //!< The tile column.
+      long m_y;                   //!< The tile row (0 is the north row).
+      te::gm::Envelope m_env;     //!< The tile box (GOOGLE_SRID).
+    };
 
     class TileGeneratorService
     {
@@ -39,28 +86,190 @@ namespace geopx
 
         void setInputParameters(std::list<te::map::AbstractLayerPtr> layers, te::gm::Envelope env, int srid, int zoomLevelMin, int zoomLevelMax, int tileSize, std::string path, std::string format);
 
+        /*!
+          \brief Writes the tiles missing in the store to the validation log, listing the store once for each level.
+
+          \param createMissingTiles If true the missing tiles are drawn, using the service threads.
+        */
         void runValidation(bool createMissingTiles);
 
         void runService(bool isRaster);
 
+        /*!
+          \brief Regenerates only the tiles changed by an edition of the data.
+
+          The tiles of the maximum level that intersect the changed boxes are drawn again and
+          their ancestors are rebuilt up to the minimum level. In the raster mode the ancestors
+          are built from the new tiles and the stored tiles of their siblings, in the vector mode
+          they are drawn from the layers. The other tiles must have been generated before.
+          The report is written even if no tile is inside the changed boxes.
+
+          \param changed   The boxes of the data changed (in the layers SRID).
+          \param isRaster  The mode used to generate the tiles.
+        */
+        void runIncremental(const std::vector<te::gm::Envelope>& changed, bool isRaster);
+
+        /*!
+          \brief Sets the number of threads that draw the tiles of a level, 0 to use the hardware threads (default).
+
+          \note Each thread draws a copy of the data set layers with its own data sources (see TileRenderer),
+                 the other layers are drawn by one thread at a time.
+        */
+        void setNumberOfThreads(std::size_t nThreads);
+
+        /*!
+          \brief Sets the encoder of the tiles, the service takes its ownership.
+
+          \note It must be called after setInputParameters, which sets the default encoder (Qt image writer of the format).
+        */
+        void setEncoder(TileEncoder* encoder);
+
+        /*! \brief Sets the number of threads that encode the tiles, 0 to use the hardware threads (default). */
+        void setNumberOfEncoderThreads(std::size_t nThreads);
+
+        /*! \brief Sets where the tiles are stored (default TILE_STORE_DIRECTORY). */
+        void setStoreType(TileStoreType type);
+
+        /*!
+          \brief Sets the number of tiles in each side of the blocks (metatiles) drawn at once (default 1).
+
+          The layers are drawn once for each block, with a margin around it, and the block is
+          sliced in tiles. The data source queries and the style setup are done once for the
+          block, and the labels are not clipped at the tile edges inside it.
+        */
+        void setMetatileSize(int size);
+
+        /*! \brief Sets the margin, in pixels, drawn around each block of tiles larger than one tile (default TILE_METATILE_BUFFER). */
+        void setMetatileBuffer(int pixels);
+
+        /*!
+          \brief Sets if the tiles of a raster layer are read from its blocks instead of drawing the layer (default false).
+
+          It is used in the raster mode when a single layer is visible and its data is a raster,
+          otherwise the layers are drawn. The raster is resampled by the nearest neighbour. It is
+          also drawn if its bands are not 8 bit or its style changes the values (see RasterTileReader::GetBands).
+        */
+        void setDirectRasterReading(bool direct);
+
+        /*! \brief Sets the color of the pixels without data (default white), use Qt::transparent to find the empty tiles. */
+        void setBackgroundColor(const QColor& color);
+
+        /*! \brief Sets if the tiles without content (all pixels transparent) are not stored (default false). */
+        void setSkipEmptyTiles(bool skip);
+
+        /*! \brief Sets if the duplicated tiles are stored as links to one file in the directory store (default false). */
+        void setLinkDuplicateTiles(bool link);
+
+        /*!
+          \brief Returns the counters and stage times of the last run.
+
+          At the end of each run they are also written to path/TILE_REPORT_FILE (text) and
+          path/TILE_REPORT_JSON_FILE (JSON), which can be compared between runs.
+        */
+        const TileStatistics& getStatistics() const;
+
       protected:
 
         void checkParameters();
 
-        void buildDisplay();
+        void buildRenderer();
+
+        /*! \brief Creates the sink of the store type. */
+        void buildSink();
+
+        /*! \brief Creates the default encoder, if none was set, and starts the encoder threads. */
+        void buildEncoder();
+
+        /*! \brief Opens the raster read directly, if it is enabled and the mode is raster. */
+        void buildRasterReader(bool isRaster);
+
+        /*! \brief Stops the run statistics and writes the reports to the service path, a report not written is logged. */
+        void writeReport();
+
+        /*! \brief Sets the MBTiles metadata from the service parameters. */
+        void setMetadata(MBTilesTileSink* sink, bool isRaster);
+
+        /*! \brief Gets the tiles of a zoom level that intersect the service box. */
+        void getLevelTiles(int level, std::vector<TileRequest>& requests);
+
+        /*! \brief Gets the blocks of tiles of a zoom level, the tile (m_x, m_y) of each request is the first tile of the block. */
+        void getLevelMetatiles(int level, std::vector<TileRequest>& requests);
+
+        /*!
+          \brief Draws a block of tiles and gives each tile of it, inside the service box, to the consumer.
+
+          A null image is given for the tiles of a block that could not be drawn, they are counted as failed.
+        */
+        void drawMetatile(const TileRequest& metatile, const std::function<void(const TileRequest&, const QImage&)>& consumer);
+
+        /*! \brief Draws the maximum level and builds the lower levels from it in memory. */
+        void generateFromRaster();
+
+        /*! \brief Draws all levels from the layers. */
+        void generateFromVector();
+
+        /*!
+          \brief Gets the tiles (x, y) of each level, from the minimum level, that intersect the changed boxes.
+        */
+        void getChangedTiles(const std::vector<te::gm::Envelope>& changed, std::vector<std::set<std::pair<long, long> > >& tiles);
+
+        /*! \brief Draws the changed tiles of the maximum level and builds their ancestors with the stored siblings. */
+        void regenerateFromRaster(const std::vector<std::set<std::pair<long, long> > >& tiles);
+
+        /*! \brief Draws the changed tiles of all levels from the layers. */
+        void regenerateFromVector(const std::vector<std::set<std::pair<long, long> > >& tiles);
 
-        QPixmap* drawTile(te::gm::Envelope env);
+        /*!
+          \brief Calls the work function for each tile, using the service threads.
 
-        QPixmap drawTile(te::gm::Envelope env, int level);
+          The progress is updated by the calling thread. A tile whose work fails is skipped and counted as failed.
 
-        void validateTile(FILE* file, Tile* tile, int level, int tileIdxX, int tileIdxY, bool& isValid);
+          \return False if the progress was canceled.
+        */
+        bool processTiles(const std::vector<TileRequest>& requests, te::common::TaskProgress& progress, const std::function<void(const TileRequest&)>& work);
 
-        void savePixmap(Tile* tile, QPixmap* pix, int level, int tileIdxX, int tileIdxY);
+        QImage drawTile(int level, const te::gm::Envelope& env);
 
-        std::string getOSMTileFilePath(Tile* tile, int level, int tileIdxX, int tileIdxY, bool save);
+        /*! \brief Draws the layers, or reads the raster directly, in an image of a box (GOOGLE_SRID), the time is added to the level. */
+        QImage drawImage(int level, const te::gm::Envelope& env, int width, int height);
+
+        /*! \brief Stores a tile, the images with more than one color are given to the encoder threads. */
+        void saveImage(const QImage& image, int level, long tileIdxX, long tileIdxY);
+
+        /*! \brief Encodes a tile of a single color, each color is encoded once. */
+        QByteArray encodeColor(const QImage& image, QRgb color, int level);
 
       protected:
-        te::qt::widgets::MapDisplay* m_display;
+        std::unique_ptr<TileRenderer> m_renderer;       //!< Draws the layers off screen.
+
+        std::size_t m_threads;                          //!< Number of threads that draw the tiles.
+
+        int m_metatileSize;                             //!< Number of tiles in each side of a block drawn at once.
+        int m_metatileBuffer;                           //!< Margin drawn around each block, in pixels.
+
+        TileStoreType m_storeType;                      //!< Where the tiles are stored.
+
+        TileStatistics m_statistics;                    //!< The counters and stage times of the run (used by the encoder threads and the pyramid).
+
+        std::unique_ptr<TileSink> m_sink;               //!< Stores the tiles.
+
+        std::unique_ptr<TileEncoder> m_encoder;         //!< Encodes the tiles.
+
+        std::size_t m_encoderThreads;                   //!< Number of threads that encode the tiles.
+
+        std::unique_ptr<TileEncoderPool> m_encoderPool; //!< Encodes and stores the tiles drawn (destroyed before the sink).
+
+        QColor m_backgroundColor;                       //!< The color of the pixels without data.
+
+        bool m_skipEmptyTiles;                          //!< True if the transparent tiles are not stored.
+        bool m_linkDuplicateTiles;                      //!< True if the duplicated tiles are linked (directory store).
+
+        bool m_directRaster;                            //!< True if a raster layer is read directly.
+        std::unique_ptr<te::rst::Raster> m_raster;      //!< The raster read directly.
+        std::unique_ptr<RasterTileReader> m_rasterReader; //!< Reads the raster tiles (destroyed before the raster).
+
+        std::map<QRgb, QByteArray> m_colorTiles;        //!< The data of the single color tiles encoded.
+        std::mutex m_colorMutex;                        //!< Protects the single color tiles.
 
         std::list<te::map::AbstractLayerPtr> m_layers;
 
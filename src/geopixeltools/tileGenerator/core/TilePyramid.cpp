@@ -0,0 +1,161 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TilePyramid.cpp
+
+  \brief This file contains a class used to build the lower zoom levels from the tiles of the maximum level.
+*/
+
+#include "TilePyramid.h"
+#include "Tile.h"
+#include "TileStatistics.h"
+
+//STL Includes
+#include <algorithm>
+
+namespace
+{
+  /*! Averages four premultiplied ARGB pixels, two channels at a time */
+  inline quint32 Average4(quint32 a, quint32 b, quint32 c, quint32 d)
+  {
+    quint32 rb = (a & 0x00FF00FF) + (b & 0x00FF00FF) + (c & 0x00FF00FF) + (d & 0x00FF00FF) + 0x00020002;
+    quint32 ag = ((a >> 8) & 0x00FF00FF) + ((b >> 8) & 0x00FF00FF) + ((c >> 8) & 0x00FF00FF) + ((d >> 8) & 0x00FF00FF) + 0x00020002;
+
+    return ((rb >> 2) & 0x00FF00FF) | (((ag >> 2) & 0x00FF00FF) << 8);
+  }
+}
+
+geopx::tools::TilePyramid::TilePyramid(const te::gm::Envelope& env, int minLevel, int maxLevel, int tileSize, TileStatistics* statistics) :
+  m_minLevel(minLevel),
+  m_maxLevel(maxLevel),
+  m_tileSize(tileSize),
+  m_statistics(statistics)
+{
+  for(int i = minLevel; i <= maxLevel; ++i)
+  {
+    Tile tile(i, tileSize);
+
+    long tIdxX1, tIdxY1, tIdxX2, tIdxY2;
+
+    tile.tileMatrix(env, tIdxX1, tIdxY1, tIdxX2, tIdxY2);
+
+    m_firstX.push_back(tIdxX1);
+    m_lastX.push_back(tIdxX2);
+    m_firstY.push_back(tIdxY2);
+    m_lastY.push_back(tIdxY1);
+  }
+}
+
+geopx::tools::TilePyramid::~TilePyramid()
+{
+}
+
+void geopx::tools::TilePyramid::add(int level, long x, long y, const QImage& image, const Consumer& consumer)
+{
+  if(level <= m_minLevel || level > m_maxLevel)
+    return;
+
+  int parentLevel = level - 1;
+  long parentX = x / 2;
+  long parentY = y / 2;
+
+  QImage children[4];
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::pair<int, std::pair<long, long> > key(parentLevel, std::make_pair(parentX, parentY));
+
+    Quad& quad = m_quads[key];
+
+    quad.m_children[(y % 2) * 2 + x % 2] = image;
+
+    if(++quad.m_count < getChildrenCount(parentLevel, parentX, parentY))
+      return;
+
+    for(int t = 0; t < 4; ++t)
+      children[t] = quad.m_children[t];
+
+    m_quads.erase(key);
+  }
+
+  QImage parent;
+
+  {
+    TileStageTimer timer(m_statistics, TILE_STAGE_DOWNSAMPLE, parentLevel);
+
+    parent = downsample(children, m_tileSize);
+  }
+
+  consumer(parentLevel, parentX, parentY, parent);
+
+  add(parentLevel, parentX, parentY, parent, consumer);
+}
+
+std::size_t geopx::tools::TilePyramid::getPendingCount()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  return m_quads.size();
+}
+
+unsigned long long geopx::tools::TilePyramid::getZOrder(long x, long y)
+{
+  unsigned long long z = 0;
+
+  for(int b = 0; b < 32; ++b)
+  {
+    z |= static_cast<unsigned long long>((x >> b) & 1) << (2 * b);
+    z |= static_cast<unsigned long long>((y >> b) & 1) << (2 * b + 1);
+  }
+
+  return z;
+}
+
+QImage geopx::tools::TilePyramid::downsample(const QImage children[4], int tileSize)
+{
+  QImage parent(tileSize, tileSize, QImage::Format_ARGB32_Premultiplied);
+  parent.fill(Qt::transparent);
+
+  int half = tileSize / 2;
+
+  for(int t = 0; t < 4; ++t)
+  {
+    if(children[t].isNull())
+      continue;
+
+    QImage child = children[t];
+
+    if(child.format() != QImage::Format_ARGB32_Premultiplied)
+      child = child.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    if(child.width() != tileSize || child.height() != tileSize)
+      child = child.scaled(tileSize, tileSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    int offsetX = (t % 2) * half;
+    int offsetY = (t / 2) * half;
+
+    for(int r = 0; r < half; ++r)
+    {
+      const quint32* line0 = reinterpret_cast<const quint32*>(child.constScanLine(2 * r));
+      const quint32* line1 = reinterpret_cast<const quint32*>(child.constScanLine(2 * r + 1));
+
+      quint32* out = reinterpret_cast<quint32*>(parent.scanLine(offsetY + r)) + offsetX;
+
+      for(int c = 0; c < half; ++c)
+        out[c] = Average4(line0[2 * c], line0[2 * c + 1], line1[2 * c], line1[2 * c + 1]);
+    }
+  }
+
+  return parent;
+}
+
+int geopx::tools::TilePyramid::getChildrenCount(int level, long x, long y) const
+{
+  std::size_t child = static_cast<std::size_t>(level + 1 - m_minLevel);
+
+  long x0 = std::max(2 * x, m_firstX[child]);
+  long x1 = std::min(2 * x + 1, m_lastX[child]);
+  long y0 = std::max(2 * y, m_firstY[child]);
+  long y1 = std::min(2 * y + 1, m_lastY[child]);
+
+  return static_cast<int>((x1 - x0 + 1) * (y1 - y0 + 1));
+}
@@ -0,0 +1,122 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TilePyramid.h
+
+  \brief This file contains a class used to build the lower zoom levels from the tiles of the maximum level.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILEPYRAMID_H
+#define __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILEPYRAMID_H
+
+#include "../../Config.h"
+
+//TerraLib Includes
+#include <terralib/geometry/Envelope.h>
+
+//STL Includes
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+//QT Includes
+#include <QImage>
+
+namespace geopx
+{
+  namespace tools
+  {
+    //forward declarations
+    class TileStatistics;
+
+    /*!
+      \class TilePyramid
+
+      \brief Builds the tiles of the lower zoom levels from the tiles of the maximum level, in memory.
+
+      The tiles of the maximum level are added as they are drawn. Each parent tile is built by
+      a 2x2 box filter over the raw pixels of its children as soon as all of its children were
+      added, and it is added to the next level. The children are released when the parent is
+      built, so when the maximum level tiles are added in Z-order only a few incomplete
+      parents are kept in memory for each level.
+
+      \note add() can be called by many threads at the same time.
+    */
+    class GEOPXTOOLSEXPORT TilePyramid
+    {
+      public:
+
+        /*! \brief Called with each parent tile built (level, x, y, image). */
+        typedef std::function<void(int, long, long, const QImage&)> Consumer;
+
+        /*!
+          \brief Constructor.
+
+          \param env        The box of the tiles (GOOGLE_SRID), it gives the tiles of each level.
+          \param minLevel   The lowest level built.
+          \param maxLevel   The level whose tiles are added.
+          \param tileSize   The tile width and height.
+          \param statistics The statistics where the downsample time is added, if not null.
+        */
+        TilePyramid(const te::gm::Envelope& env, int minLevel, int maxLevel, int tileSize, TileStatistics* statistics = 0);
+
+        ~TilePyramid();
+
+      public:
+
+        /*!
+          \brief Adds a tile, the parents completed by it are built and given to the consumer.
+
+          \param image The tile image, a null image if the tile could not be drawn (it is transparent in the parent).
+        */
+        void add(int level, long x, long y, const QImage& image, const Consumer& consumer);
+
+        /*! \brief Returns the number of parents waiting for children. */
+        std::size_t getPendingCount();
+
+        /*! \brief Returns the position of a tile in the Z-order (the bits of x and y interleaved). */
+        static unsigned long long getZOrder(long x, long y);
+
+        /*!
+          \brief Builds a tile from its four children with a 2x2 box filter.
+
+          \param children The children images (top left, top right, bottom left and bottom right), null images are transparent.
+        */
+        static QImage downsample(const QImage children[4], int tileSize);
+
+      protected:
+
+        /*! \brief The children of a parent tile added so far. */
+        struct Quad
+        {
+          Quad() : m_count(0) {}
+
+          QImage m_children[4];
+          int m_count;
+        };
+
+        /*! \brief Returns the number of children of a parent tile inside the box. */
+        int getChildrenCount(int level, long x, long y) const;
+
+      protected:
+
+        int m_minLevel;
+        int m_maxLevel;
+        int m_tileSize;
+
+        TileStatistics* m_statistics;                                   //!< Times the downsample, if not null.
+
+        std::vector<long> m_firstX;                                     //!< First column of each level.
+        std::vector<long> m_lastX;                                      //!< Last column of each level.
+        std::vector<long> m_firstY;                                     //!< First row of each level.
+        std::vector<long> m_lastY;                                      //!< Last row of each level.
+
+        std::map<std::pair<int, std::pair<long, long> >, Quad> m_quads; //!< Incomplete parents (level, x, y).
+
+        std::mutex m_mutex;                                             //!< Protects the quads.
+    };
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILEPYRAMID_H
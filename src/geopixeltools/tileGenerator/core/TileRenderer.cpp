@@ -0,0 +1,185 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileRenderer.cpp
+
+  \brief This file contains a class used to draw a set of layers into off screen images.
+*/
+
+//size in meters of a pixel used to compute the scale (OGC standard rendering pixel)
+#define TILE_RENDERER_PIXEL_SIZE 0.00028
+
+#include "TileRenderer.h"
+
+//TerraLib Includes
+#include <terralib/dataaccess/datasource/DataSourceInfo.h>
+#include <terralib/dataaccess/datasource/DataSourceInfoManager.h>
+#include <terralib/dataaccess/datasource/DataSourceManager.h>
+#include <terralib/maptools/DataSetLayer.h>
+#include <terralib/maptools/Enums.h>
+#include <terralib/qt/widgets/canvas/Canvas.h>
+
+//Boost Includes
+#include <boost/uuid/random_generator.hpp>
+#include <boost/uuid/uuid_io.hpp>
+
+//STL Includes
+#include <algorithm>
+
+geopx::tools::TileRenderer::TileRenderer(const std::list<te::map::AbstractLayerPtr>& layers, int srid) :
+  m_layers(layers),
+  m_srid(srid),
+  m_backgroundColor(Qt::white),
+  m_copyable(true)
+{
+  m_copies.push_back(m_layers);
+  m_free.push_back(0);
+}
+
+geopx::tools::TileRenderer::~TileRenderer()
+{
+  m_copies.clear();
+
+  for(std::size_t t = 0; t < m_dataSources.size(); ++t)
+    te::da::DataSourceManager::getInstance().detach(m_dataSources[t]);
+}
+
+void geopx::tools::TileRenderer::setBackgroundColor(const QColor& color)
+{
+  m_backgroundColor = color;
+}
+
+std::size_t geopx::tools::TileRenderer::reserve(std::size_t nThreads)
+{
+  while(m_copyable && m_copies.size() < nThreads)
+  {
+    LayerList copies;
+
+    try
+    {
+      for(LayerList::const_iterator it = m_layers.begin(); it != m_layers.end() && m_copyable; ++it)
+      {
+        //the hidden layers are not drawn
+        if((*it)->getVisibility() == te::map::NOT_VISIBLE)
+          continue;
+
+        te::map::AbstractLayerPtr copy = copyLayer(*it);
+
+        if(copy.get())
+          copies.push_back(copy);
+        else
+          m_copyable = false;
+      }
+    }
+    catch(...)
+    {
+      //the data source could not be opened again
+      m_copyable = false;
+    }
+
+    if(!m_copyable)
+      break;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_free.push_back(m_copies.size());
+    m_copies.push_back(copies);
+  }
+
+  return std::min(nThreads, m_copies.size());
+}
+
+QImage geopx::tools::TileRenderer::draw(const te::gm::Envelope& env, int width, int height, bool* cancel)
+{
+  QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+
+  image.fill(m_backgroundColor);
+
+  std::size_t idx = 0;
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_released.wait(lock, [this] { return !m_free.empty(); });
+
+    idx = m_free.back();
+    m_free.pop_back();
+  }
+
+  try
+  {
+    draw(m_copies[idx], image, env, cancel);
+  }
+  catch(...)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_free.push_back(idx);
+    m_released.notify_one();
+
+    throw;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_free.push_back(idx);
+  }
+
+  m_released.notify_one();
+
+  return image;
+}
+
+te::map::AbstractLayerPtr geopx::tools::TileRenderer::copyLayer(const te::map::AbstractLayerPtr& layer)
+{
+  te::map::DataSetLayer* dsLayer = dynamic_cast<te::map::DataSetLayer*>(layer.get());
+
+  if(!dsLayer)
+    return te::map::AbstractLayerPtr();
+
+  te::da::DataSourceInfoPtr info = te::da::DataSourceInfoManager::getInstance().get(dsLayer->getDataSourceId());
+
+  if(!info.get())
+    return te::map::AbstractLayerPtr();
+
+  boost::uuids::basic_random_generator<boost::mt19937> gen;
+  boost::uuids::uuid u = gen();
+  std::string id = boost::uuids::to_string(u);
+
+  //a data source with the same connection, used only by the copy
+  te::da::DataSourcePtr ds = te::da::DataSourceManager::getInstance().get(id, info->getType(), info->getConnInfo());
+
+  m_dataSources.push_back(ds);
+
+  te::map::AbstractLayerPtr copy(dsLayer->clone());
+
+  te::map::DataSetLayer* dsCopy = dynamic_cast<te::map::DataSetLayer*>(copy.get());
+
+  if(!dsCopy)
+    return te::map::AbstractLayerPtr();
+
+  dsCopy->setDataSourceId(id);
+
+  return copy;
+}
+
+void geopx::tools::TileRenderer::draw(const LayerList& layers, QImage& image, const te::gm::Envelope& env, bool* cancel) const
+{
+  //the canvas ends its painter when destroyed, before the image is returned; its own device
+  //is an image too, a pixmap can only be created by the GUI thread
+  te::qt::widgets::Canvas canvas(image.width(), image.height(), QInternal::Image);
+  canvas.setDevice(&image, false);
+  canvas.setWindow(env.m_llx, env.m_lly, env.m_urx, env.m_ury);
+
+  double scale = (env.getWidth() / image.width()) / TILE_RENDERER_PIXEL_SIZE;
+
+  for(LayerList::const_reverse_iterator it = layers.rbegin(); it != layers.rend(); ++it)
+  {
+    if(*cancel)
+      break;
+
+    if((*it)->getVisibility() == te::map::NOT_VISIBLE)
+      continue;
+
+    (*it)->draw(&canvas, env, m_srid, scale, cancel);
+  }
+}
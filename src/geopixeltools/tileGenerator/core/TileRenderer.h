@@ -0,0 +1,120 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileRenderer.h
+
+  \brief This file contains a class used to draw a set of layers into off screen images.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILERENDERER_H
+#define __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILERENDERER_H
+
+#include "../../Config.h"
+
+//TerraLib Includes
+#include <terralib/dataaccess/datasource/DataSource.h>
+#include <terralib/maptools/AbstractLayer.h>
+#include <terralib/geometry/Envelope.h>
+
+//STL Includes
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <vector>
+
+//QT Includes
+#include <QColor>
+#include <QImage>
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \class TileRenderer
+
+      \brief Draws a set of layers into off screen images.
+
+      Each call to draw uses its own image and canvas. The images are QImage because QPixmap
+      can only be used by the GUI thread.
+
+      Most data source drivers can not be read by many threads at the same time, so each
+      thread draws its own copy of the layers, with data sources opened from the connections
+      of the layer data sources (see reserve). A thread waits while all copies are drawn by
+      the other threads, so the layers that can not be copied are drawn by one thread at a time.
+    */
+    class TileRenderer
+    {
+      public:
+
+        /*!
+          \brief Constructor.
+
+          \param layers The layers, the first layer is drawn over the others.
+          \param srid   The SRID of the boxes given to draw.
+        */
+        TileRenderer(const std::list<te::map::AbstractLayerPtr>& layers, int srid);
+
+        /*! \brief Closes the data sources opened for the copies of the layers. */
+        ~TileRenderer();
+
+      public:
+
+        /*! \brief Sets the color used to fill the images before the layers are drawn (default white). */
+        void setBackgroundColor(const QColor& color);
+
+        /*!
+          \brief Copies the layers to be drawn by many threads at the same time.
+
+          Only the data set layers are copied, each copy with a new data source. The copies are
+          kept until the renderer is destroyed.
+
+          \param nThreads The number of threads.
+
+          \return The number of threads that can draw at the same time, 1 if a visible layer can not be copied.
+
+          \note It must not be called while a thread draws.
+        */
+        std::size_t reserve(std::size_t nThreads);
+
+        /*!
+          \brief Draws the layers over the box into a new image.
+
+          \param env    The box drawn, using the renderer SRID.
+          \param width  The image width.
+          \param height The image height.
+          \param cancel Flag checked by the layers while drawing.
+
+          \note It waits while the copies of the layers are drawn by other threads.
+        */
+        QImage draw(const te::gm::Envelope& env, int width, int height, bool* cancel);
+
+      protected:
+
+        typedef std::list<te::map::AbstractLayerPtr> LayerList;
+
+        /*! \brief Copies a data set layer with a new data source, returns a null pointer if it is not a data set layer. */
+        te::map::AbstractLayerPtr copyLayer(const te::map::AbstractLayerPtr& layer);
+
+        /*! \brief Draws a set of layers into the image. */
+        void draw(const LayerList& layers, QImage& image, const te::gm::Envelope& env, bool* cancel) const;
+
+      protected:
+
+        LayerList m_layers;                               //!< The layers drawn.
+
+        int m_srid;                                       //!< The SRID of the boxes.
+
+        QColor m_backgroundColor;                         //!< The color of the pixels without data.
+
+        std::vector<LayerList> m_copies;                  //!< The layers drawn by each thread, the first ones are the layers given.
+        std::vector<te::da::DataSourcePtr> m_dataSources; //!< The data sources opened for the copies.
+        bool m_copyable;                                  //!< False if a visible layer can not be copied.
+
+        std::vector<std::size_t> m_free;                  //!< The copies not drawn by a thread.
+        std::mutex m_mutex;                               //!< Protects the free copies.
+        std::condition_variable m_released;               //!< Signaled when a thread finishes drawing a copy.
+    };
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILERENDERER_H
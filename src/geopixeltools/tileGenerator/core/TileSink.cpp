@@ -0,0 +1,195 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileSink.cpp
+
+  \brief This file contains the interface used by the tile generator to store the tiles.
+*/
+
+#include "TileSink.h"
+#include "TileStatistics.h"
+
+//TerraLib Includes
+#include <terralib/common/StringUtils.h>
+#include <terralib/core/Exception.h>
+
+//Boost Includes
+#include <boost/filesystem.hpp>
+
+//Qt Includes
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+
+//STL Includes
+#include <cstdlib>
+
+geopx::tools::TileSink::TileSink() :
+  m_statistics(0)
+{
+}
+
+geopx::tools::TileSink::~TileSink()
+{
+}
+
+void geopx::tools::TileSink::setStatistics(TileStatistics* statistics)
+{
+  m_statistics = statistics;
+}
+
+geopx::tools::DirectoryTileSink::DirectoryTileSink(const std::string& path, const std::string& format) :
+  m_path(path),
+  m_extension(te::common::Convert2LCase(format)),
+  m_linkDuplicates(false)
+{
+}
+
+geopx::tools::DirectoryTileSink::~DirectoryTileSink()
+{
+}
+
+void geopx::tools::DirectoryTileSink::write(int level, long x, long y, const QByteArray& data)
+{
+  TileStageTimer timer(m_statistics, TILE_STAGE_WRITE, level);
+
+  createDirectory(level, x);
+
+  std::string fileName = getFilePath(level, x, y);
+
+  //the old file can be linked by other tiles, so it is not overwritten
+  boost::system::error_code ec;
+  boost::filesystem::remove(fileName, ec);
+
+  std::string hash;
+
+  if(m_linkDuplicates)
+  {
+    hash = QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex().constData();
+
+    std::string linked;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      std::unordered_map<std::string, std::string>::const_iterator it = m_files.find(hash);
+
+      if(it != m_files.end())
+        linked = it->second;
+    }
+
+    //if the link fails (file system without hard links) the tile is written
+    if(!linked.empty())
+    {
+      boost::filesystem::create_hard_link(linked, fileName, ec);
+
+      if(!ec)
+        return;
+    }
+  }
+
+  {
+    QFile file(fileName.c_str());
+
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+      throw te::core::Exception() << te::ErrorDescription("Error writing the tile file " + fileName + ".");
+  }
+
+  if(m_linkDuplicates)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_files.size() >= DIRECTORY_SINK_MAX_HASHES)
+      m_files.clear();
+
+    m_files.insert(std::make_pair(hash, fileName));
+  }
+}
+
+void geopx::tools::DirectoryTileSink::remove(int level, long x, long y)
+{
+  boost::system::error_code ec;
+  boost::filesystem::remove(getFilePath(level, x, y), ec);
+}
+
+bool geopx::tools::DirectoryTileSink::read(int level, long x, long y, QByteArray& data)
+{
+  QFile file(getFilePath(level, x, y).c_str());
+
+  if(!file.open(QIODevice::ReadOnly))
+    return false;
+
+  data = file.readAll();
+
+  return true;
+}
+
+bool geopx::tools::DirectoryTileSink::exists(int level, long x, long y)
+{
+  return QFile::exists(getFilePath(level, x, y).c_str());
+}
+
+void geopx::tools::DirectoryTileSink::getStoredTiles(int level, std::set<std::pair<long, long> >& tiles)
+{
+  boost::filesystem::path pathLevel(m_path + "/" + te::common::Convert2String(level));
+
+  std::string extension = "." + m_extension;
+
+  boost::system::error_code ec;
+
+  for(boost::filesystem::directory_iterator itColumn(pathLevel, ec), end; !ec && itColumn != end; itColumn.increment(ec))
+  {
+    std::string column = itColumn->path().filename().string();
+
+    char* last = 0;
+
+    long x = std::strtol(column.c_str(), &last, 10);
+
+    if(column.empty() || *last != '\0')
+      continue;
+
+    boost::system::error_code ecColumn;
+
+    for(boost::filesystem::directory_iterator itRow(itColumn->path(), ecColumn); !ecColumn && itRow != end; itRow.increment(ecColumn))
+    {
+      std::string row = itRow->path().filename().string();
+
+      if(row.size() <= extension.size() || row.compare(row.size() - extension.size(), extension.size(), extension) != 0)
+        continue;
+
+      long y = std::strtol(row.c_str(), &last, 10);
+
+      if(last != row.c_str() + row.size() - extension.size())
+        continue;
+
+      tiles.insert(std::make_pair(x, y));
+    }
+  }
+}
+
+void geopx::tools::DirectoryTileSink::flush()
+{
+}
+
+void geopx::tools::DirectoryTileSink::setLinkDuplicates(bool link)
+{
+  m_linkDuplicates = link;
+}
+
+std::string geopx::tools::DirectoryTileSink::getFilePath(int level, long x, long y) const
+{
+  return m_path + "/" + te::common::Convert2String(level) + "/" + te::common::Convert2String(x) + "/" + te::common::Convert2String(y) + "." + m_extension;
+}
+
+void geopx::tools::DirectoryTileSink::createDirectory(int level, long x)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if(!m_columns.insert(std::make_pair(level, x)).second)
+    return;
+
+  std::string pathColumn = m_path + "/" + te::common::Convert2String(level) + "/" + te::common::Convert2String(x);
+
+  QDir dir(m_path.c_str());
+
+  if(!dir.mkpath(pathColumn.c_str()))
+    throw te::core::Exception() << te::ErrorDescription("Error creating the tile directory " + pathColumn + ".");
+}
@@ -0,0 +1,143 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileSink.h
+
+  \brief This file contains the interface used by the tile generator to store the tiles.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILESINK_H
+#define __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILESINK_H
+
+#include "../../Config.h"
+
+//STL Includes
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+//QT Includes
+#include <QByteArray>
+
+#define DIRECTORY_SINK_MAX_HASHES 65536
+
+namespace geopx
+{
+  namespace tools
+  {
+    class TileStatistics;
+
+    /*!
+      \class TileSink
+
+      \brief The store of the tiles created by the tile generator.
+
+      The tiles are identified by the zoom level and the tile column and row, with the
+      row 0 at the north (as the Tile class). The data is the encoded image.
+
+      The sink adds the time spent storing each tile to the TILE_STAGE_WRITE stage of the
+      statistics, where the data is actually stored (a sink may write in another thread).
+
+      \note Implementations must accept calls from more than one thread.
+    */
+    class GEOPXTOOLSEXPORT TileSink
+    {
+      public:
+
+        TileSink();
+
+        virtual ~TileSink();
+
+      public:
+
+        /*! \brief Stores a tile, replacing the tile stored before. */
+        virtual void write(int level, long x, long y, const QByteArray& data) = 0;
+
+        /*! \brief Removes a tile stored, nothing is done if the tile does not exist. */
+        virtual void remove(int level, long x, long y) = 0;
+
+        /*! \brief Reads a tile stored, returns false if the tile does not exist. */
+        virtual bool read(int level, long x, long y, QByteArray& data) = 0;
+
+        /*! \brief Returns true if the tile is stored. */
+        virtual bool exists(int level, long x, long y) = 0;
+
+        /*! \brief Gets the tiles (x, y) stored for a level, with a single listing of the store. */
+        virtual void getStoredTiles(int level, std::set<std::pair<long, long> >& tiles) = 0;
+
+        /*! \brief Waits until all tiles written are stored and can be read. */
+        virtual void flush() = 0;
+
+        /*! \brief Sets the statistics that receive the write times, it must be set before the first write. */
+        void setStatistics(TileStatistics* statistics);
+
+      protected:
+
+        TileStatistics* m_statistics;                     //!< Receives the write times, if not null.
+    };
+
+    /*!
+      \class DirectoryTileSink
+
+      \brief A sink that writes each tile to a file path/level/x/y.format (the OSM layout).
+
+      When the duplicates are linked, a tile whose data was already written is stored as a
+      hard link to the first file with the same data. A tile is always written to a new file
+      (the old one is removed), so replacing a tile does not change the tiles linked to it.
+    */
+    class GEOPXTOOLSEXPORT DirectoryTileSink : public TileSink
+    {
+      public:
+
+        /*!
+          \param path   The base directory, it must exist.
+          \param format The file extension.
+        */
+        DirectoryTileSink(const std::string& path, const std::string& format);
+
+        ~DirectoryTileSink();
+
+      public:
+
+        void write(int level, long x, long y, const QByteArray& data);
+
+        void remove(int level, long x, long y);
+
+        bool read(int level, long x, long y, QByteArray& data);
+
+        bool exists(int level, long x, long y);
+
+        /*! \brief Lists the column directories of the level and the files of each column, without reading the file attributes. */
+        void getStoredTiles(int level, std::set<std::pair<long, long> >& tiles);
+
+        void flush();
+
+        /*! \brief Sets if the tiles with the same data are stored as hard links to one file (default false). */
+        void setLinkDuplicates(bool link);
+
+        /*! \brief Returns the path of the tile file. */
+        std::string getFilePath(int level, long x, long y) const;
+
+      protected:
+
+        /*! \brief Creates the level and column directories of a tile, once for each column. */
+        void createDirectory(int level, long x);
+
+      protected:
+
+        std::string m_path;                               //!< The base directory.
+        std::string m_extension;                          //!< The file extension (lower case format).
+
+        std::set<std::pair<int, long> > m_columns;        //!< Columns whose directory was created.
+
+        bool m_linkDuplicates;                            //!< True if the duplicated tiles are linked.
+
+        std::unordered_map<std::string, std::string> m_files; //!< The file written for each data hash (cleared when it reaches DIRECTORY_SINK_MAX_HASHES).
+
+        std::mutex m_mutex;                               //!< Protects the columns and the files.
+    };
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILESINK_H
@@ -0,0 +1,349 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileStatistics.cpp
+
+  \brief This file contains the counters and stage timers of a tile generation run.
+*/
+
+#include "TileStatistics.h"
+
+//TerraLib Includes
+#include <terralib/core/Exception.h>
+
+//STL Includes
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+geopx::tools::TileStatistics::TileStatistics() :
+  m_minLevel(0),
+  m_maxLevel(-1),
+  m_running(false)
+{
+  for(int s = 0; s < TILE_STAGE_COUNT; ++s)
+  {
+    m_stageSeconds[s] = 0.;
+    m_stageCalls[s] = 0;
+  }
+}
+
+geopx::tools::TileStatistics::~TileStatistics()
+{
+}
+
+void geopx::tools::TileStatistics::start(int minLevel, int maxLevel)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_minLevel = minLevel;
+  m_maxLevel = maxLevel;
+
+  for(int s = 0; s < TILE_STAGE_COUNT; ++s)
+  {
+    m_stageSeconds[s] = 0.;
+    m_stageCalls[s] = 0;
+  }
+
+  m_levels.assign(maxLevel >= minLevel ? static_cast<std::size_t>(maxLevel - minLevel + 1) : 0, TileLevelStatistics());
+
+  m_start = std::chrono::steady_clock::now();
+  m_stop = m_start;
+  m_running = true;
+}
+
+void geopx::tools::TileStatistics::stop()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if(!m_running)
+    return;
+
+  m_stop = std::chrono::steady_clock::now();
+  m_running = false;
+}
+
+void geopx::tools::TileStatistics::addTime(TileStage stage, int level, double seconds)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_stageSeconds[stage] += seconds;
+  ++m_stageCalls[stage];
+
+  if(TileLevelStatistics* counters = getLevelCounters(level))
+    counters->m_seconds += seconds;
+}
+
+void geopx::tools::TileStatistics::addStored(int level, std::size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if(TileLevelStatistics* counters = getLevelCounters(level))
+  {
+    ++counters->m_tiles;
+    counters->m_bytes += bytes;
+  }
+}
+
+void geopx::tools::TileStatistics::addEmpty(int level)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if(TileLevelStatistics* counters = getLevelCounters(level))
+    ++counters->m_emptyTiles;
+}
+
+void geopx::tools::TileStatistics::addSingleColor(int level)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if(TileLevelStatistics* counters = getLevelCounters(level))
+    ++counters->m_singleColorTiles;
+}
+
+void geopx::tools::TileStatistics::addFailed(int level, std::size_t tiles)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if(TileLevelStatistics* counters = getLevelCounters(level))
+    counters->m_failedTiles += tiles;
+}
+
+double geopx::tools::TileStatistics::getSeconds() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  std::chrono::steady_clock::time_point end = m_running ? std::chrono::steady_clock::now() : m_stop;
+
+  return std::chrono::duration<double>(end - m_start).count();
+}
+
+double geopx::tools::TileStatistics::getStageSeconds(TileStage stage) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  return m_stageSeconds[stage];
+}
+
+std::size_t geopx::tools::TileStatistics::getStageCalls(TileStage stage) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  return m_stageCalls[stage];
+}
+
+geopx::tools::TileLevelStatistics geopx::tools::TileStatistics::getTotal() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  TileLevelStatistics total;
+
+  for(std::size_t i = 0; i < m_levels.size(); ++i)
+  {
+    total.m_tiles += m_levels[i].m_tiles;
+    total.m_emptyTiles += m_levels[i].m_emptyTiles;
+    total.m_singleColorTiles += m_levels[i].m_singleColorTiles;
+    total.m_failedTiles += m_levels[i].m_failedTiles;
+    total.m_bytes += m_levels[i].m_bytes;
+    total.m_seconds += m_levels[i].m_seconds;
+  }
+
+  return total;
+}
+
+geopx::tools::TileLevelStatistics geopx::tools::TileStatistics::getLevel(int level) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if(level < m_minLevel || level > m_maxLevel)
+    return TileLevelStatistics();
+
+  return m_levels[static_cast<std::size_t>(level - m_minLevel)];
+}
+
+int geopx::tools::TileStatistics::getMinLevel() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  return m_minLevel;
+}
+
+int geopx::tools::TileStatistics::getMaxLevel() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  return m_maxLevel;
+}
+
+double geopx::tools::TileStatistics::getTilesPerSecond() const
+{
+  double seconds = getSeconds();
+
+  if(seconds <= 0.)
+    return 0.;
+
+  return getTotal().m_tiles / seconds;
+}
+
+double geopx::tools::TileStatistics::getEmptyRatio() const
+{
+  TileLevelStatistics total = getTotal();
+
+  std::size_t tiles = total.m_tiles + total.m_emptyTiles;
+
+  if(tiles == 0)
+    return 0.;
+
+  return static_cast<double>(total.m_emptyTiles) / tiles;
+}
+
+std::string geopx::tools::TileStatistics::getSummary() const
+{
+  TileLevelStatistics total = getTotal();
+
+  double seconds = getSeconds();
+
+  double stageTotal = 0.;
+
+  for(int s = 0; s < TILE_STAGE_COUNT; ++s)
+    stageTotal += getStageSeconds(static_cast<TileStage>(s));
+
+  std::ostringstream os;
+
+  os << std::fixed << std::setprecision(3)
+     << "Tile Generator Report" << std::endl << std::endl
+     << "Time: " << seconds << " s" << std::endl
+     << "Tiles stored: " << total.m_tiles << " (" << std::setprecision(1) << getTilesPerSecond() << " tiles/s)" << std::endl
+     << "Bytes written: " << total.m_bytes << std::endl
+     << "Empty tiles skipped: " << total.m_emptyTiles << " (" << getEmptyRatio() * 100. << " %)" << std::endl
+     << "Single color tiles: " << total.m_singleColorTiles << std::endl
+     << "Failed tiles: " << total.m_failedTiles << std::endl << std::endl;
+
+  os << std::left << std::setw(12) << "Stage" << std::right << std::setw(12) << "Seconds" << std::setw(10) << "Calls" << std::setw(10) << "Share" << std::endl;
+
+  for(int s = 0; s < TILE_STAGE_COUNT; ++s)
+  {
+    TileStage stage = static_cast<TileStage>(s);
+
+    double stageSeconds = getStageSeconds(stage);
+
+    os << std::left << std::setw(12) << GetStageName(stage) << std::right
+       << std::setprecision(3) << std::setw(12) << stageSeconds
+       << std::setw(10) << getStageCalls(stage)
+       << std::setprecision(1) << std::setw(8) << (stageTotal > 0. ? stageSeconds * 100. / stageTotal : 0.) << " %" << std::endl;
+  }
+
+  os << std::endl
+     << std::left << std::setw(12) << "Level" << std::right << std::setw(10) << "Tiles" << std::setw(10) << "Empty"
+     << std::setw(10) << "Failed" << std::setw(14) << "Bytes" << std::setw(12) << "Seconds" << std::endl;
+
+  for(int i = getMaxLevel(); i >= getMinLevel(); --i)
+  {
+    TileLevelStatistics level = getLevel(i);
+
+    os << std::left << std::setw(12) << i << std::right << std::setw(10) << level.m_tiles << std::setw(10) << level.m_emptyTiles
+       << std::setw(10) << level.m_failedTiles << std::setw(14) << level.m_bytes
+       << std::setprecision(3) << std::setw(12) << level.m_seconds << std::endl;
+  }
+
+  return os.str();
+}
+
+void geopx::tools::TileStatistics::writeJSON(std::ostream& os) const
+{
+  TileLevelStatistics total = getTotal();
+
+  //the document is written by hand, the property tree writer quotes the numbers
+  os << std::fixed << std::setprecision(6)
+     << "{" << std::endl
+     << "  \"seconds\": " << getSeconds() << "," << std::endl
+     << "  \"tiles\": " << total.m_tiles << "," << std::endl
+     << "  \"tilesPerSecond\": " << getTilesPerSecond() << "," << std::endl
+     << "  \"bytes\": " << total.m_bytes << "," << std::endl
+     << "  \"emptyTiles\": " << total.m_emptyTiles << "," << std::endl
+     << "  \"emptyRatio\": " << getEmptyRatio() << "," << std::endl
+     << "  \"singleColorTiles\": " << total.m_singleColorTiles << "," << std::endl
+     << "  \"failedTiles\": " << total.m_failedTiles << "," << std::endl
+     << "  \"stages\": {" << std::endl;
+
+  for(int s = 0; s < TILE_STAGE_COUNT; ++s)
+  {
+    TileStage stage = static_cast<TileStage>(s);
+
+    os << "    \"" << GetStageName(stage) << "\": { \"seconds\": " << getStageSeconds(stage) << ", \"calls\": " << getStageCalls(stage) << " }"
+       << (s + 1 < TILE_STAGE_COUNT ? "," : "") << std::endl;
+  }
+
+  os << "  }," << std::endl
+     << "  \"levels\": [" << std::endl;
+
+  for(int i = getMaxLevel(); i >= getMinLevel(); --i)
+  {
+    TileLevelStatistics level = getLevel(i);
+
+    os << "    { \"level\": " << i << ", \"tiles\": " << level.m_tiles << ", \"emptyTiles\": " << level.m_emptyTiles
+       << ", \"singleColorTiles\": " << level.m_singleColorTiles << ", \"failedTiles\": " << level.m_failedTiles
+       << ", \"bytes\": " << level.m_bytes << ", \"seconds\": " << level.m_seconds << " }"
+       << (i > getMinLevel() ? "," : "") << std::endl;
+  }
+
+  os << "  ]" << std::endl
+     << "}" << std::endl;
+}
+
+void geopx::tools::TileStatistics::writeReport(const std::string& summaryFile, const std::string& jsonFile) const
+{
+  std::ofstream summary(summaryFile.c_str());
+
+  if(!summary)
+    throw te::core::Exception() << te::ErrorDescription("Error creating the report file " + summaryFile + ".");
+
+  summary << getSummary();
+
+  std::ofstream json(jsonFile.c_str());
+
+  if(!json)
+    throw te::core::Exception() << te::ErrorDescription("Error creating the report file " + jsonFile + ".");
+
+  writeJSON(json);
+}
+
+const char* geopx::tools::TileStatistics::GetStageName(TileStage stage)
+{
+  switch(stage)
+  {
+    case TILE_STAGE_DRAW:
+      return "draw";
+    case TILE_STAGE_DOWNSAMPLE:
+      return "downsample";
+    case TILE_STAGE_QUEUE:
+      return "queue";
+    case TILE_STAGE_ENCODE:
+      return "encode";
+    case TILE_STAGE_WRITE:
+      return "write";
+    default:
+      return "";
+  }
+}
+
+geopx::tools::TileLevelStatistics* geopx::tools::TileStatistics::getLevelCounters(int level)
+{
+  if(level < m_minLevel || level > m_maxLevel)
+    return 0;
+
+  return &m_levels[static_cast<std::size_t>(level - m_minLevel)];
+}
+
+geopx::tools::TileStageTimer::TileStageTimer(TileStatistics* statistics, TileStage stage, int level) :
+  m_statistics(statistics),
+  m_stage(stage),
+  m_level(level)
+{
+  if(m_statistics)
+    m_start = std::chrono::steady_clock::now();
+}
+
+geopx::tools::TileStageTimer::~TileStageTimer()
+{
+  if(m_statistics)
+    m_statistics->addTime(m_stage, m_level, std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count());
+}
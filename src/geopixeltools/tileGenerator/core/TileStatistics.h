@@ -0,0 +1,179 @@
+/*!
+  \file geopx-desktop/src/geopixeltools/tileGenerator/core/TileStatistics.h
+
+  \brief This file contains the counters and stage timers of a tile generation run.
+*/
+
+#ifndef __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILESTATISTICS_H
+#define __GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILESTATISTICS_H
+
+#include "../../Config.h"
+
+//STL Includes
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace geopx
+{
+  namespace tools
+  {
+    /*!
+      \enum TileStage
+
+      \brief The stages of the tile pipeline that are timed.
+    */
+    enum TileStage
+    {
+      TILE_STAGE_DRAW,            //!< Layers drawn (data source queries and rasterization) or raster read.
+      TILE_STAGE_DOWNSAMPLE,      //!< Parent tiles built from their children.
+      TILE_STAGE_QUEUE,           //!< Drawing threads waiting for a place in the encoder queue.
+      TILE_STAGE_ENCODE,          //!< Images encoded.
+      TILE_STAGE_WRITE,           //!< Tiles written to the sink.
+      TILE_STAGE_COUNT
+    };
+
+    /*!
+      \struct TileLevelStatistics
+
+      \brief The counters of a zoom level.
+    */
+    struct TileLevelStatistics
+    {
+      TileLevelStatistics() : m_tiles(0), m_emptyTiles(0), m_singleColorTiles(0), m_failedTiles(0), m_bytes(0), m_seconds(0.) {}
+
+      std::size_t m_tiles;                //!< Tiles stored.
+      std::size_t m_emptyTiles;           //!< Empty tiles not stored.
+      std::size_t m_singleColorTiles;     //!< Tiles stored with the encoding of their color.
+      std::size_t m_failedTiles;          //!< Tiles that could not be drawn, encoded or written.
+      unsigned long long m_bytes;         //!< Bytes given to the sink.
+      double m_seconds;                   //!< Time of all stages spent on the level (summed over the threads).
+    };
+
+    /*!
+      \class TileStatistics
+
+      \brief Counts the tiles of a run and the time spent in each stage of the pipeline.
+
+      The stage times are summed over the threads, so with many threads they are larger than
+      the run time; their shares tell which stage limits the run. The bytes are the encoded
+      data given to the sink, the duplicated tiles are counted for each tile.
+
+      \note The counters can be changed by many threads at the same time.
+    */
+    class GEOPXTOOLSEXPORT TileStatistics
+    {
+      public:
+
+        TileStatistics();
+
+        ~TileStatistics();
+
+      public:
+
+        /*! \brief Clears the counters and starts the run clock. */
+        void start(int minLevel, int maxLevel);
+
+        /*! \brief Stops the run clock. */
+        void stop();
+
+        /*! \brief Adds the time of a call of a stage, spent on a tile (or block of tiles) of the level. */
+        void addTime(TileStage stage, int level, double seconds);
+
+        /*! \brief Counts a tile stored with the size of its data. */
+        void addStored(int level, std::size_t bytes);
+
+        void addEmpty(int level);
+
+        void addSingleColor(int level);
+
+        void addFailed(int level, std::size_t tiles = 1);
+
+        /*! \brief Returns the run time, up to now if the run was not stopped. */
+        double getSeconds() const;
+
+        /*! \brief Returns the time of a stage, summed over the threads. */
+        double getStageSeconds(TileStage stage) const;
+
+        /*! \brief Returns the number of calls of a stage. */
+        std::size_t getStageCalls(TileStage stage) const;
+
+        /*! \brief Returns the counters of all levels added. */
+        TileLevelStatistics getTotal() const;
+
+        /*! \brief Returns the counters of a level, zero counters for a level outside the run. */
+        TileLevelStatistics getLevel(int level) const;
+
+        int getMinLevel() const;
+
+        int getMaxLevel() const;
+
+        /*! \brief Returns the tiles stored by second of the run. */
+        double getTilesPerSecond() const;
+
+        /*! \brief Returns the share of the empty tiles among the tiles stored and skipped. */
+        double getEmptyRatio() const;
+
+        /*! \brief Returns a text report with the totals, the stage times and the level counters. */
+        std::string getSummary() const;
+
+        /*! \brief Writes the counters as a JSON document. */
+        void writeJSON(std::ostream& os) const;
+
+        /*! \brief Writes the text report and the JSON document to files, throws if a file can not be written. */
+        void writeReport(const std::string& summaryFile, const std::string& jsonFile) const;
+
+        /*! \brief Returns the name of a stage, used as key in the reports. */
+        static const char* GetStageName(TileStage stage);
+
+      protected:
+
+        /*! \brief Returns the counters of a level, the lock must be held. */
+        TileLevelStatistics* getLevelCounters(int level);
+
+      protected:
+
+        int m_minLevel;
+        int m_maxLevel;
+
+        std::chrono::steady_clock::time_point m_start;    //!< Start of the run.
+        std::chrono::steady_clock::time_point m_stop;     //!< End of the run.
+        bool m_running;                                   //!< True until the run is stopped.
+
+        double m_stageSeconds[TILE_STAGE_COUNT];          //!< Time of each stage.
+        std::size_t m_stageCalls[TILE_STAGE_COUNT];       //!< Calls of each stage.
+
+        std::vector<TileLevelStatistics> m_levels;        //!< Counters of each level, from the minimum level.
+
+        mutable std::mutex m_mutex;                       //!< Protects the counters.
+    };
+
+    /*!
+      \class TileStageTimer
+
+      \brief Adds the time from its construction to its destruction to a stage of the statistics.
+    */
+    class GEOPXTOOLSEXPORT TileStageTimer
+    {
+      public:
+
+        /*! \param statistics The statistics, nothing is timed if it is null. */
+        TileStageTimer(TileStatistics* statistics, TileStage stage, int level);
+
+        ~TileStageTimer();
+
+      private:
+
+        TileStatistics* m_statistics;
+        TileStage m_stage;
+        int m_level;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+  } // end namespace tools
+} // end namespace geopx
+
+#endif //__GEOPXDESKTOP_TOOLS_TILEGENERATOR_TILESTATISTICS_H
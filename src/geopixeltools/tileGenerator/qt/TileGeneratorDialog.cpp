@@ -6,6 +6,7 @@
 
 #include "TileGeneratorDialog.h"
 #include "ui_TileGeneratorDialogForm.h"
+#include "../core/TileEncoder.h"
 #include "../core/TileGeneratorService.h"
 
 // TerraLib
@@ -56,19 +57,36 @@ geopx::tools::TileGeneratorDialog::TileGeneratorDialog(QWidget* parent, Qt::Wind
   m_action->setEnabled(true);
   m_action->setObjectName("tileGen_boxTool");
 
+  //the changed areas are acquired from the map display too, each box is added to the update
+  m_changedAction = new QAction(this);
+  m_changedAction->setIcon(QIcon::fromTheme("pointer"));
+  m_changedAction->setToolTip("Acquire a changed area from map display.");
+  m_changedAction->setCheckable(true);
+  m_changedAction->setEnabled(true);
+  m_changedAction->setObjectName("tileGen_changedBoxTool");
+
   //connects
   connect(m_action, SIGNAL(triggered(bool)), this, SLOT(onToolButtonClicked(bool)));
+  connect(m_changedAction, SIGNAL(triggered(bool)), this, SLOT(onChangedToolButtonClicked(bool)));
   connect(m_ui->m_dirToolButton, SIGNAL(clicked()), this, SLOT(onDirToolButtonClicked()));
   connect(m_ui->m_validatePushButton, SIGNAL(clicked()), this, SLOT(onValidatePushButtonClicked()));
   connect(m_ui->m_okPushButton, SIGNAL(clicked()), this, SLOT(onOkPushButtonClicked()));
+  connect(m_ui->m_updatePushButton, SIGNAL(clicked()), this, SLOT(onUpdatePushButtonClicked()));
+  connect(m_ui->m_formatComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(onFormatComboBoxChanged(int)));
+
+  onFormatComboBoxChanged(m_ui->m_formatComboBox->currentIndex());
 
   // Get the action group of map tools.
   m_ui->m_toolButton->setDefaultAction(m_action);
+  m_ui->m_changedToolButton->setDefaultAction(m_changedAction);
 
   QActionGroup* toolsGroup = te::qt::af::AppCtrlSingleton::getInstance().findActionGroup("Map.ToolsGroup");
   
   if (toolsGroup)
+  {
     toolsGroup->addAction(m_action);
+    toolsGroup->addAction(m_changedAction);
+  }
   
   m_clearTool = false;
 }
@@ -130,6 +148,32 @@ void geopx::tools::TileGeneratorDialog::onToolButtonClicked(bool flag)
   m_clearTool = true;
 }
 
+void geopx::tools::TileGeneratorDialog::onChangedEnvelopeAcquired(te::gm::Envelope env)
+{
+  m_changedEnvs.push_back(env);
+
+  m_ui->m_updatePushButton->setText(tr("Update (%1)").arg(m_changedEnvs.size()));
+}
+
+void geopx::tools::TileGeneratorDialog::onChangedToolButtonClicked(bool flag)
+{
+  if (!flag)
+  {
+    m_clearTool = false;
+    return;
+  }
+
+  if (!m_appDisplay)
+    return;
+
+  te::qt::widgets::ExtentAcquire* ea = new te::qt::widgets::ExtentAcquire(m_appDisplay->getDisplay(), Qt::BlankCursor);
+  m_appDisplay->getDisplay()->setCurrentTool(ea);
+
+  connect(ea, SIGNAL(extentAcquired(te::gm::Envelope)), this, SLOT(onChangedEnvelopeAcquired(te::gm::Envelope)));
+
+  m_clearTool = true;
+}
+
 void geopx::tools::TileGeneratorDialog::onDirToolButtonClicked()
 {
   QString dirName = QFileDialog::getExistingDirectory(this, tr("Select a directory to save tiles"), "", QFileDialog::ShowDirsOnly);
@@ -174,7 +218,7 @@ void geopx::tools::TileGeneratorDialog::onValidatePushButtonClicked()
 
   try
   {
-    service.setInputParameters(m_layerList, m_env, m_srid, m_ui->m_zoomMinSpinBox->value(), m_ui->m_zoomMaxSpinBox->value(), tileSize, path, format);
+    setServiceParameters(service, tileSize, path, format);
 
     service.runValidation(createMissingTiles);
   }
@@ -192,7 +236,69 @@ void geopx::tools::TileGeneratorDialog::onValidatePushButtonClicked()
   QMessageBox::information(this, tr("Information"), tr("Tile Validation done!"));
 }
 
+void geopx::tools::TileGeneratorDialog::setServiceParameters(geopx::tools::TileGeneratorService& service, int tileSize, const std::string& path, const std::string& format)
+{
+  service.setInputParameters(m_layerList, m_env, m_srid, m_ui->m_zoomMinSpinBox->value(), m_ui->m_zoomMaxSpinBox->value(), tileSize, path, format);
+
+  if(m_ui->m_mbtilesCheckBox->isChecked())
+    service.setStoreType(geopx::tools::TILE_STORE_MBTILES);
+
+  if(m_ui->m_transparentCheckBox->isChecked())
+  {
+    service.setBackgroundColor(Qt::transparent);
+    service.setSkipEmptyTiles(true);
+  }
+
+  service.setLinkDuplicateTiles(m_ui->m_linkCheckBox->isChecked());
+
+  service.setMetatileSize(m_ui->m_metatileSpinBox->value());
+
+  service.setNumberOfThreads(m_ui->m_threadsSpinBox->value());
+
+  service.setEncoder(buildEncoder(format));
+
+  service.setDirectRasterReading(m_ui->m_directRasterCheckBox->isChecked());
+}
+
+geopx::tools::TileEncoder* geopx::tools::TileGeneratorDialog::buildEncoder(const std::string& format)
+{
+  if(m_ui->m_paletteCheckBox->isChecked() && QString(format.c_str()).compare("png", Qt::CaseInsensitive) == 0)
+    return new geopx::tools::PaletteTileEncoder(256, m_ui->m_compressionSpinBox->value());
+
+  //the quality is used by the lossy formats and the compression by PNG
+  geopx::tools::ImageTileEncoder* encoder = new geopx::tools::ImageTileEncoder(format, m_ui->m_qualitySpinBox->value());
+  encoder->setCompression(m_ui->m_compressionSpinBox->value());
+
+  return encoder;
+}
+
+void geopx::tools::TileGeneratorDialog::onFormatComboBoxChanged(int index)
+{
+  //each option only applies to some formats
+  bool png = m_ui->m_formatComboBox->itemText(index).compare("png", Qt::CaseInsensitive) == 0;
+
+  m_ui->m_qualitySpinBox->setEnabled(!png);
+  m_ui->m_compressionSpinBox->setEnabled(png);
+  m_ui->m_paletteCheckBox->setEnabled(png);
+}
+
 void geopx::tools::TileGeneratorDialog::onOkPushButtonClicked()
+{
+  generateTiles(false);
+}
+
+void geopx::tools::TileGeneratorDialog::onUpdatePushButtonClicked()
+{
+  if(m_changedEnvs.empty())
+  {
+    QMessageBox::warning(this, tr("Warning"), tr("Acquire the changed areas from the map display first."));
+    return;
+  }
+
+  generateTiles(true);
+}
+
+void geopx::tools::TileGeneratorDialog::generateTiles(bool update)
 {
   //get dir info
   if(m_ui->m_dirLineEdit->text().isEmpty())
@@ -230,9 +336,13 @@ void geopx::tools::TileGeneratorDialog::onOkPushButtonClicked()
 
   try
   {
-    service.setInputParameters(m_layerList, m_env, m_srid, m_ui->m_zoomMinSpinBox->value(), m_ui->m_zoomMaxSpinBox->value(), tileSize, path, format);
+    setServiceParameters(service, tileSize, path, format);
 
-    service.runService(isRaster);
+    //the update regenerates the tiles of the changed areas in the existing store
+    if(update)
+      service.runIncremental(m_changedEnvs, isRaster);
+    else
+      service.runService(isRaster);
   }
   catch(std::exception e)
   {
@@ -245,7 +355,23 @@ void geopx::tools::TileGeneratorDialog::onOkPushButtonClicked()
     return;
   }
 
-  QMessageBox::information(this, tr("Information"), tr("Tile Generation done!"));
+  //the full report is written to the output path
+  const geopx::tools::TileStatistics& statistics = service.getStatistics();
+
+  QString message = (update ? tr("Tile Update done!") : tr("Tile Generation done!")) + "\n\n" +
+                    tr("%1 tiles stored in %2 s (%3 tiles/s), %4 empty tiles skipped.")
+                    .arg(statistics.getTotal().m_tiles).arg(statistics.getSeconds(), 0, 'f', 1)
+                    .arg(statistics.getTilesPerSecond(), 0, 'f', 1).arg(statistics.getTotal().m_emptyTiles) + "\n" +
+                    tr("Report: %1").arg(QString::fromStdString(path + "/" + TILE_REPORT_FILE));
+
+  QMessageBox::information(this, tr("Information"), message);
+
+  if(update)
+  {
+    m_changedEnvs.clear();
+    m_ui->m_updatePushButton->setText(tr("Update"));
+    return;
+  }
 
   accept();
 }
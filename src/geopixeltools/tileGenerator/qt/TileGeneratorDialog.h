@@ -16,6 +16,7 @@
 
 // STL
 #include <memory>
+#include <vector>
 
 // Qt
 #include <QDialog>
@@ -26,6 +27,9 @@ namespace geopx
 {
   namespace tools
   {
+    //forward declarations
+    class TileEncoder;
+    class TileGeneratorService;
 
     /*!
       \class TileGeneratorDialog
@@ -62,6 +66,25 @@ namespace geopx
 
         void onOkPushButtonClicked();
 
+        void onChangedEnvelopeAcquired(te::gm::Envelope env);
+
+        void onChangedToolButtonClicked(bool flag);
+
+        void onUpdatePushButtonClicked();
+
+        void onFormatComboBoxChanged(int index);
+
+      protected:
+
+        /*! \brief Creates the encoder of the tiles from the format and the encoder options. */
+        geopx::tools::TileEncoder* buildEncoder(const std::string& format);
+
+        /*! \brief Sets the parameters of the service from the dialog options. */
+        void setServiceParameters(geopx::tools::TileGeneratorService& service, int tileSize, const std::string& path, const std::string& format);
+
+        /*! \brief Generates all tiles, or updates the tiles of the changed areas in the existing store. */
+        void generateTiles(bool update);
+
       private:
 
         std::unique_ptr<Ui::TileGeneratorDialogForm> m_ui;
@@ -72,10 +95,14 @@ namespace geopx
 
         te::gm::Envelope m_env;
 
+        std::vector<te::gm::Envelope> m_changedEnvs;      //!< Changed areas, in the SRID of the extent.
+
         int m_srid;
 
         QAction* m_action;
 
+        QAction* m_changedAction;
+
         bool m_clearTool;
     }; 
 